@@ -11,13 +11,16 @@ Part of Core Audio AUBase Classes
 #include "AUInputElement.h"
 #include "AUOutputElement.h"
 #include <algorithm>
+#include <condition_variable>
+#include <mutex>
 #include <syslog.h>
+#include <thread>
 #include "CAAudioChannelLayout.h"
 #include "CAHostTimeBase.h"
 #include "CAVectorUnit.h"
 #include "CAXException.h"
 
-#if TARGET_OS_MAC && (TARGET_CPU_X86 || TARGET_CPU_X86_64)
+#if (TARGET_OS_MAC || TARGET_OS_LINUX) && (TARGET_CPU_X86 || TARGET_CPU_X86_64)
 	// our compiler does ALL floating point with SSE
 	inline int  GETCSR ()    { int _result; asm volatile ("stmxcsr %0" : "=m" (*&_result) ); return _result; }
 	inline void SETCSR (int a)    { int _temp = a; asm volatile( "ldmxcsr %0" : : "m" (*&_temp ) ); }
@@ -46,6 +49,293 @@ static CFStringRef kPartString = NULL;
 
 SInt32 AUBase::sVectorUnitType = kVecUninitialized;
 
+// the size of the buffer GetLoggingString allocates
+static const size_t kLogStringSize = 256;
+
+// Render calls in progress on this thread, across all units: DoRender of one unit can pull
+// another through a host callback.
+static thread_local UInt32 sRenderCallDepth = 0;
+
+struct AURenderCallScope {
+	AURenderCallScope() { ++sRenderCallDepth; }
+	~AURenderCallScope() { --sRenderCallDepth; }
+};
+
+//_____________________________________________________________________________
+//
+//	The process-wide thread that delivers queued property changes for the units that use it.
+//	The render thread never wakes it (that could mean a system call and a lock), so while any unit
+//	is registered it also looks at the queues every kPollInterval; other threads wake it at once.
+//	It delivers without mMutex held: a unit's listeners run under the unit's own listeners mutex,
+//	and a listener holding that on another thread may uninitialize the unit, which unregisters it.
+//	Only a unit going away waits for a delivery to it in progress (Unregister with inWait); a
+//	listener must not dispose of the unit it is called for.
+class AUPropertyNotifier {
+public:
+	static AUPropertyNotifier &	Shared()
+	{
+		// never destroyed: the thread may still be waiting when the process exits
+		static AUPropertyNotifier *sShared = new AUPropertyNotifier;
+		return *sShared;
+	}
+	
+	void	Register(AUBase *inUnit)
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		if (std::find(mUnits.begin(), mUnits.end(), inUnit) == mUnits.end())
+			mUnits.push_back(inUnit);
+		if (!mThreadStarted) {
+			std::thread(&AUPropertyNotifier::Run, this).detach();
+			mThreadStarted = true;
+		}
+		// a polling thread finds the unit by itself; waking it for every Initialize would cost a
+		// context switch each time a host brings up a unit
+		if (mIdle)
+			mCondition.notify_one();
+	}
+	
+	void	Unregister(AUBase *inUnit, bool inWait)
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		mUnits.erase(std::remove(mUnits.begin(), mUnits.end(), inUnit), mUnits.end());
+		if (inWait)
+			mDelivered.wait(lock, [this, inUnit] { return mDelivering != inUnit; });
+	}
+	
+	void	Wake()
+	{
+		std::lock_guard<std::mutex> lock(mMutex);
+		mWake = true;
+		mCondition.notify_one();
+	}
+	
+private:
+	enum { kPollInterval = 10 };	// milliseconds
+	
+	AUPropertyNotifier() : mDelivering(NULL), mThreadStarted(false), mWake(false), mIdle(false) { }
+	
+	void	Run()
+	{
+		std::unique_lock<std::mutex> lock(mMutex);
+		for (;;) {
+			if (mUnits.empty()) {
+				mIdle = true;
+				mCondition.wait(lock, [this] { return !mUnits.empty(); });
+				mIdle = false;
+			} else
+				mCondition.wait_for(lock, std::chrono::milliseconds(kPollInterval), [this] { return mWake; });
+			mWake = false;
+			// units may register and unregister while a delivery runs; go on after the one served
+			size_t i = 0;
+			while (i < mUnits.size()) {
+				AUBase *unit = mUnits[i];
+				mDelivering = unit;
+				lock.unlock();
+				unit->DeliverPropertyChanges();
+				lock.lock();
+				mDelivering = NULL;
+				mDelivered.notify_all();
+				std::vector<AUBase *>::iterator served = std::find(mUnits.begin(), mUnits.end(), unit);
+				if (served != mUnits.end())
+					i = (served - mUnits.begin()) + 1;
+			}
+		}
+	}
+	
+	std::mutex						mMutex;
+	std::condition_variable			mCondition;
+	std::condition_variable			mDelivered;		// mDelivering went back to NULL
+	std::vector<AUBase *>			mUnits;
+	AUBase *						mDelivering;	// whose changes Run is delivering
+	bool							mThreadStarted;
+	bool							mWake;
+	bool							mIdle;			// waiting for a unit to register, not polling
+};
+
+//_____________________________________________________________________________
+//
+bool				AUPropertyChangeQueue::Post(	AudioUnitPropertyID				inID,
+													AudioUnitScope					inScope,
+													AudioUnitElement				inElement)
+{
+	const UInt32 mask = kCapacity - 1;
+	const UInt32 start = (inID * 31 + inScope * 7 + inElement) & mask;
+	
+	for (UInt32 attempt = 0; attempt < kCapacity; ++attempt) {
+		Slot *freeSlot = NULL;
+		UInt32 freeState = 0;
+		// look at every slot: the change may be pending past a slot that was drained since
+		for (UInt32 i = 0; i < kCapacity; ++i) {
+			Slot &slot = mSlots[(start + i) & mask];
+			UInt32 state = slot.mState.load(std::memory_order_acquire);
+			if ((state & kSlotStateMask) == kSlotPending) {
+				bool match = slot.mID.load(std::memory_order_relaxed) == inID &&
+							 slot.mScope.load(std::memory_order_relaxed) == inScope &&
+							 slot.mElement.load(std::memory_order_relaxed) == inElement;
+				std::atomic_thread_fence(std::memory_order_acquire);
+				// still pending, so the listeners will run after this change was made
+				if (match && slot.mState.load(std::memory_order_relaxed) == state)
+					return true;
+			} else if ((state & kSlotStateMask) == kSlotFree && freeSlot == NULL) {
+				freeSlot = &slot;
+				freeState = state;
+			}
+		}
+		if (freeSlot == NULL)
+			return false;
+		
+		UInt32 claimed = (freeState & ~UInt32(kSlotStateMask)) + kSlotGeneration;
+		if (freeSlot->mState.compare_exchange_strong(freeState, claimed | kSlotWriting, std::memory_order_acquire)) {
+			freeSlot->mID.store(inID, std::memory_order_relaxed);
+			freeSlot->mScope.store(inScope, std::memory_order_relaxed);
+			freeSlot->mElement.store(inElement, std::memory_order_relaxed);
+			freeSlot->mState.store(claimed | kSlotPending, std::memory_order_release);
+			mPending.fetch_add(1, std::memory_order_release);
+			return true;
+		}
+	}
+	return false;
+}
+
+//_____________________________________________________________________________
+//
+UInt32				AUPropertyChangeQueue::Drain(	Change *						outChanges,
+													UInt32							inMaxChanges)
+{
+	UInt32 count = 0;
+	for (UInt32 i = 0; i < kCapacity && count < inMaxChanges && !IsEmpty(); ++i) {
+		Slot &slot = mSlots[i];
+		UInt32 state = slot.mState.load(std::memory_order_acquire);
+		if ((state & kSlotStateMask) != kSlotPending)
+			continue;
+		Change &change = outChanges[count];
+		change.mID = slot.mID.load(std::memory_order_relaxed);
+		change.mScope = slot.mScope.load(std::memory_order_relaxed);
+		change.mElement = slot.mElement.load(std::memory_order_relaxed);
+		// a posting thread that sees the slot pending after this relies on the listeners running later
+		if (slot.mState.compare_exchange_strong(state, (state & ~UInt32(kSlotStateMask)) | kSlotFree,
+												std::memory_order_acq_rel)) {
+			mPending.fetch_sub(1, std::memory_order_relaxed);
+			++count;
+		}
+	}
+	return count;
+}
+
+//_____________________________________________________________________________
+//
+AURenderNotifyList::~AURenderNotifyList()
+{
+	Reclaim();
+	free(mCurrent.load(std::memory_order_relaxed));
+}
+
+//_____________________________________________________________________________
+//
+OSStatus			AURenderNotifyList::Add(AURenderCallback inProc, void *inRefCon)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	const Snapshot *current = mCurrent.load(std::memory_order_relaxed);
+	UInt32 count = current ? current->mCount : 0;
+	for (UInt32 i = 0; i < count; ++i)
+		if (current->mCallbacks[i].mProc == inProc && current->mCallbacks[i].mRefCon == inRefCon)
+			return noErr;
+	
+	Snapshot *snapshot = static_cast<Snapshot *>(malloc(offsetof(Snapshot, mCallbacks) + (count + 1) * sizeof(Callback)));
+	if (snapshot == NULL)
+		return kAudio_MemFullError;
+	if (count)
+		memcpy(snapshot->mCallbacks, current->mCallbacks, count * sizeof(Callback));
+	snapshot->mCallbacks[count].mProc = inProc;
+	snapshot->mCallbacks[count].mRefCon = inRefCon;
+	snapshot->mCount = count + 1;
+	Publish(snapshot);
+	return noErr;
+}
+
+//_____________________________________________________________________________
+//
+void				AURenderNotifyList::Remove(AURenderCallback inProc, void *inRefCon)
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	const Snapshot *current = mCurrent.load(std::memory_order_relaxed);
+	if (current == NULL)
+		return;
+	UInt32 index = 0;
+	while (index < current->mCount &&
+			!(current->mCallbacks[index].mProc == inProc && current->mCallbacks[index].mRefCon == inRefCon))
+		++index;
+	if (index == current->mCount)
+		return;
+	
+	Snapshot *snapshot = NULL;
+	if (current->mCount > 1) {
+		// keeps the old array if this fails: the notification stays rather than the host's memory leaking
+		snapshot = static_cast<Snapshot *>(malloc(offsetof(Snapshot, mCallbacks) + (current->mCount - 1) * sizeof(Callback)));
+		if (snapshot == NULL)
+			return;
+		memcpy(snapshot->mCallbacks, current->mCallbacks, index * sizeof(Callback));
+		memcpy(snapshot->mCallbacks + index, current->mCallbacks + index + 1, (current->mCount - index - 1) * sizeof(Callback));
+		snapshot->mCount = current->mCount - 1;
+	}
+	Publish(snapshot);
+}
+
+//_____________________________________________________________________________
+//
+UInt32				AURenderNotifyList::GetAllocatedBytes() const
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	UInt32 bytes = 0;
+	const Snapshot *current = mCurrent.load(std::memory_order_relaxed);
+	if (current != NULL)
+		bytes += offsetof(Snapshot, mCallbacks) + current->mCount * sizeof(Callback);
+	for (const Snapshot *retired = mRetired; retired != NULL; retired = retired->mNextRetired)
+		bytes += offsetof(Snapshot, mCallbacks) + retired->mCount * sizeof(Callback);
+	return bytes;
+}
+
+//_____________________________________________________________________________
+//
+//	Makes inSnapshot (NULL for an empty list) current and retires the old one. Called with mMutex held.
+void				AURenderNotifyList::Publish(Snapshot *inSnapshot)
+{
+	if (inSnapshot != NULL)
+		inSnapshot->mNextRetired = NULL;
+	Snapshot *old = mCurrent.exchange(inSnapshot, std::memory_order_seq_cst);
+	if (old != NULL) {
+		old->mNextRetired = mRetired;
+		mRetired = old;
+	}
+	// the render thread marks an array before checking that it is current, so if it has old, this sees the mark
+	FreeRetired(mInUse.load(std::memory_order_seq_cst));
+}
+
+//_____________________________________________________________________________
+//
+void				AURenderNotifyList::Reclaim()
+{
+	std::lock_guard<std::mutex> lock(mMutex);
+	FreeRetired(NULL);
+}
+
+//_____________________________________________________________________________
+//
+//	Frees the retired arrays other than inKeep. Called with mMutex held.
+void				AURenderNotifyList::FreeRetired(const Snapshot *inKeep)
+{
+	Snapshot **link = &mRetired;
+	while (*link != NULL) {
+		Snapshot *snapshot = *link;
+		if (snapshot != inKeep) {
+			*link = snapshot->mNextRetired;
+			free(snapshot);
+		} else {
+			link = &snapshot->mNextRetired;
+		}
+	}
+}
+
 //_____________________________________________________________________________
 //
 AUBase::AUBase(	AudioComponentInstance			inInstance, 
@@ -61,11 +351,16 @@ AUBase::AUBase(	AudioComponentInstance			inInstance,
 	mInitNumGroupEls(numGroupElements),
 #endif
 	mRenderCallbacksTouched(false),
-	mRenderThreadID (NULL),
+	mRenderThreadID (0),
 	mWantsRenderThreadID (false),
 	mLastRenderError(0),
 	mUsesFixedBlockSize(false),
 	mBuffersAllocated(false),
+	mPropertyListenersMutex("AUBase property listeners"),
+	mPropertyNotificationMode(kAUPropertyNotification_Synchronous),
+	mUsesPropertyNotifier(false),
+	mUsesBufferArena(false),
+	mRetireIOBuffers(false),
 	mLogString (NULL),
     mNickName (NULL),
 	mAUMutex(NULL)
@@ -116,6 +411,8 @@ AUBase::AUBase(	AudioComponentInstance			inInstance,
 //
 AUBase::~AUBase()
 {
+	if (mUsesPropertyNotifier)
+		AUPropertyNotifier::Shared().Unregister(this, true);
 	if (mCurrentPreset.presetName) CFRelease (mCurrentPreset.presetName);
 #if !CA_NO_AU_UI_FEATURES
 	if (mContextName) CFRelease (mContextName);
@@ -174,6 +471,68 @@ void				AUBase::ReallocateBuffers()
 		input->AllocateBuffer();	// does no work if already allocated
 	}
 	mBuffersAllocated = true;
+
+	mUsesBufferArena = AUBufferArena::IsEnabled();
+	mRetireIOBuffers = false;
+	if (mUsesBufferArena)
+		ReserveArenaBuffers();
+}
+
+//_____________________________________________________________________________
+//
+void				AUBase::ReserveArenaBuffers()
+{
+	// enough blocks for this unit to borrow all its buffers at once
+	std::vector<UInt32> arenaBytes;
+	UInt32 nOutputs = Outputs().GetNumberOfElements();
+	for (UInt32 i = 0; i < nOutputs; ++i)
+		if (UInt32 bytes = GetOutput(i)->GetBufferBytes())
+			arenaBytes.push_back(bytes);
+	UInt32 nInputs = Inputs().GetNumberOfElements();
+	for (UInt32 i = 0; i < nInputs; ++i)
+		if (UInt32 bytes = GetInput(i)->GetBufferBytes())
+			arenaBytes.push_back(bytes);
+	AUBufferArena::Reserve(arenaBytes.data(), UInt32(arenaBytes.size()));
+}
+
+//_____________________________________________________________________________
+//
+void				AUBase::RetireIOBuffers()
+{
+	UInt32 nOutputs = Outputs().GetNumberOfElements();
+	for (UInt32 i = 0; i < nOutputs; ++i)
+		GetOutput(i)->RetireBuffer();
+	UInt32 nInputs = Inputs().GetNumberOfElements();
+	for (UInt32 i = 0; i < nInputs; ++i)
+		GetInput(i)->RetireBuffer();
+	mUsesBufferArena = true;
+	mRetireIOBuffers = false;
+}
+
+//_____________________________________________________________________________
+//
+UInt32				AUBase::FreeRetiredIOBuffers()
+{
+	UInt32 bytes = 0;
+	UInt32 nOutputs = Outputs().GetNumberOfElements();
+	for (UInt32 i = 0; i < nOutputs; ++i)
+		bytes += GetOutput(i)->FreeRetiredBuffer();
+	UInt32 nInputs = Inputs().GetNumberOfElements();
+	for (UInt32 i = 0; i < nInputs; ++i)
+		bytes += GetInput(i)->FreeRetiredBuffer();
+	return bytes;
+}
+
+//_____________________________________________________________________________
+//
+void				AUBase::ReturnArenaBuffers(const AudioBufferList &inHandedOut)
+{
+	UInt32 nOutputs = Outputs().GetNumberOfElements();
+	for (UInt32 i = 0; i < nOutputs; ++i)
+		GetOutput(i)->ReturnArenaBuffer(inHandedOut);
+	UInt32 nInputs = Inputs().GetNumberOfElements();
+	for (UInt32 i = 0; i < nInputs; ++i)
+		GetInput(i)->ReturnArenaBuffer(inHandedOut);
 }
 
 //_____________________________________________________________________________
@@ -196,6 +555,33 @@ void				AUBase::DeallocateIOBuffers()
 	mBuffersAllocated = false;
 }
 
+//_____________________________________________________________________________
+//
+void				AUBase::GetMemoryUsage(AUMemoryUsage &outUsage) const
+{
+	memset(&outUsage, 0, sizeof(outUsage));
+	outUsage.mInstance = sizeof(AUBase);
+	for (UInt32 i = 0; i < kNumScopes; ++i)
+		mScopes[i].AddMemoryUsage(outUsage);
+	
+	outUsage.mOther += mParamList.capacity() * sizeof(AudioUnitParameterEvent);
+	outUsage.mOther += mRenderCallbacks.GetAllocatedBytes();
+	{
+		CAMutex::Locker lock(const_cast<CAMutex &>(mPropertyListenersMutex));
+		outUsage.mOther += mPropertyListeners.capacity() * sizeof(PropertyListener);
+	}
+	if (mLogString)
+		outUsage.mOther += kLogStringSize;
+	if (mNickName)
+		outUsage.mOther += CFStringGetLength(mNickName) * sizeof(UniChar);
+#if !CA_NO_AU_UI_FEATURES
+	if (mContextName)
+		outUsage.mOther += CFStringGetLength(mContextName) * sizeof(UniChar);
+#endif
+	if (mAUMutex)
+		outUsage.mOther += sizeof(CAMutex);
+}
+
 //_____________________________________________________________________________
 //
 OSStatus			AUBase::DoInitialize()
@@ -211,6 +597,7 @@ OSStatus			AUBase::DoInitialize()
 			ReallocateBuffers();	// calls CreateElements()
 			mInitialized = true;	// signal that it's okay to render
 			CAMemoryBarrier();
+			UpdatePropertyNotifier();
 		}
 	}
 
@@ -231,6 +618,10 @@ void				AUBase::PreDestructor()
 	// this is called from the ComponentBase dispatcher, which doesn't know anything about our (optional) lock
 	CAMutex::Locker lock(mAUMutex);
 	DoCleanup();
+	// no deliveries once the subclass starts going away, including one that started before an
+	// Uninitialize (this DoCleanup's, say) unregistered the unit
+	AUPropertyNotifier::Shared().Unregister(this, true);
+	mUsesPropertyNotifier = false;
 }
 
 //_____________________________________________________________________________
@@ -242,9 +633,11 @@ void				AUBase::DoCleanup()
 	
 	DeallocateIOBuffers();
 	ResetRenderTime ();
+	mRenderCallbacks.Reclaim();
 
 	mInitialized = false;
 	mHasBegunInitializing = false;
+	UpdatePropertyNotifier();
 }
 
 //_____________________________________________________________________________
@@ -1126,6 +1519,7 @@ OSStatus			AUBase::AddPropertyListener(	AudioUnitPropertyID				inID,
 													AudioUnitPropertyListenerProc	inProc,
 													void *							inProcRefCon)
 {
+	CAMutex::Locker lock(mPropertyListenersMutex);
 	PropertyListener pl;
 	
 	pl.propertyID = inID;
@@ -1146,6 +1540,7 @@ OSStatus			AUBase::RemovePropertyListener(		AudioUnitPropertyID				inID,
 														void *							inProcRefCon,
 														bool							refConSpecified)
 {
+	CAMutex::Locker lock(mPropertyListenersMutex);
 	// iterate in reverse so that it's safe to erase in the middle of the vector
 	for (int i = (int)mPropertyListeners.size(); --i >=0; ) {
 		PropertyListeners::iterator it = mPropertyListeners.begin() + i;
@@ -1161,9 +1556,99 @@ void				AUBase::PropertyChanged(			AudioUnitPropertyID				inID,
 														AudioUnitScope					inScope, 
 														AudioUnitElement				inElement)
 {
-	for (PropertyListeners::iterator it = mPropertyListeners.begin(); it != mPropertyListeners.end(); ++it)
-		if ((*it).propertyID == inID)
-			((*it).listenerProc)((*it).listenerRefCon, mComponentInstance, inID, inScope, inElement);
+	const bool rendering = InRenderCall() || InRenderThread();
+	if (mPropertyNotificationMode == kAUPropertyNotification_Synchronous && !rendering) {
+		CallPropertyListeners(inID, inScope, inElement);
+		return;
+	}
+	if (!mPropertyChanges.Post(inID, inScope, inElement)) {
+		// the queue is full of other changes; the render thread has to drop this one
+		if (!rendering && mPropertyNotificationMode != kAUPropertyNotification_HostPumped)
+			CallPropertyListeners(inID, inScope, inElement);
+		return;
+	}
+	if (mPropertyNotificationMode == kAUPropertyNotification_NotifierThread && !rendering)
+		AUPropertyNotifier::Shared().Wake();
+}
+
+//_____________________________________________________________________________
+//
+bool				AUBase::InRenderCall()
+{
+	return sRenderCallDepth != 0;
+}
+
+//_____________________________________________________________________________
+//
+void				AUBase::CallPropertyListeners(		AudioUnitPropertyID				inID,
+														AudioUnitScope					inScope,
+														AudioUnitElement				inElement)
+{
+	CAMutex::Locker lock(mPropertyListenersMutex);
+	// by index, on a copy: a listener may add or remove listeners
+	for (size_t i = 0; i < mPropertyListeners.size(); ++i) {
+		PropertyListener pl = mPropertyListeners[i];
+		if (pl.propertyID == inID)
+			(pl.listenerProc)(pl.listenerRefCon, mComponentInstance, inID, inScope, inElement);
+	}
+}
+
+//_____________________________________________________________________________
+//
+UInt32				AUBase::DeliverPropertyChanges(UInt32 inMaxChanges)
+{
+	if (InRenderCall() || InRenderThread())
+		return 0;
+	
+	UInt32 delivered = 0;
+	AUPropertyChangeQueue::Change changes[16];
+	while (inMaxChanges == 0 || delivered < inMaxChanges) {
+		UInt32 batch = 16;
+		if (inMaxChanges != 0)
+			batch = std::min(batch, inMaxChanges - delivered);
+		UInt32 count = mPropertyChanges.Drain(changes, batch);
+		if (count == 0)
+			break;
+		for (UInt32 i = 0; i < count; ++i)
+			CallPropertyListeners(changes[i].mID, changes[i].mScope, changes[i].mElement);
+		delivered += count;
+	}
+	return delivered;
+}
+
+//_____________________________________________________________________________
+//
+OSStatus			AUBase::SetPropertyNotificationMode(UInt32 inMode)
+{
+	if (inMode > kAUPropertyNotification_HostPumped)
+		return kAudio_ParamError;
+	if (InRenderCall() || InRenderThread())
+		return kAudioUnitErr_CannotDoInCurrentContext;
+	mPropertyNotificationMode = inMode;
+	UpdatePropertyNotifier();
+	if (inMode == kAUPropertyNotification_Synchronous)
+		DeliverPropertyChanges();
+	return noErr;
+}
+
+//_____________________________________________________________________________
+//
+//	The notifier thread serves units in NotifierThread mode, and Synchronous units while they are
+//	initialized, which is when they can render.
+void				AUBase::UpdatePropertyNotifier()
+{
+	bool wantsNotifier = mPropertyNotificationMode == kAUPropertyNotification_NotifierThread ||
+						 (mPropertyNotificationMode == kAUPropertyNotification_Synchronous && mInitialized);
+	if (wantsNotifier == mUsesPropertyNotifier)
+		return;
+	if (wantsNotifier)
+		AUPropertyNotifier::Shared().Register(this);
+	else
+		AUPropertyNotifier::Shared().Unregister(this, false);
+	mUsesPropertyNotifier = wantsNotifier;
+	// what the last render calls queued would otherwise wait for the next Initialize
+	if (mPropertyNotificationMode == kAUPropertyNotification_Synchronous)
+		DeliverPropertyChanges();
 }
 
 //_____________________________________________________________________________
@@ -1174,10 +1659,11 @@ OSStatus			AUBase::SetRenderNotification(	AURenderCallback		 		inProc,
 	if (inProc == NULL)
 		return kAudio_ParamError;
 
-	mRenderCallbacksTouched = true;
-	mRenderCallbacks.deferred_add(RenderCallback(inProc, inRefCon));
+	OSStatus result = mRenderCallbacks.Add(inProc, inRefCon);
 			// this will do nothing if it's already in the list
-	return noErr;
+	if (result == noErr)
+		mRenderCallbacksTouched.store(true, std::memory_order_relaxed);
+	return result;
 }
 
 //_____________________________________________________________________________
@@ -1185,7 +1671,7 @@ OSStatus			AUBase::SetRenderNotification(	AURenderCallback		 		inProc,
 OSStatus			AUBase::RemoveRenderNotification(	AURenderCallback			inProc,
 														void *						inRefCon)
 {
-	mRenderCallbacks.deferred_remove(RenderCallback(inProc, inRefCon));
+	mRenderCallbacks.Remove(inProc, inRefCon);
 	return noErr;	// error?
 }
 
@@ -1369,7 +1855,7 @@ void				AUBase::SetWantsRenderThreadID (bool inFlag)
 	
 	mWantsRenderThreadID = inFlag;
 	if (!mWantsRenderThreadID)
-		mRenderThreadID = NULL;
+		mRenderThreadID = 0;
 }
 
 //_____________________________________________________________________________
@@ -1383,8 +1869,9 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 											UInt32							inFramesToProcess,
 											AudioBufferList &				ioData)
 {
+	AURenderCallScope renderCall;
 	OSStatus theError;
-	RenderCallbackList::iterator rcit;
+	const AURenderNotifyList::Snapshot *notify = NULL;
 	
 	AUTRACE(kCATrace_AUBaseRenderStart, mComponentInstance, (uintptr_t)this, inBusNumber, inFramesToProcess, (uintptr_t)ioData.mBuffers[0].mData);
 	DISABLE_DENORMALS
@@ -1433,7 +1920,7 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 		
 		if (WantsRenderThreadID())
 		{
-			#if TARGET_OS_MAC
+			#if TARGET_OS_MAC || TARGET_OS_LINUX
 				mRenderThreadID = pthread_self();
 			#elif TARGET_OS_WIN32
 				mRenderThreadID = GetCurrentThreadId();
@@ -1441,36 +1928,41 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 		}
 		
 		AudioUnitRenderActionFlags flags;
-		if (mRenderCallbacksTouched) {
-			mRenderCallbacks.update();
+		const bool notifying = mRenderCallbacksTouched.load(std::memory_order_relaxed);
+		if (notifying) {
+			// the same array for pre and post render, even if the host changes the list in between
+			notify = mRenderCallbacks.Acquire();
 			flags = ioActionFlags | kAudioUnitRenderAction_PreRender;
-			for (rcit = mRenderCallbacks.begin(); rcit != mRenderCallbacks.end(); ++rcit) {
-				RenderCallback &rc = *rcit;
-				AUTRACE(kCATrace_AUBaseRenderCallbackStart, mComponentInstance, (intptr_t)this, (intptr_t)rc.mRenderNotify, 1, 0);
-				(*(AURenderCallback)rc.mRenderNotify)(rc.mRenderNotifyRefCon, 
+			for (UInt32 i = 0, n = notify ? notify->mCount : 0; i < n; ++i) {
+				const AURenderNotifyList::Callback &rc = notify->mCallbacks[i];
+				AUTRACE(kCATrace_AUBaseRenderCallbackStart, mComponentInstance, (intptr_t)this, (intptr_t)rc.mProc, 1, 0);
+				(*rc.mProc)(rc.mRefCon, 
 								&flags,
 								&inTimeStamp, inBusNumber, inFramesToProcess, &ioData);
-				AUTRACE(kCATrace_AUBaseRenderCallbackEnd, mComponentInstance, (intptr_t)this, (intptr_t)rc.mRenderNotify, 1, 0);
+				AUTRACE(kCATrace_AUBaseRenderCallbackEnd, mComponentInstance, (intptr_t)this, (intptr_t)rc.mProc, 1, 0);
 			}
 		}
 		
+		if (mRetireIOBuffers)
+			RetireIOBuffers();
 		theError = DoRenderBus(ioActionFlags, inTimeStamp, inBusNumber, output, inFramesToProcess, ioData);
 		
-		if (mRenderCallbacksTouched) {
+		if (notifying) {
 			flags = ioActionFlags | kAudioUnitRenderAction_PostRender;
 			
 			if (SetRenderError (theError)) {
 				flags |= kAudioUnitRenderAction_PostRenderError;		
 			}
 			
-			for (rcit = mRenderCallbacks.begin(); rcit != mRenderCallbacks.end(); ++rcit) {
-				RenderCallback &rc = *rcit;
-				AUTRACE(kCATrace_AUBaseRenderCallbackStart, mComponentInstance, (intptr_t)this, (intptr_t)rc.mRenderNotify, 2, 0);
-				(*(AURenderCallback)rc.mRenderNotify)(rc.mRenderNotifyRefCon, 
+			for (UInt32 i = 0, n = notify ? notify->mCount : 0; i < n; ++i) {
+				const AURenderNotifyList::Callback &rc = notify->mCallbacks[i];
+				AUTRACE(kCATrace_AUBaseRenderCallbackStart, mComponentInstance, (intptr_t)this, (intptr_t)rc.mProc, 2, 0);
+				(*rc.mProc)(rc.mRefCon, 
 								&flags,
 								&inTimeStamp, inBusNumber, inFramesToProcess, &ioData);
-				AUTRACE(kCATrace_AUBaseRenderCallbackEnd, mComponentInstance, (intptr_t)this, (intptr_t)rc.mRenderNotify, 2, 0);
+				AUTRACE(kCATrace_AUBaseRenderCallbackEnd, mComponentInstance, (intptr_t)this, (intptr_t)rc.mProc, 2, 0);
 			}
+			mRenderCallbacks.Release();
 		}
 
 		// The vector's being emptied
@@ -1490,6 +1982,8 @@ OSStatus			AUBase::DoRender(		AudioUnitRenderActionFlags &	ioActionFlags,
 		goto errexit;
 	}
 done:	
+	if (mUsesBufferArena)
+		ReturnArenaBuffers(ioData);
 	RESTORE_DENORMALS
 	AUTRACE(kCATrace_AUBaseRenderEnd, mComponentInstance, (intptr_t)this, theError, ioActionFlags, CATrace_ablData(ioData));
 	
@@ -1511,6 +2005,7 @@ OSStatus	AUBase::DoProcess (	AudioUnitRenderActionFlags  &		ioActionFlags,
 								UInt32								inFramesToProcess,
 								AudioBufferList &					ioData)
 {
+	AURenderCallScope renderCall;
 	OSStatus theError;
 	AUTRACE(kCATrace_AUBaseRenderStart, mComponentInstance, (intptr_t)this, -1, inFramesToProcess, 0);
 	DISABLE_DENORMALS
@@ -1552,7 +2047,7 @@ OSStatus	AUBase::DoProcess (	AudioUnitRenderActionFlags  &		ioActionFlags,
 		
 		if (WantsRenderThreadID())
 		{
-			#if TARGET_OS_MAC
+			#if TARGET_OS_MAC || TARGET_OS_LINUX
 				mRenderThreadID = pthread_self();
 			#elif TARGET_OS_WIN32
 				mRenderThreadID = GetCurrentThreadId();
@@ -1596,6 +2091,7 @@ OSStatus	AUBase::DoProcessMultiple (	AudioUnitRenderActionFlags  & ioActionFlags
 							   UInt32								inNumberOutputBufferLists,
 							   AudioBufferList **					ioOutputBufferLists)
 {
+	AURenderCallScope renderCall;
 	OSStatus theError;
 	DISABLE_DENORMALS
 	
@@ -1673,7 +2169,7 @@ OSStatus	AUBase::DoProcessMultiple (	AudioUnitRenderActionFlags  & ioActionFlags
 		
 		if (WantsRenderThreadID())
 		{
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 			mRenderThreadID = pthread_self();
 #elif TARGET_OS_WIN32
 			mRenderThreadID = GetCurrentThreadId();
@@ -2143,6 +2639,164 @@ OSStatus			AUBase::RestoreState(	CFPropertyListRef	plist)
 	return noErr;
 }
 
+//_____________________________________________________________________________
+//
+//	Returns the size of the binary state, and writes it to outData if that is not NULL and the
+//	state fits in inCapacity bytes: a single pass over the parameters either way.
+UInt32				AUBase::WriteBinaryState(UInt8 *outData, UInt32 inCapacity)
+{
+	UInt32 size = sizeof(AUBinaryStateHeader), nblocks = 0;
+	
+	for (AudioUnitScope iscope = 0; iscope < 3; ++iscope) {
+		AUScope &scope = GetScope(iscope);
+		AudioUnitElement nElems = scope.GetNumberOfElements();
+		for (AudioUnitElement ielem = 0; ielem < nElems; ++ielem) {
+			AUElement *element = scope.GetElement(ielem);
+			if (element->GetNumberOfParameters() == 0)
+				continue;
+			
+			AUBinaryStateBlock *block = outData && size + sizeof(AUBinaryStateBlock) <= inCapacity ?
+											reinterpret_cast<AUBinaryStateBlock *>(outData + size) : NULL;
+			size += sizeof(AUBinaryStateBlock);
+			UInt32 count;
+			bool indexed;
+			size += element->SaveBinaryState(iscope, block ? outData + size : NULL, block ? inCapacity - size : 0,
+											 count, indexed);
+			if (block) {
+				block->mScope = iscope;
+				block->mElement = ielem;
+				block->mCount = count;
+				block->mIndexed = indexed;
+			}
+			++nblocks;
+		}
+	}
+	
+	char name[kAUBinaryStateMaxNameLength + 1];
+	if (mCurrentPreset.presetName == NULL ||
+		!CFStringGetCString(mCurrentPreset.presetName, name, sizeof(name), kCFStringEncodingUTF8))
+		name[0] = 0;
+	UInt32 nameLength = static_cast<UInt32>(strlen(name));
+	UInt32 namePadded = (nameLength + 1 + 3) & ~3U;
+	if (outData && size + namePadded <= inCapacity) {
+		memset(outData + size, 0, namePadded);
+		memcpy(outData + size, name, nameLength);
+	}
+	size += namePadded;
+	
+	if (outData && size <= inCapacity) {
+		AudioComponentDescription desc = GetComponentDescription();
+		AUBinaryStateHeader *header = reinterpret_cast<AUBinaryStateHeader *>(outData);
+		header->mMagic = kAUBinaryStateMagic;
+		header->mVersion = kAUBinaryStateVersion;
+		header->mSize = size;
+		header->mComponentSubType = desc.componentSubType;
+		header->mComponentManufacturer = desc.componentManufacturer;
+		header->mPresetNumber = mCurrentPreset.presetNumber;
+		header->mNumberOfBlocks = nblocks;
+		header->mNameLength = nameLength;
+	}
+	return size;
+}
+
+//_____________________________________________________________________________
+//
+OSStatus			AUBase::SaveBinaryState(void *outData, UInt32 &ioDataSize)
+{
+	if (outData == NULL || (reinterpret_cast<uintptr_t>(outData) & 3) != 0)
+		return kAudio_ParamError;
+	UInt32 size = WriteBinaryState(static_cast<UInt8 *>(outData), ioDataSize);
+	if (size > ioDataSize)
+		return kAudioUnitErr_InvalidPropertyValue;
+	ioDataSize = size;
+	return noErr;
+}
+
+//_____________________________________________________________________________
+//
+OSStatus			AUBase::RestoreBinaryState(const void *inData, UInt32 inDataSize)
+{
+	if (inData == NULL || (reinterpret_cast<uintptr_t>(inData) & 3) != 0 || inDataSize < sizeof(AUBinaryStateHeader))
+		return kAudioUnitErr_InvalidPropertyValue;
+	
+	const AUBinaryStateHeader &header = *static_cast<const AUBinaryStateHeader *>(inData);
+	AudioComponentDescription desc = GetComponentDescription();
+	if (header.mMagic != kAUBinaryStateMagic || header.mVersion != kAUBinaryStateVersion ||
+		header.mSize < sizeof(AUBinaryStateHeader) || header.mSize > inDataSize ||
+		header.mComponentSubType != desc.componentSubType || header.mComponentManufacturer != desc.componentManufacturer)
+		return kAudioUnitErr_InvalidPropertyValue;
+	
+	const UInt8 *begin = static_cast<const UInt8 *>(inData) + sizeof(AUBinaryStateHeader);
+	const UInt8 *pend = static_cast<const UInt8 *>(inData) + header.mSize;
+	
+	// first pass: make sure every block and the name lie within the state
+	const UInt8 *p = begin;
+	for (UInt32 i = 0; i < header.mNumberOfBlocks; ++i) {
+		if (UInt32(pend - p) < sizeof(AUBinaryStateBlock))
+			return kAudioUnitErr_InvalidPropertyValue;
+		const AUBinaryStateBlock &block = *reinterpret_cast<const AUBinaryStateBlock *>(p);
+		UInt64 bytes = UInt64(block.mCount) * (block.mIndexed ? sizeof(AudioUnitParameterValue) :
+															sizeof(AudioUnitParameterID) + sizeof(AudioUnitParameterValue));
+		p += sizeof(AUBinaryStateBlock);
+		if (bytes > UInt64(pend - p))
+			return kAudioUnitErr_InvalidPropertyValue;
+		p += bytes;
+	}
+	if (header.mNameLength > kAUBinaryStateMaxNameLength || UInt32(pend - p) <= header.mNameLength ||
+		p[header.mNameLength] != 0)
+		return kAudioUnitErr_InvalidPropertyValue;
+	const char *name = reinterpret_cast<const char *>(p);
+	
+	// second pass: restore
+	p = begin;
+	for (UInt32 i = 0; i < header.mNumberOfBlocks; ++i) {
+		const AUBinaryStateBlock &block = *reinterpret_cast<const AUBinaryStateBlock *>(p);
+		p += sizeof(AUBinaryStateBlock);
+		AUElement *element = block.mScope < kNumScopes ? GetScope(block.mScope).GetElement(block.mElement) : NULL;
+		if (block.mIndexed) {
+			const AudioUnitParameterValue *values = reinterpret_cast<const AudioUnitParameterValue *>(p);
+			if (element)
+				RestoreParameterValues(block.mScope, block.mElement, values, block.mCount);
+			p += block.mCount * sizeof(AudioUnitParameterValue);
+		} else {
+			const UInt32 *entry = reinterpret_cast<const UInt32 *>(p);
+			for (UInt32 j = 0; element && j < block.mCount; ++j) {
+				union { UInt32 i; AudioUnitParameterValue f; } value = { entry[2 * j + 1] };
+				element->SetParameter(entry[2 * j], value.f);
+			}
+			p += block.mCount * (sizeof(AudioUnitParameterID) + sizeof(AudioUnitParameterValue));
+		}
+	}
+	
+	if (mCurrentPreset.presetName) CFRelease (mCurrentPreset.presetName);
+	if (header.mNameLength > 0) {
+		mCurrentPreset.presetName = CFStringCreateWithCString(NULL, name, kCFStringEncodingUTF8);
+	} else {
+		mCurrentPreset.presetName = kUntitledString;
+		CFRetain (mCurrentPreset.presetName);
+	}
+	mCurrentPreset.presetNumber = header.mPresetNumber;
+#if !CA_USE_AUDIO_PLUGIN_ONLY
+#ifndef __LP64__
+	PropertyChanged(kAudioUnitProperty_CurrentPreset, kAudioUnitScope_Global, 0);
+#endif
+#endif
+	PropertyChanged(kAudioUnitProperty_PresentPreset, kAudioUnitScope_Global, 0);
+	return noErr;
+}
+
+//_____________________________________________________________________________
+//
+void				AUBase::RestoreParameterValues(	AudioUnitScope					inScope,
+													AudioUnitElement				inElement,
+													const AudioUnitParameterValue *	inValues,
+													UInt32							inNumberOfValues)
+{
+	AUElement *element = GetScope(inScope).GetElement(inElement);
+	if (element)
+		element->SetParameterValues(inValues, inNumberOfValues);
+}
+
 OSStatus			AUBase::GetPresets (			CFArrayRef * 					outData) const
 {
 	return kAudioUnitErr_InvalidProperty;
@@ -2344,12 +2998,11 @@ char*	AUBase::GetLoggingString () const
 	
 	AudioComponentDescription desc = GetComponentDescription();
 	
-	const size_t logStringSize = 256;
-	const_cast<AUBase*>(this)->mLogString = new char[logStringSize];
+	const_cast<AUBase*>(this)->mLogString = new char[kLogStringSize];
 	char str[24];
 	char str1[24];
 	char str2[24];
-	snprintf (const_cast<AUBase*>(this)->mLogString, logStringSize, "AU (%p): %s %s %s",
+	snprintf (const_cast<AUBase*>(this)->mLogString, kLogStringSize, "AU (%p): %s %s %s",
 		GetComponentInstance(),
 		CAStringForOSType(desc.componentType, str, sizeof(str)),
 		CAStringForOSType(desc.componentSubType, str1, sizeof(str1)),
@@ -11,7 +11,7 @@ Part of Core Audio AUBase Classes
 
 #include <TargetConditionals.h>
 
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 	#include <pthread.h>
 #elif TARGET_OS_WIN32
 	#include <windows.h>
@@ -19,6 +19,8 @@ Part of Core Audio AUBase Classes
 	#error Unsupported Operating System
 #endif
 
+#include <atomic>
+#include <mutex>
 #include <vector>
 
 #include "AUScopeElement.h"
@@ -26,7 +28,6 @@ Part of Core Audio AUBase Classes
 #include "AUOutputElement.h"
 #include "AUBuffer.h"
 #include "CAMath.h"
-#include "CAThreadSafeList.h"
 #include "CAVectorUnit.h"
 #include "CAMutex.h"
 #if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
@@ -65,6 +66,191 @@ Part of Core Audio AUBase Classes
 
 // ________________________________________________________________________
 
+/*! @struct AUBinaryStateHeader
+	@abstract The start of the state written by AUBase::SaveBinaryState.
+	@discussion A compact alternative to the ClassInfo property list, for hosts that snapshot
+		many instances: one buffer in native byte order, no Core Foundation objects, and a
+		restore that reads the caller's buffer in place. The header is followed by
+		mNumberOfBlocks parameter blocks, each an AUBinaryStateBlock and then either mCount
+		values for parameter IDs 0 ... mCount-1 (mIndexed) or mCount ID/value pairs, and then
+		the preset name in UTF-8, zero-terminated and padded to a multiple of 4 bytes.
+		
+		Render quality, CPU load, element names and extended scopes are not part of it; hosts
+		that need them use the property list.
+*/
+struct AUBinaryStateHeader {
+	UInt32		mMagic;					// kAUBinaryStateMagic, in the writer's byte order
+	UInt32		mVersion;				// kAUBinaryStateVersion
+	UInt32		mSize;					// bytes, including this header
+	UInt32		mComponentSubType;
+	UInt32		mComponentManufacturer;
+	SInt32		mPresetNumber;
+	UInt32		mNumberOfBlocks;
+	UInt32		mNameLength;			// bytes, without the terminating zero
+};
+
+/*! @struct AUBinaryStateBlock */
+struct AUBinaryStateBlock {
+	UInt32		mScope;
+	UInt32		mElement;
+	UInt32		mCount;
+	UInt32		mIndexed;
+};
+
+enum {
+	kAUBinaryStateMagic			= 'AUbs',
+	kAUBinaryStateVersion		= 1,
+	kAUBinaryStateMaxNameLength	= 255		// longer preset names are saved as empty
+};
+
+// ________________________________________________________________________
+
+/*! @enum AUPropertyNotificationMode
+	@abstract How AUBase::PropertyChanged reaches property listeners.
+	@discussion In every mode, a change posted on the render thread is queued, never delivered
+		there.
+	@constant kAUPropertyNotification_Synchronous
+		Listeners run on the thread that changed the property; changes posted while rendering
+		are delivered by the notifier thread. The default.
+	@constant kAUPropertyNotification_NotifierThread
+		All changes are queued and delivered by a process-wide notifier thread.
+	@constant kAUPropertyNotification_HostPumped
+		All changes are queued and delivered when the host calls DeliverPropertyChanges.
+*/
+enum {
+	kAUPropertyNotification_Synchronous		= 0,
+	kAUPropertyNotification_NotifierThread	= 1,
+	kAUPropertyNotification_HostPumped		= 2
+};
+
+/*! @class AUPropertyChangeQueue
+	@abstract A preallocated, lock-free set of pending property changes.
+	@discussion Any thread may Post, including the render thread: a post never blocks, allocates
+		or calls out. A change that is already pending with the same ID, scope and element is
+		coalesced into it, since a listener only learns that the property changed and reads the
+		current value itself. Drain hands the pending changes out in no particular order.
+		
+		Each slot carries a generation count next to its state, and the key is read between two
+		loads of that word, so a post never mistakes a slot that was drained and reused for the
+		one it read.
+*/
+class AUPropertyChangeQueue {
+public:
+	enum { kCapacity = 64 };	// distinct pending changes; a power of two
+
+	struct Change {
+		AudioUnitPropertyID		mID;
+		AudioUnitScope			mScope;
+		AudioUnitElement		mElement;
+	};
+
+								AUPropertyChangeQueue() : mSlots(), mPending(0) { }
+
+	/*! @method Post
+		@abstract Queues a change; returns false if it is new and all slots are pending. */
+	bool						Post(					AudioUnitPropertyID				inID,
+														AudioUnitScope					inScope,
+														AudioUnitElement				inElement);
+
+	/*! @method Drain
+		@abstract Removes up to inMaxChanges pending changes into outChanges; returns how many. */
+	UInt32						Drain(					Change *						outChanges,
+														UInt32							inMaxChanges);
+
+	bool						IsEmpty() const { return mPending.load(std::memory_order_acquire) == 0; }
+
+private:
+	enum {
+		kSlotFree		= 0,
+		kSlotWriting	= 1,
+		kSlotPending	= 2,
+		kSlotStateMask	= 3,
+		kSlotGeneration	= 4		// added to a slot's word each time it is claimed
+	};
+
+	struct Slot {
+		std::atomic<UInt32>		mState;
+		std::atomic<UInt32>		mID;
+		std::atomic<UInt32>		mScope;
+		std::atomic<UInt32>		mElement;
+	};
+
+	Slot						mSlots[kCapacity];
+	std::atomic<UInt32>			mPending;
+};
+
+/*! @class AURenderNotifyList
+	@abstract The render notifications, kept as an immutable array that the render thread reads
+		with a single load.
+	@discussion Add and Remove never run on the render thread; under a mutex they copy the array
+		with the change, make the copy current with one atomic store and retire the old array.
+		The render thread brackets each render cycle's use of the array with Acquire and Release:
+		Acquire marks the array in use, checking that it is still current after marking it, and
+		Release clears the mark. Every Add or Remove frees the retired arrays but the marked one,
+		so at most one stays retired however often the host changes the list between render
+		cycles; Reclaim frees it while the unit isn't rendering. This relies on one render call
+		at a time, as the AudioUnit API does.
+*/
+class AURenderNotifyList {
+public:
+	struct Callback {
+		AURenderCallback		mProc;
+		void *					mRefCon;
+	};
+	
+	struct Snapshot {
+		Snapshot *				mNextRetired;
+		UInt32					mCount;
+		Callback				mCallbacks[1];		// mCount of them
+	};
+
+								AURenderNotifyList() : mCurrent(NULL), mInUse(NULL), mRetired(NULL) { }
+								~AURenderNotifyList();
+
+	/*! @method Add
+		@abstract Adds a notification; does nothing if it is already in the list. */
+	OSStatus					Add(AURenderCallback inProc, void *inRefCon);
+	/*! @method Remove */
+	void						Remove(AURenderCallback inProc, void *inRefCon);
+	/*! @method Reclaim
+		@abstract Frees the retired arrays. Only while the unit is not rendering. */
+	void						Reclaim();
+	/*! @method GetAllocatedBytes
+		@abstract The bytes held by the current and retired arrays. */
+	UInt32						GetAllocatedBytes() const;
+
+	/*! @method Acquire
+		@abstract Render thread: the current array, or NULL if there are no notifications. */
+	const Snapshot *			Acquire()
+								{
+									const Snapshot *snapshot = mCurrent.load(std::memory_order_relaxed);
+									for (;;) {
+										mInUse.store(snapshot, std::memory_order_seq_cst);
+										const Snapshot *current = mCurrent.load(std::memory_order_seq_cst);
+										if (current == snapshot)
+											return snapshot;
+										snapshot = current;
+									}
+								}
+	/*! @method Release
+		@abstract Render thread: the render cycle is done with the array Acquire returned. */
+	void						Release()	{ mInUse.store(NULL, std::memory_order_release); }
+
+private:
+	void						Publish(Snapshot *inSnapshot);
+	void						FreeRetired(const Snapshot *inKeep);
+	
+								AURenderNotifyList(const AURenderNotifyList &);
+	AURenderNotifyList &		operator=(const AURenderNotifyList &);
+
+	std::atomic<Snapshot *>		mCurrent;
+	std::atomic<const Snapshot *>	mInUse;				// by the render thread, or NULL
+	Snapshot *					mRetired;				// guarded by mMutex
+	mutable std::mutex			mMutex;
+};
+
+// ________________________________________________________________________
+
 /*! @class AUBase */
 class AUBase : public ComponentBase {
 public:
@@ -188,6 +374,22 @@ public:
 														void *							inProcRefCon,
 														bool							refConSpecified);
 	
+	/*! @method GetPropertyNotificationMode */
+	UInt32						GetPropertyNotificationMode() const { return mPropertyNotificationMode; }
+	
+	/*! @method SetPropertyNotificationMode
+		@abstract Selects an AUPropertyNotificationMode. Changes already queued stay queued, except
+			that switching to kAUPropertyNotification_Synchronous delivers them. Not for the render
+			thread.
+	*/
+	OSStatus					SetPropertyNotificationMode(UInt32 inMode);
+	
+	/*! @method DeliverPropertyChanges
+		@abstract Calls the listeners for up to inMaxChanges queued changes (0 for all of them) and
+			returns how many changes were delivered. Does nothing on the render thread.
+	*/
+	UInt32						DeliverPropertyChanges(UInt32 inMaxChanges = 0);
+	
 	/*! @method SetRenderNotification */
 	virtual OSStatus			SetRenderNotification(	AURenderCallback		 		inProc,
 														void *							inRefCon);
@@ -357,6 +559,35 @@ public:
 	/*! @method RestoreState */
 	virtual OSStatus			RestoreState(			CFPropertyListRef				inData);
 
+	/*! @method GetBinaryStateSize
+		@abstract The size of the buffer SaveBinaryState needs.
+	*/
+	UInt32						GetBinaryStateSize()	{ return WriteBinaryState(NULL, 0); }
+
+	/*! @method SaveBinaryState
+		@abstract Writes the state described by AUBinaryStateHeader into outData, which must be
+			4-byte aligned and ioDataSize bytes long. Returns the bytes written in ioDataSize.
+	*/
+	virtual OSStatus			SaveBinaryState(		void *							outData,
+														UInt32 &						ioDataSize);
+
+	/*! @method RestoreBinaryState
+		@abstract Restores a state written by SaveBinaryState, reading inData in place. inData
+			must be 4-byte aligned. The whole state is validated before anything is changed.
+	*/
+	virtual OSStatus			RestoreBinaryState(		const void *					inData,
+														UInt32							inDataSize);
+
+	/*! @method RestoreParameterValues
+		@abstract Called by RestoreBinaryState for each block of indexed parameters; inValues
+			holds the values for parameter IDs 0 ... inNumberOfValues-1 and points into the
+			caller's buffer. The default sets them on the element.
+	*/
+	virtual void				RestoreParameterValues(	AudioUnitScope					inScope,
+														AudioUnitElement				inElement,
+														const AudioUnitParameterValue *	inValues,
+														UInt32							inNumberOfValues);
+
 	/*! @method GetParameterValueStrings */
 	virtual OSStatus			GetParameterValueStrings(AudioUnitScope					inScope,
 														AudioUnitParameterID			inParameterID,
@@ -375,6 +606,10 @@ public:
 		// and the name should be valid, or the preset WON'T take
 	/*! @method SetAFactoryPresetAsCurrent */
 	bool						SetAFactoryPresetAsCurrent (const AUPreset & inPreset);
+
+		// the preset kAudioUnitProperty_PresentPreset reports; the name is not retained
+	/*! @method GetCurrentPreset */
+	const AUPreset &			GetCurrentPreset () const { return mCurrentPreset; }
 		
 		// Called when someone sets a new, valid preset
 		// If this is a valid preset, then the subclass sets its state to that preset
@@ -573,7 +808,7 @@ public:
 	/*! @method IsRenderThread */
 	bool						InRenderThread () const 
 								{
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 									return (mRenderThreadID ? pthread_equal (mRenderThreadID, pthread_self()) : false);
 #elif TARGET_OS_WIN32
 									return (mRenderThreadID ? mRenderThreadID == GetCurrentThreadId() : false);
@@ -587,10 +822,19 @@ public:
 								}
 									// says whether an input is connected or has a callback
 
-	/*! @method PropertyChanged */
+	/*! @method PropertyChanged
+		@abstract Notifies the property's listeners now or through the queue, according to the
+			notification mode; never on the render thread.
+	*/
 	virtual void				PropertyChanged(		AudioUnitPropertyID				inID,
 														AudioUnitScope					inScope, 
 														AudioUnitElement				inElement);
+	
+	/*! @method InRenderCall
+		@abstract True while the calling thread is inside DoRender, DoProcess or DoProcessMultiple
+			of any unit, including the host callbacks they make.
+	*/
+	static bool					InRenderCall();
 
 #if !CA_NO_AU_UI_FEATURES
 	// These calls can be used to call a Host's Callbacks. The method returns -1 if the host
@@ -649,6 +893,12 @@ public:
 	
 	CAMutex*					GetMutex() { return mAUMutex; }
 
+	/*! @method GetMemoryUsage
+		@abstract Fills in the bytes this instance has allocated, by what they are for.
+		@discussion A subclass that allocates overrides it, calls the inherited method, adds its
+			own allocations and sets mInstance to its own size. Not on the render thread. */
+	virtual void				GetMemoryUsage(AUMemoryUsage &outUsage) const;
+
 	// ________________________________________________________________________
 	/*! @method CreateElement */
 	virtual AUElement *			CreateElement(			AudioUnitScope					scope,
@@ -717,6 +967,25 @@ protected:
 	virtual void				ReallocateBuffers();
 									// needs to be called when mMaxFramesPerSlice changes
 	virtual void				DeallocateIOBuffers();
+	/*! @method ReturnArenaBuffers */
+	void						ReturnArenaBuffers(const AudioBufferList &inHandedOut);
+									// at the end of DoRender; keeps what inHandedOut points into
+	/*! @method ReserveArenaBuffers
+		@abstract Makes sure AUBufferArena's reserve covers this unit borrowing all its I/O
+			buffers at once. Not on the render thread. */
+	void						ReserveArenaBuffers();
+	/*! @method RequestIOBufferRetirement
+		@abstract Render thread: at the start of the next DoRender, before anything is prepared
+			in them, the I/O buffers with memory of their own set it aside and borrow from
+			AUBufferArena from then on, until the buffers are next reallocated.
+		@discussion Retiring waits for the next render call because the caller of this one may
+			read what it was handed until then. Call ReserveArenaBuffers beforehand, so that the
+			render thread doesn't have to allocate the blocks. */
+	void						RequestIOBufferRetirement() { mRetireIOBuffers = true; }
+	/*! @method FreeRetiredIOBuffers
+		@abstract Frees the memory the I/O buffers retired; from any thread but the render
+			thread. Returns the bytes freed. */
+	UInt32						FreeRetiredIOBuffers();
 		
 	/*! @method FillInParameterName */
 	static void					FillInParameterName (AudioUnitParameterInfo& ioInfo, CFStringRef inName, bool inShouldRelease)
@@ -863,21 +1132,13 @@ protected:
 	// ________________________________________________________________________
 	//	Private data members to discourage hacking in subclasses
 private:
-	struct RenderCallback {
-		RenderCallback(AURenderCallback proc, void *ref) :
-			mRenderNotify(proc),
-			mRenderNotifyRefCon(ref)
-		{ }
-		
-		AURenderCallback			mRenderNotify;
-		void *						mRenderNotifyRefCon;
-		
-		bool operator == (const RenderCallback &other) {
-			return this->mRenderNotify == other.mRenderNotify &&
-					this->mRenderNotifyRefCon == other.mRenderNotifyRefCon;
-		}
-	};
-	typedef TThreadSafeList<RenderCallback>	RenderCallbackList;
+	UInt32						WriteBinaryState(UInt8 *outData, UInt32 inCapacity);
+	
+	void						CallPropertyListeners(	AudioUnitPropertyID				inID,
+														AudioUnitScope					inScope,
+														AudioUnitElement				inElement);
+	void						UpdatePropertyNotifier();
+	void						RetireIOBuffers();
 	
 protected:
 #if !CA_BASIC_AU_FEATURES
@@ -910,11 +1171,11 @@ private:
 	AUScope						mScopes[kNumScopes];
 	
 	/*! @var mRenderCallbacks */
-	RenderCallbackList			mRenderCallbacks;
-	bool						mRenderCallbacksTouched;
+	AURenderNotifyList			mRenderCallbacks;
+	std::atomic<bool>			mRenderCallbacksTouched;	// set by the first SetRenderNotification
 	
 	/*! @var mRenderThreadID */
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 	pthread_t					mRenderThreadID;
 #elif TARGET_OS_WIN32
 	UInt32						mRenderThreadID;
@@ -949,9 +1210,23 @@ protected:
 	ParameterEventList			mParamList;
 	/*! @var mPropertyListeners */
 	PropertyListeners			mPropertyListeners;
+	/*! @var mPropertyListenersMutex
+		Guards mPropertyListeners against a delivery on another thread; recursive, so listeners
+		may add and remove listeners. */
+	CAMutex						mPropertyListenersMutex;
+	/*! @var mPropertyChanges */
+	AUPropertyChangeQueue		mPropertyChanges;
+	/*! @var mPropertyNotificationMode */
+	UInt32						mPropertyNotificationMode;
+	/*! @var mUsesPropertyNotifier */
+	bool						mUsesPropertyNotifier;
 	
 	/*! @var mBuffersAllocated */
 	bool						mBuffersAllocated;
+	/*! @var mUsesBufferArena */
+	bool						mUsesBufferArena;	// the I/O buffers are borrowed from AUBufferArena
+	/*! @var mRetireIOBuffers */
+	bool						mRetireIOBuffers;	// see RequestIOBufferRetirement
 	
 	/*! @var mLogString */
 	// if this is NOT null, it will contain identifying info about this AU.
@@ -26,6 +26,8 @@ public:
 	virtual OSStatus	SetStreamFormat(const CAStreamBasicDescription &desc);
 	/*! @method NeedsBufferSpace */
 	virtual bool		NeedsBufferSpace() const { return IsCallback(); }
+	/*! @method GetObjectSize */
+	virtual UInt32		GetObjectSize() const { return sizeof(AUInputElement); }
 
 	/*! @method SetConnection */
 	void				SetConnection(const AudioUnitConnection &conn);
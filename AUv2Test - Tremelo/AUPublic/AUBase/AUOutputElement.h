@@ -23,6 +23,8 @@ public:
 	virtual OSStatus	SetStreamFormat(const CAStreamBasicDescription &desc);
 	/*! @method NeedsBufferSpace */
 	virtual bool		NeedsBufferSpace() const { return true; }
+	/*! @method GetObjectSize */
+	virtual UInt32		GetObjectSize() const { return sizeof(AUOutputElement); }
 };
 
 #endif // __AUOutput_h__
@@ -14,7 +14,11 @@ Part of Core Audio AUBase Classes
 #define ACPI ((AudioComponentPlugInInstance *)self)
 #define AUI	((AUBase *)&ACPI->mInstanceStorage)
 
-#define AUI_LOCK CAMutex::Locker auLock(AUI->GetMutex());
+// On the render thread the unit's lock is only tried: a call that would have to wait for a UI
+// thread holding it fails instead of blocking the render cycle.
+#define AUI_LOCK \
+	CAMutex::Locker auLock(AUI->GetMutex(), AUI->InRenderCall() || AUI->InRenderThread()); \
+	if (!auLock.HasLock()) return kAudioUnitErr_CannotDoInCurrentContext;
 
 // ------------------------------------------------------------------------------------------------
 static OSStatus AUMethodInitialize(void *self)
@@ -7,23 +7,59 @@ Part of Core Audio AUBase Classes
 */
 
 #include "AUScopeElement.h"
-#include <AudioUnit/AudioUnitProperties.h>
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <AudioUnit/AudioUnitProperties.h>
+#else
+	#include <AudioUnitProperties.h>
+#endif
 #include "AUBase.h"
 
+#include <algorithm>
+
 //_____________________________________________________________________________
 //
-//	By default, parameterIDs may be arbitrarily spaced, and an STL map
-//  will be used for access.  Calling UseIndexedParameters() will
-//	instead use an STL vector for faster indexed access.
+//	By default, parameterIDs may be arbitrarily spaced; they are kept in a sorted
+//	array alongside the values and found by binary search.  Calling
+//	UseIndexedParameters() instead indexes the values by ID directly.
 //	This assumes the paramIDs are numbered 0.....inNumberOfParameters-1
 //	Call this before defining/adding any parameters with SetParameter()
 //
 void	AUElement::UseIndexedParameters(int inNumberOfParameters)
 {
-	mIndexedParameters.resize (inNumberOfParameters);	
+	mParameterEvents.resize (inNumberOfParameters);	
+	std::vector<AudioUnitParameterID>().swap(mParameterIDs);
 	mUseIndexedParameters = true;
 }
 
+//_____________________________________________________________________________
+//
+//	Helper method.
+//	returns the index of paramID's event in mParameterEvents, or -1
+//
+inline SInt32	AUElement::FindParameter(AudioUnitParameterID paramID) const
+{
+	if(mUseIndexedParameters)
+		return paramID < mParameterEvents.size() ? SInt32(paramID) : -1;
+	
+	std::vector<AudioUnitParameterID>::const_iterator i = std::lower_bound(mParameterIDs.begin(), mParameterIDs.end(), paramID);
+	if (i == mParameterIDs.end() || *i != paramID)
+		return -1;
+	return SInt32(i - mParameterIDs.begin());
+}
+
+//_____________________________________________________________________________
+//
+//	Helper method.
+//	inserts a new paramID, keeping the IDs sorted
+//
+void	AUElement::AddParameter(AudioUnitParameterID paramID, const ParameterMapEvent &inEvent)
+{
+	std::vector<AudioUnitParameterID>::iterator i = std::lower_bound(mParameterIDs.begin(), mParameterIDs.end(), paramID);
+	const size_t index = i - mParameterIDs.begin();
+	mParameterIDs.insert(i, paramID);
+	mParameterEvents.insert(mParameterEvents.begin() + index, inEvent);
+}
+
 //_____________________________________________________________________________
 //
 //	Helper method.
@@ -31,25 +67,11 @@ void	AUElement::UseIndexedParameters(int inNumberOfParameters)
 //
 inline ParameterMapEvent&	AUElement::GetParamEvent(AudioUnitParameterID paramID)
 {
-	ParameterMapEvent *event;
+	SInt32 index = FindParameter(paramID);
+	if (index < 0)
+		COMPONENT_THROW(kAudioUnitErr_InvalidParameter);
 	
-	if(mUseIndexedParameters)
-	{
-		if(paramID >= mIndexedParameters.size() )
-			COMPONENT_THROW(kAudioUnitErr_InvalidParameter);
-		
-		event = &mIndexedParameters[paramID];
-	}
-	else
-	{
-		ParameterMap::iterator i = mParameters.find(paramID);
-		if (i == mParameters.end())
-			COMPONENT_THROW(kAudioUnitErr_InvalidParameter);
-			
-		event = &(*i).second;
-	}
-	
-	return *event;
+	return mParameterEvents[index];
 }
 
 //_____________________________________________________________________________
@@ -59,19 +81,7 @@ inline ParameterMapEvent&	AUElement::GetParamEvent(AudioUnitParameterID paramID)
 //
 bool		AUElement::HasParameterID (AudioUnitParameterID paramID) const
 {	
-	if(mUseIndexedParameters)
-	{
-		if(paramID >= mIndexedParameters.size() )
-			return false;
-		
-		return true;
-	}
-	
-	ParameterMap::const_iterator i = mParameters.find(paramID);
-	if (i == mParameters.end())
-		return false;
-		
-	return true;
+	return FindParameter(paramID) >= 0;
 }
 
 //_____________________________________________________________________________
@@ -122,9 +132,9 @@ void			AUElement::SetParameter(AudioUnitParameterID paramID, AudioUnitParameterV
 	}
 	else
 	{
-		ParameterMap::iterator i = mParameters.find(paramID);
+		SInt32 index = FindParameter(paramID);
 	
-		if (i == mParameters.end())
+		if (index < 0)
 		{
 			if (mAudioUnit->IsInitialized() && !okWhenInitialized) {
 				// The AU should not be creating new parameters once initialized.
@@ -136,15 +146,15 @@ void			AUElement::SetParameter(AudioUnitParameterID paramID, AudioUnitParameterV
 								mAudioUnit->GetLoggingString(), (int)paramID);
 #endif
 			} else {
-				// create new entry in map for the paramID (only happens first time)
+				// create new entry for the paramID (only happens first time)
 				ParameterMapEvent event(inValue);		
-				mParameters[paramID] = event;
+				AddParameter(paramID, event);
 			}
 		}
 		else
 		{
-			// paramID already exists in map so simply change its value
-			ParameterMapEvent &event = (*i).second;
+			// paramID already exists so simply change its value
+			ParameterMapEvent &event = mParameterEvents[index];
 			event.SetValue(inValue);
 		}
 	}
@@ -165,9 +175,9 @@ void			AUElement::SetScheduledEvent(	AudioUnitParameterID 			paramID,
 	}
 	else
 	{
-		ParameterMap::iterator i = mParameters.find(paramID);
+		SInt32 index = FindParameter(paramID);
 	
-		if (i == mParameters.end())
+		if (index < 0)
 		{
 			if (mAudioUnit->IsInitialized() && !okWhenInitialized) {
 				// The AU should not be creating new parameters once initialized.
@@ -179,15 +189,15 @@ void			AUElement::SetScheduledEvent(	AudioUnitParameterID 			paramID,
 								mAudioUnit->GetLoggingString(), (int)paramID);
 #endif
 			} else {
-				// create new entry in map for the paramID (only happens first time)
+				// create new entry for the paramID (only happens first time)
 				ParameterMapEvent event(inEvent, inSliceOffsetInBuffer, inSliceDurationFrames);		
-				mParameters[paramID] = event;
+				AddParameter(paramID, event);
 			}
 		}
 		else
 		{
-			// paramID already exists in map so simply change its value
-			ParameterMapEvent &event = (*i).second;
+			// paramID already exists so simply change its value
+			ParameterMapEvent &event = mParameterEvents[index];
 			
 			event.SetScheduledEvent(inEvent, inSliceOffsetInBuffer, inSliceDurationFrames );
 		}
@@ -202,15 +212,12 @@ void			AUElement::GetParameterList(AudioUnitParameterID *outList)
 {
 	if(mUseIndexedParameters)
 	{
-		UInt32 nparams = static_cast<UInt32>(mIndexedParameters.size());
+		UInt32 nparams = static_cast<UInt32>(mParameterEvents.size());
 		for (UInt32 i = 0; i < nparams; i++ )
 			*outList++ = (AudioUnitParameterID)i;
 	}
 	else
-	{
-		for (ParameterMap::iterator i = mParameters.begin(); i != mParameters.end(); ++i)
-			*outList++ = (*i).first;
-	}
+		std::copy(mParameterIDs.begin(), mParameterIDs.end(), outList);
 }
 
 //_____________________________________________________________________________
@@ -223,7 +230,7 @@ void			AUElement::SaveState(AudioUnitScope scope, CFMutableDataRef data)
 
 	if(mUseIndexedParameters)
 	{
-		nparams = static_cast<UInt32>(mIndexedParameters.size());
+		nparams = static_cast<UInt32>(mParameterEvents.size());
 		theData = CFSwapInt32HostToBig(nparams);
 		CFDataAppendBytes(data, (UInt8 *)&theData, sizeof(nparams));
 	
@@ -246,7 +253,7 @@ void			AUElement::SaveState(AudioUnitScope scope, CFMutableDataRef data)
 			
 			entry.paramID = CFSwapInt32HostToBig(i);
 	
-			AudioUnitParameterValue v = mIndexedParameters[i].GetValue();
+			AudioUnitParameterValue v = mParameterEvents[i].GetValue();
 			entry.value = CFSwapInt32HostToBig(*(UInt32 *)&v );
 	
 			CFDataAppendBytes(data, (UInt8 *)&entry, sizeof(entry));
@@ -254,18 +261,18 @@ void			AUElement::SaveState(AudioUnitScope scope, CFMutableDataRef data)
 	}
 	else
 	{
-		nparams = static_cast<uint32_t>(mParameters.size());
+		nparams = static_cast<uint32_t>(mParameterEvents.size());
 		theData = CFSwapInt32HostToBig(nparams);
 		CFDataAppendBytes(data, (UInt8 *)&theData, sizeof(nparams));
 	
-		for (ParameterMap::iterator i = mParameters.begin(); i != mParameters.end(); ++i) {
+		for (UInt32 i = 0; i < nparams; i++) {
 			struct {
 				UInt32				paramID;
 				//CFSwappedFloat32	value; crashes gcc3 PFE
 				UInt32				value;	// really a big-endian float
 			} entry;
 			
-			if (mAudioUnit->GetParameterInfo(scope, (*i).first, paramInfo) == noErr) {
+			if (mAudioUnit->GetParameterInfo(scope, mParameterIDs[i], paramInfo) == noErr) {
 				if ((paramInfo.flags & kAudioUnitParameterFlag_CFNameRelease) && paramInfo.cfNameString)
 					CFRelease(paramInfo.cfNameString);
 				if (paramInfo.flags & kAudioUnitParameterFlag_OmitFromPresets) {
@@ -274,9 +281,9 @@ void			AUElement::SaveState(AudioUnitScope scope, CFMutableDataRef data)
 				}
 			}
 
-			entry.paramID = CFSwapInt32HostToBig((*i).first);
+			entry.paramID = CFSwapInt32HostToBig(mParameterIDs[i]);
 	
-			AudioUnitParameterValue v = (*i).second.GetValue();
+			AudioUnitParameterValue v = mParameterEvents[i].GetValue();
 			entry.value = CFSwapInt32HostToBig(*(UInt32 *)&v );
 	
 			CFDataAppendBytes(data, (UInt8 *)&entry, sizeof(entry));
@@ -315,6 +322,77 @@ const UInt8 *	AUElement::RestoreState(const UInt8 *state)
 	return p;
 }
 
+//_____________________________________________________________________________
+//
+UInt32			AUElement::SaveBinaryState(AudioUnitScope scope, UInt8 *outData, UInt32 inCapacity, UInt32 &outCount, bool &outIndexed)
+{
+	AudioUnitParameterInfo paramInfo;
+	UInt32 nparams = GetNumberOfParameters();
+	
+	// Parameter info is only consulted for kAudioUnitParameterFlag_OmitFromPresets.
+	outIndexed = mUseIndexedParameters;
+	outCount = 0;
+	for (UInt32 i = 0; i < nparams; i++) {
+		AudioUnitParameterID paramID = mUseIndexedParameters ? i : mParameterIDs[i];
+		bool omit = false;
+		if (mAudioUnit->GetParameterInfo(scope, paramID, paramInfo) == noErr) {
+			if ((paramInfo.flags & kAudioUnitParameterFlag_CFNameRelease) && paramInfo.cfNameString)
+				CFRelease(paramInfo.cfNameString);
+			omit = (paramInfo.flags & kAudioUnitParameterFlag_OmitFromPresets) != 0;
+		}
+		if (omit)
+			outIndexed = false;
+		else
+			++outCount;
+	}
+	
+	const UInt32 size = outIndexed ? nparams * sizeof(AudioUnitParameterValue) :
+									 outCount * (sizeof(AudioUnitParameterID) + sizeof(AudioUnitParameterValue));
+	if (outData == NULL || size > inCapacity)
+		return size;
+	
+	if (outIndexed) {
+		// every indexed parameter, in ID order: the IDs are implicit
+		AudioUnitParameterValue *values = reinterpret_cast<AudioUnitParameterValue *>(outData);
+		for (UInt32 i = 0; i < nparams; i++)
+			values[i] = mParameterEvents[i].GetValue();
+	} else {
+		struct Entry {
+			AudioUnitParameterID		paramID;
+			AudioUnitParameterValue		value;
+		} *entry = reinterpret_cast<Entry *>(outData);
+		
+		for (UInt32 i = 0; i < nparams; i++) {
+			AudioUnitParameterID paramID = mUseIndexedParameters ? i : mParameterIDs[i];
+			AudioUnitParameterValue value = mParameterEvents[i].GetValue();
+			if (mAudioUnit->GetParameterInfo(scope, paramID, paramInfo) == noErr) {
+				if ((paramInfo.flags & kAudioUnitParameterFlag_CFNameRelease) && paramInfo.cfNameString)
+					CFRelease(paramInfo.cfNameString);
+				if (paramInfo.flags & kAudioUnitParameterFlag_OmitFromPresets)
+					continue;
+			}
+			entry->paramID = paramID;
+			entry->value = value;
+			++entry;
+		}
+	}
+	return size;
+}
+
+//_____________________________________________________________________________
+//
+void			AUElement::SetParameterValues(const AudioUnitParameterValue *inValues, UInt32 inCount)
+{
+	if (mUseIndexedParameters) {
+		UInt32 nparams = std::min(inCount, static_cast<UInt32>(mParameterEvents.size()));
+		for (UInt32 i = 0; i < nparams; i++)
+			mParameterEvents[i].SetValue(inValues[i]);
+	} else {
+		for (UInt32 i = 0; i < inCount; i++)
+			SetParameter(i, inValues[i]);
+	}
+}
+
 //_____________________________________________________________________________
 //
 void	AUElement::SetName (CFStringRef inName) 
@@ -324,6 +402,17 @@ void	AUElement::SetName (CFStringRef inName)
 	if (mElementName) CFRetain (mElementName);
 }
 
+//_____________________________________________________________________________
+//
+void	AUElement::AddMemoryUsage(AUMemoryUsage &ioUsage) const
+{
+	ioUsage.mElements += GetObjectSize();
+	ioUsage.mParameters += mParameterIDs.capacity() * sizeof(AudioUnitParameterID) +
+							mParameterEvents.capacity() * sizeof(ParameterMapEvent);
+	if (mElementName)
+		ioUsage.mElementNames += CFStringGetLength(mElementName) * sizeof(UniChar);
+}
+
 
 //_____________________________________________________________________________
 //
@@ -354,7 +443,8 @@ void			AUIOElement::AllocateBuffer(UInt32 inFramesToAllocate)
 		
 //		printf ("will allocate: %d\n", (int)((mWillAllocate && NeedsBufferSpace()) ? framesToAllocate : 0));
 		
-		mIOBuffer.Allocate(mStreamFormat, (mWillAllocate && NeedsBufferSpace()) ? framesToAllocate : 0);
+		mIOBuffer.Allocate(mStreamFormat, (mWillAllocate && NeedsBufferSpace()) ? framesToAllocate : 0,
+							AUBufferArena::IsEnabled());
 	}
 }
 
@@ -409,12 +499,23 @@ OSStatus	AUIOElement::RemoveAudioChannelLayout ()
 }
 
 
+//_____________________________________________________________________________
+//
+void	AUIOElement::AddMemoryUsage(AUMemoryUsage &ioUsage) const
+{
+	AUElement::AddMemoryUsage(ioUsage);
+	ioUsage.mIOBuffers += mIOBuffer.GetMemoryUsage();
+}
+
+
 //_____________________________________________________________________________
 //
 AUScope::~AUScope()
 {
-	for (ElementVector::iterator it = mElements.begin(); it != mElements.end(); ++it)
-		delete *it;
+	for (UInt32 i = 0; i < mNumberOfElements; ++i)
+		delete mElements[i];
+	if (mElements != mInlineElements)
+		delete [] mElements;
 }
 
 //_____________________________________________________________________________
@@ -424,20 +525,38 @@ void	AUScope::SetNumberOfElements(UInt32 numElements)
 	if (mDelegate)
 		return mDelegate->SetNumberOfElements(numElements);
 
-	if (numElements > mElements.size()) {
-		mElements.reserve(numElements);
-		while (numElements > mElements.size()) {
-			AUElement *elem = mCreator->CreateElement(GetScope(), static_cast<UInt32>(mElements.size()));
-			mElements.push_back(elem);
+	if (numElements > mNumberOfElements) {
+		if (numElements > mCapacity) {
+			AUElement **elements = new AUElement *[numElements];
+			std::copy(mElements, mElements + mNumberOfElements, elements);
+			if (mElements != mInlineElements)
+				delete [] mElements;
+			mElements = elements;
+			mCapacity = numElements;
+		}
+		while (numElements > mNumberOfElements) {
+			mElements[mNumberOfElements] = mCreator->CreateElement(GetScope(), mNumberOfElements);
+			++mNumberOfElements;
 		}
 	} else
-		while (numElements < mElements.size()) {
-			AUElement *elem = mElements.back();
-			mElements.pop_back();
-			delete elem;
+		while (numElements < mNumberOfElements) {
+			--mNumberOfElements;
+			delete mElements[mNumberOfElements];
 		}
 }
 
+//_____________________________________________________________________________
+//
+void	AUScope::AddMemoryUsage(AUMemoryUsage &ioUsage) const
+{
+	if (mDelegate)
+		return;
+	if (mElements != mInlineElements)
+		ioUsage.mElements += mCapacity * sizeof(AUElement *);
+	for (UInt32 i = 0; i < mNumberOfElements; ++i)
+		mElements[i]->AddMemoryUsage(ioUsage);
+}
+
 //_____________________________________________________________________________
 //
 bool	AUScope::HasElementWithName () const
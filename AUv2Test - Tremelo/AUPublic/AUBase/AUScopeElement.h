@@ -9,7 +9,6 @@ Part of Core Audio AUBase Classes
 #ifndef __AUScopeElement_h__
 #define __AUScopeElement_h__
 
-#include <map>
 #include <vector>
 
 #if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
@@ -156,6 +155,27 @@ private:
 
 
 
+// ____________________________________________________________________________
+//
+/*! @struct AUMemoryUsage
+	@abstract The bytes an AudioUnit instance has allocated, by what they are for.
+	@discussion Each field is the bytes requested from the allocator, without its own overhead.
+		mInstance is the object itself; the others are what it and its elements allocate on the
+		heap, plus the element objects. Strings count their characters, not the string objects,
+		which may be shared with the host.
+*/
+struct AUMemoryUsage {
+	UInt64		mInstance;		// the AudioUnit object
+	UInt64		mElements;		// element objects and the scopes' element arrays
+	UInt64		mParameters;	// the elements' parameter storage
+	UInt64		mElementNames;	// element names
+	UInt64		mIOBuffers;		// the elements' I/O buffers and buffer lists
+	UInt64		mKernels;		// AUEffectBase's kernels and kernel list
+	UInt64		mOther;			// everything else: listeners, notifications, strings, subclass data
+	
+	UInt64		Total() const	{ return mInstance + mElements + mParameters + mElementNames + mIOBuffers + mKernels + mOther; }
+};
+
 // ____________________________________________________________________________
 //
 class AUIOElement;
@@ -173,7 +193,7 @@ public:
 /*! @method GetNumberOfParameters */
 	virtual UInt32				GetNumberOfParameters()
 	{
-		if(mUseIndexedParameters) return static_cast<UInt32>(mIndexedParameters.size()); else return static_cast<UInt32>(mParameters.size());
+		return static_cast<UInt32>(mParameterEvents.size());
 	}
 /*! @method GetParameterList */
 	virtual void				GetParameterList(AudioUnitParameterID *outList);
@@ -213,6 +233,17 @@ public:
 	void						SaveState(AudioUnitScope scope, CFMutableDataRef data);
 /*! @method RestoreState */
 	const UInt8 *				RestoreState(const UInt8 *state);
+/*! @method SaveBinaryState
+	@abstract Returns the bytes the parameters take in AUBase's binary state, and writes them to
+		outData if it is not NULL and they fit in inCapacity. Indexed parameters go out as a plain
+		array of values (outIndexed true) unless some are omitted from presets; otherwise as
+		ID/value pairs.
+*/
+	UInt32						SaveBinaryState(AudioUnitScope scope, UInt8 *outData, UInt32 inCapacity, UInt32 &outCount, bool &outIndexed);
+/*! @method SetParameterValues
+	@abstract Sets parameters 0 ... inCount-1 from an array of values.
+*/
+	void						SetParameterValues(const AudioUnitParameterValue *inValues, UInt32 inCount);
 /*! @method GetName */
 	CFStringRef					GetName () const { return mElementName; }
 /*! @method SetName */
@@ -224,22 +255,35 @@ public:
 
 /*! @method AsIOElement*/
 	virtual AUIOElement*		AsIOElement () { return NULL; }
+
+/*! @method GetObjectSize
+	@abstract sizeof the element's class; subclasses override it so the memory usage counts them.
+*/
+	virtual UInt32				GetObjectSize() const { return sizeof(AUElement); }
+/*! @method AddMemoryUsage
+	@abstract Adds the element object and what it has allocated to ioUsage.
+*/
+	virtual void				AddMemoryUsage(AUMemoryUsage &ioUsage) const;
 	
 protected:
 	inline ParameterMapEvent&	GetParamEvent(AudioUnitParameterID paramID);
 	
 private:
-	typedef std::map<AudioUnitParameterID, ParameterMapEvent, std::less<AudioUnitParameterID> > ParameterMap;
+	// The index of paramID's event in mParameterEvents, or -1.
+	inline SInt32				FindParameter(AudioUnitParameterID paramID) const;
+	void						AddParameter(AudioUnitParameterID paramID, const ParameterMapEvent &inEvent);
 
 /*! @var mAudioUnit */
 	AUBase *						mAudioUnit;
-/*! @var mParameters */
-	ParameterMap					mParameters;
 
 /*! @var mUseIndexedParameters */
 	bool							mUseIndexedParameters;
-/*! @var mIndexedParameters */
-	std::vector<ParameterMapEvent>	mIndexedParameters;
+/*! @var mParameterIDs
+	The IDs in ascending order, parallel to mParameterEvents; empty when the parameters are
+	indexed, since then an ID is its index. */
+	std::vector<AudioUnitParameterID>	mParameterIDs;
+/*! @var mParameterEvents */
+	std::vector<ParameterMapEvent>	mParameterEvents;
 	
 /*! @var mElementName */
 	CFStringRef						mElementName;
@@ -287,6 +331,18 @@ public:
 										return mIOBuffer.PrepareBuffer(mStreamFormat, nFrames);
 									throw OSStatus(kAudioUnitErr_InvalidPropertyValue);
 								}
+/*! @method ReturnArenaBuffer */
+	void						ReturnArenaBuffer(const AudioBufferList &inHandedOut) {
+									mIOBuffer.ReturnArenaBlock(inHandedOut);
+								}
+/*! @method GetArenaBytes */
+	UInt32						GetArenaBytes() const { return mIOBuffer.GetArenaBytes(); }
+/*! @method GetBufferBytes */
+	UInt32						GetBufferBytes() const { return mIOBuffer.GetBufferBytes(); }
+/*! @method RetireBuffer */
+	UInt32						RetireBuffer() { return mIOBuffer.RetireMemory(); }
+/*! @method FreeRetiredBuffer */
+	UInt32						FreeRetiredBuffer() { return mIOBuffer.FreeRetiredMemory(); }
 /*! @method PrepareNullBuffer */
 	AudioBufferList &			PrepareNullBuffer(UInt32 nFrames) {
 									return mIOBuffer.PrepareNullBuffer(mStreamFormat, nFrames);
@@ -365,6 +421,9 @@ public:
 /*! @method AsIOElement*/
 	virtual AUIOElement*		AsIOElement () { return this; }
 
+/*! @method AddMemoryUsage */
+	virtual void				AddMemoryUsage(AUMemoryUsage &ioUsage) const;
+
 protected:
 /*! @var mStreamFormat */
 	CAStreamBasicDescription	mStreamFormat;
@@ -424,7 +483,8 @@ private:
 class AUScope {
 public:
 /*! @ctor AUScope */
-					AUScope() : mCreator(NULL), mScope(0), mDelegate(0) { }	
+					AUScope() : mCreator(NULL), mScope(0), mElements(mInlineElements), mNumberOfElements(0),
+								mCapacity(kInlineElements), mDelegate(0) { }	
 /*! @dtor ~AUScope */
 					~AUScope();
 	
@@ -451,7 +511,7 @@ public:
 		if (mDelegate)
 			return mDelegate->GetNumberOfElements();
 			
-		return static_cast<UInt32>(mElements.size());
+		return mNumberOfElements;
 	}
 	
 /*! @method GetElement */
@@ -460,9 +520,8 @@ public:
 		if (mDelegate)
 			return mDelegate->GetElement(elementIndex);
 
-		ElementVector::const_iterator i = mElements.begin() + elementIndex;
-			// catch passing -1 in as the elementIndex - causes a wrap around
-		return (i >= mElements.end() || i < mElements.begin()) ? NULL : *i;
+			// passing -1 in as the elementIndex wraps around to a large index
+		return elementIndex < mNumberOfElements ? mElements[elementIndex] : NULL;
 	}
 	
 /*! @method SafeGetElement */
@@ -501,15 +560,31 @@ public:
 
 /*! @method RestoreState */
     const UInt8 *	RestoreState(const UInt8 *state);
+
+/*! @method AddMemoryUsage
+	@abstract Adds the element array and the elements to ioUsage; nothing for a delegate's elements.
+*/
+	void			AddMemoryUsage(AUMemoryUsage &ioUsage) const;
 	
 private:
-	typedef std::vector<AUElement *> ElementVector;
+					AUScope(const AUScope &);
+	AUScope &		operator=(const AUScope &);
+
+	// Most scopes have at most one element, so that one is kept inline and an array is only
+	// allocated for more.
+	enum { kInlineElements = 1 };
 /*! @var mCreator */
 	AUBase *					mCreator;
 /*! @var mScope */
 	AudioUnitScope				mScope;
 /*! @var mElements */
-	ElementVector				mElements;
+	AUElement **				mElements;		// mInlineElements or a heap array of mCapacity
+/*! @var mNumberOfElements */
+	UInt32						mNumberOfElements;
+/*! @var mCapacity */
+	UInt32						mCapacity;
+/*! @var mInlineElements */
+	AUElement *					mInlineElements[kInlineElements];
 /*! @var mDelegate */
 	AUScopeDelegate *			mDelegate;
 };
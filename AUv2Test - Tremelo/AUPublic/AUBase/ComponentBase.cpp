@@ -9,7 +9,7 @@ Part of Core Audio AUBase Classes
 #include "ComponentBase.h"
 #include "CAXException.h"
 
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 pthread_mutex_t ComponentInitLocker::sComponentOpenMutex = PTHREAD_MUTEX_INITIALIZER;
 pthread_once_t ComponentInitLocker::sOnce = PTHREAD_ONCE_INIT;
 
@@ -130,7 +130,7 @@ protected:
 
 class ComponentInitLocker 
 {
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 public:
 	ComponentInitLocker() 
 	{ 
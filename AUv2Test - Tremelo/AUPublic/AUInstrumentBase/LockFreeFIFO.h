@@ -6,73 +6,187 @@ Abstract:
 Part of Core Audio AUInstrument Base Classes
 */
 
-#include <libkern/OSAtomic.h>
+#ifndef __LockFreeFIFO_h__
+#define __LockFreeFIFO_h__
 
+#include <atomic>
+
+#if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
+	#include <CoreAudio/CoreAudioTypes.h>
+#else
+	#include "CoreAudioTypes.h"
+#endif
+
+// Single-producer, single-consumer ring buffers of preallocated items. One thread writes, one
+// thread reads; neither ever blocks. The size must be a power of two, and one slot is always left
+// empty to tell a full FIFO from an empty one.
+//
+// Each index is written by one side only, published with a release store and read by the other
+// side with an acquire load. The indices sit on separate cache lines, and each side keeps a copy
+// of the other side's index on its own line, reloading it only when the copy says the FIFO is
+// full (or empty). So in steady state a write or read touches no cache line the other thread
+// writes. The exception is LockFreeFIFOWithFree's writer, which frees whatever the reader is
+// done with on every write, as it always has, and so reads the reader's index each time.
+//
+// WriteItems and ReadItems hand out up to a given number of contiguous slots as a span, in two
+// pieces when they wrap around the end of the buffer, to be committed with a single
+// AdvanceWritePtr(n) or AdvanceReadPtr(n).
+
+enum { kLockFreeFIFOCacheLineSize = 128 };	// covers 64-byte lines and the 128-byte pairs prefetched on x86 and Apple silicon
+
+// ____________________________________________________________________________
+//
 template <class ITEM>
-class LockFreeFIFOWithFree
+struct LockFreeFIFOSpan
 {
-	LockFreeFIFOWithFree(); // private, unimplemented.
-public:
-	LockFreeFIFOWithFree(UInt32 inMaxSize)
-		: mReadIndex(0), mWriteIndex(0), mFreeIndex(0)
+	ITEM *	mItems[2];		// the second piece starts at the beginning of the buffer
+	UInt32	mCounts[2];
+
+	UInt32	Count() const				{ return mCounts[0] + mCounts[1]; }
+	ITEM &	operator[](UInt32 inIndex)	{ return inIndex < mCounts[0] ? mItems[0][inIndex] : mItems[1][inIndex - mCounts[0]]; }
+};
+
+// ____________________________________________________________________________
+//
+//	The ring and its read and write indices, shared by LockFreeFIFO and LockFreeFIFOWithFree.
+template <class ITEM>
+class LockFreeFIFOBase
+{
+	LockFreeFIFOBase(); // private, unimplemented.
+	LockFreeFIFOBase(const LockFreeFIFOBase &);
+	LockFreeFIFOBase &operator=(const LockFreeFIFOBase &);
+protected:
+	LockFreeFIFOBase(UInt32 inMaxSize)
+		: mItems(new ITEM[inMaxSize]), mMask(inMaxSize - 1),
+		  mWriteIndex(0), mWriterLimit(0), mReadIndex(0), mCachedWriteIndex(0)
 	{
 		//assert(IsPowerOfTwo(inMaxSize));
-		mItems = new ITEM[inMaxSize];
-		mMask = inMaxSize - 1;
 	}
-	
-	~LockFreeFIFOWithFree()
+
+	~LockFreeFIFOBase()
 	{
 		delete [] mItems;
 	}
 
-	
-	void Reset() 
+	void ResetIndices()
+	{
+		mWriteIndex.store(0, std::memory_order_relaxed);
+		mWriterLimit = 0;
+		mReadIndex.store(0, std::memory_order_relaxed);
+		mCachedWriteIndex = 0;
+	}
+
+	// Writer side. Slots free for writing, given the index the writer may not reach.
+	UInt32 WritableCount(UInt32 inLimit) const
+	{
+		return (inLimit - mWriteIndex.load(std::memory_order_relaxed) - 1) & mMask;
+	}
+
+	// Up to inMaxItems slots starting at inIndex, inCount of which are available.
+	LockFreeFIFOSpan<ITEM> MakeSpan(UInt32 inIndex, UInt32 inCount, UInt32 inMaxItems) const
+	{
+		if (inCount > inMaxItems)
+			inCount = inMaxItems;
+		UInt32 first = mMask + 1 - inIndex;
+		if (first > inCount)
+			first = inCount;
+		LockFreeFIFOSpan<ITEM> span = { { &mItems[inIndex], mItems }, { first, inCount - first } };
+		return span;
+	}
+
+public:
+	// Reader side.
+	ITEM* ReadItem()
+	{
+		UInt32 readIndex = mReadIndex.load(std::memory_order_relaxed);
+		if (readIndex == mCachedWriteIndex) {
+			mCachedWriteIndex = mWriteIndex.load(std::memory_order_acquire);
+			if (readIndex == mCachedWriteIndex) return NULL;
+		}
+		return &mItems[readIndex];
+	}
+
+	LockFreeFIFOSpan<ITEM> ReadItems(UInt32 inMaxItems)
+	{
+		UInt32 readIndex = mReadIndex.load(std::memory_order_relaxed);
+		if (((mCachedWriteIndex - readIndex) & mMask) < inMaxItems)
+			mCachedWriteIndex = mWriteIndex.load(std::memory_order_acquire);
+		return MakeSpan(readIndex, (mCachedWriteIndex - readIndex) & mMask, inMaxItems);
+	}
+
+	void AdvanceReadPtr(UInt32 inCount = 1)
+	{
+		mReadIndex.store((mReadIndex.load(std::memory_order_relaxed) + inCount) & mMask, std::memory_order_release);
+	}
+
+protected:
+	ITEM *const				mItems;
+	const UInt32			mMask;
+
+	// written by the writer
+	char					mPad0[kLockFreeFIFOCacheLineSize];
+	std::atomic<UInt32>		mWriteIndex;
+	UInt32					mWriterLimit;		// the writer's copy of the index it may not reach
+
+	// written by the reader
+	char					mPad1[kLockFreeFIFOCacheLineSize];
+	std::atomic<UInt32>		mReadIndex;
+	UInt32					mCachedWriteIndex;	// the reader's copy of mWriteIndex
+	char					mPad2[kLockFreeFIFOCacheLineSize];
+};
+
+// ____________________________________________________________________________
+//
+//	The writer also frees the items the reader is done with, calling ITEM::Free() on its own
+//	thread at the start of every WriteItem or WriteItems, so nothing an item holds outlives its
+//	reading by more than one write.
+template <class ITEM>
+class LockFreeFIFOWithFree : public LockFreeFIFOBase<ITEM>
+{
+	typedef LockFreeFIFOBase<ITEM> Base;
+public:
+	LockFreeFIFOWithFree(UInt32 inMaxSize)
+		: Base(inMaxSize), mFreeIndex(0)
+	{
+	}
+
+	// Not while either side is using the FIFO.
+	void Reset()
 	{
 		FreeItems();
-		mReadIndex = 0;
-		mWriteIndex = 0;
+		Base::ResetIndices();
 		mFreeIndex = 0;
 	}
-	
-	ITEM* WriteItem() 
+
+	ITEM* WriteItem()
 	{
-		//printf("WriteItem %d %d\n", mReadIndex, mWriteIndex);
 		FreeItems(); // free items on the write thread.
-		int32_t nextWriteIndex = (mWriteIndex + 1) & mMask;
-		if (nextWriteIndex == mFreeIndex) return NULL;
-		return &mItems[mWriteIndex];
+		UInt32 writeIndex = Base::mWriteIndex.load(std::memory_order_relaxed);
+		if (((writeIndex + 1) & Base::mMask) == mFreeIndex) return NULL;
+		return &Base::mItems[writeIndex];
 	}
-	
-	ITEM* ReadItem() 
+
+	LockFreeFIFOSpan<ITEM> WriteItems(UInt32 inMaxItems)
 	{
-		//printf("ReadItem %d %d\n", mReadIndex, mWriteIndex);
-		if (mReadIndex == mWriteIndex) return NULL;
-		return &mItems[mReadIndex];
+		FreeItems();
+		return Base::MakeSpan(Base::mWriteIndex.load(std::memory_order_relaxed), Base::WritableCount(mFreeIndex), inMaxItems);
 	}
-	void AdvanceWritePtr() { OSAtomicCompareAndSwap32(mWriteIndex, (mWriteIndex + 1) & mMask, &mWriteIndex); }
-	void AdvanceReadPtr()  { OSAtomicCompareAndSwap32(mReadIndex,  (mReadIndex  + 1) & mMask, &mReadIndex); }
-private:
-	ITEM* FreeItem() 
+
+	void AdvanceWritePtr(UInt32 inCount = 1)
 	{
-		if (mFreeIndex == mReadIndex) return NULL;
-		return &mItems[mFreeIndex];
+		Base::mWriteIndex.store((Base::mWriteIndex.load(std::memory_order_relaxed) + inCount) & Base::mMask, std::memory_order_release);
 	}
-	void AdvanceFreePtr() { OSAtomicCompareAndSwap32(mFreeIndex, (mFreeIndex + 1) & mMask, &mFreeIndex); }
-	
-	void FreeItems() 
+
+private:
+	void FreeItems()
 	{
-		ITEM* item;
-		while ((item = FreeItem()) != NULL)
-		{
-			item->Free();
-			AdvanceFreePtr();
-		}
+		// everything up to the reader's index has been read
+		UInt32 readIndex = Base::mReadIndex.load(std::memory_order_acquire);
+		for (; mFreeIndex != readIndex; mFreeIndex = (mFreeIndex + 1) & Base::mMask)
+			Base::mItems[mFreeIndex].Free();
 	}
-	
-	volatile int32_t mReadIndex, mWriteIndex, mFreeIndex;
-	int32_t mMask;
-	ITEM *mItems;
+
+	UInt32 mFreeIndex;		// writer only: items before it are free, up to the write index
 };
 
 
@@ -80,51 +194,42 @@ private:
 // Same as above but no free.
 
 template <class ITEM>
-class LockFreeFIFO
+class LockFreeFIFO : public LockFreeFIFOBase<ITEM>
 {
-	LockFreeFIFO(); // private, unimplemented.
+	typedef LockFreeFIFOBase<ITEM> Base;
 public:
 	LockFreeFIFO(UInt32 inMaxSize)
-		: mReadIndex(0), mWriteIndex(0)
+		: Base(inMaxSize)
 	{
-		//assert(IsPowerOfTwo(inMaxSize));
-		mItems = new ITEM[inMaxSize];
-		mMask = inMaxSize - 1;
 	}
-	
-	~LockFreeFIFO()
+
+	// Not while either side is using the FIFO.
+	void Reset()
 	{
-		delete [] mItems;
+		Base::ResetIndices();
 	}
-	
-	void Reset() 
+
+	ITEM* WriteItem()
 	{
-		mReadIndex = 0;
-		mWriteIndex = 0;
+		UInt32 writeIndex = Base::mWriteIndex.load(std::memory_order_relaxed);
+		if (((writeIndex + 1) & Base::mMask) == Base::mWriterLimit) {
+			Base::mWriterLimit = Base::mReadIndex.load(std::memory_order_acquire);
+			if (((writeIndex + 1) & Base::mMask) == Base::mWriterLimit) return NULL;
+		}
+		return &Base::mItems[writeIndex];
 	}
-	
-	ITEM* WriteItem() 
+
+	LockFreeFIFOSpan<ITEM> WriteItems(UInt32 inMaxItems)
 	{
-		int32_t nextWriteIndex = (mWriteIndex + 1) & mMask;
-		if (nextWriteIndex == mReadIndex) return NULL;
-		return &mItems[mWriteIndex];
+		if (Base::WritableCount(Base::mWriterLimit) < inMaxItems)
+			Base::mWriterLimit = Base::mReadIndex.load(std::memory_order_acquire);
+		return Base::MakeSpan(Base::mWriteIndex.load(std::memory_order_relaxed), Base::WritableCount(Base::mWriterLimit), inMaxItems);
 	}
-	
-	ITEM* ReadItem() 
+
+	void AdvanceWritePtr(UInt32 inCount = 1)
 	{
-		if (mReadIndex == mWriteIndex) return NULL;
-		return &mItems[mReadIndex];
+		Base::mWriteIndex.store((Base::mWriteIndex.load(std::memory_order_relaxed) + inCount) & Base::mMask, std::memory_order_release);
 	}
-	
-		// the CompareAndSwap will always succeed. We use CompareAndSwap because it calls the PowerPC sync instruction,
-		// plus any processor bug workarounds for various CPUs.
-	void AdvanceWritePtr() { OSAtomicCompareAndSwap32(mWriteIndex, (mWriteIndex + 1) & mMask, &mWriteIndex); }
-	void AdvanceReadPtr()  { OSAtomicCompareAndSwap32(mReadIndex,  (mReadIndex  + 1) & mMask, &mReadIndex); }
-	
-private:
-	
-	volatile int32_t mReadIndex, mWriteIndex;
-	int32_t mMask;
-	ITEM *mItems;
 };
 
+#endif // __LockFreeFIFO_h__
@@ -27,6 +27,8 @@ public:
 	
 	AUInstrumentBase* GetAUInstrument() { return (AUInstrumentBase*)GetAudioUnit(); }
 	
+	virtual UInt32 GetObjectSize() const { return sizeof(SynthElement); }
+	
 private:
 	UInt32 mIndex;
 };
@@ -110,6 +112,8 @@ public:
 	SynthGroupElement(AUInstrumentBase *audioUnit, UInt32 inElement, MIDIControlHandler *inHandler);
 	virtual					~SynthGroupElement();
 
+	virtual UInt32			GetObjectSize() const { return sizeof(SynthGroupElement); }
+
 	virtual void			NoteOn(SynthNote *note, SynthPartElement *part, NoteInstanceID inNoteID, UInt32 inOffsetSampleFrame, const MusicDeviceNoteParams &inParams);
 	virtual void			NoteOff(NoteInstanceID inNoteID, UInt32 inOffsetSampleFrame);
 	void					SustainOn(UInt32 inFrame);
@@ -179,6 +183,8 @@ public:
 	UInt32		GetMaxPolyphony() const { return mMaxPolyphony; }
 	void		SetMaxPolyphony(UInt32 inMaxPolyphony) { mMaxPolyphony = inMaxPolyphony; }
 	
+	virtual UInt32 GetObjectSize() const { return sizeof(SynthPartElement); }
+	
 private:
 	UInt32							mGroupIndex;
 	UInt32							mPatchIndex;
@@ -8,6 +8,8 @@ Part of Core Audio AUBase Classes
 
 #include "AUEffectBase.h"
 
+#include <algorithm>
+
 /* 
 	This class does not deal as well as it should with N-M effects...
 	
@@ -26,6 +28,7 @@ AUEffectBase::AUEffectBase(	AudioComponentInstance	audioUnit,
 	mBypassEffect(false),
 	mParamSRDep (false),
 	mProcessesInPlace(inProcessesInPlace),
+	mKernelStorage(NULL), mKernelStride(0), mKernelStorageCount(0),
 	mMainOutput(NULL), mMainInput(NULL)
 #if TARGET_OS_IPHONE
 	, mOnlyOneKernel(false)
@@ -38,16 +41,36 @@ AUEffectBase::AUEffectBase(	AudioComponentInstance	audioUnit,
 AUEffectBase::~AUEffectBase()
 {
 	Cleanup();
+	AUBufferMemory::Free(mKernelStorage);
 }
 
 //_____________________________________________________________________________
 //
-void AUEffectBase::Cleanup()
+void AUEffectBase::DestroyKernel(AUKernelBase *inKernel)
+{
+	if (inKernel == NULL)
+		return;
+	if (IsInKernelStorage(inKernel))
+		inKernel->~AUKernelBase();
+	else
+		delete inKernel;
+}
+
+//_____________________________________________________________________________
+//
+void AUEffectBase::DestroyKernels()
 {
 	for (KernelList::iterator it = mKernelList.begin(); it != mKernelList.end(); ++it)
-		delete *it;
+		DestroyKernel(*it);
 		
 	mKernelList.clear();
+}
+
+//_____________________________________________________________________________
+//
+void AUEffectBase::Cleanup()
+{
+	DestroyKernels();
 	mMainOutput = NULL;
 	mMainInput = NULL;
 }
@@ -218,14 +241,28 @@ void	AUEffectBase::MaintainKernels()
 	UInt32 nKernels = GetNumberOfChannels();
 #endif
 	
+	size_t kernelSize = KernelStorageSize();
+	if (kernelSize != 0) {
+		size_t stride = (kernelSize + kKernelAlignment - 1) & ~size_t(kKernelAlignment - 1);
+		if (nKernels > mKernelStorageCount || stride != mKernelStride) {
+			// kernels can't be moved, so any already in the old block are constructed anew
+			DestroyKernels();
+			AUBufferMemory::Free(mKernelStorage);
+			mKernelStorage = NULL;
+			mKernelStorageCount = 0;
+			mKernelStorage = static_cast<Byte *>(AUBufferMemory::Allocate(nKernels * stride, kKernelAlignment));
+			mKernelStride = stride;
+			mKernelStorageCount = nKernels;
+		}
+	}
+	
 	if (mKernelList.size() < nKernels) {
 		mKernelList.reserve(nKernels);
 		for (UInt32 i = (UInt32)mKernelList.size(); i < nKernels; ++i)
-			mKernelList.push_back(NewKernel());
+			mKernelList.push_back(kernelSize != 0 ? ConstructKernel(mKernelStorage + i * mKernelStride) : NewKernel());
 	} else {
 		while (mKernelList.size() > nKernels) {
-			AUKernelBase *kernel = mKernelList.back();
-			delete kernel;
+			DestroyKernel(mKernelList.back());
 			mKernelList.pop_back();
 		}
 	}
@@ -238,6 +275,22 @@ void	AUEffectBase::MaintainKernels()
 	}
 }
 
+void		AUEffectBase::GetMemoryUsage(AUMemoryUsage &outUsage) const
+{
+	AUBase::GetMemoryUsage(outUsage);
+	outUsage.mInstance = sizeof(AUEffectBase);
+	outUsage.mKernels += mKernelList.capacity() * sizeof(AUKernelBase *) + mKernelStorageCount * mKernelStride;
+	const UInt32 kernelSize = UInt32(KernelStorageSize());
+	for (KernelList::const_iterator it = mKernelList.begin(); it != mKernelList.end(); ++it) {
+		if (*it == NULL)
+			continue;
+		UInt32 bytes = (*it)->GetMemoryUsage();
+		if (IsInKernelStorage(*it))		// the block already counts the object
+			bytes -= std::min(bytes, kernelSize);
+		outUsage.mKernels += bytes;
+	}
+}
+
 bool		AUEffectBase::StreamFormatWritable(	AudioUnitScope					scope,
 												AudioUnitElement				element)
 {
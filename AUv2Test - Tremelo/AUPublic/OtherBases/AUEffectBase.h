@@ -81,6 +81,16 @@ public:
 	/*! @method NewKernel */
 	virtual AUKernelBase *		NewKernel() { return NULL; }
 
+	// Instead of NewKernel, a unit whose kernels are all of one class can have them constructed
+	// in place, one after another in a single block, each starting on a cache line boundary:
+	// override KernelStorageSize to return the size of the kernel class and ConstructKernel to
+	// placement-new one at inStorage. The block outlives Cleanup and channel count changes, so
+	// reinitializing reconstructs the kernels in it rather than allocating them again.
+	/*! @method KernelStorageSize */
+	virtual size_t				KernelStorageSize() const { return 0; }
+	/*! @method ConstructKernel */
+	virtual AUKernelBase *		ConstructKernel(void *inStorage) { return NULL; }
+
 	/*! @method ProcessBufferLists */
 	virtual OSStatus			ProcessBufferLists(
 											AudioUnitRenderActionFlags &	ioActionFlags,
@@ -117,6 +127,9 @@ public:
 	/*! @method IsBypassEffect */
 	// This is used for the property value - to reflect to the UI if an effect is bypassed
 	bool						IsBypassEffect () { return mBypassEffect; }
+
+	/*! @method GetMemoryUsage */
+	virtual void				GetMemoryUsage(AUMemoryUsage &outUsage) const;
 	
 protected:
 											
@@ -193,6 +206,26 @@ protected:
 	
 
 private:
+	enum { kKernelAlignment = 128 };	// a pair of 64-byte lines, since x86 prefetches lines in pairs
+	
+	/*! @method IsInKernelStorage */
+	bool							IsInKernelStorage(const AUKernelBase *inKernel) const
+									{
+										const Byte *p = reinterpret_cast<const Byte *>(inKernel);
+										return p >= mKernelStorage && p < mKernelStorage + mKernelStorageCount * mKernelStride;
+									}
+	/*! @method DestroyKernel */
+	void							DestroyKernel(AUKernelBase *inKernel);
+	/*! @method DestroyKernels */
+	void							DestroyKernels();
+	
+	/*! @var mKernelStorage */
+	Byte *							mKernelStorage;			// AUBufferMemory block for constructed-in-place kernels
+	/*! @var mKernelStride */
+	size_t							mKernelStride;			// KernelStorageSize rounded up to kKernelAlignment
+	/*! @var mKernelStorageCount */
+	UInt32							mKernelStorageCount;	// kernels mKernelStorage has room for
+	
 	/*! @var mBypassEffect */
 	bool							mBypassEffect;
 	/*! @var mParamSRDep */
@@ -270,6 +303,11 @@ public:
 	
 	void						SetChannelNum (UInt32 inChan) { mChannelNum = inChan; }
 	UInt32						GetChannelNum () { return mChannelNum; }
+
+	/*! @method GetMemoryUsage
+		@abstract The kernel object's size plus what it has allocated; a subclass that is
+			larger or allocates overrides it. */
+	virtual UInt32				GetMemoryUsage () const { return sizeof(AUKernelBase); }
 	
 protected:
 	/*! @var mAudioUnit */
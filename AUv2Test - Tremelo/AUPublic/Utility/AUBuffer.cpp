@@ -7,8 +7,309 @@ Part of Core Audio AUBase Classes
 */
 
 #include "AUBuffer.h"
+#include "CAAtomicStack.h"
+#include <algorithm>
 #include <stdlib.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+#if TARGET_OS_WIN32
+	#include <malloc.h>
+#else
+	#include <sys/mman.h>
+	#include <unistd.h>
+#endif
+
+// ____________________________________________________________________________
+//
+//	Each block is preceded, within its first alignment unit, by a header saying how it was
+//	allocated, so Free works whatever the settings are by then.
+struct AUBufferMemoryHeader {
+	void *	mBase;			// what malloc or mmap returned
+	size_t	mMappedBytes;	// 0 for heap blocks
+};
+
+static std::atomic<UInt32>	sAUBufferAlignment(AUBufferMemory::kDefaultAlignment);
+static std::atomic<UInt32>	sAUBufferOptions(0);
+
+#if !TARGET_OS_WIN32
+static const size_t kHugePageSize = 2 * 1024 * 1024;	// x86-64 and arm64 with 4K pages
+
+// A mapping of its own for a large block, so locking it or advising huge pages affects nothing else.
+static void *	MapLargeBlock(size_t inBytes, UInt32 inOptions, size_t &outMappedBytes)
+{
+	size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	size_t length = (inBytes + pageSize - 1) & ~(pageSize - 1);
+	size_t boundary = pageSize;
+#if defined(MADV_HUGEPAGE)
+	if ((inOptions & AUBufferMemory::kOption_HugePages) && length >= kHugePageSize) {
+		length = (length + kHugePageSize - 1) & ~(kHugePageSize - 1);
+		boundary = kHugePageSize;
+	}
+#endif
+	// map extra to trim the start back to a huge page boundary
+	size_t mapped = length + boundary - pageSize;
+	void *mem = mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (mem == MAP_FAILED)
+		return NULL;
+	Byte *base = (Byte *)mem;
+	Byte *start = (Byte *)(((uintptr_t)base + boundary - 1) & ~(uintptr_t)(boundary - 1));
+	if (start > base)
+		munmap(base, start - base);
+	if (start + length < base + mapped)
+		munmap(start + length, base + mapped - (start + length));
+#if defined(MADV_HUGEPAGE)
+	if (boundary == kHugePageSize)
+		madvise(start, length, MADV_HUGEPAGE);
+#endif
+	if (inOptions & AUBufferMemory::kOption_Lock)
+		mlock(start, length);	// best effort; fails beyond RLIMIT_MEMLOCK
+	outMappedBytes = length;
+	return start;
+}
+#endif
+
+void *				AUBufferMemory::Allocate(size_t inBytes, UInt32 inMinAlignment)
+{
+	size_t alignment = std::max<size_t>(sAUBufferAlignment.load(std::memory_order_relaxed), inMinAlignment);
+	UInt32 options = sAUBufferOptions.load(std::memory_order_relaxed);
+	if (inBytes > SIZE_MAX - alignment)
+		throw std::bad_alloc();
+	size_t totalBytes = inBytes + alignment;	// the first unit holds the header
+
+	void *base = NULL;
+	size_t mappedBytes = 0;
+#if TARGET_OS_WIN32
+	base = _aligned_malloc(totalBytes, alignment);
+#else
+	if (options != 0 && totalBytes >= kLargeBlockSize)
+		base = MapLargeBlock(totalBytes, options, mappedBytes);
+	if (base == NULL && posix_memalign(&base, alignment, totalBytes) != 0)
+		base = NULL;
+#endif
+	if (base == NULL)
+		throw std::bad_alloc();
+
+	Byte *block = (Byte *)base + alignment;
+	AUBufferMemoryHeader *header = (AUBufferMemoryHeader *)block - 1;
+	header->mBase = base;
+	header->mMappedBytes = mappedBytes;
+	memset(block, 0, inBytes);	// fault in every page now rather than on the render thread
+	return block;
+}
+
+void				AUBufferMemory::Free(void *inBlock)
+{
+	if (inBlock == NULL)
+		return;
+	AUBufferMemoryHeader *header = (AUBufferMemoryHeader *)inBlock - 1;
+#if TARGET_OS_WIN32
+	_aligned_free(header->mBase);
+#else
+	if (header->mMappedBytes != 0)
+		munmap(header->mBase, header->mMappedBytes);	// also unlocks
+	else
+		free(header->mBase);
+#endif
+}
+
+void				AUBufferMemory::SetAlignment(UInt32 inAlignment)
+{
+	if (inAlignment < 16 || inAlignment > 4096 || (inAlignment & (inAlignment - 1)) != 0)
+		COMPONENT_THROW(kAudio_ParamError);
+	sAUBufferAlignment.store(inAlignment, std::memory_order_relaxed);
+}
+
+UInt32				AUBufferMemory::GetAlignment()
+{
+	return sAUBufferAlignment.load(std::memory_order_relaxed);
+}
+
+void				AUBufferMemory::SetOptions(UInt32 inOptions)
+{
+	sAUBufferOptions.store(inOptions & (kOption_HugePages | kOption_Lock), std::memory_order_relaxed);
+}
+
+UInt32				AUBufferMemory::GetOptions()
+{
+	return sAUBufferOptions.load(std::memory_order_relaxed);
+}
+
+// ____________________________________________________________________________
+//
+struct AUBufferArena::Block {
+	Block *		mNext;
+	Byte *		mData;
+	UInt32		mSizeClass;
+	bool		mKept;
+
+	Block *&	next() { return mNext; }
+};
+
+enum {
+	kArenaMinSizeShift	= 12,						// 4 KB
+	kArenaSizeClasses	= 32 - kArenaMinSizeShift	// up to 2 GB
+};
+
+static UInt32	ArenaSizeClass(UInt32 inBytes)
+{
+	UInt32 sizeClass = 0;
+	while ((UInt64(1) << (sizeClass + kArenaMinSizeShift)) < inBytes)
+		++sizeClass;
+	if (sizeClass >= kArenaSizeClasses)
+		throw std::bad_alloc();
+	return sizeClass;
+}
+
+struct AUBufferArenaShared {
+	static AUBufferArenaShared &	Get()
+	{
+		// never destroyed: threads give their free lists back as they exit
+		static AUBufferArenaShared *sShared = new AUBufferArenaShared;
+		return *sShared;
+	}
+
+	AUBufferArena::Block *	NewBlock(UInt32 inSizeClass)
+	{
+		UInt32 size = UInt32(UInt64(1) << (inSizeClass + kArenaMinSizeShift));
+		AUBufferArena::Block *block = new AUBufferArena::Block;
+		try {
+			block->mData = (Byte *)AUBufferMemory::Allocate(size);
+		} catch (...) {
+			delete block;
+			throw;
+		}
+		block->mNext = NULL;
+		block->mSizeClass = inSizeClass;
+		block->mKept = false;
+		mBlocks[inSizeClass].fetch_add(1, std::memory_order_relaxed);
+		mAllocatedBytes.fetch_add(size, std::memory_order_relaxed);
+		return block;
+	}
+
+	std::atomic<bool>							mEnabled;
+	TAtomicStack2<AUBufferArena::Block>			mReserve[kArenaSizeClasses];
+	std::atomic<UInt32>							mBlocks[kArenaSizeClasses];		// allocated so far
+	std::atomic<UInt32>							mKept[kArenaSizeClasses];		// of those, out across render calls
+	std::atomic<UInt64>							mAllocatedBytes;
+	std::mutex									mReserveMutex;
+
+private:
+	AUBufferArenaShared() : mEnabled(false), mAllocatedBytes(0)
+	{
+		for (UInt32 i = 0; i < kArenaSizeClasses; ++i) {
+			mBlocks[i].store(0, std::memory_order_relaxed);
+			mKept[i].store(0, std::memory_order_relaxed);
+		}
+	}
+};
+
+// Each thread's free blocks, by size class.
+struct AUBufferArenaThreadCache {
+	AUBufferArenaThreadCache() { memset(mFree, 0, sizeof(mFree)); }
+	~AUBufferArenaThreadCache()
+	{
+		for (UInt32 i = 0; i < kArenaSizeClasses; ++i)
+			while (AUBufferArena::Block *block = mFree[i]) {
+				mFree[i] = block->mNext;
+				AUBufferArenaShared::Get().mReserve[i].push_atomic(block);
+			}
+	}
+
+	AUBufferArena::Block *	mFree[kArenaSizeClasses];
+};
+
+static thread_local AUBufferArenaThreadCache sArenaThreadCache;
+
+void				AUBufferArena::SetEnabled(bool inEnabled)
+{
+	AUBufferArenaShared::Get().mEnabled.store(inEnabled, std::memory_order_relaxed);
+}
+
+bool				AUBufferArena::IsEnabled()
+{
+	return AUBufferArenaShared::Get().mEnabled.load(std::memory_order_relaxed);
+}
 
+void				AUBufferArena::Reserve(const UInt32 *inBytes, UInt32 inCount)
+{
+	UInt32 wanted[kArenaSizeClasses] = { 0 };
+	for (UInt32 i = 0; i < inCount; ++i)
+		++wanted[ArenaSizeClass(inBytes[i])];
+
+	AUBufferArenaShared &shared = AUBufferArenaShared::Get();
+	std::lock_guard<std::mutex> lock(shared.mReserveMutex);
+	for (UInt32 sizeClass = 0; sizeClass < kArenaSizeClasses; ++sizeClass) {
+		// blocks kept by other units aren't available to borrow
+		while (shared.mBlocks[sizeClass].load(std::memory_order_relaxed) <
+				shared.mKept[sizeClass].load(std::memory_order_relaxed) + wanted[sizeClass])
+			shared.mReserve[sizeClass].push_atomic(shared.NewBlock(sizeClass));
+	}
+}
+
+AUBufferArena::Block *	AUBufferArena::Borrow(UInt32 inBytes)
+{
+	UInt32 sizeClass = ArenaSizeClass(inBytes);
+	AUBufferArenaThreadCache &cache = sArenaThreadCache;
+	Block *block = cache.mFree[sizeClass];
+	if (block != NULL) {
+		cache.mFree[sizeClass] = block->mNext;
+		return block;
+	}
+	AUBufferArenaShared &shared = AUBufferArenaShared::Get();
+	block = shared.mReserve[sizeClass].pop_atomic();
+	if (block == NULL)
+		block = shared.NewBlock(sizeClass);		// the reserve was short: allocate on this thread
+	return block;
+}
+
+static void			UnkeepArenaBlock(AUBufferArena::Block *inBlock)
+{
+	if (inBlock->mKept) {
+		inBlock->mKept = false;
+		AUBufferArenaShared::Get().mKept[inBlock->mSizeClass].fetch_sub(1, std::memory_order_relaxed);
+	}
+}
+
+void				AUBufferArena::Return(Block *inBlock)
+{
+	UnkeepArenaBlock(inBlock);
+	AUBufferArenaThreadCache &cache = sArenaThreadCache;
+	inBlock->mNext = cache.mFree[inBlock->mSizeClass];
+	cache.mFree[inBlock->mSizeClass] = inBlock;
+}
+
+void				AUBufferArena::Keep(Block *inBlock)
+{
+	if (!inBlock->mKept) {
+		inBlock->mKept = true;
+		AUBufferArenaShared::Get().mKept[inBlock->mSizeClass].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+void				AUBufferArena::Release(Block *inBlock)
+{
+	UnkeepArenaBlock(inBlock);
+	AUBufferArenaShared::Get().mReserve[inBlock->mSizeClass].push_atomic(inBlock);
+}
+
+Byte *				AUBufferArena::GetData(const Block *inBlock)
+{
+	return inBlock->mData;
+}
+
+UInt32				AUBufferArena::GetSize(const Block *inBlock)
+{
+	return UInt32(UInt64(1) << (inBlock->mSizeClass + kArenaMinSizeShift));
+}
+
+UInt64				AUBufferArena::GetAllocatedBytes()
+{
+	return AUBufferArenaShared::Get().mAllocatedBytes.load(std::memory_order_relaxed);
+}
+
+// ____________________________________________________________________________
+//
 AUBufferList::~AUBufferList()
 {
 	Deallocate();
@@ -27,7 +328,7 @@ static UInt32 SafeMultiplyAddUInt32(UInt32 a, UInt32 b, UInt32 c)
 	return a * b + c;
 }
 
-void				AUBufferList::Allocate(const CAStreamBasicDescription &format, UInt32 nFrames)
+void				AUBufferList::Allocate(const CAStreamBasicDescription &format, UInt32 nFrames, bool inUseArena)
 {
 	UInt32 nStreams;
 	if (format.IsInterleaved()) {
@@ -39,20 +340,35 @@ void				AUBufferList::Allocate(const CAStreamBasicDescription &format, UInt32 nF
 	// careful -- the I/O thread could be running!
 	if (nStreams > mAllocatedStreams) {
 		size_t theHeaderSize = sizeof(AudioBufferList) - sizeof(AudioBuffer);
-		mPtrs = (AudioBufferList *)CA_realloc(mPtrs,
-									SafeMultiplyAddUInt32(nStreams, sizeof(AudioBuffer), theHeaderSize));
+		UInt32 ptrsBytes = SafeMultiplyAddUInt32(nStreams, sizeof(AudioBuffer), theHeaderSize);
+		mPtrs = (AudioBufferList *)CA_realloc(mPtrs, ptrsBytes);
 		mAllocatedStreams = nStreams;
+		mPtrsBytes = ptrsBytes;
 	}
-	UInt32 bytesPerStream = SafeMultiplyAddUInt32(nFrames, format.mBytesPerFrame, 0xF) & ~0xF;
+	UInt32 alignment = AUBufferMemory::GetAlignment();
+	UInt32 bytesPerStream = SafeMultiplyAddUInt32(nFrames, format.mBytesPerFrame, alignment - 1) & ~(alignment - 1);
 	UInt32 nBytes = SafeMultiplyAddUInt32(nStreams, bytesPerStream, 0);
-	if (nBytes > mAllocatedBytes) {
-		if (mExternalMemory) {
+	if (inUseArena) {
+		// PrepareBuffer borrows the memory
+		if (!mUsesArena || (mArenaBlock != NULL && nBytes > AUBufferArena::GetSize(mArenaBlock)))
+			ReleaseMemory();
+		mUsesArena = true;
+		mAllocatedBytes = nBytes;
+	} else if (mUsesArena) {
+		ReleaseMemory();
+		mUsesArena = false;
+		mAllocatedBytes = 0;
+	}
+	if (!inUseArena && (nBytes > mAllocatedBytes || (mMemory != NULL && alignment != mStreamAlignment))) {
+		Byte *newMemory = (Byte *)AUBufferMemory::Allocate(nBytes);
+		if (mExternalMemory)
 			mExternalMemory = false;
-			mMemory = NULL;
-		}
-		mMemory = (Byte *)CA_realloc(mMemory, nBytes);
+		else
+			AUBufferMemory::Free(mMemory);
+		mMemory = newMemory;
 		mAllocatedBytes = nBytes;
 	}
+	mStreamAlignment = alignment;
 	mAllocatedFrames = nFrames;
 	mPtrState = kPtrsInvalid;
 }
@@ -68,14 +384,26 @@ void				AUBufferList::Deallocate()
 		free(mPtrs);
 		mPtrs = NULL;
 	} */
+	ReleaseMemory();
+	mUsesArena = false;
+	mPtrState = kPtrsInvalid;
+}
+
+void				AUBufferList::ReleaseMemory()
+{
+	FreeRetiredMemory();
+	if (mArenaBlock) {
+		AUBufferArena::Release(mArenaBlock);
+		mArenaBlock = NULL;
+		mMemory = NULL;
+	}
 	if (mMemory) {
 		if (mExternalMemory)
 			mExternalMemory = false;
 		else
-			free(mMemory);
+			AUBufferMemory::Free(mMemory);
 		mMemory = NULL;
 	}
-	mPtrState = kPtrsInvalid;
 }
 
 AudioBufferList &	AUBufferList::PrepareBuffer(const CAStreamBasicDescription &format, UInt32 nFrames)
@@ -95,11 +423,16 @@ AudioBufferList &	AUBufferList::PrepareBuffer(const CAStreamBasicDescription &fo
 			COMPONENT_THROW(kAudioUnitErr_FormatNotSupported);
 	}
 	
+	if (mUsesArena && mArenaBlock == NULL && mAllocatedBytes != 0) {
+		mArenaBlock = AUBufferArena::Borrow(mAllocatedBytes);
+		mMemory = AUBufferArena::GetData(mArenaBlock);
+	}
+
 	AudioBufferList *abl = mPtrs;
 	abl->mNumberBuffers = nStreams;
 	AudioBuffer *buf = abl->mBuffers;
 	Byte *mem = mMemory;
-	UInt32 streamInterval = (mAllocatedFrames * format.mBytesPerFrame + 0xF) & ~0xF;
+	UInt32 streamInterval = (mAllocatedFrames * format.mBytesPerFrame + mStreamAlignment - 1) & ~(mStreamAlignment - 1);
 	UInt32 bytesPerBuffer = nFrames * format.mBytesPerFrame;
 	for ( ; nStreams--; ++buf) {
 		buf->mNumberChannels = channelsPerStream;
@@ -139,21 +472,76 @@ AudioBufferList &	AUBufferList::PrepareNullBuffer(const CAStreamBasicDescription
 	return *mPtrs;
 }
 
+void				AUBufferList::ReturnArenaBlock(const AudioBufferList &inHandedOut)
+{
+	if (mArenaBlock == NULL)
+		return;
+	// the caller keeps these until it renders us again
+	const Byte *end = mMemory + AUBufferArena::GetSize(mArenaBlock);
+	for (UInt32 i = 0; i < inHandedOut.mNumberBuffers; ++i) {
+		const Byte *data = (const Byte *)inHandedOut.mBuffers[i].mData;
+		if (data >= mMemory && data < end) {
+			AUBufferArena::Keep(mArenaBlock);
+			return;
+		}
+	}
+	AUBufferArena::Return(mArenaBlock);
+	mArenaBlock = NULL;
+	mMemory = NULL;
+	if (mPtrState == kPtrsToMyMemory)
+		mPtrState = kPtrsInvalid;
+}
+
+UInt32				AUBufferList::RetireMemory()
+{
+	if (mUsesArena || mExternalMemory || mMemory == NULL)
+		return 0;
+	mRetiredBytes = mAllocatedBytes;
+	mRetiredMemory.store(mMemory, std::memory_order_release);
+	mMemory = NULL;
+	mUsesArena = true;		// mAllocatedBytes stays the size PrepareBuffer borrows
+	mPtrState = kPtrsInvalid;
+	return mRetiredBytes;
+}
+
+UInt32				AUBufferList::FreeRetiredMemory()
+{
+	Byte *memory = mRetiredMemory.exchange(NULL, std::memory_order_acquire);
+	if (memory == NULL)
+		return 0;
+	AUBufferMemory::Free(memory);
+	return mRetiredBytes;
+}
+
+UInt32				AUBufferList::GetMemoryUsage() const
+{
+	UInt32 bytes = mPtrs ? mPtrsBytes : 0;
+	if (mArenaBlock)
+		bytes += AUBufferArena::GetSize(mArenaBlock);
+	else if (mMemory && !mExternalMemory)
+		bytes += mAllocatedBytes;
+	if (mRetiredMemory.load(std::memory_order_acquire))
+		bytes += mRetiredBytes;
+	return bytes;
+}
+
 // this should NOT be called while I/O is in process
 void		AUBufferList::UseExternalBuffer(const CAStreamBasicDescription &format, const AudioUnitExternalBuffer &buf)
 {
-	UInt32 alignedSize = buf.size & ~0xF;
-	if (mMemory != NULL && alignedSize >= mAllocatedBytes) {
+	UInt32 alignedSize = buf.size & ~(mStreamAlignment - 1);
+	if (!mUsesArena && mMemory != NULL && alignedSize >= mAllocatedBytes) {
 		// don't accept the buffer if we already have one and it's big enough
 		// if we don't already have one, we don't need one
 		Byte *oldMemory = mMemory;
 		mMemory = buf.buffer;
 		mAllocatedBytes = alignedSize;
-		// from Allocate(): nBytes = nStreams * nFrames * format.mBytesPerFrame;	
-		// thus: nFrames = nBytes / (nStreams * format.mBytesPerFrame)
-		mAllocatedFrames = mAllocatedBytes / (format.NumberChannelStreams() * format.mBytesPerFrame);
+		// from Allocate(): nBytes = nStreams * bytesPerStream, each stream padded to mStreamAlignment;
+		// thus: nFrames = (nBytes / nStreams, rounded down to mStreamAlignment) / format.mBytesPerFrame
+		UInt32 bytesPerStream = (mAllocatedBytes / format.NumberChannelStreams()) & ~(mStreamAlignment - 1);
+		mAllocatedFrames = bytesPerStream / format.mBytesPerFrame;
+		if (!mExternalMemory)
+			AUBufferMemory::Free(oldMemory);
 		mExternalMemory = true;
-		free(oldMemory);
 	}
 }
 
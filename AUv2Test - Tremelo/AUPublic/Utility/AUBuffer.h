@@ -16,6 +16,7 @@ Part of Core Audio AUBase Classes
 	#include <AudioUnit.h>
 #endif
 
+#include <atomic>
 #include <string.h>
 #include "CAStreamBasicDescription.h"
 #include "CAAutoDisposer.h"
@@ -27,6 +28,107 @@ Part of Core Audio AUBase Classes
 		do { DebugMessage(#err); throw static_cast<OSStatus>(err); } while (0)
 #endif
 
+	/*! @class AUBufferMemory
+		@abstract	Where AUBufferList and TAUBuffer get their sample memory.
+		@discussion	Blocks are aligned to a cache line by default, which is also the width of an
+					AVX-512 register, so vector kernels never split a load across two lines. Every
+					page of a block is touched when it is allocated, i.e. in ReallocateBuffers, so the
+					first render after Initialize doesn't take the page faults.
+
+					Optionally, blocks of kLargeBlockSize or more get a mapping of their own, backed
+					by transparent huge pages (Linux, for the whole huge pages they span) and/or
+					locked into RAM with mlock, as far as RLIMIT_MEMLOCK allows.
+
+					The settings are process-wide and apply to blocks allocated after they change;
+					each block remembers how it was allocated.
+	*/
+class AUBufferMemory {
+public:
+	enum {
+		kDefaultAlignment	= 64,
+		kLargeBlockSize		= 64 * 1024
+	};
+	enum {
+		kOption_HugePages	= 1,
+		kOption_Lock		= 2
+	};
+
+	/*! @method Allocate
+		@abstract	Returns an aligned, pre-faulted, zeroed block; throws std::bad_alloc.
+		@discussion	The block is aligned to GetAlignment(), or to inMinAlignment (a power of two)
+					if that is larger. */
+	static void *		Allocate(size_t inBytes, UInt32 inMinAlignment = 0);
+	/*! @method Free
+		@abstract	Frees a block from Allocate; NULL is ignored. */
+	static void			Free(void *inBlock);
+
+	/*! @method SetAlignment
+		@abstract	A power of two from 16 to 4096. */
+	static void			SetAlignment(UInt32 inAlignment);
+	/*! @method GetAlignment */
+	static UInt32		GetAlignment();
+
+	/*! @method SetOptions
+		@abstract	kOption_ flags. */
+	static void			SetOptions(UInt32 inOptions);
+	/*! @method GetOptions */
+	static UInt32		GetOptions();
+};
+
+
+	/*! @class AUBufferArena
+		@abstract	Opt-in, process-wide pool of I/O buffers for AUBufferLists to borrow while they render.
+		@discussion	An AUBufferList that allocates with inUseArena keeps no memory of its own. Its
+					unit borrows a block for it in PrepareBuffer and gives it back at the end of
+					DoRender, so units rendered one after another on a thread reuse the same few
+					blocks instead of each keeping its buffers resident.
+
+					Blocks are size classes of powers of two, taken from the calling thread's free
+					list, then from a shared reserve that Reserve tops up outside the render thread,
+					and only allocated on the render thread when both are empty. A block whose memory
+					was handed to the caller of DoRender (or to a downstream unit through a
+					connection) stays with its AUBufferList until that list is prepared again or
+					deallocated, so those pointers remain valid between render calls as before.
+
+					Blocks are never freed: a thread's free list goes back to the reserve when the
+					thread exits.
+	*/
+class AUBufferArena {
+public:
+	struct Block;
+
+	/*! @method SetEnabled
+		@abstract	Applies to buffers allocated afterwards, i.e. to units initialized afterwards. */
+	static void			SetEnabled(bool inEnabled);
+	/*! @method IsEnabled */
+	static bool			IsEnabled();
+
+	/*! @method Reserve
+		@abstract	Makes sure the reserve can cover a unit borrowing blocks of all of inBytes at once. */
+	static void			Reserve(const UInt32 *inBytes, UInt32 inCount);
+
+	/*! @method Borrow
+		@abstract	A block of at least inBytes, for this thread; throws std::bad_alloc. */
+	static Block *		Borrow(UInt32 inBytes);
+	/*! @method Return
+		@abstract	Back to this thread's free list. */
+	static void			Return(Block *inBlock);
+	/*! @method Keep
+		@abstract	Notes that a borrowed block stays out across render calls. */
+	static void			Keep(Block *inBlock);
+	/*! @method Release
+		@abstract	Back to the shared reserve, from any thread. */
+	static void			Release(Block *inBlock);
+
+	/*! @method GetData */
+	static Byte *		GetData(const Block *inBlock);
+	/*! @method GetSize */
+	static UInt32		GetSize(const Block *inBlock);
+
+	/*! @method GetAllocatedBytes
+		@abstract	All the memory the arena has allocated so far. */
+	static UInt64		GetAllocatedBytes();
+};
 
 	/*! @class AUBufferList */
 class AUBufferList {
@@ -38,7 +140,8 @@ class AUBufferList {
 public:
 	/*! @ctor AUBufferList */
 	AUBufferList() : mPtrState(kPtrsInvalid), mExternalMemory(false), mPtrs(NULL), mMemory(NULL), 
-		mAllocatedStreams(0), mAllocatedFrames(0), mAllocatedBytes(0) { }
+		mAllocatedStreams(0), mPtrsBytes(0), mAllocatedFrames(0), mAllocatedBytes(0), mStreamAlignment(0),
+		mUsesArena(false), mArenaBlock(NULL), mRetiredMemory(NULL), mRetiredBytes(0) { }
 	/*! @dtor ~AUBufferList */
 	~AUBufferList();
 
@@ -97,8 +200,10 @@ public:
 							}
 						}
 	
-	/*! @method Allocate */
-	void				Allocate(const CAStreamBasicDescription &format, UInt32 nFrames);
+	/*! @method Allocate
+		@discussion	With inUseArena, no memory is allocated here: PrepareBuffer borrows it from
+					AUBufferArena, and ReturnArenaBlock gives it back. */
+	void				Allocate(const CAStreamBasicDescription &format, UInt32 nFrames, bool inUseArena = false);
 	/*! @method Deallocate */
 	void				Deallocate();
 	
@@ -119,10 +224,41 @@ public:
 
 	/*! @method GetAllocatedFrames */
 	UInt32				GetAllocatedFrames() const { return mAllocatedFrames; }
+
+	/*! @method GetArenaBytes
+		@abstract	The size of the block PrepareBuffer borrows, or 0 if this list doesn't use the arena. */
+	UInt32				GetArenaBytes() const { return mUsesArena ? mAllocatedBytes : 0; }
+	/*! @method ReturnArenaBlock
+		@abstract	Gives the borrowed block back unless inHandedOut points into it. */
+	void				ReturnArenaBlock(const AudioBufferList &inHandedOut);
+
+	/*! @method GetBufferBytes
+		@abstract	The size of the memory PrepareBuffer lays the buffers out in, own or borrowed;
+					0 for a host's external buffer. */
+	UInt32				GetBufferBytes() const { return mExternalMemory ? 0 : mAllocatedBytes; }
+	/*! @method RetireMemory
+		@abstract	Render thread, between render calls: a list with memory of its own borrows it
+					from AUBufferArena from now on, and sets the memory aside for FreeRetiredMemory.
+		@discussion	Returns the bytes set aside, or 0 if the list has no memory of its own (it uses
+					the arena already, holds a host's external buffer or has none). Whoever was
+					handed pointers into the memory must be done with them. */
+	UInt32				RetireMemory();
+	/*! @method FreeRetiredMemory
+		@abstract	Frees what RetireMemory set aside; from any thread but the render thread.
+					Returns the bytes freed. */
+	UInt32				FreeRetiredMemory();
+
+	/*! @method GetMemoryUsage
+		@abstract	The bytes allocated for the buffer list and the buffers, including a block
+					borrowed from the arena and retired memory not freed yet, but not a host's
+					external buffer. */
+	UInt32				GetMemoryUsage() const;
 	
 private:
 	/*! @ctor AUBufferList */
 	AUBufferList(AUBufferList &) { }	// prohibit copy constructor
+	/*! @method ReleaseMemory */
+	void				ReleaseMemory();
 
 	/*! @var mPtrState */
 	EPtrState					mPtrState;
@@ -134,23 +270,31 @@ private:
 	Byte *						mMemory;
 	/*! @var mAllocatedStreams */
 	UInt32						mAllocatedStreams;
+	/*! @var mPtrsBytes */
+	UInt32						mPtrsBytes;			// the size of mPtrs, which Deallocate keeps
 	/*! @var mAllocatedFrames */
 	UInt32						mAllocatedFrames;
 	/*! @var mAllocatedBytes */
 	UInt32						mAllocatedBytes;
+	/*! @var mStreamAlignment */
+	UInt32						mStreamAlignment;	// each stream starts on a multiple of this
+	/*! @var mUsesArena */
+	bool						mUsesArena;
+	/*! @var mArenaBlock */
+	AUBufferArena::Block *		mArenaBlock;		// mMemory while borrowed
+	/*! @var mRetiredMemory */
+	std::atomic<Byte *>			mRetiredMemory;		// set by RetireMemory, taken by FreeRetiredMemory
+	/*! @var mRetiredBytes */
+	UInt32						mRetiredBytes;
 };
 
 
-// Allocates an array of samples (type T), to be optimally aligned for the processor
+// Allocates an array of samples (type T), aligned by AUBufferMemory
 	/*! @class TAUBuffer */
 template <class T>
 class TAUBuffer {
 public:
-	enum { 
-		kAlignInterval = 0x10,
-		kAlignMask = kAlignInterval - 1
-	};
-	
+
 	/*! @ctor TAUBuffer.0 */
 	TAUBuffer() :	mMemObject(NULL), mAlignedBuffer(NULL), mBufferSizeBytes(0)
 	{
@@ -177,14 +321,11 @@ public:
 		if (mMemObject != NULL && reqSize == mBufferSizeBytes)
 			return;	// already allocated
 
+		void *newMemObject = AUBufferMemory::Allocate(reqSize);
+		AUBufferMemory::Free(mMemObject);
+		mMemObject = newMemObject;
+		mAlignedBuffer = (T *)mMemObject;
 		mBufferSizeBytes = reqSize;
-		mMemObject = CA_realloc(mMemObject, reqSize);
-		UInt32 misalign = (uintptr_t)mMemObject & kAlignMask;
-		if (misalign) {
-			mMemObject = CA_realloc(mMemObject, reqSize + kAlignMask);
-			mAlignedBuffer = (T *)((char *)mMemObject + kAlignInterval - misalign);
-		} else
-			mAlignedBuffer = (T *)mMemObject;
 	}
 
 	/*! @method Deallocate */
@@ -193,7 +334,7 @@ public:
 		if (mMemObject == NULL) return;			// so this method has no effect if we're using
 												// an external buffer
 		
-		free(mMemObject);
+		AUBufferMemory::Free(mMemObject);
 		mMemObject = NULL;
 		mAlignedBuffer = NULL;
 		mBufferSizeBytes = 0;
@@ -0,0 +1,142 @@
+//
+//  TremeloGainCache.h
+//  TremeloAUv2
+//
+//  One period of the sample-time LFO's final gain curve, rendered at audio
+//  rate. When the frequency spans a whole number of samples per LFO period
+//  (e.g. 2 Hz at 48 kHz, or 7 Hz over 7 cycles) and depth and waveform stay
+//  put, the gain sequence repeats exactly, so once a full period has been
+//  computed the kernels only multiply against this circular buffer.
+//
+//  The cache fills itself from the gain blocks the unit computes anyway (no
+//  separate pre-render pass), and starts over whenever anything in its Key
+//  changes or the timeline jumps.
+//
+
+#ifndef TremeloGainCache_h
+#define TremeloGainCache_h
+
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+#include <vector>
+
+class TremeloGainCache {
+public:
+    /// Everything the cached gains depend on.
+    struct Key {
+        Float64 mAnchorSampleTime;
+        Float64 mAnchorPhase;
+        Float64 mIncrement;
+        UInt32  mPeriod;        // LFO period in frames, 0 if it isn't a whole number
+        Float32 mDepth;
+        SInt32  mWaveform;
+        SInt32  mOscillator;    // kTremeloUnitProperty_Oscillator
+        UInt32  mControlInterval;   // kTremeloUnitProperty_ControlInterval
+
+        bool operator== (const Key &other) const {
+            return mAnchorSampleTime == other.mAnchorSampleTime && mAnchorPhase == other.mAnchorPhase &&
+                   mIncrement == other.mIncrement && mPeriod == other.mPeriod &&
+                   mDepth == other.mDepth && mWaveform == other.mWaveform && mOscillator == other.mOscillator &&
+                   mControlInterval == other.mControlInterval;
+        }
+    };
+
+    TremeloGainCache () : mKey(), mState(kIdle), mFilled(0), mNextFillTime(0), mWritten(false),
+                          mFramesProcessed(0), mFramesFromCache(0) { }
+
+    /// Sizes the buffer for periods of up to inMaxPeriod frames. Not for the render thread.
+    void    Allocate (UInt32 inMaxPeriod)   { mGains.assign(inMaxPeriod, 0.f); Invalidate(); }
+    void    Deallocate ()                   { std::vector<Float32>().swap(mGains); Invalidate(); }
+    /// Takes over a buffer allocated elsewhere and hands back the current one. Allocates and frees
+    /// nothing, so the render thread may call it between slices.
+    void    Adopt (std::vector<Float32> &ioGains)   { mGains.swap(ioGains); Invalidate(); }
+    void    Invalidate ()                   { mKey = Key(); mState = kIdle; mFilled = 0; }
+
+    /// Called once per slice, before the kernels run. inFrameOffset is the slice's distance from the
+    /// anchor, modulo the period; the cache holds whole frames of it, so a slice that starts between
+    /// two (a fractional sample time) is neither served nor stored.
+    void    BeginSlice (const Key &inKey, Float64 inSliceSampleTime, Float64 inFrameOffset) {
+        mWritten = false;
+        if (inKey.mPeriod == 0 || inKey.mPeriod > mGains.size() || inFrameOffset != floor(inFrameOffset)) {
+            mState = kIdle;
+            return;
+        }
+        if (!(inKey == mKey) || mState == kIdle) {
+            mKey = inKey;
+            mFilled = 0;
+        } else if (mState == kServing) {
+            return;
+        } else if (inSliceSampleTime != mNextFillTime) {
+            mFilled = 0;                    // the timeline jumped; the filled range is no longer contiguous
+        }
+        mState = kFilling;
+    }
+
+    /// Called once per slice, after the kernels ran.
+    void    EndSlice (Float64 inSliceSampleTime, UInt32 inFrames) {
+        mFramesProcessed += inFrames;
+        if (mState == kServing) {
+            mFramesFromCache += inFrames;
+        } else if (mState == kFilling) {
+            if (!mWritten) {
+                mFilled = 0;                // nothing was stored for this slice
+            } else {
+                mFilled += inFrames;
+                mNextFillTime = inSliceSampleTime + inFrames;
+                if (mFilled >= mKey.mPeriod)
+                    mState = kServing;
+            }
+        }
+    }
+
+    /// True when the current slice can be rendered from Gains().
+    bool            IsServing () const  { return mState == kServing; }
+    const Float32 * Gains () const      { return mGains.data(); }
+
+    /// Stores a slice's computed gains, starting inPosition frames into the period, while filling.
+    void            Store (UInt32 inPosition, UInt32 inFrames, const Float32 *inGains) {
+        if (mState != kFilling)
+            return;
+        for (UInt32 done = 0; done < inFrames; ) {
+            UInt32 frames = std::min(inFrames - done, mKey.mPeriod - inPosition);
+            memcpy(&mGains[inPosition], inGains + done, frames * sizeof(Float32));
+            done += frames;
+            inPosition = 0;
+        }
+        mWritten = true;
+    }
+
+    /// Copies inFrames cached gains starting inPosition frames into the period, wrapping around.
+    void            Copy (UInt32 inPosition, UInt32 inFrames, Float32 *outGains) const {
+        for (UInt32 done = 0; done < inFrames; ) {
+            UInt32 frames = std::min(inFrames - done, mKey.mPeriod - inPosition);
+            memcpy(outGains + done, &mGains[inPosition], frames * sizeof(Float32));
+            done += frames;
+            inPosition = 0;
+        }
+    }
+
+    UInt32          Period () const             { return mState == kIdle ? 0 : mKey.mPeriod; }
+    UInt32          BytesAllocated () const     { return UInt32(mGains.capacity() * sizeof(Float32)); }
+    UInt64          FramesProcessed () const    { return mFramesProcessed; }
+    UInt64          FramesFromCache () const    { return mFramesFromCache; }
+
+private:
+    enum State {
+        kIdle,                              // no whole-number period, no buffer, or a fractional offset
+        kFilling,                           // gains are being computed and stored
+        kServing                            // a full period is cached
+    };
+
+    std::vector<Float32>    mGains;
+    Key                     mKey;
+    State                   mState;
+    UInt32                  mFilled;        // contiguous frames stored under mKey
+    Float64                 mNextFillTime;  // sample time the next filling slice must start at
+    bool                    mWritten;       // gains were stored during this slice
+    UInt64                  mFramesProcessed;
+    UInt64                  mFramesFromCache;
+};
+
+#endif /* TremeloGainCache_h */
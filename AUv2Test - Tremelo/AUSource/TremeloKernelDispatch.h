@@ -0,0 +1,156 @@
+//
+//  TremeloKernelDispatch.h
+//  TremeloAUv2
+//
+//  The sample-time LFO's inner loops, compiled once per instruction set and
+//  bound through a table of function pointers. The portable build targets
+//  the baseline ISA (SSE2 on x86-64), so without this the loops never use
+//  AVX2, FMA or AVX-512 even on machines that have them.
+//
+//  Every variant is the same source: the generic bodies below are stamped
+//  out by TREMELO_KERNEL_VARIANT with a target attribute, and 'flatten'
+//  inlines TremeloOscillator into each so it is compiled for that target
+//  too. TremeloUnit binds a variant at Initialize, from CAVectorUnit (so
+//  CA_NoVector selects the generic variant) or from
+//  kTremeloUnitProperty_KernelVariant.
+//
+//  Variants can differ in the last bit of a polynomial gain, where FMA
+//  contracts a multiply-add. Within one bound variant, rendering stays a
+//  function of the timeline alone.
+//
+//  Only the sample-time LFO is dispatched. The legacy LFO's loop
+//  (TremeloUnitKernel::ProcessT and ProcessLoop) always runs the baseline
+//  build: it walks the wave table one sample at a time from a running
+//  counter, which wider registers don't speed up, and compiling it for FMA
+//  would change the output of existing sessions in the last bit.
+//
+
+#ifndef TremeloKernelDispatch_h
+#define TremeloKernelDispatch_h
+
+#include "CAVectorUnit.h"
+#include "TremeloOscillator.h"
+
+/// Values of kTremeloUnitProperty_KernelVariant.
+enum {
+    kTremeloKernelVariant_Auto      = -1,   // the best variant the CPU supports
+    kTremeloKernelVariant_Generic   = 0,    // the build's baseline ISA
+    kTremeloKernelVariant_AVX2      = 1,    // AVX2 + FMA3
+    kTremeloKernelVariant_AVX512    = 2,    // AVX-512F
+    kNumberOfTremeloKernelVariants  = 3
+};
+
+struct TremeloKernelFunctions {
+    SInt32          mVariant;
+    const char *    mName;
+
+    /// outFrames[i] = inFrames[i] * inGains[i]; in place is fine.
+    void    (*mApplyGains) (const Float32 *inFrames, Float32 *outFrames, const Float32 *inGains, UInt32 inCount);
+    /// outGains[i] = inStart + inSlope * (inOffset + i), the control-rate LFO's ramps.
+    void    (*mRenderRamp) (Float32 *outGains, UInt32 inCount, Float32 inStart, Float32 inSlope, Float32 inOffset);
+    /// TremeloOscillator::RenderGains.
+    void    (*mRenderPolynomialGains) (Float32 *outGains, UInt32 inFrames, Float64 inPosition, Float64 inPhase,
+                                       Float64 inIncrement, UInt32 inPeriod, Float32 inDepth, bool inSquare);
+};
+
+namespace TremeloKernels {
+
+inline void ApplyGains (const Float32 *inFrames, Float32 *outFrames, const Float32 *inGains, UInt32 inCount)
+{
+    for (UInt32 i = 0; i < inCount; i++)
+        outFrames[i] = inFrames[i] * inGains[i];
+}
+
+inline void RenderRamp (Float32 *outGains, UInt32 inCount, Float32 inStart, Float32 inSlope, Float32 inOffset)
+{
+    for (UInt32 i = 0; i < inCount; i++)
+        outGains[i] = inStart + inSlope * (inOffset + Float32(i));
+}
+
+} // namespace TremeloKernels
+
+#if defined(__GNUC__)
+    #define TREMELO_KERNEL_FLATTEN  __attribute__((flatten))
+#else
+    #define TREMELO_KERNEL_FLATTEN
+#endif
+
+// Attributes is empty or an __attribute__ list; the helpers are inline so the header can be
+// included from several translation units.
+#define TREMELO_KERNEL_VARIANT(Namespace, Attributes)                                                           \
+namespace Namespace {                                                                                           \
+    Attributes                                                                                                  \
+    inline void ApplyGains (const Float32 *inFrames, Float32 *outFrames, const Float32 *inGains, UInt32 inCount) \
+        { TremeloKernels::ApplyGains(inFrames, outFrames, inGains, inCount); }                                  \
+    Attributes                                                                                                  \
+    inline void RenderRamp (Float32 *outGains, UInt32 inCount, Float32 inStart, Float32 inSlope, Float32 inOffset) \
+        { TremeloKernels::RenderRamp(outGains, inCount, inStart, inSlope, inOffset); }                          \
+    Attributes                                                                                                  \
+    inline void RenderPolynomialGains (Float32 *outGains, UInt32 inFrames, Float64 inPosition, Float64 inPhase,  \
+                                       Float64 inIncrement, UInt32 inPeriod, Float32 inDepth, bool inSquare)    \
+        { TremeloOscillator::RenderGains(outGains, inFrames, inPosition, inPhase, inIncrement, inPeriod,        \
+                                         inDepth, inSquare); }                                                  \
+}
+
+TREMELO_KERNEL_VARIANT(TremeloKernelsGeneric, TREMELO_KERNEL_FLATTEN)
+
+#if (TARGET_CPU_X86 || TARGET_CPU_X86_64) && defined(__GNUC__)
+    #define TREMELO_KERNEL_X86_VARIANTS 1
+    TREMELO_KERNEL_VARIANT(TremeloKernelsAVX2, __attribute__((flatten, target("avx2,fma"))))
+    TREMELO_KERNEL_VARIANT(TremeloKernelsAVX512, __attribute__((flatten, target("avx512f,avx2,fma"))))
+#endif
+
+namespace TremeloKernelDispatch {
+
+/// The CAVectorUnit type a variant needs, or kVecUninitialized if it isn't compiled in.
+inline SInt32   RequiredVectorUnit (SInt32 inVariant)
+{
+    switch (inVariant) {
+        case kTremeloKernelVariant_Generic:     return kVecNone;
+#if TREMELO_KERNEL_X86_VARIANTS
+        case kTremeloKernelVariant_AVX2:        return kVecAVX2;
+        case kTremeloKernelVariant_AVX512:      return kVecAVX512;
+#endif
+        default:                                return kVecUninitialized;
+    }
+}
+
+/// True if inVariant is compiled in and this CPU (as CAVectorUnit sees it) can run it.
+inline bool     IsSupported (SInt32 inVariant)
+{
+    SInt32 required = RequiredVectorUnit(inVariant);
+    if (required == kVecNone)
+        return true;
+    if (required == kVecUninitialized)
+        return false;
+    // x86 types are numbered upwards from kVecSSE2, below the ARM ones.
+    SInt32 available = CAVectorUnit::GetVectorUnitType();
+    return available >= required && available < kVecNeon;
+}
+
+/// The functions for inVariant, or for the best supported variant when it is kTremeloKernelVariant_Auto.
+/// Returns NULL if inVariant isn't supported.
+inline const TremeloKernelFunctions *   Select (SInt32 inVariant)
+{
+    static const TremeloKernelFunctions sVariants[kNumberOfTremeloKernelVariants] = {
+        { kTremeloKernelVariant_Generic, "generic", TremeloKernelsGeneric::ApplyGains,
+          TremeloKernelsGeneric::RenderRamp, TremeloKernelsGeneric::RenderPolynomialGains },
+#if TREMELO_KERNEL_X86_VARIANTS
+        { kTremeloKernelVariant_AVX2, "avx2", TremeloKernelsAVX2::ApplyGains,
+          TremeloKernelsAVX2::RenderRamp, TremeloKernelsAVX2::RenderPolynomialGains },
+        { kTremeloKernelVariant_AVX512, "avx512", TremeloKernelsAVX512::ApplyGains,
+          TremeloKernelsAVX512::RenderRamp, TremeloKernelsAVX512::RenderPolynomialGains },
+#endif
+    };
+
+    if (inVariant == kTremeloKernelVariant_Auto) {
+        for (inVariant = kNumberOfTremeloKernelVariants - 1; inVariant > kTremeloKernelVariant_Generic; inVariant--)
+            if (IsSupported(inVariant))
+                break;
+    }
+    return IsSupported(inVariant) ? &sVariants[inVariant] : NULL;
+}
+
+} // namespace TremeloKernelDispatch
+
+#endif /* TremeloKernelDispatch_h */
@@ -0,0 +1,124 @@
+//
+//  TremeloOscillator.h
+//  TremeloAUv2
+//
+//  Polynomial evaluation of the tremolo waveforms, as an alternative to the
+//  kernels' wave tables. Looking up a table at a per-sample index needs a
+//  gather, which SIMD units do badly or not at all; a polynomial is plain
+//  arithmetic and runs kLanes samples at a time using the compiler's generic
+//  vector types (SSE/AVX on x86, NEON on ARM).
+//
+//  Sine:   sin(x) on [0, pi/2] is a degree-9 minimax polynomial (error 1.3e-8),
+//          extended to the full cycle by symmetry.
+//  Square: the same seven odd harmonics the kernel constructor sums, with
+//          sin(3x) ... sin(13x) generated from sin(x) by the Chebyshev
+//          recurrence sin((n+2)x) = 2cos(2x) sin(nx) - sin((n-2)x).
+//
+//  At the wave tables' own sample points the polynomial shapes match the
+//  tables to within 2e-7 (sine) and 1e-6 (square) in float arithmetic. Between
+//  the points they follow the continuous curve, where a table lookup holds the
+//  previous entry: up to 1.6e-3 (sine) and 7.2e-3 (square) of difference.
+//
+//  The sine is cheaper than the table lookup; the square, with its harmonic
+//  recurrence, costs more than its lookup and is here for continuity.
+//
+
+#ifndef TremeloOscillator_h
+#define TremeloOscillator_h
+
+#include <string.h>
+
+namespace TremeloOscillator {
+
+enum { kLanes = 4 };                // one SSE / NEON register of floats
+
+typedef Float32 Vec     __attribute__((vector_size(kLanes * sizeof(Float32))));
+typedef SInt32  VecI    __attribute__((vector_size(kLanes * sizeof(SInt32))));
+typedef Float64 VecD    __attribute__((vector_size(kLanes * sizeof(Float64))));
+typedef SInt64  VecL    __attribute__((vector_size(kLanes * sizeof(SInt64))));
+
+inline Vec  Abs (Vec v)                 { return (Vec)((VecI)v & 0x7FFFFFFF); }
+inline Vec  CopySign (Vec mag, Vec sgn) { return (Vec)(((VecI)mag & 0x7FFFFFFF) | ((VecI)sgn & (SInt32)0x80000000)); }
+
+/// sin(2 pi u) for u in [-0.5, 0.5].
+inline Vec  SinCycles (Vec u)
+{
+    const Float32 kTwoPi = 6.28318530717958647692f;
+    Vec a = Abs(u);
+    Vec b = 0.25f - Abs(a - 0.25f);     // in [0, 0.25], with sin(2 pi b) == sin(2 pi a)
+    Vec x = b * kTwoPi;
+    Vec x2 = x * x;
+    Vec s = x * (0.9999999991582449f + x2 * (-0.16666662483617703f + x2 * (0.00833313077821447f +
+                 x2 * (-0.00019813423871231916f + x2 * 2.612538035415576e-06f))));
+    return CopySign(s, u);
+}
+
+/// Wraps u from [-0.5, 1.5) into [-0.5, 0.5).
+inline Vec  WrapCycles (Vec u)
+{
+    const Vec one = { 1.f, 1.f, 1.f, 1.f };
+    return u - (Vec)((VecI)(u >= 0.5f) & (VecI)one);
+}
+
+/// The sine wave table's shape, (sin(2 pi f) + 1) / 2, for f in [0, 1].
+inline Vec  SineShape (Vec f)
+{
+    return 0.5f - 0.5f * SinCycles(f - 0.5f);
+}
+
+/// The square wave table's shape for f in [0, 1]; see the kernel constructor.
+inline Vec  SquareShape (Vec f)
+{
+    const Float32 kOffset = 0.32f / 6.28318530717958647692f;      // the constructor's 0.32 radian shift
+    Vec s1 = -SinCycles(WrapCycles(f + (kOffset - 0.5f)));
+    Vec k2 = 2.f - 4.f * s1 * s1;                                   // 2 cos(2x)
+    Vec s3 = k2 * s1 + s1;
+    Vec s5 = k2 * s3 - s1;
+    Vec s7 = k2 * s5 - s3;
+    Vec s9 = k2 * s7 - s5;
+    Vec s11 = k2 * s9 - s7;
+    Vec s13 = k2 * s11 - s9;
+    return (s1 + 0.3f * s3 + 0.15f * s5 + 0.075f * s7 + 0.0375f * s9 + 0.01875f * s11 + 0.009375f * s13 + 0.8f) * 0.63f;
+}
+
+/// Renders the sample-time LFO's final gains, like TremeloUnitKernel::RenderLFOGains does from
+/// the wave tables: frame i sits inPosition + i frames from the anchor, wrapped at inPeriod when
+/// that is non-zero, and the phase is inPhase + position * inIncrement cycles.
+inline void RenderGains (Float32 *outGains, UInt32 inFrames, Float64 inPosition, Float64 inPhase,
+                         Float64 inIncrement, UInt32 inPeriod, Float32 inDepth, bool inSquare)
+{
+    const VecD lane = { 0, 1, 2, 3 };
+    const Float64 period = inPeriod;
+    const VecD periods = { period, period, period, period };
+    const Vec one = { 1.f, 1.f, 1.f, 1.f };
+    Float64 position = inPosition;
+
+    for (UInt32 i = 0; i < inFrames; i += kLanes) {
+        VecD positions = position + lane;
+        if (inPeriod && position + (kLanes - 1) >= period)
+            positions -= (VecD)((positions >= period) & (VecL)periods);
+
+        // Truncate in double, then move negative phases up a cycle in float: float compares
+        // vectorize on every target, double compares of this width don't without AVX.
+        VecD phase = inPhase + positions * inIncrement;
+        VecD whole = __builtin_convertvector(__builtin_convertvector(phase, VecI), VecD);
+        Vec f = __builtin_convertvector(phase - whole, Vec);
+        f += (Vec)((f < 0.f) & (VecI)one);
+
+        Vec shape = inSquare ? SquareShape(f) : SineShape(f);
+        Vec gains = (shape * inDepth - inDepth + 100.f) * 0.01f;
+
+        if (inFrames - i >= kLanes)
+            memcpy(outGains + i, &gains, sizeof(gains));
+        else
+            memcpy(outGains + i, &gains, (inFrames - i) * sizeof(Float32));
+
+        position += kLanes;
+        if (inPeriod && position >= period)
+            position -= period;
+    }
+}
+
+} // namespace TremeloOscillator
+
+#endif /* TremeloOscillator_h */
@@ -0,0 +1,93 @@
+//
+//  TremeloParameterExchange.h
+//  TremeloAUv2
+//
+//  Hands a complete set of values (a preset's parameters) from a host thread
+//  to the render thread in one piece. Setting parameters one at a time lets a
+//  render cycle run between two of the writes and process a buffer with half
+//  of the old preset and half of the new one.
+//
+//  Three buffers rotate between the writer, the render thread and a shared
+//  middle slot: the writer fills its own buffer and swaps it into the middle
+//  with a single atomic exchange; the render thread, at the start of a render
+//  cycle, swaps its buffer with the middle if a fresh one is waiting. Neither
+//  side ever waits for the other or copies while the other is writing.
+//
+//  Writers (preset recalls, state restores, parameter writes that must not be
+//  reordered behind a pending set) are serialized by a mutex; they never run
+//  on the render thread. Only the render thread takes: Render, and the unit's
+//  ScheduleParameter, which hosts call on the render thread before rendering.
+//
+
+#ifndef TremeloParameterExchange_h
+#define TremeloParameterExchange_h
+
+#include <atomic>
+#include <mutex>
+
+template <typename T>
+class TremeloParameterExchange {
+public:
+    TremeloParameterExchange () : mBuffers(), mBack(0), mMiddle(1), mFront(2) { }
+
+    /// Writer side. Publishes a copy of inValue; one the render thread hasn't taken yet is replaced.
+    void        Publish (const T &inValue) {
+        std::lock_guard<std::mutex> lock(mWriterMutex);
+        mBuffers[mBack] = inValue;
+        mBack = mMiddle.exchange(mBack | kFresh, std::memory_order_acq_rel) & kIndexMask;
+    }
+
+    /// Writer side. Takes back a published value the render thread hasn't taken, so the caller can
+    /// apply it itself before something that must come after it. Returns false if there is none.
+    bool        Withdraw (T &outValue) {
+        std::lock_guard<std::mutex> lock(mWriterMutex);
+        UInt32 middle = mMiddle.load(std::memory_order_relaxed);
+        while (middle & kFresh) {
+            if (mMiddle.compare_exchange_weak(middle, middle & kIndexMask, std::memory_order_acquire)) {
+                // The render thread may now take this buffer, but it only ever reads buffers.
+                outValue = mBuffers[middle & kIndexMask];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /// Writer side. Copies a published value the render thread hasn't taken into outValue, leaving
+    /// it published. Returns false if there is none.
+    bool        Peek (T &outValue) {
+        std::lock_guard<std::mutex> lock(mWriterMutex);
+        UInt32 middle = mMiddle.load(std::memory_order_acquire);
+        if (!(middle & kFresh))
+            return false;
+        outValue = mBuffers[middle & kIndexMask];
+        return true;
+    }
+
+    /// True while a published value is waiting for the render thread. Lock-free, so callers that
+    /// may run on the render thread check it before Withdraw or Peek.
+    bool        IsPending () const { return (mMiddle.load(std::memory_order_relaxed) & kFresh) != 0; }
+
+    /// Render side; lock-free. Returns the value published since the last call, or NULL.
+    const T *   Take () {
+        if (!(mMiddle.load(std::memory_order_relaxed) & kFresh))
+            return NULL;
+        UInt32 middle = mMiddle.exchange(mFront, std::memory_order_acq_rel);
+        mFront = middle & kIndexMask;
+        // A writer may have withdrawn it between the two loads.
+        return (middle & kFresh) ? &mBuffers[mFront] : NULL;
+    }
+
+private:
+    enum {
+        kIndexMask  = 3,
+        kFresh      = 4                         // set in mMiddle when it holds an untaken value
+    };
+
+    T                   mBuffers[3];
+    UInt32              mBack;                  // the writer's buffer, guarded by mWriterMutex
+    std::atomic<UInt32> mMiddle;                // index | kFresh
+    UInt32              mFront;                 // the render thread's buffer
+    std::mutex          mWriterMutex;
+};
+
+#endif /* TremeloParameterExchange_h */
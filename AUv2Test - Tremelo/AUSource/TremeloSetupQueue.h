@@ -0,0 +1,89 @@
+//
+//  TremeloSetupQueue.h
+//  TremeloAUv2
+//
+//  A process-wide background thread that runs the part of Initialize that a
+//  unit defers with kTremeloUnitProperty_AsyncInitialize, so a host bringing
+//  up hundreds of instances isn't held up allocating and touching their
+//  render resources one after the other.
+//
+//  Jobs run one at a time, in the order they were submitted, outside the
+//  queue's mutex. Cancel takes back a job that hasn't started and waits for
+//  one that is running, so a unit can free what its job writes to once Cancel
+//  returns. The thread is started by the first Submit and never exits.
+//
+
+#ifndef TremeloSetupQueue_h
+#define TremeloSetupQueue_h
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+class TremeloSetupQueue {
+public:
+    typedef void (*JobProc) (void *inRefCon);
+
+    static TremeloSetupQueue &  Shared () {
+        // never destroyed: the thread may still be waiting when the process exits
+        static TremeloSetupQueue *sShared = new TremeloSetupQueue;
+        return *sShared;
+    }
+
+    void    Submit (JobProc inProc, void *inRefCon) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        Job job = { inProc, inRefCon };
+        mJobs.push_back(job);
+        if (!mThreadStarted) {
+            std::thread(&TremeloSetupQueue::Run, this).detach();
+            mThreadStarted = true;
+        }
+        mCondition.notify_all();
+    }
+
+    /// Removes inRefCon's queued jobs and waits for one that is running, unless called from that
+    /// job (e.g. by a property listener it triggers).
+    void    Cancel (void *inRefCon) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mJobs.erase(std::remove_if(mJobs.begin(), mJobs.end(),
+                                   [inRefCon] (const Job &job) { return job.mRefCon == inRefCon; }),
+                    mJobs.end());
+        if (std::this_thread::get_id() != mThreadID)
+            mCondition.wait(lock, [this, inRefCon] { return mRunning != inRefCon; });
+    }
+
+private:
+    struct Job {
+        JobProc mProc;
+        void *  mRefCon;
+    };
+
+    TremeloSetupQueue () : mRunning(NULL), mThreadStarted(false) { }
+
+    void    Run () {
+        std::unique_lock<std::mutex> lock(mMutex);
+        mThreadID = std::this_thread::get_id();
+        for (;;) {
+            mCondition.wait(lock, [this] { return !mJobs.empty(); });
+            Job job = mJobs.front();
+            mJobs.pop_front();
+            mRunning = job.mRefCon;
+            lock.unlock();
+            (job.mProc)(job.mRefCon);
+            lock.lock();
+            mRunning = NULL;
+            mCondition.notify_all();
+        }
+    }
+
+    std::mutex              mMutex;
+    std::condition_variable mCondition;     // a job was queued or finished
+    std::deque<Job>         mJobs;
+    void *                  mRunning;       // the refCon of the running job, or NULL
+    std::thread::id         mThreadID;
+    bool                    mThreadStarted;
+};
+
+#endif /* TremeloSetupQueue_h */
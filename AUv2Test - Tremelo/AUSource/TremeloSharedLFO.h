@@ -0,0 +1,137 @@
+//
+//  TremeloSharedLFO.h
+//  TremeloAUv2
+//
+//  Process-wide cache of sample-time LFO gain blocks, so TremeloUnit instances
+//  with identical settings rendering the same stretch of the timeline compute
+//  the modulation curve once between them. The first instance to render a
+//  slice publishes its gain block; the others copy it out.
+//
+//  The table is a small hash of slots, each guarded by a generation counter
+//  (odd while a writer owns it), i.e. a seqlock: readers never block or take
+//  a lock, copy the block and keep it only if the generation didn't move.
+//  Writers claim a slot with a compare-and-swap and simply skip publishing
+//  if another writer holds it. A hit requires the full key, the slice's
+//  sample time and its length to match, so a stale or overwritten slot can
+//  only cause a miss, never wrong audio.
+//
+//  A reader may copy a slot while a writer fills it, and throws the copy away
+//  when the generation moved. Every field a reader copies is therefore an
+//  atomic, loaded and stored relaxed; the fences around the generation order
+//  them. On the platforms we build for those are plain loads and stores.
+//
+
+#ifndef TremeloSharedLFO_h
+#define TremeloSharedLFO_h
+
+#include "TremeloGainCache.h"
+
+#include <atomic>
+#include <string.h>
+
+class TremeloSharedLFO {
+public:
+    enum {
+        kNumberOfSlots  = 32,               // power of two
+        kMaxFrames      = 4096              // longer slices are rendered locally
+    };
+
+    /// What a gain block depends on: the LFO's gain cache key plus the sample rate.
+    struct Key {
+        TremeloGainCache::Key   mLFO;
+        Float64                 mSampleRate;
+
+        bool operator== (const Key &other) const { return mLFO == other.mLFO && mSampleRate == other.mSampleRate; }
+    };
+
+    /// The process-wide instance. Its slots are allocated on first use.
+    static TremeloSharedLFO &   Shared () {
+        static TremeloSharedLFO sShared;
+        return sShared;
+    }
+
+    /// Copies the block for (inKey, inSampleTime, inFrames) into outGains if one is published.
+    bool    Read (const Key &inKey, Float64 inSampleTime, UInt32 inFrames, Float32 *outGains) {
+        if (inFrames > kMaxFrames)
+            return false;
+        Slot &slot = mSlots[SlotIndex(inKey, inSampleTime)];
+
+        UInt32 generation = slot.mGeneration.load(std::memory_order_acquire);
+        if (generation & 1)
+            return false;
+        bool match = slot.mSampleTime.load(std::memory_order_relaxed) == inSampleTime &&
+                     slot.mFrames.load(std::memory_order_relaxed) == inFrames && slot.LoadKey() == inKey;
+        if (match)
+            for (UInt32 i = 0; i < inFrames; i++)
+                outGains[i] = slot.mGains[i].load(std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return match && slot.mGeneration.load(std::memory_order_relaxed) == generation;
+    }
+
+    /// Publishes a block unless another instance is publishing into the same slot right now.
+    void    Publish (const Key &inKey, Float64 inSampleTime, UInt32 inFrames, const Float32 *inGains) {
+        if (inFrames > kMaxFrames)
+            return;
+        Slot &slot = mSlots[SlotIndex(inKey, inSampleTime)];
+
+        UInt32 generation = slot.mGeneration.load(std::memory_order_relaxed);
+        if ((generation & 1) || !slot.mGeneration.compare_exchange_strong(generation, generation + 1,
+                                                                          std::memory_order_acquire))
+            return;
+        std::atomic_thread_fence(std::memory_order_release);
+        slot.StoreKey(inKey);
+        slot.mSampleTime.store(inSampleTime, std::memory_order_relaxed);
+        slot.mFrames.store(inFrames, std::memory_order_relaxed);
+        for (UInt32 i = 0; i < inFrames; i++)
+            slot.mGains[i].store(inGains[i], std::memory_order_relaxed);
+        slot.mGeneration.store(generation + 2, std::memory_order_release);
+    }
+
+private:
+    struct Slot {
+        enum { kKeyWords = (sizeof(Key) + sizeof(UInt64) - 1) / sizeof(UInt64) };
+        
+        std::atomic<UInt32>     mGeneration;
+        std::atomic<UInt64>     mKey[kKeyWords];    // the Key's bytes
+        std::atomic<Float64>    mSampleTime;
+        std::atomic<UInt32>     mFrames;
+        std::atomic<Float32>    mGains[kMaxFrames];
+        
+        // Key is compared field by field, so its padding may hold anything.
+        Key     LoadKey () const {
+            UInt64 words[kKeyWords];
+            for (UInt32 i = 0; i < kKeyWords; i++)
+                words[i] = mKey[i].load(std::memory_order_relaxed);
+            Key key;
+            memcpy(&key, words, sizeof(Key));
+            return key;
+        }
+        void    StoreKey (const Key &inKey) {
+            UInt64 words[kKeyWords] = { };
+            memcpy(words, &inKey, sizeof(Key));
+            for (UInt32 i = 0; i < kKeyWords; i++)
+                mKey[i].store(words[i], std::memory_order_relaxed);
+        }
+    };
+
+    TremeloSharedLFO () : mSlots(new Slot[kNumberOfSlots]()) { }
+    ~TremeloSharedLFO () { delete [] mSlots; }
+
+    static UInt32   SlotIndex (const Key &inKey, Float64 inSampleTime) {
+        // Mix the fields that differ between settings and between slices.
+        UInt64 bits[4];
+        memcpy(&bits[0], &inKey.mLFO.mIncrement, sizeof(UInt64));
+        memcpy(&bits[1], &inKey.mLFO.mAnchorPhase, sizeof(UInt64));
+        memcpy(&bits[2], &inSampleTime, sizeof(UInt64));
+        bits[3] = (UInt64(inKey.mLFO.mWaveform) << 32) ^ (UInt64(inKey.mLFO.mOscillator) << 40) ^
+                  (UInt64(inKey.mLFO.mControlInterval) << 48) ^ UInt64(inKey.mLFO.mDepth * 1000.f);
+        UInt64 hash = 14695981039346656037ULL;
+        for (UInt64 word : bits)
+            hash = (hash ^ word) * 1099511628211ULL;
+        return UInt32(hash ^ (hash >> 32)) & (kNumberOfSlots - 1);
+    }
+
+    Slot *  mSlots;
+};
+
+#endif /* TremeloSharedLFO_h */
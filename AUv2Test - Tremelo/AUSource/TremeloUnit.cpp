@@ -7,6 +7,13 @@
 
 #include "TremeloUnit.hpp"
 
+#include <algorithm>
+#include <stdint.h>
+#include <type_traits>
+
+// The unit whose ScheduleParameter is running on this thread, if any; see SetParameter.
+static thread_local TremeloUnit *sSchedulingUnit = NULL;
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 AUDIOCOMPONENT_ENTRY(AUBaseFactory, TremeloUnit)
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -17,7 +24,15 @@ AUDIOCOMPONENT_ENTRY(AUBaseFactory, TremeloUnit)
 //  TremeloUnit::TremeloUnit
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // The constructor for new TremeloUnit audio units.
-TremeloUnit::TremeloUnit (AudioUnit component) : AUEffectBase(component) {
+TremeloUnit::TremeloUnit (AudioUnit component) : AUEffectBase(component),
+mSampleTimeLFO(false), mLFOAnchor(), mLFOIncrement(0), mLFOPeriod(0), mRenderSampleTime(0), mSliceSampleTime(0),
+mSliceFrameOffset(0), mParameterValues(), mSharedLFO(false), mOscillator(kTremeloOscillator_WaveTable),
+mControlInterval(kTremeloControlInterval_AudioRate), mKernelVariant(kTremeloKernelVariant_Auto),
+mKernelFunctions(TremeloKernelDispatch::Select(kTremeloKernelVariant_Auto)), mFramesFromSharedLFO(0),
+mSliceGains(NULL), mPresetCrossfade(0), mCrossfadeFrames(0), mCrossfadeLength(0), mLastKey(), mCrossfadeKey(),
+mAsyncInitialize(false), mSetupSubmitted(false), mSetupState(kSetup_Idle), mDeferredGainFrames(0), mHibernateAfter(0),
+mHibernationListener(false), mIdleFrames(0), mHibernationPending(false), mHibernating(false), mHibernations(0),
+mGainsState(kGains_InUse), mReleasedGainFrames(0), mBytesReleased(0) {
     
     // This method, defined in the AUBase superclass, ensures that the required audio unit
     // elements are created and initialised.
@@ -29,9 +44,8 @@ TremeloUnit::TremeloUnit (AudioUnit component) : AUEffectBase(component) {
     
     // During instantiation, sets up the parameters according to their defaults.
     // The parameter defaults should correspond to the settings for the default factory preset.
-    SetParameter(kParameter_Frequency, kDefaultValue_Tremelo_Freq);
-    SetParameter(kParameter_Depth, kDefaultValue_Tremelo_Depth);
-    SetParameter(kParameter_Waveform, kDefaultValue_Tremelo_Waveform);
+    for (const TremeloParameterSpec &spec : kTremeloParameters)
+        SetParameter(spec.mID, spec.mDefaultValue);
     
     // During instantiation, sets the preset menu to indicate the default preset,
     // which corresponds to the default parameters. It's possible to set this a
@@ -43,8 +57,34 @@ TremeloUnit::TremeloUnit (AudioUnit component) : AUEffectBase(component) {
     #endif
 }
 
+TremeloUnit::~TremeloUnit () {
+    // Normally Cleanup has already done this, but an Initialize that failed after queueing the job
+    // leaves the unit uninitialized.
+    CancelDeferredSetup();
+    // Waits for a delivery that is calling it.
+    if (mHibernationListener)
+        RemovePropertyListener(kTremeloUnitProperty_Hibernation, HibernationListener, this, true);
+    ResetHibernation();
+    #if AU_DEBUG_DISPATCHER
+        delete mDebugDispatcher;
+    #endif
+}
+
 #pragma mark ____Parameters
 
+// The parameter names as CFStrings, created once and kept for the life of the process like the
+// CFSTR constants they replace. GetParameterInfo runs for every parameter on every state save.
+static CFStringRef ParameterName(AudioUnitParameterID inParameterID) {
+    static const struct Names {
+        CFStringRef mNames[kNumberOfParameters];
+        Names () {
+            for (const TremeloParameterSpec &spec : kTremeloParameters)
+                mNames[spec.mID] = CFStringCreateWithCString(NULL, spec.mName, kCFStringEncodingUTF8);
+        }
+    } sNames;
+    return sNames.mNames[inParameterID];
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // TremeloUnit::GetParameterInfo
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -59,53 +99,16 @@ ComponentResult TremeloUnit::GetParameterInfo(AudioUnitScope inScope,
     // that it should consider all the audio units parameters to be readable and writable.
     outParameterInfo.flags = kAudioUnitParameterFlag_IsWritable | kAudioUnitParameterFlag_IsReadable;
     
-    // All three parameters of this audio unit are in the "global" scope.
-    if (inScope == kAudioUnitScope_Global) {
-        
-        switch (inParameterID) {
-                
-            case kParameter_Frequency:
-                // Invoked when the view needs information for the kTremelo_Param_Frequency
-                // parameter; defines how to represent this parameter in the user interface.
-                AUBase::FillInParameterName(outParameterInfo, kParamName_Tremelo_Freq, false);
-                
-                // Sets the unit of measurement for the Frequency parameter;
-                outParameterInfo.unit           = kAudioUnitParameterUnit_Hertz;
-                // Sets the minimum value for the Frequency parameter;
-                outParameterInfo.minValue       = kMinimumValue_Tremelo_Freq;
-                // Sets the maxmim value for the Frequency parameter.
-                outParameterInfo.maxValue       = kMaximumValue_Tremelo_Freq;
-                // Sets the default value for the Frequency parameter.
-                outParameterInfo.defaultValue   = kDefaultValue_Tremelo_Freq;
-                // Adds a flag to indicate to the host that it should a logarithmic
-                // control for the Frequency parameter.
-                outParameterInfo.flags          |= kAudioUnitParameterFlag_DisplayLogarithmic;
-                break;
-                
-            case kParameter_Depth:
-                AUBase::FillInParameterName(outParameterInfo, kParamName_Tremelo_Depth, false);
-                outParameterInfo.unit           = kAudioUnitParameterUnit_Percent;
-                outParameterInfo.minValue       = kMinimumValue_Tremelo_Depth;
-                outParameterInfo.maxValue       = kMaximumValue_Tremelo_Depth;
-                outParameterInfo.defaultValue   = kDefaultValue_Tremelo_Depth;
-                break;
-                
-            case kParameter_Waveform:
-                AUBase::FillInParameterName(outParameterInfo, kParamName_Tremelo_Waveform, false);
-                outParameterInfo.unit           = kAudioUnitParameterUnit_Indexed;
-                // Sets the unit of measurement for the Waveform parameter to "indexed",
-                // allowing it to be displayed as a pop-up menu in the gerneic view. The following
-                // three statements ser the min, max, and default values for the depth parameter.
-                // All three are required for peoper functioning of the parameters user interface.
-                outParameterInfo.minValue       = kSineWave_Tremelo_Waveform;
-                outParameterInfo.maxValue       = kSquareWave_Tremelo_Waveform;
-                outParameterInfo.defaultValue   = kSineWave_Tremelo_Waveform;
-                break;
-                
-            default:
-                result = kAudioUnitErr_InvalidParameter;
-                break;
-        }
+    // All three parameters of this audio unit are in the "global" scope, and everything the view
+    // needs to know about them is in kTremeloParameters.
+    if (inScope == kAudioUnitScope_Global && inParameterID < kNumberOfParameters) {
+        const TremeloParameterSpec &spec = kTremeloParameters[inParameterID];
+        AUBase::FillInParameterName(outParameterInfo, ParameterName(spec.mID), false);
+        outParameterInfo.unit           = spec.mUnit;
+        outParameterInfo.minValue       = spec.mMinValue;
+        outParameterInfo.maxValue       = spec.mMaxValue;
+        outParameterInfo.defaultValue   = spec.mDefaultValue;
+        outParameterInfo.flags          |= spec.mFlags;
     } else {
         result = kAudioUnitErr_InvalidParameter;
     }
@@ -115,62 +118,928 @@ ComponentResult TremeloUnit::GetParameterInfo(AudioUnitScope inScope,
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //TremeloUnit::GetParameterValueStrings
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// Provides the strings for the Waveform pop-up menu in the generic view.
+// Provides the strings for the pop-up menus of indexed parameters (the Waveform) in the generic view.
 ComponentResult TremeloUnit::GetParameterValueStrings(AudioUnitScope inScope,
                                                       AudioUnitParameterID inParameterID,
                                                       CFArrayRef *outStrings) {
     
-    // This method applies only to the Waveform parameter in the Global Scope.
-    if ((inScope == kAudioUnitScope_Global) && (inParameterID == kParameter_Waveform)) {
+    // This method applies only to parameters in the Global Scope that have menu items.
+    if ((inScope == kAudioUnitScope_Global) && (inParameterID < kNumberOfParameters) &&
+        kTremeloParameters[inParameterID].mValueStrings != NULL) {
         
         // When this method gets called by the AUBase::DispatchGetPropertInfo method, which
         // provides a NULL value for the outStrings parameter, just return without error.
         if (outStrings == NULL) return noErr;
         
-        // Define an array for our menu item pop-up names.
-        CFStringRef strings [] = {
-            kMenuItem_Tremelo_Sine,
-            kMenuItem_Tremelo_Square
-        };
+        const TremeloParameterSpec &spec = kTremeloParameters[inParameterID];
+        CFStringRef strings [kMaxParameterValueStrings];
+        for (UInt32 i = 0; i < spec.mNumberOfValueStrings; i++)
+            strings[i] = CFStringCreateWithCString(NULL, spec.mValueStrings[i], kCFStringEncodingUTF8);
         
-        //Create a new immutable array containing the menu item names, and places the array
-        // in the outStrings output parameter.
+        // Create a new immutable array containing the menu item names, and places the array
+        // in the outStrings output parameter. The array retains the names.
         *outStrings = CFArrayCreate(NULL,
                                     (const void **) strings,
-                                    (sizeof(strings) / sizeof(strings[0])),
-                                    NULL);
+                                    spec.mNumberOfValueStrings,
+                                    &kCFTypeArrayCallBacks);
+        for (UInt32 i = 0; i < spec.mNumberOfValueStrings; i++)
+            CFRelease(strings[i]);
         return noErr;
     }
     return kAudioUnitErr_InvalidParameter;
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::SetParameter
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Host and API writes to the global parameters are clamped here, once, so GetParameter reports
+// the value the DSP actually uses.
+OSStatus TremeloUnit::SetParameter(AudioUnitParameterID inID,
+                                   AudioUnitScope inScope,
+                                   AudioUnitElement inElement,
+                                   AudioUnitParameterValue inValue,
+                                   UInt32 inBufferOffsetInFrames) {
+    if (inScope == kAudioUnitScope_Global && inID < kNumberOfParameters) {
+        inValue = kTremeloParameters[inID].Clamp(inValue);
+        // A preset recalled before this write must not land after it. Scheduled events come
+        // from the render thread, which must not take the exchange's writer lock; ScheduleParameter
+        // has already taken the preset for them.
+        if (sSchedulingUnit != this)
+            CommitPendingParameterSet();
+    }
+    return AUEffectBase::SetParameter(inID, inScope, inElement, inValue, inBufferOffsetInFrames);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::ScheduleParameter
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Hosts schedule parameter events on the render thread, just before AudioUnitRender, and
+// AUBase applies the immediate ones through SetParameter. The preset a host recalled earlier
+// is taken here, as Render would take it, so the events still land after it.
+OSStatus TremeloUnit::ScheduleParameter(const AudioUnitParameterEvent *inParameterEvent,
+                                        UInt32 inNumEvents) {
+    TakePendingParameterSet();
+    TremeloUnit *outerUnit = sSchedulingUnit;
+    sSchedulingUnit = this;
+    OSStatus result = AUEffectBase::ScheduleParameter(inParameterEvent, inNumEvents);
+    sSchedulingUnit = outerUnit;
+    return result;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::GetParameter
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Reports a recalled preset's values as soon as it is recalled, not only once Render took it.
+OSStatus TremeloUnit::GetParameter(AudioUnitParameterID inID,
+                                   AudioUnitScope inScope,
+                                   AudioUnitElement inElement,
+                                   AudioUnitParameterValue &outValue) {
+    TremeloParameterSet pending;
+    if (inScope == kAudioUnitScope_Global && inID < kNumberOfParameters && mParameterExchange.IsPending() &&
+        mParameterExchange.Peek(pending)) {
+        outValue = kTremeloParameters[inID].Clamp(pending.mValues[inID]);
+        return noErr;
+    }
+    return AUEffectBase::GetParameter(inID, inScope, inElement, outValue);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::ApplyParameterSet, TremeloUnit::CommitPendingParameterSet
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// ApplyParameterSet writes a whole set into the global parameters; TakePendingParameterSet calls
+// it with a preset taken from mParameterExchange, between render cycles. CommitPendingParameterSet
+// applies a preset the render thread hasn't taken yet from the calling thread, for the few
+// callers that must see it in place first. It takes the exchange's writer lock, so it is never
+// called on the render thread.
+void TremeloUnit::ApplyParameterSet(const TremeloParameterSet &inSet) {
+    for (const TremeloParameterSpec &spec : kTremeloParameters)
+        Globals()->SetParameter(spec.mID, spec.Clamp(inSet.mValues[spec.mID]));
+}
+
+void TremeloUnit::CommitPendingParameterSet() {
+    TremeloParameterSet pending;
+    if (mParameterExchange.IsPending() && mParameterExchange.Withdraw(pending))
+        ApplyParameterSet(pending);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::TakePendingParameterSet
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The render thread's side of mParameterExchange, lock-free: applies a recalled preset and,
+// with the sample-time LFO, starts the crossfade from the gains the old one produced.
+void TremeloUnit::TakePendingParameterSet() {
+    if (const TremeloParameterSet *preset = mParameterExchange.Take()) {
+        ApplyParameterSet(*preset);
+        if (mSampleTimeLFO && mPresetCrossfade && mLastKey.mIncrement != 0) {
+            mCrossfadeKey = mLastKey;
+            mCrossfadeFrames = mCrossfadeLength = mPresetCrossfade;
+        }
+    }
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::CaptureParameterValues
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Takes the slice's parameter values for the kernels. Scheduled parameter events and restored
+// presets reach the parameter element without passing through SetParameter, so the values are
+// clamped again here; that is three compares per slice rather than per kernel call.
+void TremeloUnit::CaptureParameterValues() {
+    mParameterValues.mFrequency = kTremeloParameters[kParameter_Frequency].Clamp(GetParameter(kParameter_Frequency));
+    mParameterValues.mDepth     = kTremeloParameters[kParameter_Depth].Clamp(GetParameter(kParameter_Depth));
+    mParameterValues.mWaveform  = SInt32(kTremeloParameters[kParameter_Waveform].Clamp(GetParameter(kParameter_Waveform)));
+}
+
 #pragma mark ____Properties
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // Tremelo::GetPropertyInfo
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// This audio unit doesn't define any custom properties, so it uses this generic code for
-// this method.
+// Describes the custom LFO properties; everything else is handled by AUEffectBase.
 ComponentResult TremeloUnit::GetPropertyInfo(AudioUnitPropertyID inID,
                                              AudioUnitScope inScope,
                                              AudioUnitElement inElement,
                                              UInt32 &outDataSize,
                                              Boolean &outWritable) {
+    if (inScope == kAudioUnitScope_Global) {
+        switch (inID) {
+            case kTremeloUnitProperty_SampleTimeLFO:
+                outDataSize = sizeof(UInt32);
+                outWritable = true;
+                return noErr;
+            case kTremeloUnitProperty_LFOAnchor:
+                outDataSize = sizeof(TremeloLFOAnchor);
+                outWritable = true;
+                return noErr;
+            case kTremeloUnitProperty_GainCacheStats:
+                outDataSize = sizeof(TremeloGainCacheStats);
+                outWritable = false;
+                return noErr;
+            case kTremeloUnitProperty_MemoryUsage:
+                outDataSize = sizeof(AUMemoryUsage);
+                outWritable = false;
+                return noErr;
+            case kTremeloUnitProperty_Ready:
+                outDataSize = sizeof(UInt32);
+                outWritable = false;
+                return noErr;
+            case kTremeloUnitProperty_Hibernation:
+                outDataSize = sizeof(TremeloHibernationStats);
+                outWritable = false;
+                return noErr;
+            case kTremeloUnitProperty_SharedLFO:
+            case kTremeloUnitProperty_Oscillator:
+            case kTremeloUnitProperty_ControlInterval:
+            case kTremeloUnitProperty_PresetCrossfade:
+            case kTremeloUnitProperty_PropertyNotification:
+            case kTremeloUnitProperty_DeliverPropertyChanges:
+            case kTremeloUnitProperty_AsyncInitialize:
+            case kTremeloUnitProperty_HibernateAfter:
+                outDataSize = sizeof(UInt32);
+                outWritable = true;
+                return noErr;
+            case kTremeloUnitProperty_KernelVariant:
+                outDataSize = sizeof(SInt32);
+                outWritable = true;
+                return noErr;
+            case kTremeloUnitProperty_Configuration:
+                outDataSize = sizeof(TremeloUnitConfiguration);
+                outWritable = true;
+                return noErr;
+            case kTremeloUnitProperty_BinaryState:
+                outDataSize = GetBinaryStateSize();
+                outWritable = true;
+                return noErr;
+        }
+    }
     return AUEffectBase::GetPropertyInfo(inID, inScope, inElement, outDataSize, outWritable);
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // TremeloUnit::GetProperty
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// This audio unit doesn't define any custom properties, so it uses this generic code for
-// this method.
 ComponentResult TremeloUnit::GetProperty(AudioUnitPropertyID inID,
                                          AudioUnitScope inScope,
                                          AudioUnitElement inElement,
                                          void *outData) {
+    if (inScope == kAudioUnitScope_Global) {
+        switch (inID) {
+            case kTremeloUnitProperty_SampleTimeLFO:
+                *(UInt32 *)outData = mSampleTimeLFO;
+                return noErr;
+            case kTremeloUnitProperty_LFOAnchor:
+                if (!(mAnchorExchange.IsPending() && mAnchorExchange.Peek(*(TremeloLFOAnchor *)outData)))
+                    *(TremeloLFOAnchor *)outData = mLFOAnchor;
+                return noErr;
+            case kTremeloUnitProperty_SharedLFO:
+                *(UInt32 *)outData = mSharedLFO.load(std::memory_order_relaxed);
+                return noErr;
+            case kTremeloUnitProperty_Oscillator:
+                *(UInt32 *)outData = mOscillator.load(std::memory_order_relaxed);
+                return noErr;
+            case kTremeloUnitProperty_ControlInterval:
+                *(UInt32 *)outData = mControlInterval.load(std::memory_order_relaxed);
+                return noErr;
+            case kTremeloUnitProperty_KernelVariant:
+                *(SInt32 *)outData = mKernelFunctions->mVariant;
+                return noErr;
+            case kTremeloUnitProperty_PresetCrossfade:
+                *(UInt32 *)outData = mPresetCrossfade;
+                return noErr;
+            case kTremeloUnitProperty_PropertyNotification:
+                *(UInt32 *)outData = GetPropertyNotificationMode();
+                return noErr;
+            case kTremeloUnitProperty_DeliverPropertyChanges:
+                return kAudioUnitErr_InvalidProperty;
+            case kTremeloUnitProperty_BinaryState: {
+                // The dispatcher hands us a buffer of the size GetPropertyInfo reported.
+                CommitPendingParameterSet();
+                UInt32 size = GetBinaryStateSize();
+                return SaveBinaryState(outData, size);
+            }
+            case kTremeloUnitProperty_GainCacheStats: {
+                TremeloGainCacheStats &stats = *(TremeloGainCacheStats *)outData;
+                stats.mFramesProcessed  = mGainCache.FramesProcessed();
+                stats.mFramesFromCache  = mGainCache.FramesFromCache();
+                stats.mFramesFromSharedLFO = mFramesFromSharedLFO;
+                stats.mPeriodFrames     = mGainCache.Period();
+                stats.mBytesAllocated   = mGainCache.BytesAllocated();
+                return noErr;
+            }
+            case kTremeloUnitProperty_MemoryUsage:
+                GetMemoryUsage(*(AUMemoryUsage *)outData);
+                return noErr;
+            case kTremeloUnitProperty_AsyncInitialize:
+                *(UInt32 *)outData = mAsyncInitialize;
+                return noErr;
+            case kTremeloUnitProperty_Ready: {
+                UInt32 state = mSetupState.load(std::memory_order_acquire);
+                *(UInt32 *)outData = state == kSetup_Done || state == kSetup_Ready;
+                return noErr;
+            }
+            case kTremeloUnitProperty_Configuration:
+                GetConfiguration(*(TremeloUnitConfiguration *)outData);
+                return noErr;
+            case kTremeloUnitProperty_HibernateAfter:
+                *(UInt32 *)outData = mHibernateAfter.load(std::memory_order_relaxed);
+                return noErr;
+            case kTremeloUnitProperty_Hibernation:
+                GetHibernationStats(*(TremeloHibernationStats *)outData);
+                return noErr;
+        }
+    }
     return AUEffectBase::GetProperty(inID, inScope, inElement, outData);
 }
 
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::GetMemoryUsage
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+void TremeloUnit::GetMemoryUsage (AUMemoryUsage &outUsage) const {
+    AUEffectBase::GetMemoryUsage(outUsage);
+    outUsage.mInstance = sizeof(TremeloUnit);
+    outUsage.mOther += (mSliceGainBuffer.capacity() + mCrossfadeGainBuffer.capacity()) * sizeof(Float32) +
+                       mGainCache.BytesAllocated();
+    std::lock_guard<std::mutex> lock(mHibernationMutex);
+    outUsage.mOther += mSpareGains.capacity() * sizeof(Float32);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::SetProperty
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The LFO properties may be changed at any time; the kernels pick them up at the next slice.
+// The render thread moves the anchor itself, so an anchor set while the unit is initialized is
+// handed over like a recalled preset and Render takes it at the start of the next render cycle.
+// The kernel variant is the exception: it is only bound by Initialize.
+// The gain cache is only allocated by Initialize, so enabling the sample-time LFO on an
+// initialized unit renders without the cache until the next Initialize. The gain buffers it
+// can't do without are allocated here before the render thread sees it enabled.
+ComponentResult TremeloUnit::SetProperty(AudioUnitPropertyID inID,
+                                         AudioUnitScope inScope,
+                                         AudioUnitElement inElement,
+                                         const void *inData,
+                                         UInt32 inDataSize) {
+    if (inScope == kAudioUnitScope_Global) {
+        switch (inID) {
+            case kTremeloUnitProperty_SampleTimeLFO:
+                if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+                if (*(const UInt32 *)inData != 0 && IsInitialized() && mSliceGainBuffer.empty())
+                    AllocateGainBuffers();
+                mSampleTimeLFO.store(*(const UInt32 *)inData != 0, std::memory_order_release);
+                return noErr;
+            case kTremeloUnitProperty_LFOAnchor: {
+                if (inDataSize < sizeof(TremeloLFOAnchor)) return kAudioUnitErr_InvalidPropertyValue;
+                const TremeloLFOAnchor &anchor = *(const TremeloLFOAnchor *)inData;
+                if (anchor.mFrequency != 0 && (anchor.mFrequency < kMinimumValue_Tremelo_Freq ||
+                                               anchor.mFrequency > kMaximumValue_Tremelo_Freq))
+                    return kAudioUnitErr_InvalidPropertyValue;
+                if (IsInitialized())
+                    mAnchorExchange.Publish(anchor);
+                else
+                    SetLFOAnchor(anchor);
+                return noErr;
+            }
+            case kTremeloUnitProperty_SharedLFO:
+                if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+                // Create the process-wide table here rather than on the render thread.
+                if (*(const UInt32 *)inData != 0)
+                    TremeloSharedLFO::Shared();
+                mSharedLFO.store(*(const UInt32 *)inData != 0, std::memory_order_relaxed);
+                return noErr;
+            case kTremeloUnitProperty_Oscillator:
+                if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+                if (*(const UInt32 *)inData > kTremeloOscillator_Polynomial) return kAudioUnitErr_InvalidPropertyValue;
+                mOscillator.store(*(const UInt32 *)inData, std::memory_order_relaxed);
+                return noErr;
+            case kTremeloUnitProperty_ControlInterval: {
+                if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+                UInt32 interval = *(const UInt32 *)inData;
+                if (interval != kTremeloControlInterval_AudioRate && interval != kTremeloControlInterval_16 &&
+                    interval != kTremeloControlInterval_32 && interval != kTremeloControlInterval_64)
+                    return kAudioUnitErr_InvalidPropertyValue;
+                mControlInterval.store(interval, std::memory_order_relaxed);
+                return noErr;
+            }
+            case kTremeloUnitProperty_KernelVariant: {
+                if (inDataSize < sizeof(SInt32)) return kAudioUnitErr_InvalidPropertyValue;
+                SInt32 variant = *(const SInt32 *)inData;
+                if (TremeloKernelDispatch::Select(variant) == NULL) return kAudioUnitErr_InvalidPropertyValue;
+                mKernelVariant = variant;
+                return noErr;
+            }
+            case kTremeloUnitProperty_PresetCrossfade:
+                if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+                mPresetCrossfade = *(const UInt32 *)inData;
+                return noErr;
+            case kTremeloUnitProperty_AsyncInitialize:
+                if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+                mAsyncInitialize = *(const UInt32 *)inData != 0;
+                return noErr;
+            case kTremeloUnitProperty_HibernateAfter:
+                if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+                SetHibernateAfter(*(const UInt32 *)inData);
+                return noErr;
+            case kTremeloUnitProperty_Configuration:
+                if (inDataSize < sizeof(TremeloUnitConfiguration)) return kAudioUnitErr_InvalidPropertyValue;
+                return SetConfiguration(*(const TremeloUnitConfiguration *)inData);
+            case kTremeloUnitProperty_BinaryState:
+                return RestoreBinaryState(inData, inDataSize);
+            case kTremeloUnitProperty_PropertyNotification:
+                if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+                return SetPropertyNotificationMode(*(const UInt32 *)inData);
+            case kTremeloUnitProperty_DeliverPropertyChanges:
+                if (inDataSize < sizeof(UInt32)) return kAudioUnitErr_InvalidPropertyValue;
+                DeliverPropertyChanges(*(const UInt32 *)inData);
+                return noErr;
+        }
+    }
+    return AUEffectBase::SetProperty(inID, inScope, inElement, inData, inDataSize);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::GetConfiguration, TremeloUnit::SetConfiguration
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// kTremeloUnitProperty_Configuration. Setting it does in one call what the host would otherwise
+// do with a property or parameter call per field, each through the dispatcher and each telling
+// the listeners: only the formats, whose listeners AUEffectBase relies on, are changed through
+// ChangeStreamFormat, and only when they differ. The kernels, the render buffers and the DSP
+// state are not part of it; the unit's own Initialize sets them up, as for any new instance.
+// Everything that can fail is checked first, including what SetPropertyNotificationMode would
+// refuse; the formats are changed next, the input's put back if the output's is refused, so a
+// configuration that fails leaves the unit as it was.
+void TremeloUnit::GetConfiguration(TremeloUnitConfiguration &outConfiguration) {
+    CommitPendingParameterSet();
+    TremeloUnitConfiguration &config = outConfiguration;
+    config.mInputFormat = GetStreamFormat(kAudioUnitScope_Input, 0);
+    config.mOutputFormat = GetStreamFormat(kAudioUnitScope_Output, 0);
+    config.mMaxFramesPerSlice = GetMaxFramesPerSlice();
+    for (const TremeloParameterSpec &spec : kTremeloParameters)
+        config.mParameters.mValues[spec.mID] = Globals()->GetParameter(spec.mID);
+    config.mPreset = GetCurrentPreset();
+    if (config.mPreset.presetName)
+        CFRetain(config.mPreset.presetName);
+    config.mBypass = IsBypassEffect();
+    config.mInPlaceProcessing = ProcessesInPlace();
+    config.mSampleTimeLFO = mSampleTimeLFO;
+    config.mSharedLFO = mSharedLFO.load(std::memory_order_relaxed);
+    config.mOscillator = mOscillator.load(std::memory_order_relaxed);
+    config.mControlInterval = mControlInterval.load(std::memory_order_relaxed);
+    config.mKernelVariant = mKernelVariant;
+    config.mPresetCrossfade = mPresetCrossfade;
+    config.mAsyncInitialize = mAsyncInitialize;
+    config.mPropertyNotification = GetPropertyNotificationMode();
+    config.mHibernateAfter = mHibernateAfter.load(std::memory_order_relaxed);
+    config.mInitialized = IsInitialized();
+}
+
+OSStatus TremeloUnit::SetConfiguration(const TremeloUnitConfiguration &inConfiguration) {
+    const TremeloUnitConfiguration &config = inConfiguration;
+    if (IsInitialized())
+        return kAudioUnitErr_Initialized;
+    
+    const CAStreamBasicDescription inputFormat(config.mInputFormat), outputFormat(config.mOutputFormat);
+    if (!ValidFormat(kAudioUnitScope_Input, 0, inputFormat) || !ValidFormat(kAudioUnitScope_Output, 0, outputFormat))
+        return kAudioUnitErr_FormatNotSupported;
+    if (config.mMaxFramesPerSlice == 0 || (config.mPreset.presetNumber < 0 && config.mPreset.presetName == NULL) ||
+        config.mOscillator > kTremeloOscillator_Polynomial ||
+        (config.mControlInterval != kTremeloControlInterval_AudioRate && config.mControlInterval != kTremeloControlInterval_16 &&
+         config.mControlInterval != kTremeloControlInterval_32 && config.mControlInterval != kTremeloControlInterval_64) ||
+        TremeloKernelDispatch::Select(config.mKernelVariant) == NULL ||
+        config.mPropertyNotification > kAUPropertyNotification_HostPumped)
+        return kAudioUnitErr_InvalidPropertyValue;
+    const AUPreset *factoryPreset = NULL;
+    if (config.mPreset.presetNumber >= 0) {
+        for (int i = 0; i < kNumberOfPresets; i++)
+            if (kPresets[i].presetNumber == config.mPreset.presetNumber)
+                factoryPreset = &kPresets[i];
+        if (factoryPreset == NULL)
+            return kAudioUnitErr_InvalidPropertyValue;
+    }
+    const bool changesNotification = config.mPropertyNotification != GetPropertyNotificationMode();
+    if (changesNotification && (InRenderCall() || InRenderThread()))
+        return kAudioUnitErr_CannotDoInCurrentContext;
+    
+    const CAStreamBasicDescription curInput(GetStreamFormat(kAudioUnitScope_Input, 0));
+    if (!curInput.IsExactlyEqual(inputFormat)) {
+        OSStatus result = ChangeStreamFormat(kAudioUnitScope_Input, 0, curInput, inputFormat);
+        if (result != noErr)
+            return result;
+    }
+    const CAStreamBasicDescription curOutput(GetStreamFormat(kAudioUnitScope_Output, 0));
+    if (!curOutput.IsExactlyEqual(outputFormat)) {
+        OSStatus result = ChangeStreamFormat(kAudioUnitScope_Output, 0, curOutput, outputFormat);
+        if (result != noErr) {
+            if (!curInput.IsExactlyEqual(inputFormat))
+                ChangeStreamFormat(kAudioUnitScope_Input, 0, inputFormat, curInput);
+            return result;
+        }
+    }
+    SetMaxFramesPerSlice(config.mMaxFramesPerSlice);
+    
+    // Replaces a recalled preset that hasn't been applied yet, as RestoreState does.
+    TremeloParameterSet pending;
+    if (mParameterExchange.IsPending())
+        mParameterExchange.Withdraw(pending);
+    ApplyParameterSet(config.mParameters);
+    if (factoryPreset)
+        SetAFactoryPresetAsCurrent(*factoryPreset);
+    else
+        NewCustomPresetSet(config.mPreset);
+    
+    SetBypassEffect(config.mBypass != 0);
+    SetProcessesInPlace(config.mInPlaceProcessing != 0);
+    mSampleTimeLFO.store(config.mSampleTimeLFO != 0, std::memory_order_relaxed);
+    if (config.mSharedLFO)
+        TremeloSharedLFO::Shared();
+    mSharedLFO.store(config.mSharedLFO != 0, std::memory_order_relaxed);
+    mOscillator.store(config.mOscillator, std::memory_order_relaxed);
+    mControlInterval.store(config.mControlInterval, std::memory_order_relaxed);
+    mKernelVariant = config.mKernelVariant;
+    mPresetCrossfade = config.mPresetCrossfade;
+    mAsyncInitialize = config.mAsyncInitialize != 0;
+    SetHibernateAfter(config.mHibernateAfter);
+    if (changesNotification)
+        return SetPropertyNotificationMode(config.mPropertyNotification);
+    return noErr;
+}
+
+#pragma mark ____Sample-Time LFO
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::Initialize, TremeloUnit::Reset
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Both clear the LFO anchor, and discard one set since the last render, so the next render
+// starts the timeline's LFO at sample time 0.
+// Initialize also binds the kernel variant for this render session and, for the sample-time
+// LFO only, allocates the gain buffers and sizes the gain cache for the longest period the
+// sample rate allows. The cache is most of an initialized unit's memory and of the time
+// Initialize takes, so with kTremeloUnitProperty_AsyncInitialize it is left to the setup queue.
+OSStatus TremeloUnit::Initialize() {
+    OSStatus result = AUEffectBase::Initialize();
+    if (result == noErr) {
+        mKernelFunctions = TremeloKernelDispatch::Select(mKernelVariant);
+        TremeloLFOAnchor discarded;
+        if (mAnchorExchange.IsPending())
+            mAnchorExchange.Withdraw(discarded);
+        SetLFOAnchor(TremeloLFOAnchor());
+        mCrossfadeFrames = 0;
+        mLastKey = TremeloGainCache::Key();
+        ResetHibernation();
+        mSetupState.store(kSetup_Ready, std::memory_order_relaxed);
+        if (mSampleTimeLFO) {
+            AllocateGainBuffers();
+            const UInt32 maxPeriod = UInt32(GetSampleRate() * kMaxLFOPeriodSeconds);
+            if (mAsyncInitialize) {
+                mDeferredGainFrames = maxPeriod;
+                mSetupState.store(kSetup_Pending, std::memory_order_relaxed);
+                mSetupSubmitted = true;
+                TremeloSetupQueue::Shared().Submit(RunDeferredSetup, this);
+            } else {
+                mGainCache.Allocate(maxPeriod);
+            }
+        }
+    }
+    return result;
+}
+
+void TremeloUnit::Cleanup() {
+    CancelDeferredSetup();
+    ResetHibernation();
+    // Nothing renders until the next Initialize; a recalled preset would otherwise wait for it.
+    CommitPendingParameterSet();
+    mGainCache.Deallocate();
+    std::vector<Float32>().swap(mSliceGainBuffer);
+    std::vector<Float32>().swap(mCrossfadeGainBuffer);
+    AUEffectBase::Cleanup();
+}
+
+void TremeloUnit::ReallocateBuffers() {
+    AUEffectBase::ReallocateBuffers();
+    if (mHibernateAfter.load(std::memory_order_relaxed) != 0)
+        ReserveArenaBuffers();
+}
+
+// Both buffers hold up to a slice of gains. The legacy LFO uses neither.
+void TremeloUnit::AllocateGainBuffers() {
+    mSliceGainBuffer.assign(GetMaxFramesPerSlice(), 0.f);
+    mCrossfadeGainBuffer.assign(GetMaxFramesPerSlice(), 0.f);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::RunDeferredSetup, TremeloUnit::CancelDeferredSetup
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The setup queue's job: allocates (and so faults in) the gain cache's buffer on the queue's
+// thread. Render takes it over at the start of the next render cycle; the unit is ready as soon
+// as it is filled, whether or not it renders.
+void TremeloUnit::RunDeferredSetup(void *inRefCon) {
+    TremeloUnit *unit = static_cast<TremeloUnit *>(inRefCon);
+    unit->mDeferredGains.assign(unit->mDeferredGainFrames, 0.f);
+    unit->mSetupState.store(kSetup_Done, std::memory_order_release);
+    unit->PropertyChanged(kTremeloUnitProperty_Ready, kAudioUnitScope_Global, 0);
+}
+
+// Not while rendering: a buffer Render hasn't taken over yet is freed.
+void TremeloUnit::CancelDeferredSetup() {
+    if (mSetupSubmitted) {
+        TremeloSetupQueue::Shared().Cancel(this);
+        mSetupSubmitted = false;
+    }
+    mSetupState.store(kSetup_Idle, std::memory_order_relaxed);
+    std::vector<Float32>().swap(mDeferredGains);
+}
+
+OSStatus TremeloUnit::Reset(AudioUnitScope inScope, AudioUnitElement inElement) {
+    TremeloLFOAnchor discarded;
+    if (mAnchorExchange.IsPending())
+        mAnchorExchange.Withdraw(discarded);
+    SetLFOAnchor(TremeloLFOAnchor());
+    mGainCache.Invalidate();
+    mCrossfadeFrames = 0;
+    mLastKey = TremeloGainCache::Key();
+    return AUEffectBase::Reset(inScope, inElement);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::Render, TremeloUnit::ProcessScheduledSlice
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// AUEffectBase either processes the whole buffer or splits it at scheduled parameter events;
+// record where on the timeline the kernels' next Process call starts. A recalled preset is
+// taken here, between render cycles, so no buffer mixes two presets' parameters, and so are an
+// LFO anchor the host set and a gain cache the setup queue has finished allocating. Hibernation
+// is decided here as well.
+OSStatus TremeloUnit::Render(AudioUnitRenderActionFlags &ioActionFlags,
+                             const AudioTimeStamp &inTimeStamp,
+                             UInt32 inFramesToProcess) {
+    mRenderSampleTime = mSliceSampleTime = inTimeStamp.mSampleTime;
+    if (mSetupState.load(std::memory_order_acquire) == kSetup_Done) {
+        mGainCache.Adopt(mDeferredGains);
+        mSetupState.store(kSetup_Ready, std::memory_order_relaxed);
+    }
+    BeginRenderHibernation();
+    TakePendingParameterSet();
+    if (const TremeloLFOAnchor *anchor = mAnchorExchange.Take())
+        SetLFOAnchor(*anchor);
+    OSStatus result = AUEffectBase::Render(ioActionFlags, inTimeStamp, inFramesToProcess);
+    if (result == noErr)
+        EndRenderHibernation(ioActionFlags, inFramesToProcess);
+    return result;
+}
+
+OSStatus TremeloUnit::ProcessScheduledSlice(void *inUserData,
+                                            UInt32 inStartFrameInBuffer,
+                                            UInt32 inSliceFramesToProcess,
+                                            UInt32 inTotalBufferFrames) {
+    mSliceSampleTime = mRenderSampleTime + inStartFrameInBuffer;
+    return AUEffectBase::ProcessScheduledSlice(inUserData, inStartFrameInBuffer, inSliceFramesToProcess, inTotalBufferFrames);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::ProcessBufferLists
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Called once per slice before the kernels run, which makes it the place to move the shared
+// LFO anchor and to decide whether the slice comes from the gain cache; the kernels then only
+// read that state.
+OSStatus TremeloUnit::ProcessBufferLists(AudioUnitRenderActionFlags &ioActionFlags,
+                                         const AudioBufferList &inBuffer,
+                                         AudioBufferList &outBuffer,
+                                         UInt32 inFramesToProcess) {
+    CaptureParameterValues();
+    if (!mSampleTimeLFO.load(std::memory_order_acquire)) {
+        mSliceGains = NULL;
+        return AUEffectBase::ProcessBufferLists(ioActionFlags, inBuffer, outBuffer, inFramesToProcess);
+    }
+    
+    UpdateLFOAnchor(mSliceSampleTime);
+    mSliceFrameOffset = LFOFramesFromAnchor(mSliceSampleTime);
+    
+    TremeloGainCache::Key key = { mLFOAnchor.mSampleTime, mLFOAnchor.mPhase, mLFOIncrement, mLFOPeriod,
+                                  mParameterValues.mDepth, mParameterValues.mWaveform,
+                                  SInt32(mOscillator.load(std::memory_order_relaxed)),
+                                  mControlInterval.load(std::memory_order_relaxed) };
+    mGainCache.BeginSlice(key, mSliceSampleTime, mSliceFrameOffset);
+    RenderSliceGains(key, inFramesToProcess);
+    if (mCrossfadeFrames)
+        CrossfadeSliceGains(inFramesToProcess);
+    mLastKey = key;
+    
+    OSStatus result = AUEffectBase::ProcessBufferLists(ioActionFlags, inBuffer, outBuffer, inFramesToProcess);
+    
+    mGainCache.EndSlice(mSliceSampleTime, inFramesToProcess);
+    return result;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::RenderSliceGains
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Produces the slice's gain block in mSliceGains, from the cheapest source available: the
+// local period cache (only ever serving or storing slices at a whole-frame offset), a block
+// another instance published to the shared LFO, or computing it from the first kernel's wave
+// tables (and then publishing it and feeding the local cache).
+void TremeloUnit::RenderSliceGains(const TremeloGainCache::Key &inKey, UInt32 inFrames) {
+    Float32 *block = mSliceGainBuffer.data();
+    
+    if (mGainCache.IsServing()) {
+        const UInt32 position = UInt32(mSliceFrameOffset);
+        if (position + inFrames <= mLFOPeriod) {
+            mSliceGains = mGainCache.Gains() + position;
+        } else {
+            mGainCache.Copy(position, inFrames, block);
+            mSliceGains = block;
+        }
+        return;
+    }
+    
+    mSliceGains = block;
+    TremeloSharedLFO::Key sharedKey = { inKey, GetSampleRate() };
+    const bool sharedLFO = mSharedLFO.load(std::memory_order_relaxed);
+    if (sharedLFO && TremeloSharedLFO::Shared().Read(sharedKey, mSliceSampleTime, inFrames, block)) {
+        mFramesFromSharedLFO += inFrames;
+    } else {
+        static_cast<const TremeloUnitKernel *>(GetKernel(0))->RenderLFOGains(block, inFrames, mSliceFrameOffset, inKey);
+        if (sharedLFO)
+            TremeloSharedLFO::Shared().Publish(sharedKey, mSliceSampleTime, inFrames, block);
+    }
+    mGainCache.Store(UInt32(mSliceFrameOffset), inFrames, block);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::CrossfadeSliceGains
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// After a preset recall, blends the gains the old settings (mCrossfadeKey) would have produced
+// into the slice's gains, linearly over mCrossfadeLength frames. Runs after RenderSliceGains has
+// fed the gain cache and the shared LFO, which only ever hold unblended curves.
+void TremeloUnit::CrossfadeSliceGains(UInt32 inFrames) {
+    Float32 *block = mSliceGainBuffer.data();
+    if (mSliceGains != block) {
+        memcpy(block, mSliceGains, inFrames * sizeof(Float32));
+        mSliceGains = block;
+    }
+    
+    Float64 offset = mSliceSampleTime - mCrossfadeKey.mAnchorSampleTime;
+    if (mCrossfadeKey.mPeriod) {
+        offset = fmod(offset, mCrossfadeKey.mPeriod);
+        if (offset < 0) offset += mCrossfadeKey.mPeriod;
+    }
+    const UInt32 frames = std::min(inFrames, mCrossfadeFrames);
+    Float32 *from = mCrossfadeGainBuffer.data();
+    static_cast<const TremeloUnitKernel *>(GetKernel(0))->RenderLFOGains(from, frames, offset, mCrossfadeKey);
+    
+    const Float32 step = 1.f / Float32(mCrossfadeLength + 1);
+    const UInt32 done = mCrossfadeLength - mCrossfadeFrames;
+    for (UInt32 i = 0; i < frames; i++)
+        block[i] = from[i] + (block[i] - from[i]) * (Float32(done + i + 1) * step);
+    mCrossfadeFrames -= frames;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::SetLFOAnchor, TremeloUnit::UpdateLFOAnchor
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// SetLFOAnchor replaces the anchor and what is derived from it; on the render thread, or while
+// nothing renders. UpdateLFOAnchor re-anchors the LFO when the frequency parameter differs from
+// the anchor's. The new anchor's phase is the old LFO's phase at the slice start, so the
+// waveform stays continuous. Everything here is a function of the sample time and the frequency
+// history only, never of how many samples this instance happens to have processed.
+void TremeloUnit::SetLFOAnchor(const TremeloLFOAnchor &inAnchor) {
+    mLFOAnchor = inAnchor;
+    mLFOIncrement = mLFOAnchor.mFrequency / GetSampleRate();
+    UpdateLFOPeriod();
+}
+
+void TremeloUnit::UpdateLFOAnchor(Float64 inSliceSampleTime) {
+    Float64 frequency = mParameterValues.mFrequency;
+    
+    if (mLFOAnchor.mFrequency == 0) {
+        // Unset: the timeline's LFO starts at sample time 0, wherever this instance starts.
+        mLFOAnchor.mSampleTime = 0;
+        mLFOAnchor.mPhase = 0;
+    } else if (frequency != mLFOAnchor.mFrequency) {
+        Float64 phase = mLFOAnchor.mPhase + LFOFramesFromAnchor(inSliceSampleTime) * mLFOIncrement;
+        mLFOAnchor.mSampleTime = inSliceSampleTime;
+        mLFOAnchor.mPhase = phase - floor(phase);
+    } else {
+        return;
+    }
+    mLFOAnchor.mFrequency = frequency;
+    mLFOIncrement = frequency / GetSampleRate();
+    UpdateLFOPeriod();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::UpdateLFOPeriod
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Looks for the smallest number of cycles that spans a whole number of frames. The test is
+// exact: both products are integers well inside a double's mantissa.
+void TremeloUnit::UpdateLFOPeriod() {
+    const Float64 sampleRate = GetSampleRate();
+    const Float64 frequency = mLFOAnchor.mFrequency;
+    
+    mLFOPeriod = 0;
+    if (frequency <= 0)
+        return;
+    for (UInt32 cycles = 1; cycles <= kMaxLFOPeriodCycles; cycles++) {
+        Float64 frames = floor(cycles * sampleRate / frequency + 0.5);
+        if (frames > sampleRate * kMaxLFOPeriodSeconds)
+            return;
+        if (frames * frequency == cycles * sampleRate) {
+            mLFOPeriod = UInt32(frames);
+            return;
+        }
+    }
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::LFOFramesFromAnchor
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Frames from the anchor to inSampleTime, reduced modulo the whole-number period if there is
+// one. The LFO phase at inSampleTime is mLFOAnchor.mPhase + result * mLFOIncrement.
+Float64 TremeloUnit::LFOFramesFromAnchor(Float64 inSampleTime) const {
+    Float64 frames = inSampleTime - mLFOAnchor.mSampleTime;
+    if (mLFOPeriod) {
+        frames = fmod(frames, mLFOPeriod);
+        if (frames < 0) frames += mLFOPeriod;
+    }
+    return frames;
+}
+
+#pragma mark ____Hibernation
+
+// Process-wide totals behind TremeloHibernationStats.
+static std::atomic<UInt32> sUnitsHibernating(0);
+static std::atomic<UInt64> sBytesReleased(0);
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::SetHibernateAfter
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The first unit to enable hibernation installs the listener that frees what the render thread
+// sets aside; a unit that never hibernates doesn't pay for the listener list. The arena's reserve
+// is topped up here (or by ReallocateBuffers) so that the render thread finds blocks to borrow
+// once the I/O buffers have retired.
+void TremeloUnit::SetHibernateAfter(UInt32 inFrames) {
+    if (inFrames != 0) {
+        if (!mHibernationListener) {
+            AddPropertyListener(kTremeloUnitProperty_Hibernation, HibernationListener, this);
+            mHibernationListener = true;
+        }
+        if (IsInitialized())
+            ReserveArenaBuffers();
+    }
+    mHibernateAfter.store(inFrames, std::memory_order_relaxed);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::BeginRenderHibernation, TremeloUnit::EndRenderHibernation
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The render thread's side; neither allocates, frees or locks. A render call that ends after
+// mHibernateAfter idle frames asks AUBase to retire the I/O buffers at the start of the next
+// one, when the caller is done with this one's output, and the unit hibernates from then on.
+// Hibernating also moves the gain cache out to mSpareGains, including one the setup queue
+// delivers later. Either change is posted to the listeners, whose thread frees the memory.
+void TremeloUnit::BeginRenderHibernation() {
+    bool changed = false;
+    if (mHibernationPending) {
+        // DoRender has retired the I/O buffers before calling Render.
+        mHibernationPending = false;
+        mHibernating.store(true, std::memory_order_relaxed);
+        mHibernations.fetch_add(1, std::memory_order_relaxed);
+        sUnitsHibernating.fetch_add(1, std::memory_order_relaxed);
+        changed = true;
+    }
+    if (mHibernating.load(std::memory_order_relaxed)) {
+        if (mGainCache.BytesAllocated() != 0 && mGainsState.load(std::memory_order_relaxed) == kGains_InUse) {
+            mGainCache.Adopt(mSpareGains);
+            mGainsState.store(kGains_Retired, std::memory_order_release);
+            changed = true;
+        }
+    } else if (mGainsState.load(std::memory_order_acquire) == kGains_Ready) {
+        mGainCache.Adopt(mSpareGains);
+        mGainsState.store(kGains_InUse, std::memory_order_relaxed);
+    }
+    if (changed)
+        PropertyChanged(kTremeloUnitProperty_Hibernation, kAudioUnitScope_Global, 0);
+}
+
+// Waking up takes back a gain cache that hasn't been freed yet; otherwise the listeners' thread
+// allocates a new one.
+void TremeloUnit::EndRenderHibernation(AudioUnitRenderActionFlags inActionFlags, UInt32 inFrames) {
+    const UInt32 hibernateAfter = mHibernateAfter.load(std::memory_order_relaxed);
+    if (hibernateAfter != 0 && ((inActionFlags & kAudioUnitRenderAction_OutputIsSilence) || ShouldBypassEffect())) {
+        if (!mHibernating.load(std::memory_order_relaxed) && !mHibernationPending) {
+            mIdleFrames = UInt32(std::min<UInt64>(UInt64(mIdleFrames) + inFrames, hibernateAfter));
+            if (mIdleFrames == hibernateAfter) {
+                RequestIOBufferRetirement();
+                mHibernationPending = true;
+            }
+        }
+        return;
+    }
+    mIdleFrames = 0;
+    if (mHibernating.load(std::memory_order_relaxed)) {
+        mHibernating.store(false, std::memory_order_relaxed);
+        sUnitsHibernating.fetch_sub(1, std::memory_order_relaxed);
+        UInt32 retired = kGains_Retired;
+        if (mGainsState.compare_exchange_strong(retired, kGains_InUse, std::memory_order_acquire))
+            mGainCache.Adopt(mSpareGains);
+        PropertyChanged(kTremeloUnitProperty_Hibernation, kAudioUnitScope_Global, 0);
+    }
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::HibernationListener, TremeloUnit::SettleHibernation
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The listeners' side: frees what the render thread retired, and allocates the gain cache again
+// for a unit that woke up. Changes to the property coalesce in AUBase's queue, so this brings
+// the memory in line with the unit's current state rather than replaying each change.
+void TremeloUnit::HibernationListener(void *inRefCon, AudioUnit, AudioUnitPropertyID, AudioUnitScope,
+                                      AudioUnitElement) {
+    static_cast<TremeloUnit *>(inRefCon)->SettleHibernation();
+}
+
+void TremeloUnit::SettleHibernation() {
+    std::lock_guard<std::mutex> lock(mHibernationMutex);
+    SInt64 released = FreeRetiredIOBuffers();
+    UInt32 state = mGainsState.load(std::memory_order_acquire);
+    if ((state == kGains_Retired || (state == kGains_Ready && mHibernating.load(std::memory_order_relaxed))) &&
+        mGainsState.compare_exchange_strong(state, kGains_Worker, std::memory_order_acquire)) {
+        mReleasedGainFrames = mSpareGains.size();
+        released += mSpareGains.capacity() * sizeof(Float32);
+        std::vector<Float32>().swap(mSpareGains);
+        mGainsState.store(state = kGains_Released, std::memory_order_release);
+    }
+    if (state == kGains_Released && !mHibernating.load(std::memory_order_relaxed) &&
+        mGainsState.compare_exchange_strong(state, kGains_Worker, std::memory_order_acquire)) {
+        mSpareGains.assign(mReleasedGainFrames, 0.f);
+        released -= mSpareGains.capacity() * sizeof(Float32);
+        mGainsState.store(kGains_Ready, std::memory_order_release);
+    }
+    mBytesReleased += released;
+    sBytesReleased.fetch_add(UInt64(released), std::memory_order_relaxed);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::ResetHibernation, TremeloUnit::GetHibernationStats
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Not while rendering. Initialize allocates everything hibernating released again, and Cleanup
+// frees the rest, so the unit wakes up and its bytes no longer count as released.
+void TremeloUnit::ResetHibernation() {
+    std::lock_guard<std::mutex> lock(mHibernationMutex);
+    if (mHibernating.exchange(false, std::memory_order_relaxed))
+        sUnitsHibernating.fetch_sub(1, std::memory_order_relaxed);
+    mHibernationPending = false;
+    mIdleFrames = 0;
+    mHibernations.store(0, std::memory_order_relaxed);
+    mGainsState.store(kGains_InUse, std::memory_order_relaxed);
+    std::vector<Float32>().swap(mSpareGains);
+    sBytesReleased.fetch_sub(mBytesReleased, std::memory_order_relaxed);
+    mBytesReleased = 0;
+}
+
+void TremeloUnit::GetHibernationStats(TremeloHibernationStats &outStats) {
+    std::lock_guard<std::mutex> lock(mHibernationMutex);
+    outStats.mHibernating = mHibernating.load(std::memory_order_relaxed);
+    outStats.mHibernations = mHibernations.load(std::memory_order_relaxed);
+    outStats.mBytesReleased = mBytesReleased;
+    outStats.mUnitsHibernating = sUnitsHibernating.load(std::memory_order_relaxed);
+    outStats.mProcessBytesReleased = sBytesReleased.load(std::memory_order_relaxed);
+}
+
 #pragma mark ____Factory Presets
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -207,39 +1076,121 @@ ComponentResult TremeloUnit::GetPresets(CFArrayRef *outData) const {
 //    TremoloUnit::NewFactoryPresetSet
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // The NewFactoryPresetSet method defines all the factory presets for an audio unit. Basically,
-// for each preset, it invokes a series of SetParameter calls.
+// for each preset, it fills in a whole parameter set. While the unit is initialized the set is
+// published for Render to take between render cycles, so a recall never lands half way through
+// a buffer; otherwise it is applied directly. A number that isn't one of kPresets changes nothing.
 
 OSStatus TremeloUnit::NewFactoryPresetSet(const AUPreset &inNewFactoryPreset) {
     
     SInt32 chosenPreset = inNewFactoryPreset.presetNumber;
     
-    if (chosenPreset == kPreset_Slow || kPreset_Fast) {
-        
-        for (int i = 0; i < kNumberOfPresets; i++) {
-            if (chosenPreset == kPresets[i].presetNumber) {
-                // The settings for Factory preset "Slow & Gentle".
-                switch (chosenPreset) {
-                    case kPreset_Slow:
-                        SetParameter(kParameter_Frequency, kParameter_Preset_Frequency_Slow);
-                        SetParameter(kParameter_Depth, kParameter_Preset_Depth_Slow);
-                        SetParameter(kParameter_Waveform, kParameter_Preset_Waveform_Slow);
-                        break;
-                // The settings for factory preset "Fast & Hard".
-                    case kPreset_Fast:
-                        SetParameter(kParameter_Frequency, kParameter_Preset_Frequency_Fast);
-                        SetParameter(kParameter_Depth, kParameter_Preset_Depth_Fast);
-                        SetParameter(kParameter_Waveform, kParameter_Preset_Waveform_Fast);
-                        break;
-                }
-                SetAFactoryPresetAsCurrent(kPresets[i]);
-                return noErr;
+    for (int i = 0; i < kNumberOfPresets; i++) {
+        if (chosenPreset == kPresets[i].presetNumber) {
+            TremeloParameterSet preset;
+            // The settings for Factory preset "Slow & Gentle".
+            switch (chosenPreset) {
+                case kPreset_Slow:
+                    preset.mValues[kParameter_Frequency] = kParameter_Preset_Frequency_Slow;
+                    preset.mValues[kParameter_Depth] = kParameter_Preset_Depth_Slow;
+                    preset.mValues[kParameter_Waveform] = kParameter_Preset_Waveform_Slow;
+                    break;
+            // The settings for factory preset "Fast & Hard".
+                case kPreset_Fast:
+                    preset.mValues[kParameter_Frequency] = kParameter_Preset_Frequency_Fast;
+                    preset.mValues[kParameter_Depth] = kParameter_Preset_Depth_Fast;
+                    preset.mValues[kParameter_Waveform] = kParameter_Preset_Waveform_Fast;
+                    break;
+            }
+            if (IsInitialized()) {
+                mParameterExchange.Publish(preset);
+            } else {
+                CommitPendingParameterSet();
+                ApplyParameterSet(preset);
             }
+            SetAFactoryPresetAsCurrent(kPresets[i]);
+            return noErr;
         }
     }
-    return kAudioUnitErr_InvalidProperty;
+    return kAudioUnitErr_InvalidPropertyValue;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//    TremoloUnit::SaveState, TremoloUnit::RestoreState
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// A state saved right after a preset recall must contain the preset; a restored state replaces
+// a recalled preset Render hasn't taken yet.
+OSStatus TremeloUnit::SaveState(CFPropertyListRef *outData) {
+    CommitPendingParameterSet();
+    return AUEffectBase::SaveState(outData);
+}
+
+OSStatus TremeloUnit::RestoreState(CFPropertyListRef inData) {
+    TremeloParameterSet discarded;
+    if (mParameterExchange.IsPending())
+        mParameterExchange.Withdraw(discarded);
+    return AUEffectBase::RestoreState(inData);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//    TremoloUnit::RestoreParameterValues
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// A binary state's global parameters arrive as one array, so while the unit is initialized they
+// are published like a recalled preset and Render switches to them between render cycles.
+void TremeloUnit::RestoreParameterValues(AudioUnitScope inScope,
+                                         AudioUnitElement inElement,
+                                         const AudioUnitParameterValue *inValues,
+                                         UInt32 inNumberOfValues) {
+    if (inScope == kAudioUnitScope_Global && inElement == 0 && inNumberOfValues == kNumberOfParameters &&
+        IsInitialized()) {
+        TremeloParameterSet state;
+        memcpy(state.mValues, inValues, sizeof(state.mValues));
+        mParameterExchange.Publish(state);
+        return;
+    }
+    if (inScope == kAudioUnitScope_Global) {
+        TremeloParameterSet discarded;
+        if (mParameterExchange.IsPending())
+            mParameterExchange.Withdraw(discarded);
+    }
+    AUEffectBase::RestoreParameterValues(inScope, inElement, inValues, inNumberOfValues);
+}
+
+#pragma mark ____Stream Formats
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// TremeloUnit::ValidFormat
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// AUEffectBase dispatches Float32, 8.24 fixed-point and 16-bit integer buffers, interleaved or
+// not, to the kernels; the kernels handle all of them, so all of them are valid.
+bool TremeloUnit::ValidFormat(AudioUnitScope inScope,
+                              AudioUnitElement inElement,
+                              const CAStreamBasicDescription &inNewFormat) {
+    CAStreamBasicDescription::CommonPCMFormat format;
+    if (!inNewFormat.IdentifyCommonPCMFormat(format))
+        return false;
+    return format == CAStreamBasicDescription::kPCMFormatFloat32 ||
+           format == CAStreamBasicDescription::kPCMFormatFixed824 ||
+           format == CAStreamBasicDescription::kPCMFormatInt16;
 }
 
 #pragma mark ____TremeloUnit DSP Kernel
+
+// Scales one sample by a tremolo gain. The integer formats go through floating point; 8.24
+// samples use double precision, which holds all of their 32 bits. The band-limited square
+// overshoots a gain of 1 by about 1%, so integer products are saturated before they are
+// narrowed; a full-scale sample would otherwise wrap to the opposite sign.
+static inline Float32   ApplyGain (Float32 inSample, Float32 inGain)  { return inSample * inGain; }
+static inline SInt32    ApplyGain (SInt32 inSample, Float32 inGain)
+{
+    Float64 product = Float64(inSample) * inGain;
+    return SInt32(std::min(std::max(product, Float64(INT32_MIN)), Float64(INT32_MAX)));
+}
+static inline SInt16    ApplyGain (SInt16 inSample, Float32 inGain)
+{
+    Float32 product = Float32(inSample) * inGain;
+    return SInt16(std::min(std::max(product, Float32(INT16_MIN)), Float32(INT16_MAX)));
+}
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //    TremoloUnit::TremoloUnitKernel::TremoloUnitKernel()
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -259,8 +1210,25 @@ OSStatus TremeloUnit::NewFactoryPresetSet(const AUPreset &inNewFactoryPreset) {
 //
 // (In the Xcode template, the header file contains the call to the superclass constructor.)
 TremeloUnit::TremeloUnitKernel::TremeloUnitKernel(AUEffectBase *inAudioUnit) : AUKernelBase(inAudioUnit),
-mSamplesProcessed(0), mCurrentScale(0) {
+mSine(SharedWaveTables().mSine), mSquare(SharedWaveTables().mSquare), mSamplesProcessed(0), mCurrentScale(0) {
     
+    // Gets the samples per second of the audio stream from the host provided to audio unit.
+    // Obtaining the value here in the constructor assumes the sample rate will not change
+    // during the instanitation of the audio unit.
+    mSampleFrequency = GetSampleRate();
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//    TremoloUnit::TremoloUnitKernel::SharedWaveTables()
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The wave tables are the same for every kernel, so the process builds them once, the first
+// time a kernel is constructed, instead of giving each kernel (one per channel) 16 KB of its own.
+const TremeloUnit::TremeloUnitKernel::WaveTables &TremeloUnit::TremeloUnitKernel::SharedWaveTables() {
+    static const WaveTables sWaveTables;
+    return sWaveTables;
+}
+
+TremeloUnit::TremeloUnitKernel::WaveTables::WaveTables() {
     // Generates a wave table that represents one cycle of a sine wave, normalized so that
     //  that it never goes negative and it ranges from 0 to 1; this sine wave represents
     // how to vary the volume during one cycle of tremelo.
@@ -285,10 +1253,6 @@ mSamplesProcessed(0), mCurrentScale(0) {
                       ) * 0.63;     // Scales the wave so the peak value is close
                                     //  to unity gain.
     }
-    // Gets the samples per second of the audio stream from the host provided to audio unit.
-    // Obtaining the value here in the constructor assumes the sample rate will not change
-    // during the instanitation of the audio unit.
-    mSampleFrequency = GetSampleRate();
 }
 
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -305,143 +1269,232 @@ void TremeloUnit::TremeloUnitKernel::Reset() {
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 //    TremoloUnit::TremoloUnitKernel::Process
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
-// This method contains the DSP code.
-void TremeloUnit::TremeloUnitKernel::Process(const Float32 *inSourceP,  // The audio sample input buffer.
-                                             Float32 *inDestP,          // The audio sample output buffer
-                                             UInt32 inSamplesToProcess, // The number of samples in the input buffer
-                                             UInt32 inNumChannels,      // The number of input channels. This is always equal to 1
-                                                                        //  there is always one kernel object instaniated
-                                                                        //  per channel of audio.
-                                             bool &ioSilence)           // A boolean flag indicating whether the input to the audio
-                                                                        //  unit consists of silence, with a TRUE value indicating
-                                                                        //  silence.
+// This method contains the DSP code. Everything that stays the same for the whole buffer is
+// decided here, once; the per-sample work happens in the ProcessLoop specialization it picks.
+template <typename T>
+void TremeloUnit::TremeloUnitKernel::ProcessT(const T *inSourceP,     // The audio sample input buffer.
+                                              T *inDestP,             // The audio sample output buffer
+                                              UInt32 inSamplesToProcess, // The number of samples in the input buffer
+                                              UInt32 inNumChannels,   // The number of interleaved channels; 1 for
+                                                                      //  deinterleaved buffers. There is always one
+                                                                      //  kernel object instaniated per channel of audio.
+                                              bool &ioSilence)        // A boolean flag indicating whether the input to the audio
+                                                                      //  unit consists of silence, with a TRUE value indicating
+                                                                      //  silence.
 {
     // Ignores the request to perform the Process method if the input to the audio unit is silence.
-    if (!ioSilence) {
-        
-        // Assigns a pointer variable to the start if the audio sample input buffer.
-        const Float32 *sourceP = inSourceP;
-        
-        Float32 *destP = inDestP;           // A pointer variable to the start of the audio sample output buffer.
-        Float32 inputSample;                // The current input sample to process.
-        Float32 outputSample;               // The current output sample resulting from one iteration of
-                                            //  the processing loop.
-        Float32 tremeloFrequency;           // The tremelo frquency requested by the user via the audio units view.
-        Float32 tremeloDepth;               // The tremelo depth requested by the user via the audio unit's view.
-        Float32 samplesPerTremeloCycle;     // The number of audio samples in one cycle of the tremelo waveform.
-        Float32 rawTremeloGain;             // The tremelo gain for the current audio sample, as stored in the wave table.
-        Float32 tremeloGain;                // The adjusted tremelo gain of the current audio sample, considering the
-                                            //  depth parameter value.
-        
-        int tremeloWaveform;                // The tremelo waveform type requested by the user via the audio unit's view.
-        
-        // Once per input buffer, get the tremelo frequency (in Hz) from the user via the audio unit's view.
-        tremeloFrequency    = GetParameter(kParameter_Frequency);
-        // Once per input buffer, get the tremelo depth (in percent %) from the user via the audio unit's view.
-        tremeloDepth        = GetParameter(kParameter_Depth);
-        // Once per input buffer, get the tremelo waveform type from the user via the audio unit's view.
-        tremeloWaveform     = (int) GetParameter(kParameter_Waveform);
-        
-        // Assigns a pointer to the wave table for the user selected tremelo wave form.
-        if (tremeloWaveform == kSineWave_Tremelo_Waveform) {
-            waveArrayPointer = &mSine[0];
+    if (ioSilence)
+        return;
+    
+    // With the sample-time LFO the unit renders one gain block per slice, shared by all
+    // channels (see TremeloUnit::RenderSliceGains); each kernel only applies it. The unit decides
+    // per slice, so all channels agree even if the property changes mid-render.
+    TremeloUnit *unit = static_cast<TremeloUnit *>(mAudioUnit);
+    if (const Float32 *gains = unit->mSliceGains) {
+        if (std::is_same<T, Float32>::value && inNumChannels == 1) {
+            unit->mKernelFunctions->mApplyGains((const Float32 *)inSourceP, (Float32 *)inDestP, gains,
+                                                inSamplesToProcess);
         } else {
-            waveArrayPointer = &mSquare[0];
+            for (UInt32 i = 0; i < inSamplesToProcess; i++)
+                inDestP[i * inNumChannels] = ApplyGain(inSourceP[i * inNumChannels], gains[i]);
         }
+        return;
+    }
+    
+    Float32 tremeloFrequency;           // The tremelo frquency requested by the user via the audio units view.
+    Float32 tremeloDepth;               // The tremelo depth requested by the user via the audio unit's view.
+    Float32 samplesPerTremeloCycle;     // The number of audio samples in one cycle of the tremelo waveform.
+    int tremeloWaveform;                // The tremelo waveform type requested by the user via the audio unit's view.
+    
+    // Once per input buffer, get the tremelo frequency (in Hz), depth (in percent %) and waveform
+    // type the user requested via the audio unit's view. The unit captured and bounds-checked them
+    // for this slice (see TremeloUnit::CaptureParameterValues).
+    const TremeloParameterValues &parameters = unit->mParameterValues;
+    tremeloFrequency    = parameters.mFrequency;
+    tremeloDepth        = parameters.mDepth;
+    tremeloWaveform     = parameters.mWaveform;
+    
+    // Assigns a pointer to the wave table for the user selected tremelo wave form. The loops
+    // only ever read through this pointer, so the waveform costs nothing per sample.
+    if (tremeloWaveform == kSineWave_Tremelo_Waveform) {
+        waveArrayPointer = &mSine[0];
+    } else {
+        waveArrayPointer = &mSquare[0];
+    }
+    
+    // Calculate the number of audio sample per cycle of tremelo frequency.
+    samplesPerTremeloCycle = mSampleFrequency / tremeloFrequency;
+    
+    // Calculate the scaling factor to use for applying the wave to the current sampling
+    //  frequency and tremelo frequency.
+    mNextScale = kWaveArraySize / samplesPerTremeloCycle;
+    /*
+        An explanation of the scaling factor (mNextScale)
+        -------------------------------------------------
+        Say that the audio sample frequency is 10 kHz and that the tremolo frequency is
+        10.0 Hz. the number of audio samples per tremolo cycle is then 1,000.
         
-        // Performs bounds checking on the parameters.
-        if (tremeloFrequency < kMinimumValue_Tremelo_Freq) {
-            tremeloFrequency = kMinimumValue_Tremelo_Freq;
-        }
-        if (tremeloFrequency > kMaximumValue_Tremelo_Freq) {
-            tremeloFrequency = kMaximumValue_Tremelo_Freq;
-        }
+        For a wave table of length 1,000, the scaling factor is then unity (1.0). This means
+        that the wave table happens to be the exact size needed for each point in the table
+        to correspond to exactly one sample.
+
+        If the tremolo frequency slows to 1.0 Hz, then the number of samples per tremolo
+        cycle rises to 10,000. The scaling factor is then 0.1. This means that every 10th
+        element of the wave table array corresponds to a sample.
         
-        if (tremeloDepth    < kMinimumValue_Tremelo_Depth) {
-            tremeloDepth    = kMinimumValue_Tremelo_Depth;
-        }
-        if (tremeloDepth    > kMaximumValue_Tremelo_Depth) {
-            tremeloDepth    = kMaximumValue_Tremelo_Depth;
-        }
+        If the tremolo frequency increases to 20 Hz, the samples per tremolo cycle lowers to
+        500. The scaling factor is then 1,000/500 = 2.0. In this case, two samples in a row
+        need to make use of the same point in the wave table.
+    */
+    
+    // Only a pending frequency change, or a counter about to pass sampleLimit, needs the loop
+    // to look for the next zero crossing; most buffers need neither.
+    typedef void (TremeloUnitKernel::*Loop)(const T *, T *, UInt32, UInt32, Float32);
+    static const Loop kLoops[2][2] = {
+        { &TremeloUnitKernel::ProcessLoop<T, false, false>, &TremeloUnitKernel::ProcessLoop<T, false, true> },
+        { &TremeloUnitKernel::ProcessLoop<T, true, false>,  &TremeloUnitKernel::ProcessLoop<T, true, true> }
+    };
+    const bool watchZeroCrossing = (mNextScale != mCurrentScale) ||
+                                   (mSamplesProcessed + long(inSamplesToProcess) > long(sampleLimit));
+    (this->*kLoops[inNumChannels > 1][watchZeroCrossing])(inSourceP, inDestP, inSamplesToProcess, inNumChannels,
+                                                          tremeloDepth);
+}
+
+template void TremeloUnit::TremeloUnitKernel::ProcessT<Float32>(const Float32 *, Float32 *, UInt32, UInt32, bool &);
+template void TremeloUnit::TremeloUnitKernel::ProcessT<SInt32>(const SInt32 *, SInt32 *, UInt32, UInt32, bool &);
+template void TremeloUnit::TremeloUnitKernel::ProcessT<SInt16>(const SInt16 *, SInt16 *, UInt32, UInt32, bool &);
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//    TremoloUnit::TremoloUnitKernel::ProcessLoop
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// The sample processing loop; processes the current batch of samples, one sample at a time.
+// Without kWatchZeroCrossing neither of the index == 0 checks below can fire within the
+// buffer, so that specialization drops them and the body has no branches.
+template <typename T, bool kInterleaved, bool kWatchZeroCrossing>
+void TremeloUnit::TremeloUnitKernel::ProcessLoop(const T *inSourceP,
+                                                 T *inDestP,
+                                                 UInt32 inFrames,
+                                                 UInt32 inStride,
+                                                 Float32 inDepth) {
+    const UInt32 stride = kInterleaved ? inStride : 1;
+    const float *wave = waveArrayPointer;
+    long samplesProcessed = mSamplesProcessed;
+    
+    for (UInt32 i = 0; i < inFrames; i++) {
         
-        // Calculate the number of audio sample per cycle of tremelo frequency.
-        samplesPerTremeloCycle = mSampleFrequency / tremeloFrequency;
+        // The following statement calculates the position in the wave table ("index") to
+        // use for the current sample. This position, along with the calculation of
+        // mNextScale, is the only subtle math for this audio unit.
+        //
+        // "index" is the position marker in the wave table. The wave table is an array;
+        //        index varies from 0 to kWaveArraySize.
+        //
+        //    "index" is also the number of samples processed since the last
+        //    counter reset, divided by the number of samples that play during one pass
+        //    through the wave table, modulo the size of the wave table (see "An explanation...",
+        //  in ProcessT).
         
-        // Calculate the scaling factor to use for applying the wave to the current sampling
-        //  frequency and tremelo frequency.
-        mNextScale = kWaveArraySize / samplesPerTremeloCycle;
-        /*
-            An explanation of the scaling factor (mNextScale)
-            -------------------------------------------------
-            Say that the audio sample frequency is 10 kHz and that the tremolo frequency is
-            10.0 Hz. the number of audio samples per tremolo cycle is then 1,000.
-            
-            For a wave table of length 1,000, the scaling factor is then unity (1.0). This means
-            that the wave table happens to be the exact size needed for each point in the table
-            to correspond to exactly one sample.
-
-            If the tremolo frequency slows to 1.0 Hz, then the number of samples per tremolo
-            cycle rises to 10,000. The scaling factor is then 0.1. This means that every 10th
-            element of the wave table array corresponds to a sample.
-            
-            If the tremolo frequency increases to 20 Hz, the samples per tremolo cycle lowers to
-            500. The scaling factor is then 1,000/500 = 2.0. In this case, two samples in a row
-            need to make use of the same point in the wave table.
-        */
+        int index = static_cast<long>(samplesProcessed * mCurrentScale) % kWaveArraySize;
         
-        // The sample processing loop; processes the current batch of samples, one sample at a time.
-        for (int i = 0; i < inSamplesToProcess; i++) {
-            
-            // The following statement calculates the position in the wave table ("index") to
-            // use for the current sample. This position, along with the calculation of
-            // mNextScale, is the only subtle math for this audio unit.
-            //
-            // "index" is the position marker in the wave table. The wave table is an array;
-            //        index varies from 0 to kWaveArraySize.
-            //
-            //    "index" is also the number of samples processed since the last
-            //    counter reset, divided by the number of samples that play during one pass
-            //    through the wave table, modulo the size of the wave table (see "An explanation...",
-            //  above).
-            
-            int index = static_cast<long>(mSamplesProcessed * mCurrentScale) % kWaveArraySize;
-            
+        if (kWatchZeroCrossing) {
             // If the user has moved the tremolo frequency slider, changes the scale factor
             // at the next positive zero crossing of the tremolo sine wave and resets the
-            // mSamplesProcessed value so it stays in sync with the index position.
+            // sample counter so it stays in sync with the index position.
             if ((mNextScale != mCurrentScale) && (index == 0)) {
                 mCurrentScale = mNextScale;
-                mSamplesProcessed = 0;
+                samplesProcessed = 0;
             }
             
             // If the audio unit runs for a long time without the user moving the
-            // tremolo frequency slider, resets the mSamplesProcessed value at the
+            // tremolo frequency slider, resets the sample counter at the
             // next positive zero crossing of the tremolo sine wave.
-            if ((mSamplesProcessed >= sampleLimit) && (index == 0)) {
-                mSamplesProcessed = 0;
+            if ((samplesProcessed >= sampleLimit) && (index == 0)) {
+                samplesProcessed = 0;
             }
+        }
+        
+        // Calculates the final tremelo gain from the wave table according to the depth setting.
+        Float32 tremeloGain = (wave[index] * inDepth - inDepth + 100.0) * 0.01;
+        
+        // Calculates and stores the output sample.
+        inDestP[i * stride] = ApplyGain(inSourceP[i * stride], tremeloGain);
+        
+        // Advance the global samples counter.
+        samplesProcessed += 1;
+    }
+    mSamplesProcessed = samplesProcessed;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//    TremoloUnit::TremoloUnitKernel::RenderLFOGains
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Computes the sample-time LFO's gains for one slice, from this kernel's wave tables or with
+// the polynomial oscillator. inFrameOffset is the first frame's distance from the anchor
+// (already reduced modulo the period when there is a whole-number period), so every gain is
+// a function of the sample's position on the timeline alone.
+//
+// With a control interval N, the waveform is only evaluated at positions that are multiples
+// of N (and at the period's end), and the gains in between are a linear ramp. The control
+// points are fixed on the timeline too, so chunked rendering and the gain cache still see
+// the same gains for the same position. A fractional sample time only shifts where in each
+// ramp the samples fall: a segment takes every sample before its end point, at least one.
+void TremeloUnit::TremeloUnitKernel::RenderLFOGains(Float32 *outGains,
+                                                    UInt32 inFrames,
+                                                    Float64 inFrameOffset,
+                                                    const TremeloGainCache::Key &inLFO) const {
+    const TremeloKernelFunctions *functions = static_cast<TremeloUnit *>(mAudioUnit)->mKernelFunctions;
+    const Float64 period = inLFO.mPeriod;
+    
+    if (inLFO.mControlInterval != kTremeloControlInterval_AudioRate) {
+        TremeloGainCache::Key pointLFO = inLFO;
+        pointLFO.mControlInterval = kTremeloControlInterval_AudioRate;
+        
+        const Float64 interval = inLFO.mControlInterval;
+        Float64 position = inFrameOffset;
+        Float64 start = floor(position / interval) * interval;
+        Float32 startGain, endGain;
+        RenderLFOGains(&startGain, 1, start, pointLFO);
+        
+        for (UInt32 i = 0; i < inFrames; ) {
+            Float64 end = start + interval;
+            const bool wraps = inLFO.mPeriod && end >= period;
+            if (wraps) end = period;
+            RenderLFOGains(&endGain, 1, wraps ? 0 : end, pointLFO);
             
-            // Gets the raw tremelo gain from the appropiate wave table.
-            rawTremeloGain = waveArrayPointer[index];
-            
-            // Calculates the finel tremelo gain according to the depth setting.
-            tremeloGain = (rawTremeloGain * tremeloDepth - tremeloDepth + 100.0) * 0.01;
-            
-            // Gets the next input sample.
-            inputSample = *sourceP;
-            
-            // Calculates the next output sample.
-            outputSample = (inputSample * tremeloGain);
-            
-            // Stores the output sample in the output buffer.
-            *destP = outputSample;
-            
-            // Advance to the next sample location in the input and output buffer.
-            sourceP += 1;
-            destP += 1;
+            const Float32 slope = (endGain - startGain) / Float32(end - start);
+            const UInt32 frames = std::min(inFrames - i, UInt32(ceil(end - position)));
+            functions->mRenderRamp(outGains + i, frames, startGain, slope, Float32(position - start));
             
-            // Advance the global samples counter.
-            mSamplesProcessed += 1;
+            i += frames;
+            position += frames;
+            if (position >= end) {
+                position -= end;
+                start = wraps ? 0 : end;
+                position += start;
+                startGain = endGain;
+            }
         }
+        return;
+    }
+    
+    if (inLFO.mOscillator == kTremeloOscillator_Polynomial) {
+        functions->mRenderPolynomialGains(outGains, inFrames, inFrameOffset, inLFO.mAnchorPhase, inLFO.mIncrement,
+                                          inLFO.mPeriod, inLFO.mDepth, inLFO.mWaveform != kSineWave_Tremelo_Waveform);
+        return;
+    }
+    
+    const float *wave = (inLFO.mWaveform == kSineWave_Tremelo_Waveform) ? mSine : mSquare;
+    const Float32 depth = inLFO.mDepth;
+    Float64 position = inFrameOffset;
+    
+    for (UInt32 i = 0; i < inFrames; i++) {
+        Float64 phase = inLFO.mAnchorPhase + position * inLFO.mIncrement;
+        int index = static_cast<int>((phase - floor(phase)) * kWaveArraySize);
+        if (index >= kWaveArraySize) index = kWaveArraySize - 1;
+        
+        outGains[i] = (wave[index] * depth - depth + 100.0) * 0.01;
+        
+        position += 1;
+        if (position == period) position = 0;
     }
 }
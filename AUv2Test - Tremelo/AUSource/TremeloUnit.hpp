@@ -7,6 +7,15 @@
 
 #include "AUEffectBase.h"
 #include "TremeloUnitVersion.h"
+#include "TremeloGainCache.h"
+#include "TremeloSharedLFO.h"
+#include "TremeloKernelDispatch.h"
+#include "TremeloParameterExchange.h"
+#include "TremeloSetupQueue.h"
+
+#include <atomic>
+#include <mutex>
+#include <new>
 
 #if AU_DEBUG_DISPATCHER
     #include "AUDebugDispatcher.h"
@@ -18,29 +27,6 @@
 /* constants for parameters and factory presets */
 #pragma mark ____TremeloUnit Parameter Constants
 
-/// Provides the user interface name for the frequency parameter.
-static CFStringRef kParamName_Tremelo_Freq          = CFSTR("Frequency");
-/// Defines a constant default value for the Frequency parameter, anticipating a unit of hertz to be defined in the .cpp implementation file.
-static constexpr float kDefaultValue_Tremelo_Freq   = 2.0;
-/// Defines a constant for the minimum value for the Frequency parameter.
-static constexpr float kMinimumValue_Tremelo_Freq   = 0.5;
-/// Defines a constant for the maximum value for the Frequency parameter.
-static constexpr float kMaximumValue_Tremelo_Freq   = 20.0;
-
-static CFStringRef kParamName_Tremelo_Depth         = CFSTR("Depth");
-static constexpr float kDefaultValue_Tremelo_Depth  = 50.0;
-static constexpr float kMinimumValue_Tremelo_Depth  = 0.0;
-static constexpr float kMaximumValue_Tremelo_Depth  = 100.0;
-
-static CFStringRef kParamName_Tremelo_Waveform      = CFSTR("Waveform");
-static constexpr int kSineWave_Tremelo_Waveform     = 1;
-static constexpr int kSquareWave_Tremelo_Waveform   = 2;
-static constexpr int kDefaultValue_Tremelo_Waveform = kSineWave_Tremelo_Waveform;
-
-// Defines menu item names for the Waveform parameter.
-static CFStringRef kMenuItem_Tremelo_Sine           = CFSTR("Sine");
-static CFStringRef kMenuItem_Tremelo_Square         = CFSTR("Square");
-
 enum Parameters {
     kParameter_Frequency    = 0,
     kParameter_Depth        = 1,
@@ -48,6 +34,80 @@ enum Parameters {
     kNumberOfParameters     = 3
 };
 
+static constexpr int kSineWave_Tremelo_Waveform     = 1;
+static constexpr int kSquareWave_Tremelo_Waveform   = 2;
+
+/// Menu item names for the Waveform parameter, in value order from kSineWave_Tremelo_Waveform.
+static constexpr const char *kMenuItems_Tremelo_Waveform[] = { "Sine", "Square" };
+
+/// Everything the unit knows about one parameter. GetParameterInfo, GetParameterValueStrings,
+/// SetParameter's clamping and the kernels' TremeloParameterValues are all generated from
+/// kTremeloParameters below, so a parameter is added or changed in that one place.
+struct TremeloParameterSpec {
+    AudioUnitParameterID    mID;
+    const char *            mName;
+    AudioUnitParameterUnit  mUnit;
+    Float32                 mMinValue;
+    Float32                 mMaxValue;
+    Float32                 mDefaultValue;
+    UInt32                  mFlags;                 // in addition to IsReadable | IsWritable
+    const char * const *    mValueStrings;          // menu items of an indexed parameter, or NULL
+    UInt32                  mNumberOfValueStrings;
+    
+    /// The value the DSP uses for inValue: within range, and whole for indexed parameters.
+    constexpr Float32 Clamp (Float32 inValue) const {
+        Float32 value = inValue < mMinValue ? mMinValue : (inValue > mMaxValue ? mMaxValue : inValue);
+        return mUnit == kAudioUnitParameterUnit_Indexed ? Float32(SInt32(value + 0.5f)) : value;
+    }
+};
+
+static constexpr TremeloParameterSpec kTremeloParameters[kNumberOfParameters] = {
+    // The frequency is shown with a logarithmic control.
+    { kParameter_Frequency, "Frequency", kAudioUnitParameterUnit_Hertz, 0.5f, 20.f, 2.f,
+      kAudioUnitParameterFlag_DisplayLogarithmic, NULL, 0 },
+    { kParameter_Depth, "Depth", kAudioUnitParameterUnit_Percent, 0.f, 100.f, 50.f,
+      0, NULL, 0 },
+    // "Indexed" lets the generic view display the waveform as a pop-up menu.
+    { kParameter_Waveform, "Waveform", kAudioUnitParameterUnit_Indexed,
+      kSineWave_Tremelo_Waveform, kSquareWave_Tremelo_Waveform, kSineWave_Tremelo_Waveform,
+      0, kMenuItems_Tremelo_Waveform, sizeof(kMenuItems_Tremelo_Waveform) / sizeof(kMenuItems_Tremelo_Waveform[0]) }
+};
+
+static_assert(kTremeloParameters[kParameter_Frequency].mID == kParameter_Frequency &&
+              kTremeloParameters[kParameter_Depth].mID == kParameter_Depth &&
+              kTremeloParameters[kParameter_Waveform].mID == kParameter_Waveform,
+              "kTremeloParameters must be indexed by parameter ID");
+/// The most menu items any indexed parameter has.
+enum { kMaxParameterValueStrings = 8 };
+
+static_assert(kTremeloParameters[kParameter_Waveform].mNumberOfValueStrings <= kMaxParameterValueStrings,
+              "raise kMaxParameterValueStrings");
+static_assert(kTremeloParameters[kParameter_Waveform].mMaxValue - kTremeloParameters[kParameter_Waveform].mMinValue + 1 ==
+              kTremeloParameters[kParameter_Waveform].mNumberOfValueStrings,
+              "every waveform needs a menu item");
+
+/// The range constants the rest of the unit uses, taken from the schema.
+static constexpr float kDefaultValue_Tremelo_Freq   = kTremeloParameters[kParameter_Frequency].mDefaultValue;
+static constexpr float kMinimumValue_Tremelo_Freq   = kTremeloParameters[kParameter_Frequency].mMinValue;
+static constexpr float kMaximumValue_Tremelo_Freq   = kTremeloParameters[kParameter_Frequency].mMaxValue;
+static constexpr float kDefaultValue_Tremelo_Depth  = kTremeloParameters[kParameter_Depth].mDefaultValue;
+static constexpr float kMinimumValue_Tremelo_Depth  = kTremeloParameters[kParameter_Depth].mMinValue;
+static constexpr float kMaximumValue_Tremelo_Depth  = kTremeloParameters[kParameter_Depth].mMaxValue;
+static constexpr int kDefaultValue_Tremelo_Waveform = kSineWave_Tremelo_Waveform;
+
+/// The parameters as the kernels read them: clamped, and captured once per slice.
+struct TremeloParameterValues {
+    Float32 mFrequency;
+    Float32 mDepth;
+    SInt32  mWaveform;
+};
+
+/// A whole set of parameter values, indexed by parameter ID, as a preset recall publishes it to
+/// the render thread; see TremeloParameterExchange.h.
+struct TremeloParameterSet {
+    AudioUnitParameterValue mValues[kNumberOfParameters];
+};
+
 #pragma mark ____TremeloUnit Factory Preset Constants
 
 /// Define a constant for the frequency value for the "Slow and Gentle" factory preset.
@@ -87,6 +147,168 @@ static AUPreset kPresets [kNumberOfPresets] = {
 // Defines a constant representing the default factory present - "Slow & Gentle"
 static constexpr int kPreset_Default = kPreset_Slow;
 
+#pragma mark ____TremeloUnit Custom Properties
+
+enum {
+    /// UInt32, global scope. When non-zero the LFO phase is derived from the render time stamp's
+    /// mSampleTime instead of the kernels' running sample counters, so any stretch of the timeline
+    /// renders the same no matter how it was split across render calls or instances.
+    kTremeloUnitProperty_SampleTimeLFO  = 64000,
+    /// TremeloLFOAnchor, global scope. The phase reference of the sample-time LFO.
+    kTremeloUnitProperty_LFOAnchor      = 64001,
+    /// TremeloGainCacheStats, global scope, read-only. See TremeloGainCache.h.
+    kTremeloUnitProperty_GainCacheStats = 64002,
+    /// UInt32, global scope. When non-zero (and the sample-time LFO is on), gain blocks are shared
+    /// with other instances in the process that have the same settings and render the same
+    /// slices. See TremeloSharedLFO.h.
+    kTremeloUnitProperty_SharedLFO      = 64003,
+    /// UInt32, global scope. How the sample-time LFO evaluates the waveform; see below.
+    kTremeloUnitProperty_Oscillator     = 64004,
+    /// UInt32, global scope. The sample-time LFO's control interval; see below.
+    kTremeloUnitProperty_ControlInterval = 64005,
+    /// SInt32, global scope. Setting it picks the instruction set variant of the sample-time LFO's
+    /// loops that the next Initialize binds (a kTremeloKernelVariant_ value; Auto by default);
+    /// getting it returns the variant that is bound. See TremeloKernelDispatch.h.
+    kTremeloUnitProperty_KernelVariant  = 64006,
+    /// UInt32, global scope. Frames over which the sample-time LFO's gain curve crossfades from the
+    /// old settings to a factory preset's when one is recalled during rendering; 0 (the default)
+    /// switches at the render cycle boundary. The legacy LFO always switches at the boundary.
+    kTremeloUnitProperty_PresetCrossfade = 64007,
+    /// Raw bytes, global scope. The unit's state in AUBase's binary format (see
+    /// AUBinaryStateHeader): a faster alternative to kAudioUnitProperty_ClassInfo for hosts that
+    /// snapshot many instances. Setting it restores the state; on an initialized unit the
+    /// parameters switch between render cycles, like a recalled preset.
+    kTremeloUnitProperty_BinaryState    = 64008,
+    /// UInt32, global scope. How property listeners are called: a kAUPropertyNotification_ value
+    /// (see AUBase.h). Listeners never run on the render thread.
+    kTremeloUnitProperty_PropertyNotification = 64009,
+    /// UInt32, global scope, write-only. Setting it calls the listeners for up to that many queued
+    /// property changes (0 for all); the host's pump in kAUPropertyNotification_HostPumped mode.
+    kTremeloUnitProperty_DeliverPropertyChanges = 64010,
+    /// AUMemoryUsage (see AUScopeElement.h), global scope, read-only. The bytes this instance has
+    /// allocated, by what they are for. What instances share (the wave tables, the shared LFO's
+    /// slots, the buffer arena's reserve) is not counted.
+    kTremeloUnitProperty_MemoryUsage    = 64011,
+    /// UInt32, global scope. When non-zero, the next Initialize returns before the sample-time LFO's
+    /// gain cache (two seconds of gains) is allocated, and a background thread shared by all
+    /// instances allocates it (see TremeloSetupQueue.h). Until the render thread takes it over, at
+    /// the start of a render cycle, the unit renders the same output without the cache.
+    kTremeloUnitProperty_AsyncInitialize = 64012,
+    /// UInt32, global scope, read-only. Non-zero once the unit is initialized and nothing Initialize
+    /// deferred is outstanding. Listeners are called when it turns on.
+    kTremeloUnitProperty_Ready          = 64013,
+    /// TremeloUnitConfiguration, global scope. Everything a host sets up on an instance before it
+    /// renders, in one piece, so one configured unit can stamp out others without repeating each
+    /// set-up call. Only settable while uninitialized; see TremeloUnit_Clone.
+    kTremeloUnitProperty_Configuration  = 64014,
+    /// UInt32, global scope. Frames of silent (kAudioUnitRenderAction_OutputIsSilence) or bypassed
+    /// output after which an initialized unit hibernates; 0 (the default) never. See below.
+    kTremeloUnitProperty_HibernateAfter = 64015,
+    /// TremeloHibernationStats, global scope, read-only. Listeners are called when the unit
+    /// hibernates or wakes up.
+    kTremeloUnitProperty_Hibernation    = 64016
+};
+
+/// Values of kTremeloUnitProperty_Oscillator.
+enum {
+    /// Looks the waveform up in the kernel's 2000-point wave tables (the default).
+    kTremeloOscillator_WaveTable    = 0,
+    /// Evaluates the waveform with SIMD polynomials; see TremeloOscillator.h for the accuracy.
+    kTremeloOscillator_Polynomial   = 1
+};
+
+/// Values of kTremeloUnitProperty_ControlInterval. At 0 (the default) the sample-time LFO evaluates
+/// its waveform for every frame. At N it evaluates it every N frames from the anchor (and at the
+/// end of a whole-number period) and ramps linearly in between, for about 1/N of the oscillator
+/// cost when the gain cache can't serve the slice.
+///
+/// Linear interpolation undershoots the curve between control points by up to about
+/// A (2 pi f N / sr)^2 / 8 for a sine of gain amplitude A = depth / 200: at 20 Hz and 44.1 kHz with
+/// depth 100, 1.3e-4 (-78 dB) at N = 16, 5.2e-4 (-66 dB) at 32 and 2.1e-3 (-54 dB) at 64. The error
+/// repeats every control interval, so it reaches the audio as sidebands at multiples of sr / N
+/// (689 Hz and up for N = 64 at 44.1 kHz) around the signal, at roughly (f N / sr)^2 of the
+/// modulation depth. The square waveform's steep edges are rounded off over one interval instead:
+/// at 20 Hz and depth 100 the gain is off by up to 2.3e-3 at N = 16, 9.2e-3 at 32 and 3.6e-2 at 64,
+/// so prefer 16 for the square at fast rates. (With the wave tables, whose own steps are 1.6e-3,
+/// only N = 64 adds noticeably to the sine's error.)
+enum {
+    kTremeloControlInterval_AudioRate   = 0,
+    kTremeloControlInterval_16          = 16,
+    kTremeloControlInterval_32          = 32,
+    kTremeloControlInterval_64          = 64
+};
+
+/// The sample-time LFO's phase, in cycles, is mPhase + (t - mSampleTime) * mFrequency / sampleRate.
+/// The anchor moves to the start of the slice in which the frequency changes, keeping the phase
+/// continuous. After Initialize or Reset it is unset (mFrequency == 0), and the first slice anchors
+/// at sample time 0 with phase 0. A host that splits automated audio into chunks can carry the
+/// anchor over by reading it at the end of one chunk (or computing it) and setting it on the next.
+struct TremeloLFOAnchor {
+    Float64 mSampleTime;
+    Float64 mPhase;
+    Float64 mFrequency;
+};
+
+/// When the LFO period is a whole number of frames P (at most kMaxLFOPeriodSeconds long, over
+/// at most kMaxLFOPeriodCycles cycles), the sample-time LFO measures time from the anchor modulo
+/// P. Mathematically this is the same phase; numerically it keeps the gain sequence exactly
+/// periodic, which is what lets the gain cache replay it.
+static constexpr Float64 kMaxLFOPeriodSeconds  = 2.0;
+static constexpr UInt32  kMaxLFOPeriodCycles   = 16;
+
+/// Counters behind kTremeloUnitProperty_GainCacheStats; the hit rate is
+/// mFramesFromCache / mFramesProcessed. Frames count once per slice, not per channel.
+struct TremeloGainCacheStats {
+    UInt64  mFramesProcessed;       // frames rendered with the sample-time LFO
+    UInt64  mFramesFromCache;       // of those, frames rendered from the cached period
+    UInt64  mFramesFromSharedLFO;   // of those, frames whose gains another instance computed
+    UInt32  mPeriodFrames;          // current whole-number period, 0 if none
+    UInt32  mBytesAllocated;        // size of the cache buffer
+};
+
+/// A hibernating unit gives back the memory it only needs for audible output: its I/O buffers,
+/// which it borrows from AUBufferArena for each render call from then on, and the sample-time
+/// LFO's gain cache. The render thread sets them aside; the property listeners' thread frees them,
+/// so with kAUPropertyNotification_HostPumped that waits for the host's pump. The kernels stay,
+/// being a few hundred bytes, and so do the gain buffers a slice needs.
+///
+/// The first render call whose output isn't silent wakes the unit up. It renders from borrowed
+/// buffers, as it did while hibernating, so waking up allocates nothing on the render thread; the
+/// gain cache is allocated again on the listeners' thread and taken over at the start of a later
+/// render call, and until then the unit renders the same output without it. The I/O memory is
+/// only allocated again by the next Initialize.
+struct TremeloHibernationStats {
+    UInt32  mHibernating;           // this unit is hibernating
+    UInt32  mHibernations;          // times it hibernated since it was initialized
+    UInt64  mBytesReleased;         // bytes it has freed and not allocated again
+    UInt32  mUnitsHibernating;      // in the process
+    UInt64  mProcessBytesReleased;  // mBytesReleased of all units in the process
+};
+
+/// kTremeloUnitProperty_Configuration. Getting it retains mPreset.presetName, as getting
+/// kAudioUnitProperty_PresentPreset does; the caller releases it. Setting it checks every field
+/// before changing anything, and ignores mInitialized. A non-negative mPreset.presetNumber must be
+/// a factory preset's, whose name is used; changing mPropertyNotification fails while rendering.
+struct TremeloUnitConfiguration {
+    AudioStreamBasicDescription mInputFormat;
+    AudioStreamBasicDescription mOutputFormat;
+    UInt32                  mMaxFramesPerSlice;
+    TremeloParameterSet     mParameters;        // including a recalled preset Render hasn't taken yet
+    AUPreset                mPreset;            // kAudioUnitProperty_PresentPreset
+    UInt32                  mBypass;            // kAudioUnitProperty_BypassEffect
+    UInt32                  mInPlaceProcessing; // kAudioUnitProperty_InPlaceProcessing
+    UInt32                  mSampleTimeLFO;
+    UInt32                  mSharedLFO;
+    UInt32                  mOscillator;
+    UInt32                  mControlInterval;
+    SInt32                  mKernelVariant;     // as set, not as bound
+    UInt32                  mPresetCrossfade;
+    UInt32                  mAsyncInitialize;
+    UInt32                  mPropertyNotification;
+    UInt32                  mHibernateAfter;
+    UInt32                  mInitialized;       // the unit was initialized when this was taken
+};
+
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
 // TremeloUnit class
 //~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
@@ -97,12 +319,15 @@ class TremeloUnit : public AUEffectBase {
 public:
     TremeloUnit (AudioUnit component);
     
-#if AU_DEBUG_DISPATCHER
-    virtual ~TremeloUnit () { delete mDebugDispatcher; }
-#endif
+    // Waits for a deferred setup job still running for this unit.
+    virtual ~TremeloUnit ();
     
     virtual AUKernelBase *NewKernel () { return new TremeloUnitKernel(this); }
     
+    // The kernels are constructed in AUEffectBase's kernel block rather than by NewKernel.
+    virtual size_t KernelStorageSize () const { return sizeof(TremeloUnitKernel); }
+    virtual AUKernelBase *ConstructKernel (void *inStorage) { return new (inStorage) TremeloUnitKernel(this); }
+    
     virtual ComponentResult GetParameterValueStrings(AudioUnitScope inScope,
                                                      AudioUnitParameterID inParameterID,
                                                      CFArrayRef *outStrings);
@@ -111,6 +336,35 @@ public:
                                              AudioUnitParameterID inParameterID,
                                              AudioUnitParameterInfo &outParameterInfo);
     
+    // Clamps global parameter values to kTremeloParameters' ranges.
+    using AUEffectBase::SetParameter;
+    virtual OSStatus SetParameter(AudioUnitParameterID inID,
+                                  AudioUnitScope inScope,
+                                  AudioUnitElement inElement,
+                                  AudioUnitParameterValue inValue,
+                                  UInt32 inBufferOffsetInFrames);
+    
+    // Takes a recalled preset on the render thread before the events are applied.
+    virtual OSStatus ScheduleParameter(const AudioUnitParameterEvent *inParameterEvent,
+                                       UInt32 inNumEvents);
+    
+    // GetParameter and SaveState first apply a preset still waiting for the render thread, so
+    // they report it; RestoreState discards it.
+    using AUEffectBase::GetParameter;
+    virtual OSStatus GetParameter(AudioUnitParameterID inID,
+                                  AudioUnitScope inScope,
+                                  AudioUnitElement inElement,
+                                  AudioUnitParameterValue &outValue);
+    
+    virtual OSStatus SaveState(CFPropertyListRef *outData);
+    
+    virtual OSStatus RestoreState(CFPropertyListRef inData);
+    
+    virtual void RestoreParameterValues(AudioUnitScope inScope,
+                                        AudioUnitElement inElement,
+                                        const AudioUnitParameterValue *inValues,
+                                        UInt32 inNumberOfValues);
+    
     virtual ComponentResult GetPropertyInfo(AudioUnitPropertyID inID,
                                             AudioUnitScope inScope,
                                             AudioUnitElement inElement,
@@ -122,6 +376,43 @@ public:
                                         AudioUnitElement inElement,
                                         void *outData);
     
+    virtual ComponentResult SetProperty(AudioUnitPropertyID inID,
+                                        AudioUnitScope inScope,
+                                        AudioUnitElement inElement,
+                                        const void *inData,
+                                        UInt32 inDataSize);
+    
+    virtual OSStatus Initialize ();
+    
+    virtual void Cleanup ();
+    
+    // Also tops up the buffer arena's reserve for a unit that may hibernate.
+    virtual void ReallocateBuffers ();
+    
+    virtual OSStatus Reset (AudioUnitScope inScope, AudioUnitElement inElement);
+    
+    // Render, ProcessScheduledSlice and ProcessBufferLists are overridden only to track the
+    // sample time of each slice for the sample-time LFO.
+    virtual OSStatus Render (AudioUnitRenderActionFlags &ioActionFlags,
+                             const AudioTimeStamp &inTimeStamp,
+                             UInt32 inFramesToProcess);
+    
+    virtual OSStatus ProcessScheduledSlice (void *inUserData,
+                                            UInt32 inStartFrameInBuffer,
+                                            UInt32 inSliceFramesToProcess,
+                                            UInt32 inTotalBufferFrames);
+    
+    virtual OSStatus ProcessBufferLists (AudioUnitRenderActionFlags &ioActionFlags,
+                                         const AudioBufferList &inBuffer,
+                                         AudioBufferList &outBuffer,
+                                         UInt32 inFramesToProcess);
+    
+    // Besides AUBase's deinterleaved Float32, accepts interleaved streams and the 8.24
+    // fixed-point and 16-bit integer formats, all of which the kernel has loops for.
+    virtual bool ValidFormat (AudioUnitScope inScope,
+                              AudioUnitElement inElement,
+                              const CAStreamBasicDescription &inNewFormat);
+    
     // Report that the AudioUnit supports the kAudioUnitProperty_TailTime property.
     virtual bool SupportsTail() { return true; }
     
@@ -137,6 +428,9 @@ public:
      AUBase superclass. */
     virtual OSStatus NewFactoryPresetSet(const AUPreset &inNewFactoryPreset);
     
+    // Adds the gain buffers and the gain cache to AUEffectBase's accounting.
+    virtual void GetMemoryUsage (AUMemoryUsage &outUsage) const;
+    
     
 protected:
     class TremeloUnitKernel : public AUKernelBase {
@@ -144,21 +438,61 @@ protected:
         TremeloUnitKernel (AUEffectBase *inAudioUnit);
         
         /* *Required* overrides for the process method from the AUBase superclass
-         for this effect. Processes one channel of interleaved samples. */
+         for this effect. Processes one channel, inNumChannels samples apart. */
         virtual void Process(const Float32 *inSourceP,
                              Float32 *inDestP,
                              UInt32 inFramesToProcess,
-                             UInt32 inNumChannels, /* equal to 1 */
+                             UInt32 inNumChannels,
+                             bool &ioSilence
+                             ) { ProcessT(inSourceP, inDestP, inFramesToProcess, inNumChannels, ioSilence); }
+        
+        // Fixed-point 8.24 and 16-bit integer streams; see TremeloUnit::ValidFormat.
+        virtual void Process(const SInt32 *inSourceP,
+                             SInt32 *inDestP,
+                             UInt32 inFramesToProcess,
+                             UInt32 inNumChannels,
                              bool &ioSilence
-                             );
+                             ) { ProcessT(inSourceP, inDestP, inFramesToProcess, inNumChannels, ioSilence); }
+        virtual void Process(const SInt16 *inSourceP,
+                             SInt16 *inDestP,
+                             UInt32 inFramesToProcess,
+                             UInt32 inNumChannels,
+                             bool &ioSilence
+                             ) { ProcessT(inSourceP, inDestP, inFramesToProcess, inNumChannels, ioSilence); }
         
         virtual void Reset ();
         
+        virtual UInt32 GetMemoryUsage () const { return sizeof(TremeloUnitKernel); }
+        
+        void RenderLFOGains (Float32 *outGains,
+                             UInt32 inFrames,
+                             Float64 inFrameOffset,
+                             const TremeloGainCache::Key &inLFO) const;
+        
     private:
+        template <typename T>
+        void ProcessT (const T *inSourceP, T *inDestP, UInt32 inFramesToProcess, UInt32 inNumChannels,
+                       bool &ioSilence);
+        
+        // The legacy LFO's sample loop, specialized on the sample type, on whether samples are
+        // interleaved (a stride of inNumChannels rather than 1), and on whether the loop must
+        // watch for the next zero crossing (a pending frequency change or counter reset).
+        template <typename T, bool kInterleaved, bool kWatchZeroCrossing>
+        void ProcessLoop (const T *inSourceP, T *inDestP, UInt32 inFrames, UInt32 inStride, Float32 inDepth);
+        
         enum    {kWaveArraySize = 2000};    // The number of points in the wave table.
-        float   mSine [kWaveArraySize];     // The wave table for the tremelo sine wave.
-        float   mSquare [kWaveArraySize];   // The wave table for the tremelo square wave.
-        float   *waveArrayPointer;          // Points to the wave table to use for the current audio input buffer.
+        
+        // Every kernel uses the same tables, so they are computed once for the process.
+        struct WaveTables {
+            WaveTables ();
+            float   mSine [kWaveArraySize];     // The wave table for the tremelo sine wave.
+            float   mSquare [kWaveArraySize];   // The wave table for the tremelo square wave.
+        };
+        static const WaveTables &SharedWaveTables ();
+        
+        const float *mSine;                 // SharedWaveTables().mSine
+        const float *mSquare;               // SharedWaveTables().mSquare
+        const float *waveArrayPointer;      // Points to the wave table to use for the current audio input buffer.
         Float32 mSampleFrequency;           // The 'sample rate' of the audio signal being processed.
         long    mSamplesProcessed;          // The number of sample since the audio unit starting rendering
                                             //  or since this variable was reset to 0. We have to keep track
@@ -173,6 +507,93 @@ protected:
         float   mNextScale;                 // The scaling factor that the user most recently requested, by moving the
                                             //  tremelo frequency slider.
     };
+    
+private:
+    /// Where the work Initialize hands to the setup queue stands.
+    enum {
+        kSetup_Idle,                        // uninitialized
+        kSetup_Pending,                     // queued or running
+        kSetup_Done,                        // mDeferredGains is filled, for Render to take over
+        kSetup_Ready                        // nothing outstanding
+    };
+    
+    /// Where the gain cache stands while the unit hibernates. mSpareGains belongs to the render
+    /// thread in InUse, to the listeners' thread in Worker, and to whoever moves it out of Retired
+    /// or Ready first.
+    enum {
+        kGains_InUse,                       // in mGainCache (or there is none); mSpareGains is empty
+        kGains_Retired,                     // in mSpareGains, to be freed
+        kGains_Worker,                      // being freed or allocated
+        kGains_Released,                    // freed
+        kGains_Ready                        // allocated again in mSpareGains, for Render to take over
+    };
+    
+    static void HibernationListener (void *inRefCon, AudioUnit, AudioUnitPropertyID, AudioUnitScope,
+                                     AudioUnitElement);
+    void    SetHibernateAfter (UInt32 inFrames);
+    void    BeginRenderHibernation ();
+    void    EndRenderHibernation (AudioUnitRenderActionFlags inActionFlags, UInt32 inFrames);
+    void    SettleHibernation ();
+    void    ResetHibernation ();
+    void    GetHibernationStats (TremeloHibernationStats &outStats);
+    static void RunDeferredSetup (void *inRefCon);
+    void    CancelDeferredSetup ();
+    void    AllocateGainBuffers ();
+    void    GetConfiguration (TremeloUnitConfiguration &outConfiguration);
+    OSStatus SetConfiguration (const TremeloUnitConfiguration &inConfiguration);
+    void    ApplyParameterSet (const TremeloParameterSet &inSet);
+    void    CommitPendingParameterSet ();
+    void    TakePendingParameterSet ();
+    void    CaptureParameterValues ();
+    void    SetLFOAnchor (const TremeloLFOAnchor &inAnchor);
+    void    UpdateLFOAnchor (Float64 inSliceSampleTime);
+    void    RenderSliceGains (const TremeloGainCache::Key &inKey, UInt32 inFrames);
+    void    CrossfadeSliceGains (UInt32 inFrames);
+    void    UpdateLFOPeriod ();
+    Float64 LFOFramesFromAnchor (Float64 inSampleTime) const;
+    
+    std::atomic<bool>   mSampleTimeLFO;     // kTremeloUnitProperty_SampleTimeLFO
+    TremeloLFOAnchor    mLFOAnchor;         // kTremeloUnitProperty_LFOAnchor
+    TremeloParameterExchange<TremeloLFOAnchor> mAnchorExchange;     // Anchors set while initialized.
+    Float64             mLFOIncrement;      // mLFOAnchor.mFrequency in cycles per sample.
+    UInt32              mLFOPeriod;         // Whole-number LFO period in frames, or 0.
+    Float64             mRenderSampleTime;  // Sample time of the current Render call.
+    Float64             mSliceSampleTime;   // Sample time of the slice the kernels are processing.
+    Float64             mSliceFrameOffset;  // LFOFramesFromAnchor(mSliceSampleTime)
+    TremeloParameterValues mParameterValues;    // The current slice's parameters; see CaptureParameterValues.
+    TremeloGainCache    mGainCache;         // Allocated by Initialize when the sample-time LFO is on.
+    std::atomic<bool>   mSharedLFO;         // kTremeloUnitProperty_SharedLFO
+    std::atomic<UInt32> mOscillator;        // kTremeloUnitProperty_Oscillator
+    std::atomic<UInt32> mControlInterval;   // kTremeloUnitProperty_ControlInterval
+    SInt32              mKernelVariant;     // kTremeloUnitProperty_KernelVariant, as set
+    const TremeloKernelFunctions *mKernelFunctions; // Bound by Initialize.
+    UInt64              mFramesFromSharedLFO;
+    std::vector<Float32> mSliceGainBuffer;  // MaximumFramesPerSlice gains, once the sample-time LFO is on.
+    const Float32 *     mSliceGains;        // The current slice's gains, in mSliceGainBuffer or mGainCache;
+                                            //  NULL when the slice uses the legacy LFO.
+    TremeloParameterExchange<TremeloParameterSet> mParameterExchange;   // Presets on their way to Render.
+    UInt32              mPresetCrossfade;   // kTremeloUnitProperty_PresetCrossfade
+    UInt32              mCrossfadeFrames;   // Frames of the current crossfade still to render, 0 if none.
+    UInt32              mCrossfadeLength;   // mPresetCrossfade when the current crossfade started.
+    TremeloGainCache::Key mLastKey;         // The LFO settings of the last slice rendered.
+    TremeloGainCache::Key mCrossfadeKey;    // The settings being faded out.
+    std::vector<Float32> mCrossfadeGainBuffer;  // mCrossfadeKey's gains, sized with mSliceGainBuffer.
+    bool                mAsyncInitialize;   // kTremeloUnitProperty_AsyncInitialize
+    bool                mSetupSubmitted;    // A job for this unit may be in the setup queue.
+    std::atomic<UInt32> mSetupState;        // kSetup_ values
+    UInt32              mDeferredGainFrames;    // The gain cache size the job allocates.
+    std::vector<Float32> mDeferredGains;    // Filled by the job; swapped into mGainCache by Render.
+    std::atomic<UInt32> mHibernateAfter;    // kTremeloUnitProperty_HibernateAfter
+    bool                mHibernationListener;   // HibernationListener is installed.
+    UInt32              mIdleFrames;        // Silent or bypassed frames rendered in a row, up to mHibernateAfter.
+    bool                mHibernationPending;    // The I/O buffers retire at the start of the next render call.
+    std::atomic<bool>   mHibernating;
+    std::atomic<UInt32> mHibernations;
+    std::atomic<UInt32> mGainsState;        // kGains_ values
+    std::vector<Float32> mSpareGains;       // The gain cache's buffer on its way out or back in.
+    size_t              mReleasedGainFrames;    // The size of the gain cache that was freed.
+    UInt64              mBytesReleased;     // TremeloHibernationStats::mBytesReleased
+    mutable std::mutex  mHibernationMutex;  // Guards mSpareGains and mBytesReleased off the render thread.
 };
 
 #endif /* TremeloUnit_hpp */
@@ -0,0 +1,620 @@
+//
+//  TremeloUnitAPI.cpp
+//  TremeloAUv2
+//
+//  Implements the C interface in TremeloUnitAPI.h on top of the AudioUnit
+//  host API, so every call goes through the same AUBase dispatch path a Mac
+//  host would use.
+//
+
+#include "TremeloUnitAPI.h"
+#include "TremeloUnit.hpp"
+#include "CAStreamBasicDescription.h"
+
+#include <mutex>
+#include <string.h>
+#include <vector>
+
+// Factory function generated by AUDIOCOMPONENT_ENTRY in TremeloUnit.cpp.
+extern "C" void *TremeloUnitFactory(const AudioComponentDescription *inDesc);
+
+#pragma mark ____TremeloUnitInstance
+
+struct TremeloUnitPropertyListenerRecord {
+    TremeloUnitRef              mUnit;
+    AudioUnitPropertyID         mPropertyID;
+    TremeloUnitPropertyListener mListener;
+    void *                      mRefCon;
+};
+
+struct TremeloUnitInstance {
+    AudioUnit               mUnit;
+    UInt32                  mChannels;
+    Float64                 mSampleTime;
+    const float *const *    mInput;             // only valid for the duration of TremeloUnit_Render
+    AudioBufferList *       mOutputList;        // sized for mChannels buffers
+    std::vector<TremeloUnitPropertyListenerRecord *>    mListeners;
+};
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//    RegisterTremeloUnit
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Makes the component known to AudioComponentFindNext, using the same description as
+// the AudioComponents entry in Info.plist.
+static AudioComponent RegisterTremeloUnit ()
+{
+    static AudioComponent sComponent = NULL;
+    static std::once_flag sOnce;
+    std::call_once(sOnce, [] {
+        AudioComponentDescription desc = { kAudioUnitType_Effect, TremeloUnit_COMP_SUBTYPE, TrmeloUnit_COMP_MANF, 0, 0 };
+        sComponent = AudioComponentRegister(&desc, CFSTR("DAVE: Tremelo AUv2"), kTremoloUnitVersion,
+                                            (AudioComponentFactoryFunction)TremeloUnitFactory);
+    });
+    return sComponent;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//    InputCallback
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Supplies the caller's input channels when AUEffectBase pulls its input bus. If the unit
+// left the buffer pointers empty we hand over the caller's memory directly, otherwise the
+// samples are copied into the buffers the unit allocated. Without input the buffers are
+// cleared and flagged as silence, as a Mac host's silent source would.
+static OSStatus InputCallback (void *inRefCon, AudioUnitRenderActionFlags *ioActionFlags, const AudioTimeStamp *,
+                               UInt32, UInt32 inNumberFrames, AudioBufferList *ioData)
+{
+    TremeloUnitInstance *instance = static_cast<TremeloUnitInstance *>(inRefCon);
+    if (ioData->mNumberBuffers != instance->mChannels)
+        return kAudio_ParamError;
+
+    if (instance->mInput == NULL) {
+        for (UInt32 channel = 0; channel < ioData->mNumberBuffers; ++channel) {
+            AudioBuffer &buffer = ioData->mBuffers[channel];
+            if (buffer.mData == NULL)
+                return kAudio_ParamError;
+            buffer.mDataByteSize = inNumberFrames * sizeof(Float32);
+            memset(buffer.mData, 0, buffer.mDataByteSize);
+        }
+        *ioActionFlags |= kAudioUnitRenderAction_OutputIsSilence;
+        return noErr;
+    }
+
+    for (UInt32 channel = 0; channel < ioData->mNumberBuffers; ++channel) {
+        AudioBuffer &buffer = ioData->mBuffers[channel];
+        const float *source = instance->mInput[channel];
+        buffer.mDataByteSize = inNumberFrames * sizeof(Float32);
+        if (buffer.mData == NULL)
+            buffer.mData = const_cast<float *>(source);
+        else if (buffer.mData != source)
+            memcpy(buffer.mData, source, buffer.mDataByteSize);
+    }
+    return noErr;
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//    PropertyListenerTrampoline
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// Registered with the unit once per TremeloUnit_AddPropertyListener, with the record as its refCon.
+static void PropertyListenerTrampoline (void *inRefCon, AudioUnit, AudioUnitPropertyID inID,
+                                        AudioUnitScope inScope, AudioUnitElement inElement)
+{
+    const TremeloUnitPropertyListenerRecord *record = static_cast<const TremeloUnitPropertyListenerRecord *>(inRefCon);
+    record->mListener(record->mRefCon, record->mUnit, inID, inScope, inElement);
+}
+
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+//    NewInstance, SetOutputChannels
+//~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~~
+// What TremeloUnit_New and TremeloUnit_Clone share: the instance with its input callback
+// installed, before any format is set.
+static OSStatus NewInstance (TremeloUnitInstance **outInstance)
+{
+    *outInstance = NULL;
+
+    AudioComponent component = RegisterTremeloUnit();
+    if (component == NULL)
+        return kAudioUnitErr_FailedInitialization;
+
+    TremeloUnitInstance *instance = new (std::nothrow) TremeloUnitInstance();
+    if (instance == NULL)
+        return kAudio_MemFullError;
+
+    OSStatus result = AudioComponentInstanceNew(component, &instance->mUnit);
+    if (result == noErr) {
+        AURenderCallbackStruct callback = { InputCallback, instance };
+        result = AudioUnitSetProperty(instance->mUnit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0,
+                                      &callback, sizeof(callback));
+    }
+    if (result) {
+        TremeloUnit_Dispose(instance);
+        return result;
+    }
+    *outInstance = instance;
+    return noErr;
+}
+
+// Sizes the output buffer list TremeloUnit_Render hands the unit for inChannels channels.
+static OSStatus SetOutputChannels (TremeloUnitInstance *inInstance, UInt32 inChannels)
+{
+    size_t listSize = offsetof(AudioBufferList, mBuffers) + inChannels * sizeof(AudioBuffer);
+    AudioBufferList *list = (AudioBufferList *)realloc(inInstance->mOutputList, listSize);
+    if (list == NULL)
+        return kAudio_MemFullError;
+    list->mNumberBuffers = inChannels;
+    inInstance->mOutputList = list;
+    inInstance->mChannels = inChannels;
+    return noErr;
+}
+
+#pragma mark ____C API
+
+int32_t TremeloUnit_New (TremeloUnitRef *outUnit)
+{
+    if (outUnit == NULL)
+        return kAudio_ParamError;
+
+    OSStatus result = NewInstance(outUnit);
+    if (result == noErr) {
+        result = TremeloUnit_SetFormat(*outUnit, kAUDefaultSampleRate, 2);
+        if (result) {
+            TremeloUnit_Dispose(*outUnit);
+            *outUnit = NULL;
+        }
+    }
+    return result;
+}
+
+int32_t TremeloUnit_Clone (TremeloUnitRef inPrototype, TremeloUnitRef *outClone)
+{
+    if (inPrototype == NULL || outClone == NULL)
+        return kAudio_ParamError;
+    *outClone = NULL;
+
+    TremeloUnitConfiguration config;
+    UInt32 size = sizeof(config);
+    OSStatus result = AudioUnitGetProperty(inPrototype->mUnit, kTremeloUnitProperty_Configuration,
+                                           kAudioUnitScope_Global, 0, &config, &size);
+    if (result)
+        return result;
+
+    TremeloUnitInstance *clone = NULL;
+    result = NewInstance(&clone);
+    if (result == noErr)
+        result = AudioUnitSetProperty(clone->mUnit, kTremeloUnitProperty_Configuration, kAudioUnitScope_Global, 0,
+                                      &config, sizeof(config));
+    if (result == noErr)
+        result = SetOutputChannels(clone, inPrototype->mChannels);
+    if (result == noErr && config.mInitialized)
+        result = TremeloUnit_Initialize(clone);
+    if (config.mPreset.presetName)
+        CFRelease(config.mPreset.presetName);
+
+    if (result) {
+        if (clone)
+            TremeloUnit_Dispose(clone);
+        return result;
+    }
+    *outClone = clone;
+    return noErr;
+}
+
+int32_t TremeloUnit_Dispose (TremeloUnitRef inUnit)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+
+    OSStatus result = noErr;
+    if (inUnit->mUnit) {
+        AudioUnitUninitialize(inUnit->mUnit);
+        result = AudioComponentInstanceDispose(inUnit->mUnit);
+    }
+    for (TremeloUnitPropertyListenerRecord *record : inUnit->mListeners)
+        delete record;
+    free(inUnit->mOutputList);
+    delete inUnit;
+    return result;
+}
+
+int32_t TremeloUnit_SetFormat (TremeloUnitRef inUnit, double inSampleRate, uint32_t inChannels)
+{
+    if (inUnit == NULL || inChannels == 0 || !(inSampleRate > 0.))
+        return kAudio_ParamError;
+
+    CAStreamBasicDescription format(inSampleRate, inChannels, CAStreamBasicDescription::kPCMFormatFloat32, false);
+    OSStatus result = AudioUnitSetProperty(inUnit->mUnit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Input, 0,
+                                           &format, sizeof(AudioStreamBasicDescription));
+    if (result == noErr)
+        result = AudioUnitSetProperty(inUnit->mUnit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 0,
+                                      &format, sizeof(AudioStreamBasicDescription));
+    if (result)
+        return result;
+    return SetOutputChannels(inUnit, inChannels);
+}
+
+int32_t TremeloUnit_SetMaximumFramesPerSlice (TremeloUnitRef inUnit, uint32_t inFrames)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    UInt32 frames = inFrames;
+    return AudioUnitSetProperty(inUnit->mUnit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0,
+                                &frames, sizeof(frames));
+}
+
+int32_t TremeloUnit_Initialize (TremeloUnitRef inUnit)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    inUnit->mSampleTime = 0.;
+    return AudioUnitInitialize(inUnit->mUnit);
+}
+
+int32_t TremeloUnit_SetAsyncInitialize (TremeloUnitRef inUnit, int inEnable)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    UInt32 enable = inEnable != 0;
+    return AudioUnitSetProperty(inUnit->mUnit, kTremeloUnitProperty_AsyncInitialize, kAudioUnitScope_Global, 0,
+                                &enable, sizeof(enable));
+}
+
+int32_t TremeloUnit_IsReady (TremeloUnitRef inUnit, int *outReady)
+{
+    if (inUnit == NULL || outReady == NULL)
+        return kAudio_ParamError;
+    UInt32 ready;
+    UInt32 size = sizeof(ready);
+    OSStatus result = AudioUnitGetProperty(inUnit->mUnit, kTremeloUnitProperty_Ready, kAudioUnitScope_Global, 0,
+                                           &ready, &size);
+    if (result == noErr)
+        *outReady = ready != 0;
+    return result;
+}
+
+int32_t TremeloUnit_Uninitialize (TremeloUnitRef inUnit)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    return AudioUnitUninitialize(inUnit->mUnit);
+}
+
+int32_t TremeloUnit_Reset (TremeloUnitRef inUnit)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    return AudioUnitReset(inUnit->mUnit, kAudioUnitScope_Global, 0);
+}
+
+int32_t TremeloUnit_SetParameter (TremeloUnitRef inUnit, uint32_t inParameterID, float inValue)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    return AudioUnitSetParameter(inUnit->mUnit, inParameterID, kAudioUnitScope_Global, 0, inValue, 0);
+}
+
+int32_t TremeloUnit_GetParameter (TremeloUnitRef inUnit, uint32_t inParameterID, float *outValue)
+{
+    if (inUnit == NULL || outValue == NULL)
+        return kAudio_ParamError;
+    return AudioUnitGetParameter(inUnit->mUnit, inParameterID, kAudioUnitScope_Global, 0, outValue);
+}
+
+int32_t TremeloUnit_SetFactoryPreset (TremeloUnitRef inUnit, int32_t inPresetNumber)
+{
+    if (inUnit == NULL || inPresetNumber < 0)
+        return kAudio_ParamError;
+    AUPreset preset = { inPresetNumber, NULL };
+    return AudioUnitSetProperty(inUnit->mUnit, kAudioUnitProperty_PresentPreset, kAudioUnitScope_Global, 0,
+                                &preset, sizeof(preset));
+}
+
+int32_t TremeloUnit_SaveState (TremeloUnitRef inUnit, void *outData, uint32_t *ioSize)
+{
+    if (inUnit == NULL || ioSize == NULL)
+        return kAudio_ParamError;
+    UInt32 size = 0;
+    OSStatus result;
+    if (outData == NULL || *ioSize < sizeof(AUBinaryStateHeader)) {
+        result = AudioUnitGetProperty(inUnit->mUnit, kTremeloUnitProperty_BinaryState, kAudioUnitScope_Global, 0,
+                                      NULL, &size);
+        if (result == noErr && outData != NULL)
+            result = kAudio_ParamError;
+        *ioSize = size;
+        return result;
+    }
+    size = *ioSize;
+    result = AudioUnitGetProperty(inUnit->mUnit, kTremeloUnitProperty_BinaryState, kAudioUnitScope_Global, 0,
+                                  outData, &size);
+    if (result != noErr) {
+        *ioSize = 0;
+        return result;
+    }
+    // A short buffer gets a truncated copy; report the size needed instead.
+    *ioSize = ((const AUBinaryStateHeader *)outData)->mSize;
+    if (*ioSize > size)
+        return kAudio_ParamError;
+    return noErr;
+}
+
+int32_t TremeloUnit_RestoreState (TremeloUnitRef inUnit, const void *inData, uint32_t inSize)
+{
+    if (inUnit == NULL || inData == NULL)
+        return kAudio_ParamError;
+    return AudioUnitSetProperty(inUnit->mUnit, kTremeloUnitProperty_BinaryState, kAudioUnitScope_Global, 0,
+                                inData, inSize);
+}
+
+int32_t TremeloUnit_AddPropertyListener (TremeloUnitRef inUnit, uint32_t inPropertyID,
+                                         TremeloUnitPropertyListener inListener, void *inRefCon)
+{
+    if (inUnit == NULL || inListener == NULL)
+        return kAudio_ParamError;
+    TremeloUnitPropertyListenerRecord *record =
+        new (std::nothrow) TremeloUnitPropertyListenerRecord { inUnit, inPropertyID, inListener, inRefCon };
+    if (record == NULL)
+        return kAudio_MemFullError;
+    OSStatus result = AudioUnitAddPropertyListener(inUnit->mUnit, inPropertyID, PropertyListenerTrampoline, record);
+    if (result != noErr) {
+        delete record;
+        return result;
+    }
+    inUnit->mListeners.push_back(record);
+    return noErr;
+}
+
+int32_t TremeloUnit_RemovePropertyListener (TremeloUnitRef inUnit, uint32_t inPropertyID,
+                                            TremeloUnitPropertyListener inListener, void *inRefCon)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    std::vector<TremeloUnitPropertyListenerRecord *> &listeners = inUnit->mListeners;
+    for (size_t i = listeners.size(); i-- > 0; ) {
+        TremeloUnitPropertyListenerRecord *record = listeners[i];
+        if (record->mPropertyID != inPropertyID || record->mListener != inListener || record->mRefCon != inRefCon)
+            continue;
+        // Once this returns the unit no longer calls the trampoline with the record.
+        AudioUnitRemovePropertyListenerWithUserData(inUnit->mUnit, inPropertyID, PropertyListenerTrampoline, record);
+        listeners.erase(listeners.begin() + i);
+        delete record;
+    }
+    return noErr;
+}
+
+int32_t TremeloUnit_SetPropertyNotification (TremeloUnitRef inUnit, int inMode)
+{
+    if (inUnit == NULL || inMode < 0)
+        return kAudio_ParamError;
+    UInt32 mode = inMode;
+    return AudioUnitSetProperty(inUnit->mUnit, kTremeloUnitProperty_PropertyNotification, kAudioUnitScope_Global, 0,
+                                &mode, sizeof(mode));
+}
+
+int32_t TremeloUnit_DeliverPropertyChanges (TremeloUnitRef inUnit, uint32_t inMaxChanges)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    UInt32 maxChanges = inMaxChanges;
+    return AudioUnitSetProperty(inUnit->mUnit, kTremeloUnitProperty_DeliverPropertyChanges, kAudioUnitScope_Global, 0,
+                                &maxChanges, sizeof(maxChanges));
+}
+
+int32_t TremeloUnit_SetPresetCrossfade (TremeloUnitRef inUnit, uint32_t inFrames)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    UInt32 frames = inFrames;
+    return AudioUnitSetProperty(inUnit->mUnit, kTremeloUnitProperty_PresetCrossfade, kAudioUnitScope_Global, 0,
+                                &frames, sizeof(frames));
+}
+
+int32_t TremeloUnit_SetBypass (TremeloUnitRef inUnit, int inBypass)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    UInt32 bypass = inBypass != 0;
+    return AudioUnitSetProperty(inUnit->mUnit, kAudioUnitProperty_BypassEffect, kAudioUnitScope_Global, 0,
+                                &bypass, sizeof(bypass));
+}
+
+int32_t TremeloUnit_SetSampleTimeLFO (TremeloUnitRef inUnit, int inEnable)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    UInt32 enable = inEnable != 0;
+    return AudioUnitSetProperty(inUnit->mUnit, kTremeloUnitProperty_SampleTimeLFO, kAudioUnitScope_Global, 0,
+                                &enable, sizeof(enable));
+}
+
+int32_t TremeloUnit_SetSampleTime (TremeloUnitRef inUnit, double inSampleTime)
+{
+    if (inUnit == NULL || !(inSampleTime >= 0.))
+        return kAudio_ParamError;
+    inUnit->mSampleTime = inSampleTime;
+    return noErr;
+}
+
+int32_t TremeloUnit_GetLFOAnchor (TremeloUnitRef inUnit, TremeloUnitLFOAnchor *outAnchor)
+{
+    if (inUnit == NULL || outAnchor == NULL)
+        return kAudio_ParamError;
+    TremeloLFOAnchor anchor;
+    UInt32 size = sizeof(anchor);
+    OSStatus result = AudioUnitGetProperty(inUnit->mUnit, kTremeloUnitProperty_LFOAnchor, kAudioUnitScope_Global, 0,
+                                           &anchor, &size);
+    if (result == noErr) {
+        outAnchor->sampleTime = anchor.mSampleTime;
+        outAnchor->phase = anchor.mPhase;
+        outAnchor->frequency = anchor.mFrequency;
+    }
+    return result;
+}
+
+int32_t TremeloUnit_SetLFOAnchor (TremeloUnitRef inUnit, const TremeloUnitLFOAnchor *inAnchor)
+{
+    if (inUnit == NULL || inAnchor == NULL)
+        return kAudio_ParamError;
+    TremeloLFOAnchor anchor = { inAnchor->sampleTime, inAnchor->phase, inAnchor->frequency };
+    return AudioUnitSetProperty(inUnit->mUnit, kTremeloUnitProperty_LFOAnchor, kAudioUnitScope_Global, 0,
+                                &anchor, sizeof(anchor));
+}
+
+int32_t TremeloUnit_SetOscillator (TremeloUnitRef inUnit, int inOscillator)
+{
+    if (inUnit == NULL || inOscillator < 0)
+        return kAudio_ParamError;
+    UInt32 oscillator = inOscillator;
+    return AudioUnitSetProperty(inUnit->mUnit, kTremeloUnitProperty_Oscillator, kAudioUnitScope_Global, 0,
+                                &oscillator, sizeof(oscillator));
+}
+
+int32_t TremeloUnit_SetControlInterval (TremeloUnitRef inUnit, uint32_t inFrames)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    UInt32 interval = inFrames;
+    return AudioUnitSetProperty(inUnit->mUnit, kTremeloUnitProperty_ControlInterval, kAudioUnitScope_Global, 0,
+                                &interval, sizeof(interval));
+}
+
+int32_t TremeloUnit_SetKernelVariant (TremeloUnitRef inUnit, int inVariant)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    SInt32 variant = inVariant;
+    return AudioUnitSetProperty(inUnit->mUnit, kTremeloUnitProperty_KernelVariant, kAudioUnitScope_Global, 0,
+                                &variant, sizeof(variant));
+}
+
+int32_t TremeloUnit_GetKernelVariant (TremeloUnitRef inUnit, int *outVariant)
+{
+    if (inUnit == NULL || outVariant == NULL)
+        return kAudio_ParamError;
+    SInt32 variant;
+    UInt32 size = sizeof(variant);
+    OSStatus result = AudioUnitGetProperty(inUnit->mUnit, kTremeloUnitProperty_KernelVariant, kAudioUnitScope_Global, 0,
+                                           &variant, &size);
+    if (result == noErr)
+        *outVariant = variant;
+    return result;
+}
+
+int32_t TremeloUnit_SetSharedLFO (TremeloUnitRef inUnit, int inEnable)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    UInt32 enable = inEnable != 0;
+    return AudioUnitSetProperty(inUnit->mUnit, kTremeloUnitProperty_SharedLFO, kAudioUnitScope_Global, 0,
+                                &enable, sizeof(enable));
+}
+
+int32_t TremeloUnit_SetBufferOptions (uint32_t inOptions)
+{
+    if (inOptions & ~UInt32(kTremeloUnitBufferOption_HugePages | kTremeloUnitBufferOption_Lock |
+                            kTremeloUnitBufferOption_SharedArena))
+        return kAudio_ParamError;
+    AUBufferMemory::SetOptions(inOptions & (kTremeloUnitBufferOption_HugePages | kTremeloUnitBufferOption_Lock));
+    AUBufferArena::SetEnabled((inOptions & kTremeloUnitBufferOption_SharedArena) != 0);
+    return noErr;
+}
+
+int32_t TremeloUnit_GetGainCacheStats (TremeloUnitRef inUnit, TremeloUnitGainCacheStats *outStats)
+{
+    if (inUnit == NULL || outStats == NULL)
+        return kAudio_ParamError;
+    TremeloGainCacheStats stats;
+    UInt32 size = sizeof(stats);
+    OSStatus result = AudioUnitGetProperty(inUnit->mUnit, kTremeloUnitProperty_GainCacheStats, kAudioUnitScope_Global, 0,
+                                           &stats, &size);
+    if (result == noErr) {
+        outStats->framesProcessed = stats.mFramesProcessed;
+        outStats->framesFromCache = stats.mFramesFromCache;
+        outStats->framesFromSharedLFO = stats.mFramesFromSharedLFO;
+        outStats->periodFrames = stats.mPeriodFrames;
+        outStats->bytesAllocated = stats.mBytesAllocated;
+    }
+    return result;
+}
+
+int32_t TremeloUnit_GetMemoryUsage (TremeloUnitRef inUnit, TremeloUnitMemoryUsage *outUsage)
+{
+    if (inUnit == NULL || outUsage == NULL)
+        return kAudio_ParamError;
+    AUMemoryUsage usage;
+    UInt32 size = sizeof(usage);
+    OSStatus result = AudioUnitGetProperty(inUnit->mUnit, kTremeloUnitProperty_MemoryUsage, kAudioUnitScope_Global, 0,
+                                           &usage, &size);
+    if (result == noErr) {
+        usage.mOther += sizeof(TremeloUnitInstance) +
+                        inUnit->mListeners.capacity() * sizeof(TremeloUnitPropertyListenerRecord *) +
+                        inUnit->mListeners.size() * sizeof(TremeloUnitPropertyListenerRecord);
+        if (inUnit->mOutputList)
+            usage.mOther += offsetof(AudioBufferList, mBuffers) + inUnit->mChannels * sizeof(AudioBuffer);
+        outUsage->instance = usage.mInstance;
+        outUsage->elements = usage.mElements;
+        outUsage->parameters = usage.mParameters;
+        outUsage->elementNames = usage.mElementNames;
+        outUsage->ioBuffers = usage.mIOBuffers;
+        outUsage->kernels = usage.mKernels;
+        outUsage->other = usage.mOther;
+        outUsage->total = usage.Total();
+    }
+    return result;
+}
+
+int32_t TremeloUnit_SetHibernateAfter (TremeloUnitRef inUnit, uint32_t inFrames)
+{
+    if (inUnit == NULL)
+        return kAudio_ParamError;
+    UInt32 frames = inFrames;
+    return AudioUnitSetProperty(inUnit->mUnit, kTremeloUnitProperty_HibernateAfter, kAudioUnitScope_Global, 0,
+                                &frames, sizeof(frames));
+}
+
+int32_t TremeloUnit_GetHibernationStats (TremeloUnitRef inUnit, TremeloUnitHibernationStats *outStats)
+{
+    if (inUnit == NULL || outStats == NULL)
+        return kAudio_ParamError;
+    TremeloHibernationStats stats;
+    UInt32 size = sizeof(stats);
+    OSStatus result = AudioUnitGetProperty(inUnit->mUnit, kTremeloUnitProperty_Hibernation, kAudioUnitScope_Global, 0,
+                                           &stats, &size);
+    if (result == noErr) {
+        outStats->hibernating = stats.mHibernating;
+        outStats->hibernations = stats.mHibernations;
+        outStats->bytesReleased = stats.mBytesReleased;
+        outStats->unitsHibernating = stats.mUnitsHibernating;
+        outStats->processBytesReleased = stats.mProcessBytesReleased;
+    }
+    return result;
+}
+
+int32_t TremeloUnit_Render (TremeloUnitRef inUnit, const float *const *inInput, float *const *ioOutput, uint32_t inFrames)
+{
+    if (inUnit == NULL || ioOutput == NULL)
+        return kAudio_ParamError;
+
+    AudioBufferList *output = inUnit->mOutputList;
+    for (UInt32 channel = 0; channel < inUnit->mChannels; ++channel) {
+        output->mBuffers[channel].mNumberChannels = 1;
+        output->mBuffers[channel].mDataByteSize = inFrames * sizeof(Float32);
+        output->mBuffers[channel].mData = ioOutput[channel];
+    }
+
+    AudioTimeStamp timeStamp;
+    memset(&timeStamp, 0, sizeof(timeStamp));
+    timeStamp.mSampleTime = inUnit->mSampleTime;
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+
+    inUnit->mInput = inInput;
+    AudioUnitRenderActionFlags flags = 0;
+    OSStatus result = AudioUnitRender(inUnit->mUnit, &flags, &timeStamp, 0, inFrames, output);
+    inUnit->mInput = NULL;
+
+    if (result == noErr) {
+        // the unit may have rendered into its own buffers (e.g. when it reports silence)
+        for (UInt32 channel = 0; channel < inUnit->mChannels; ++channel)
+            if (output->mBuffers[channel].mData != ioOutput[channel])
+                memcpy(ioOutput[channel], output->mBuffers[channel].mData, inFrames * sizeof(Float32));
+        inUnit->mSampleTime += inFrames;
+    }
+    return result;
+}
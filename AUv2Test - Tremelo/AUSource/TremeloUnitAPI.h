@@ -0,0 +1,249 @@
+//
+//  TremeloUnitAPI.h
+//  TremeloAUv2
+//
+//  Plain C interface to TremeloUnit for hosts that don't speak the AudioUnit
+//  API (e.g. a Linux render engine). Each call maps onto the AudioUnit call
+//  of the same name, so the unit behaves exactly as it does inside Logic.
+//  Audio is exchanged as non-interleaved 32-bit float, one pointer per
+//  channel. All calls return 0 on success or an OSStatus error code.
+//
+
+#ifndef TremeloUnitAPI_h
+#define TremeloUnitAPI_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Opaque handle to one TremeloUnit instance.
+typedef struct TremeloUnitInstance *TremeloUnitRef;
+
+/// Parameter IDs, matching the Parameters enum in TremeloUnit.hpp.
+enum {
+    kTremeloUnitParam_Frequency = 0,    // Hz, 0.5 ... 20
+    kTremeloUnitParam_Depth     = 1,    // percent, 0 ... 100
+    kTremeloUnitParam_Waveform  = 2     // see below
+};
+
+/// Values of kTremeloUnitParam_Waveform.
+enum {
+    kTremeloUnitParam_Waveform_Sine     = 1,
+    kTremeloUnitParam_Waveform_Square   = 2
+};
+
+/// Registers the component (once per process) and creates a new, uninitialized instance.
+int32_t TremeloUnit_New(TremeloUnitRef *outUnit);
+
+/// Creates a new instance configured like inPrototype, from one snapshot of its set-up: formats,
+/// maximum frames per slice, parameters and current preset, bypass, and every setting made with
+/// the calls below (see kTremeloUnitProperty_Configuration in TremeloUnit.hpp). If the prototype
+/// is initialized, so is the clone, with render buffers and DSP state of its own, ready for
+/// TremeloUnit_Render at sample time 0. Property listeners are not copied. Not while the
+/// prototype is being rendered or set up on another thread.
+int32_t TremeloUnit_Clone(TremeloUnitRef inPrototype, TremeloUnitRef *outClone);
+
+/// Uninitializes if needed and destroys the instance.
+int32_t TremeloUnit_Dispose(TremeloUnitRef inUnit);
+
+/// Sets the sample rate and channel count of both the input and output bus.
+/// Must be called while the unit is uninitialized.
+int32_t TremeloUnit_SetFormat(TremeloUnitRef inUnit, double inSampleRate, uint32_t inChannels);
+
+/// Sets the largest number of frames that will be passed to TremeloUnit_Render.
+/// Must be called while the unit is uninitialized.
+int32_t TremeloUnit_SetMaximumFramesPerSlice(TremeloUnitRef inUnit, uint32_t inFrames);
+
+/// Allocates the render resources for the current format.
+int32_t TremeloUnit_Initialize(TremeloUnitRef inUnit);
+
+/// Enables (non-zero) or disables asynchronous initialization from the next TremeloUnit_Initialize
+/// on. With the sample-time LFO, Initialize then returns without allocating the gain cache, which
+/// a background thread shared by all instances allocates; the unit renders the same output
+/// without the cache until it is ready. See kTremeloUnitProperty_AsyncInitialize.
+int32_t TremeloUnit_SetAsyncInitialize(TremeloUnitRef inUnit, int inEnable);
+
+/// Sets *outReady to non-zero once the unit is initialized and its background setup, if any, is
+/// done. Listeners for kTremeloUnitProperty_Ready (64013) are called when it turns on.
+int32_t TremeloUnit_IsReady(TremeloUnitRef inUnit, int *outReady);
+
+/// Releases the render resources; the format may be changed again afterwards.
+int32_t TremeloUnit_Uninitialize(TremeloUnitRef inUnit);
+
+/// Clears the LFO and DSP state without changing the parameters.
+int32_t TremeloUnit_Reset(TremeloUnitRef inUnit);
+
+int32_t TremeloUnit_SetParameter(TremeloUnitRef inUnit, uint32_t inParameterID, float inValue);
+int32_t TremeloUnit_GetParameter(TremeloUnitRef inUnit, uint32_t inParameterID, float *outValue);
+
+/// Applies one of the factory presets (0 = "Slow & Gentle", 1 = "Fast & Hard"). On an initialized
+/// unit the whole preset takes effect at the start of the next TremeloUnit_Render call.
+int32_t TremeloUnit_SetFactoryPreset(TremeloUnitRef inUnit, int32_t inPresetNumber);
+
+/// Crossfades the sample-time LFO's gain curve into a recalled preset over inFrames frames
+/// (0, the default, switches at the render call boundary).
+int32_t TremeloUnit_SetPresetCrossfade(TremeloUnitRef inUnit, uint32_t inFrames);
+
+/// Bypasses the effect (non-zero), passing the input through unchanged, or stops bypassing it.
+int32_t TremeloUnit_SetBypass(TremeloUnitRef inUnit, int inBypass);
+
+/// Saves the unit's state (parameters and preset name) into outData in a compact binary form,
+/// see kTremeloUnitProperty_BinaryState. With outData NULL, returns the size needed in *ioSize;
+/// otherwise *ioSize is the buffer size on entry and the bytes written on return. outData must
+/// be 4-byte aligned.
+int32_t TremeloUnit_SaveState(TremeloUnitRef inUnit, void *outData, uint32_t *ioSize);
+/// Restores a state saved by TremeloUnit_SaveState, reading inData in place.
+int32_t TremeloUnit_RestoreState(TremeloUnitRef inUnit, const void *inData, uint32_t inSize);
+
+/// Called after a property of the unit changed (an AudioUnit property ID, scope and element).
+/// Never called on a thread inside TremeloUnit_Render; see TremeloUnit_SetPropertyNotification.
+typedef void (*TremeloUnitPropertyListener)(void *inRefCon, TremeloUnitRef inUnit, uint32_t inPropertyID,
+                                            uint32_t inScope, uint32_t inElement);
+
+int32_t TremeloUnit_AddPropertyListener(TremeloUnitRef inUnit, uint32_t inPropertyID,
+                                        TremeloUnitPropertyListener inListener, void *inRefCon);
+int32_t TremeloUnit_RemovePropertyListener(TremeloUnitRef inUnit, uint32_t inPropertyID,
+                                           TremeloUnitPropertyListener inListener, void *inRefCon);
+
+/// Values for TremeloUnit_SetPropertyNotification, matching kAUPropertyNotification_ in AUBase.h.
+enum {
+    /// Listeners run on the thread that changed the property; changes made while rendering are
+    /// delivered by a notifier thread. The default.
+    kTremeloUnitPropertyNotification_Synchronous    = 0,
+    /// Every change is queued and delivered by a process-wide notifier thread.
+    kTremeloUnitPropertyNotification_NotifierThread = 1,
+    /// Every change is queued until the host calls TremeloUnit_DeliverPropertyChanges.
+    kTremeloUnitPropertyNotification_HostPumped     = 2
+};
+
+int32_t TremeloUnit_SetPropertyNotification(TremeloUnitRef inUnit, int inMode);
+/// Calls the listeners for up to inMaxChanges queued property changes (0 for all of them). Must
+/// not be called from the render thread. Changes to the same property, scope and element that
+/// pile up between two calls are delivered once.
+int32_t TremeloUnit_DeliverPropertyChanges(TremeloUnitRef inUnit, uint32_t inMaxChanges);
+
+/// Phase reference of the sample-time LFO; see TremeloLFOAnchor in TremeloUnit.hpp.
+typedef struct TremeloUnitLFOAnchor {
+    double  sampleTime;
+    double  phase;          // cycles
+    double  frequency;      // Hz, 0 = unset
+} TremeloUnitLFOAnchor;
+
+/// Enables (non-zero) or disables the sample-time LFO. When enabled the output for a given
+/// stretch of the timeline does not depend on how it was split into render calls or across
+/// instances, so an offline host can render chunks of a file in parallel and concatenate them.
+int32_t TremeloUnit_SetSampleTimeLFO(TremeloUnitRef inUnit, int inEnable);
+
+/// Sets the sample time stamped on the next TremeloUnit_Render call (0 after Initialize).
+/// Each Render advances it by the number of frames rendered.
+int32_t TremeloUnit_SetSampleTime(TremeloUnitRef inUnit, double inSampleTime);
+
+int32_t TremeloUnit_GetLFOAnchor(TremeloUnitRef inUnit, TremeloUnitLFOAnchor *outAnchor);
+/// On an initialized unit the anchor takes effect at the start of the next TremeloUnit_Render
+/// call; Initialize and Reset clear it.
+int32_t TremeloUnit_SetLFOAnchor(TremeloUnitRef inUnit, const TremeloUnitLFOAnchor *inAnchor);
+
+/// Values for TremeloUnit_SetOscillator.
+enum {
+    kTremeloUnitOscillator_WaveTable    = 0,
+    kTremeloUnitOscillator_Polynomial   = 1
+};
+
+/// Selects how the sample-time LFO evaluates its waveform: the wave tables (default) or SIMD
+/// polynomials. Only has an effect while the sample-time LFO is enabled.
+int32_t TremeloUnit_SetOscillator(TremeloUnitRef inUnit, int inOscillator);
+
+/// Sets the sample-time LFO's control interval: 0 evaluates the waveform every frame, 16, 32 or
+/// 64 every that many frames with linear ramps in between. See kTremeloUnitProperty_ControlInterval
+/// in TremeloUnit.hpp for the accuracy.
+int32_t TremeloUnit_SetControlInterval(TremeloUnitRef inUnit, uint32_t inFrames);
+
+/// Values for TremeloUnit_SetKernelVariant; see TremeloKernelDispatch.h.
+enum {
+    kTremeloUnitKernelVariant_Auto      = -1,
+    kTremeloUnitKernelVariant_Generic   = 0,
+    kTremeloUnitKernelVariant_AVX2      = 1,
+    kTremeloUnitKernelVariant_AVX512    = 2
+};
+
+/// Forces an instruction set variant of the sample-time LFO's loops, from the next
+/// TremeloUnit_Initialize on. Fails if this build or CPU can't run it.
+int32_t TremeloUnit_SetKernelVariant(TremeloUnitRef inUnit, int inVariant);
+/// The variant currently bound.
+int32_t TremeloUnit_GetKernelVariant(TremeloUnitRef inUnit, int *outVariant);
+
+/// Gain cache counters; see TremeloGainCacheStats in TremeloUnit.hpp.
+typedef struct TremeloUnitGainCacheStats {
+    uint64_t    framesProcessed;
+    uint64_t    framesFromCache;
+    uint64_t    framesFromSharedLFO;
+    uint32_t    periodFrames;
+    uint32_t    bytesAllocated;
+} TremeloUnitGainCacheStats;
+
+int32_t TremeloUnit_GetGainCacheStats(TremeloUnitRef inUnit, TremeloUnitGainCacheStats *outStats);
+
+/// Bytes allocated by one instance; see AUMemoryUsage in AUScopeElement.h. other includes this
+/// API's own bookkeeping for the instance.
+typedef struct TremeloUnitMemoryUsage {
+    uint64_t    instance;
+    uint64_t    elements;
+    uint64_t    parameters;
+    uint64_t    elementNames;
+    uint64_t    ioBuffers;
+    uint64_t    kernels;
+    uint64_t    other;
+    uint64_t    total;
+} TremeloUnitMemoryUsage;
+
+int32_t TremeloUnit_GetMemoryUsage(TremeloUnitRef inUnit, TremeloUnitMemoryUsage *outUsage);
+
+/// Enables (non-zero) or disables sharing sample-time LFO gain blocks with other instances in
+/// the process that have identical settings and render the same slices. Only has an effect
+/// while the sample-time LFO is enabled.
+int32_t TremeloUnit_SetSharedLFO(TremeloUnitRef inUnit, int inEnable);
+
+/// Flags for TremeloUnit_SetBufferOptions; see AUBufferMemory in AUBuffer.h.
+enum {
+    kTremeloUnitBufferOption_HugePages      = 1,    // back large render buffers with transparent huge pages
+    kTremeloUnitBufferOption_Lock           = 2,    // mlock large render buffers, within RLIMIT_MEMLOCK
+    kTremeloUnitBufferOption_SharedArena    = 4     // borrow I/O buffers from a pool shared by all instances
+                                                    // for the duration of each render; see AUBufferArena
+};
+
+/// Process-wide: how the render buffers of every instance are allocated from the next
+/// TremeloUnit_Initialize on. Buffers are always cache-line aligned and pre-faulted.
+int32_t TremeloUnit_SetBufferOptions(uint32_t inOptions);
+
+/// Hibernates the unit after inFrames frames of silent or bypassed output (0, the default, never):
+/// it frees its render buffers and the sample-time LFO's gain cache until its output is audible
+/// again, borrowing buffers from the shared pool while it renders. The memory is freed on the
+/// thread that calls the property listeners; see kTremeloUnitProperty_HibernateAfter.
+int32_t TremeloUnit_SetHibernateAfter(TremeloUnitRef inUnit, uint32_t inFrames);
+
+/// See TremeloHibernationStats in TremeloUnit.hpp. Listeners for kTremeloUnitProperty_Hibernation
+/// (64016) are called when the unit hibernates or wakes up.
+typedef struct TremeloUnitHibernationStats {
+    uint32_t    hibernating;
+    uint32_t    hibernations;
+    uint64_t    bytesReleased;
+    uint32_t    unitsHibernating;           // in the process
+    uint64_t    processBytesReleased;
+} TremeloUnitHibernationStats;
+
+int32_t TremeloUnit_GetHibernationStats(TremeloUnitRef inUnit, TremeloUnitHibernationStats *outStats);
+
+/// Processes inFrames frames from inInput into ioOutput. Both are arrays of
+/// one pointer per channel; in-place processing (inInput[i] == ioOutput[i]) is
+/// allowed. inFrames must not exceed the maximum frames per slice. A NULL inInput
+/// renders silent input, which the unit can tell apart from samples that happen
+/// to be zero (see TremeloUnit_SetHibernateAfter).
+int32_t TremeloUnit_Render(TremeloUnitRef inUnit, const float *const *inInput, float *const *ioOutput, uint32_t inFrames);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TremeloUnitAPI_h */
@@ -0,0 +1,286 @@
+//
+//  TremeloRender.cpp
+//  TremeloAUv2
+//
+//  Offline batch renderer: runs WAV files through TremeloUnit without a host.
+//  Files are distributed over a pool of workers, each owning one TremeloUnit
+//  instance; audio is pulled through the unit's input callback exactly as it
+//  is inside a DAW (AudioUnitRender -> AUBase::DoRender -> AUEffectBase).
+//
+//  usage: tremelo-render [options] -o <dir> <file.wav>...
+//
+
+#include "TremeloUnitAPI.h"
+#include "WaveFile.h"
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+struct RenderOptions {
+    std::string                 mOutputDirectory;
+    std::vector<std::string>    mInputs;
+    unsigned                    mJobs           = 0;        // 0 = one per hardware thread
+    uint32_t                    mBlockFrames    = 4096;
+    int32_t                     mPreset         = -1;       // -1 = keep the unit's default
+    float                       mFrequency      = -1.f;     // < 0 = not set on the command line
+    float                       mDepth          = -1.f;
+    float                       mWaveform       = -1.f;
+    bool                        mQuiet          = false;
+};
+
+struct RenderTotals {
+    std::mutex  mMutex;
+    double      mAudioSeconds   = 0.;
+    double      mBusySeconds    = 0.;                       // summed over workers
+    unsigned    mFiles          = 0;
+    unsigned    mFailures       = 0;
+};
+
+typedef std::chrono::steady_clock Clock;
+
+void PrintUsage (FILE *inStream)
+{
+    fprintf(inStream,
+            "usage: tremelo-render [options] -o <dir> <file.wav>...\n"
+            "\n"
+            "  -o, --output <dir>       directory for the rendered files (required)\n"
+            "  -j, --jobs <n>           files rendered concurrently (default: hardware threads)\n"
+            "  -b, --block <frames>     frames per render slice (default: 4096)\n"
+            "  -p, --preset <n>         factory preset (0 = Slow & Gentle, 1 = Fast & Hard)\n"
+            "  -f, --frequency <hz>     tremolo frequency, 0.5 ... 20\n"
+            "  -d, --depth <percent>    tremolo depth, 0 ... 100\n"
+            "  -w, --waveform <shape>   sine or square\n"
+            "  -q, --quiet              only print the summary\n"
+            "  -h, --help\n");
+}
+
+bool ParseOptions (int argc, char *argv[], RenderOptions &outOptions)
+{
+    static const struct option kLongOptions[] = {
+        { "output",     required_argument,  NULL, 'o' },
+        { "jobs",       required_argument,  NULL, 'j' },
+        { "block",      required_argument,  NULL, 'b' },
+        { "preset",     required_argument,  NULL, 'p' },
+        { "frequency",  required_argument,  NULL, 'f' },
+        { "depth",      required_argument,  NULL, 'd' },
+        { "waveform",   required_argument,  NULL, 'w' },
+        { "quiet",      no_argument,        NULL, 'q' },
+        { "help",       no_argument,        NULL, 'h' },
+        { NULL,         0,                  NULL, 0 }
+    };
+
+    int option;
+    while ((option = getopt_long(argc, argv, "o:j:b:p:f:d:w:qh", kLongOptions, NULL)) != -1) {
+        switch (option) {
+            case 'o':   outOptions.mOutputDirectory = optarg;               break;
+            case 'j':   outOptions.mJobs = (unsigned)atoi(optarg);          break;
+            case 'b':   outOptions.mBlockFrames = (uint32_t)atoi(optarg);   break;
+            case 'p':   outOptions.mPreset = atoi(optarg);                  break;
+            case 'f':   outOptions.mFrequency = (float)atof(optarg);        break;
+            case 'd':   outOptions.mDepth = (float)atof(optarg);            break;
+            case 'q':   outOptions.mQuiet = true;                           break;
+            case 'w':
+                if (strcmp(optarg, "sine") == 0)
+                    outOptions.mWaveform = kTremeloUnitParam_Waveform_Sine;
+                else if (strcmp(optarg, "square") == 0)
+                    outOptions.mWaveform = kTremeloUnitParam_Waveform_Square;
+                else {
+                    fprintf(stderr, "tremelo-render: unknown waveform '%s'\n", optarg);
+                    return false;
+                }
+                break;
+            case 'h':
+                PrintUsage(stdout);
+                exit(0);
+            default:
+                PrintUsage(stderr);
+                return false;
+        }
+    }
+    for (int i = optind; i < argc; ++i)
+        outOptions.mInputs.push_back(argv[i]);
+
+    if (outOptions.mOutputDirectory.empty() || outOptions.mInputs.empty()) {
+        PrintUsage(stderr);
+        return false;
+    }
+    if (outOptions.mBlockFrames == 0) {
+        fprintf(stderr, "tremelo-render: block size must be at least one frame\n");
+        return false;
+    }
+    if (outOptions.mJobs == 0)
+        outOptions.mJobs = std::thread::hardware_concurrency() ? std::thread::hardware_concurrency() : 1;
+    if (outOptions.mJobs > outOptions.mInputs.size())
+        outOptions.mJobs = (unsigned)outOptions.mInputs.size();
+    return true;
+}
+
+std::string OutputPath (const RenderOptions &inOptions, const std::string &inInput)
+{
+    size_t slash = inInput.find_last_of('/');
+    std::string name = (slash == std::string::npos) ? inInput : inInput.substr(slash + 1);
+    return inOptions.mOutputDirectory + "/" + name;
+}
+
+// Applies the command line parameters; a preset goes first so individual values override it.
+int32_t ApplyParameters (TremeloUnitRef inUnit, const RenderOptions &inOptions)
+{
+    int32_t result = 0;
+    if (inOptions.mPreset >= 0)
+        result = TremeloUnit_SetFactoryPreset(inUnit, inOptions.mPreset);
+    if (result == 0 && inOptions.mFrequency >= 0.f)
+        result = TremeloUnit_SetParameter(inUnit, kTremeloUnitParam_Frequency, inOptions.mFrequency);
+    if (result == 0 && inOptions.mDepth >= 0.f)
+        result = TremeloUnit_SetParameter(inUnit, kTremeloUnitParam_Depth, inOptions.mDepth);
+    if (result == 0 && inOptions.mWaveform >= 0.f)
+        result = TremeloUnit_SetParameter(inUnit, kTremeloUnitParam_Waveform, inOptions.mWaveform);
+    return result;
+}
+
+// Renders one file with inUnit. Returns false and fills outError on failure.
+bool RenderFile (TremeloUnitRef inUnit, const RenderOptions &inOptions, const std::string &inInput,
+                 double &outAudioSeconds, std::string &outError)
+{
+    // The same file under another name (-o . for ./in.wav, a symlink, a hard link) counts too.
+    std::string outputPath = OutputPath(inOptions, inInput);
+    struct stat inputInfo, outputInfo;
+    if (stat(inInput.c_str(), &inputInfo) == 0 && stat(outputPath.c_str(), &outputInfo) == 0 &&
+        inputInfo.st_dev == outputInfo.st_dev && inputInfo.st_ino == outputInfo.st_ino) {
+        outError = "output would overwrite the input";
+        return false;
+    }
+
+    WaveReader reader;
+    if (!reader.Open(inInput.c_str(), outError))
+        return false;
+    const WaveFormat &format = reader.Format();
+
+    int32_t result = TremeloUnit_Uninitialize(inUnit);
+    if (result == 0)
+        result = TremeloUnit_SetFormat(inUnit, format.mSampleRate, format.mChannels);
+    if (result == 0)
+        result = TremeloUnit_SetMaximumFramesPerSlice(inUnit, inOptions.mBlockFrames);
+    if (result == 0)
+        result = TremeloUnit_Initialize(inUnit);
+    if (result != 0) {
+        outError = "could not configure TremeloUnit (error " + std::to_string(result) + ")";
+        return false;
+    }
+
+    WaveWriter writer;
+    if (!writer.Open(outputPath.c_str(), format, outError))
+        return false;
+
+    // One buffer per channel, rendered in place.
+    std::vector<float> storage((size_t)format.mChannels * inOptions.mBlockFrames);
+    std::vector<float *> channels(format.mChannels);
+    for (uint32_t channel = 0; channel < format.mChannels; ++channel)
+        channels[channel] = storage.data() + (size_t)channel * inOptions.mBlockFrames;
+
+    uint32_t frames;
+    bool ok = true;
+    while (ok && (frames = reader.Read(channels.data(), inOptions.mBlockFrames)) > 0) {
+        result = TremeloUnit_Render(inUnit, channels.data(), channels.data(), frames);
+        if (result != 0) {
+            outError = "render failed (error " + std::to_string(result) + ")";
+            ok = false;
+        } else if (!writer.Write(channels.data(), frames)) {
+            ok = false;
+        }
+    }
+
+    // A failed render leaves whatever was at the output path before.
+    std::string closeError;
+    if (!ok)
+        writer.Discard();
+    else if (!writer.Close(closeError)) {
+        outError = closeError;
+        ok = false;
+    }
+    if (!ok && outError.empty())
+        outError = "write failed";
+
+    outAudioSeconds = reader.FrameCount() / format.mSampleRate;
+    return ok;
+}
+
+void Worker (const RenderOptions &inOptions, std::atomic<size_t> &ioNextInput, RenderTotals &ioTotals)
+{
+    TremeloUnitRef unit = NULL;
+    int32_t result = TremeloUnit_New(&unit);
+    if (result == 0)
+        result = ApplyParameters(unit, inOptions);
+    if (result != 0) {
+        fprintf(stderr, "tremelo-render: could not create TremeloUnit (error %d)\n", result);
+        if (unit)
+            TremeloUnit_Dispose(unit);
+        std::lock_guard<std::mutex> lock(ioTotals.mMutex);
+        ioTotals.mFailures += 1;
+        return;
+    }
+
+    size_t index;
+    while ((index = ioNextInput.fetch_add(1)) < inOptions.mInputs.size()) {
+        const std::string &input = inOptions.mInputs[index];
+        double audioSeconds = 0.;
+        std::string error;
+
+        Clock::time_point start = Clock::now();
+        bool ok = RenderFile(unit, inOptions, input, audioSeconds, error);
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        std::lock_guard<std::mutex> lock(ioTotals.mMutex);
+        ioTotals.mBusySeconds += seconds;
+        if (ok) {
+            ioTotals.mFiles += 1;
+            ioTotals.mAudioSeconds += audioSeconds;
+            if (!inOptions.mQuiet)
+                printf("%s: %.2f s of audio in %.3f s (%.1fx realtime)\n",
+                       input.c_str(), audioSeconds, seconds, seconds > 0. ? audioSeconds / seconds : 0.);
+        } else {
+            ioTotals.mFailures += 1;
+            fprintf(stderr, "tremelo-render: %s: %s\n", input.c_str(), error.c_str());
+        }
+    }
+    TremeloUnit_Dispose(unit);
+}
+
+} // namespace
+
+int main (int argc, char *argv[])
+{
+    RenderOptions options;
+    if (!ParseOptions(argc, argv, options))
+        return 2;
+
+    RenderTotals totals;
+    std::atomic<size_t> nextInput(0);
+
+    Clock::time_point start = Clock::now();
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < options.mJobs; ++i)
+        workers.emplace_back(Worker, std::cref(options), std::ref(nextInput), std::ref(totals));
+    for (std::thread &worker : workers)
+        worker.join();
+    double wallSeconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    printf("%u file(s), %.2f s of audio in %.3f s with %u worker(s): %.1fx realtime overall, %.1fx realtime per core\n",
+           totals.mFiles, totals.mAudioSeconds, wallSeconds, options.mJobs,
+           wallSeconds > 0. ? totals.mAudioSeconds / wallSeconds : 0.,
+           totals.mBusySeconds > 0. ? totals.mAudioSeconds / totals.mBusySeconds : 0.);
+    if (totals.mFailures)
+        fprintf(stderr, "tremelo-render: %u failure(s)\n", totals.mFailures);
+    return totals.mFailures ? 1 : 0;
+}
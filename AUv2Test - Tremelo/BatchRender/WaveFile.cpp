@@ -0,0 +1,504 @@
+//
+//  WaveFile.cpp
+//  TremeloAUv2
+//
+
+#include "WaveFile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if !defined(__BYTE_ORDER__) || __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+    #error "WaveFile assumes a little-endian host"
+#endif
+
+namespace {
+
+enum {
+    kWaveFormat_PCM         = 0x0001,
+    kWaveFormat_IEEEFloat   = 0x0003,
+    kWaveFormat_Extensible  = 0xFFFE
+};
+
+inline uint16_t ReadLE16 (const uint8_t *p) { uint16_t v; memcpy(&v, p, sizeof(v)); return v; }
+inline uint32_t ReadLE32 (const uint8_t *p) { uint32_t v; memcpy(&v, p, sizeof(v)); return v; }
+inline void WriteLE16 (uint8_t *p, uint16_t v) { memcpy(p, &v, sizeof(v)); }
+inline void WriteLE32 (uint8_t *p, uint32_t v) { memcpy(p, &v, sizeof(v)); }
+
+inline size_t PageSize ()
+{
+    static const size_t sPageSize = (size_t)sysconf(_SC_PAGESIZE);
+    return sPageSize;
+}
+
+inline float Clip (float inValue)
+{
+    return inValue < -1.f ? -1.f : (inValue > 1.f ? 1.f : inValue);
+}
+
+} // namespace
+
+uint32_t WaveFormat::BytesPerSample () const
+{
+    switch (mSampleType) {
+        case kInt16:    return 2;
+        case kInt24:    return 3;
+        case kInt32:    return 4;
+        case kFloat32:  return 4;
+        case kFloat64:  return 8;
+    }
+    return 0;
+}
+
+#pragma mark ____WaveReader
+
+WaveReader::WaveReader ()
+    : mFile(-1), mMap(NULL), mMapLength(0), mDataOffset(0), mFormat(), mFrameCount(0),
+      mPosition(0), mAdvisedEnd(0), mReleasedEnd(0)
+{
+}
+
+WaveReader::~WaveReader ()
+{
+    Close();
+}
+
+void WaveReader::Close ()
+{
+    if (mMap)
+        munmap(mMap, mMapLength);
+    if (mFile >= 0)
+        close(mFile);
+    mFile = -1;
+    mMap = NULL;
+    mMapLength = 0;
+    mFrameCount = mPosition = 0;
+}
+
+bool WaveReader::Open (const char *inPath, std::string &outError)
+{
+    Close();
+
+    mFile = open(inPath, O_RDONLY | O_CLOEXEC);
+    struct stat info;
+    if (mFile < 0 || fstat(mFile, &info) != 0) {
+        outError = strerror(errno);
+        Close();
+        return false;
+    }
+    if (info.st_size < 12) {
+        outError = "file too short to be a WAV file";
+        Close();
+        return false;
+    }
+
+    mMapLength = (size_t)info.st_size;
+    void *map = mmap(NULL, mMapLength, PROT_READ, MAP_PRIVATE, mFile, 0);
+    if (map == MAP_FAILED) {
+        outError = strerror(errno);
+        mMapLength = 0;
+        Close();
+        return false;
+    }
+    mMap = (uint8_t *)map;
+    madvise(mMap, mMapLength, MADV_SEQUENTIAL);
+
+    if (memcmp(mMap, "RIFF", 4) != 0 || memcmp(mMap + 8, "WAVE", 4) != 0) {
+        outError = "not a RIFF/WAVE file";
+        Close();
+        return false;
+    }
+
+    // Walk the chunk list for 'fmt ' and 'data'; chunks are padded to an even length.
+    const uint8_t *fmt = NULL;
+    uint32_t fmtSize = 0;
+    size_t dataSize = 0;
+    size_t offset = 12;
+    while (offset + 8 <= mMapLength) {
+        const uint8_t *chunk = mMap + offset;
+        uint32_t chunkSize = ReadLE32(chunk + 4);
+        if (memcmp(chunk, "fmt ", 4) == 0) {
+            fmt = chunk + 8;
+            fmtSize = chunkSize;
+        } else if (memcmp(chunk, "data", 4) == 0) {
+            mDataOffset = offset + 8;
+            // tolerate writers that leave the size at 0 or 0xFFFFFFFF when streaming
+            dataSize = (chunkSize == 0 || mDataOffset + chunkSize > mMapLength) ? mMapLength - mDataOffset : chunkSize;
+            break;
+        }
+        offset += 8 + (size_t)chunkSize + (chunkSize & 1);
+    }
+    if (fmt == NULL || fmtSize < 16 || fmt + fmtSize > mMap + mMapLength || mDataOffset == 0) {
+        outError = "missing or malformed fmt/data chunk";
+        Close();
+        return false;
+    }
+
+    uint16_t formatTag = ReadLE16(fmt);
+    uint16_t channels = ReadLE16(fmt + 2);
+    uint32_t sampleRate = ReadLE32(fmt + 4);
+    uint16_t bitsPerSample = ReadLE16(fmt + 14);
+    if (formatTag == kWaveFormat_Extensible && fmtSize >= 40)
+        formatTag = ReadLE16(fmt + 24);     // first two bytes of the SubFormat GUID
+
+    mFormat.mSampleRate = sampleRate;
+    mFormat.mChannels = channels;
+    if (formatTag == kWaveFormat_PCM && bitsPerSample == 16)
+        mFormat.mSampleType = WaveFormat::kInt16;
+    else if (formatTag == kWaveFormat_PCM && bitsPerSample == 24)
+        mFormat.mSampleType = WaveFormat::kInt24;
+    else if (formatTag == kWaveFormat_PCM && bitsPerSample == 32)
+        mFormat.mSampleType = WaveFormat::kInt32;
+    else if (formatTag == kWaveFormat_IEEEFloat && bitsPerSample == 32)
+        mFormat.mSampleType = WaveFormat::kFloat32;
+    else if (formatTag == kWaveFormat_IEEEFloat && bitsPerSample == 64)
+        mFormat.mSampleType = WaveFormat::kFloat64;
+    else {
+        outError = "unsupported sample format (format tag " + std::to_string(formatTag) + ", "
+                 + std::to_string(bitsPerSample) + " bits)";
+        Close();
+        return false;
+    }
+    if (channels == 0 || sampleRate == 0) {
+        outError = "invalid channel count or sample rate";
+        Close();
+        return false;
+    }
+
+    mFrameCount = dataSize / mFormat.BytesPerFrame();
+    mPosition = 0;
+    mAdvisedEnd = mReleasedEnd = mDataOffset & ~(PageSize() - 1);
+    AdviseWindow(mDataOffset);
+    return true;
+}
+
+// Keeps kReadAheadBytes prefetched in front of inOffset and drops the pages already
+// consumed, so a long file streams through a bounded amount of page cache per worker.
+void WaveReader::AdviseWindow (size_t inOffset)
+{
+    const size_t pageMask = ~(PageSize() - 1);
+
+    if (inOffset + kReadAheadBytes / 2 >= mAdvisedEnd && mAdvisedEnd < mMapLength) {
+        size_t start = mAdvisedEnd;
+        size_t end = (inOffset + kReadAheadBytes < mMapLength) ? inOffset + kReadAheadBytes : mMapLength;
+        if (end > start)
+            madvise(mMap + start, end - start, MADV_WILLNEED);
+        mAdvisedEnd = (end + PageSize() - 1) & pageMask;
+    }
+
+    size_t consumed = inOffset & pageMask;
+    if (consumed >= mReleasedEnd + kReadAheadBytes) {
+        madvise(mMap + mReleasedEnd, consumed - mReleasedEnd, MADV_DONTNEED);
+        mReleasedEnd = consumed;
+    }
+}
+
+uint32_t WaveReader::Read (float *const *outChannels, uint32_t inFrames)
+{
+    uint64_t remaining = mFrameCount - mPosition;
+    uint32_t frames = remaining < inFrames ? (uint32_t)remaining : inFrames;
+    if (frames == 0)
+        return 0;
+
+    const uint32_t channels = mFormat.mChannels;
+    const uint32_t bytesPerFrame = mFormat.BytesPerFrame();
+    const size_t offset = mDataOffset + mPosition * bytesPerFrame;
+    AdviseWindow(offset + (size_t)frames * bytesPerFrame);
+
+    const uint8_t *src = mMap + offset;
+    for (uint32_t channel = 0; channel < channels; ++channel) {
+        float *dest = outChannels[channel];
+        switch (mFormat.mSampleType) {
+            case WaveFormat::kInt16: {
+                const uint8_t *p = src + channel * 2;
+                for (uint32_t i = 0; i < frames; ++i, p += bytesPerFrame)
+                    dest[i] = (int16_t)ReadLE16(p) * (1.f / 32768.f);
+                break;
+            }
+            case WaveFormat::kInt24: {
+                const uint8_t *p = src + channel * 3;
+                for (uint32_t i = 0; i < frames; ++i, p += bytesPerFrame) {
+                    int32_t value = (int32_t)((uint32_t)p[0] << 8 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 24) >> 8;
+                    dest[i] = value * (1.f / 8388608.f);
+                }
+                break;
+            }
+            case WaveFormat::kInt32: {
+                const uint8_t *p = src + channel * 4;
+                for (uint32_t i = 0; i < frames; ++i, p += bytesPerFrame)
+                    dest[i] = (float)((int32_t)ReadLE32(p) * (1. / 2147483648.));
+                break;
+            }
+            case WaveFormat::kFloat32: {
+                const uint8_t *p = src + channel * 4;
+                for (uint32_t i = 0; i < frames; ++i, p += bytesPerFrame)
+                    memcpy(&dest[i], p, sizeof(float));
+                break;
+            }
+            case WaveFormat::kFloat64: {
+                const uint8_t *p = src + channel * 8;
+                for (uint32_t i = 0; i < frames; ++i, p += bytesPerFrame) {
+                    double value;
+                    memcpy(&value, p, sizeof(value));
+                    dest[i] = (float)value;
+                }
+                break;
+            }
+        }
+    }
+    mPosition += frames;
+    return frames;
+}
+
+#pragma mark ____WaveWriter
+
+WaveWriter::WaveWriter ()
+    : mFile(-1), mFormat(), mHeaderSize(0), mDataBytes(0), mFill(0), mActive(0),
+      mPendingData(NULL), mPendingSize(0), mQuit(false), mError(0)
+{
+}
+
+WaveWriter::~WaveWriter ()
+{
+    if (mFile >= 0)
+        Discard();
+}
+
+bool WaveWriter::Open (const char *inPath, const WaveFormat &inFormat, std::string &outError)
+{
+    // In the output's directory, so that Close's rename is atomic and never copies.
+    mPath = inPath;
+    mTempPath = mPath + ".XXXXXX";
+    mFile = mkostemp(&mTempPath[0], O_CLOEXEC);
+    if (mFile < 0) {
+        outError = strerror(errno);
+        return false;
+    }
+    fchmod(mFile, 0644);        // mkstemp creates it 0600; a plain open would have made it 0644
+    mFormat = inFormat;
+    mDataBytes = 0;
+    mFill = 0;
+    mActive = 0;
+    mPendingData = NULL;
+    mQuit = false;
+    mError = 0;
+
+    // RIFF header, an 18-byte fmt chunk for float (cbSize = 0) or a 16-byte one for PCM,
+    // and the data chunk header. The RIFF and data sizes are patched in Close.
+    const bool isFloat = inFormat.mSampleType == WaveFormat::kFloat32 || inFormat.mSampleType == WaveFormat::kFloat64;
+    const uint32_t fmtSize = isFloat ? 18 : 16;
+    uint8_t header[64];
+    memset(header, 0, sizeof(header));
+    memcpy(header, "RIFF", 4);
+    memcpy(header + 8, "WAVE", 4);
+    memcpy(header + 12, "fmt ", 4);
+    WriteLE32(header + 16, fmtSize);
+    WriteLE16(header + 20, isFloat ? kWaveFormat_IEEEFloat : kWaveFormat_PCM);
+    WriteLE16(header + 22, (uint16_t)inFormat.mChannels);
+    WriteLE32(header + 24, (uint32_t)lround(inFormat.mSampleRate));
+    WriteLE32(header + 28, (uint32_t)lround(inFormat.mSampleRate) * inFormat.BytesPerFrame());
+    WriteLE16(header + 32, (uint16_t)inFormat.BytesPerFrame());
+    WriteLE16(header + 34, (uint16_t)(inFormat.BytesPerSample() * 8));
+    uint8_t *data = header + 20 + fmtSize;
+    memcpy(data, "data", 4);
+    mHeaderSize = (uint32_t)(data + 8 - header);
+
+    if (write(mFile, header, mHeaderSize) != (ssize_t)mHeaderSize) {
+        outError = strerror(errno);
+        close(mFile);
+        unlink(mTempPath.c_str());
+        mFile = -1;
+        return false;
+    }
+
+    for (int i = 0; i < 2; ++i)
+        mBuffers[i].resize(kBufferBytes - kBufferBytes % inFormat.BytesPerFrame());
+    mThread = std::thread(&WaveWriter::WriterThread, this);
+    return true;
+}
+
+// Hands the fill buffer to the writer thread, first waiting for it to finish the other one.
+void WaveWriter::Submit ()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    mCondition.wait(lock, [this] { return mPendingData == NULL; });
+    mPendingData = mBuffers[mActive].data();
+    mPendingSize = mFill;
+    mDataBytes += mFill;
+    lock.unlock();
+    mCondition.notify_all();
+
+    mActive ^= 1;
+    mFill = 0;
+}
+
+void WaveWriter::WriterThread ()
+{
+    std::unique_lock<std::mutex> lock(mMutex);
+    for (;;) {
+        mCondition.wait(lock, [this] { return mPendingData != NULL || mQuit; });
+        if (mPendingData == NULL)
+            break;
+
+        const uint8_t *data = mPendingData;
+        size_t size = mPendingSize;
+        lock.unlock();
+        int error = 0;
+        while (size > 0) {
+            ssize_t written = write(mFile, data, size);
+            if (written < 0) {
+                if (errno == EINTR)
+                    continue;
+                error = errno;
+                break;
+            }
+            data += written;
+            size -= (size_t)written;
+        }
+        lock.lock();
+
+        if (error && mError == 0)
+            mError = error;
+        mPendingData = NULL;
+        mCondition.notify_all();
+    }
+}
+
+bool WaveWriter::Write (const float *const *inChannels, uint32_t inFrames)
+{
+    const uint32_t channels = mFormat.mChannels;
+    const uint32_t bytesPerFrame = mFormat.BytesPerFrame();
+
+    uint32_t done = 0;
+    while (done < inFrames) {
+        if (mError)
+            return false;
+
+        std::vector<uint8_t> &buffer = mBuffers[mActive];
+        uint32_t room = (uint32_t)((buffer.size() - mFill) / bytesPerFrame);
+        uint32_t frames = (inFrames - done < room) ? inFrames - done : room;
+        uint8_t *dest = buffer.data() + mFill;
+
+        for (uint32_t channel = 0; channel < channels; ++channel) {
+            const float *src = inChannels[channel] + done;
+            switch (mFormat.mSampleType) {
+                case WaveFormat::kInt16: {
+                    uint8_t *p = dest + channel * 2;
+                    for (uint32_t i = 0; i < frames; ++i, p += bytesPerFrame)
+                        WriteLE16(p, (uint16_t)(int16_t)lrintf(Clip(src[i]) * 32767.f));
+                    break;
+                }
+                case WaveFormat::kInt24: {
+                    uint8_t *p = dest + channel * 3;
+                    for (uint32_t i = 0; i < frames; ++i, p += bytesPerFrame) {
+                        int32_t value = (int32_t)lrintf(Clip(src[i]) * 8388607.f);
+                        p[0] = (uint8_t)value;
+                        p[1] = (uint8_t)(value >> 8);
+                        p[2] = (uint8_t)(value >> 16);
+                    }
+                    break;
+                }
+                case WaveFormat::kInt32: {
+                    uint8_t *p = dest + channel * 4;
+                    for (uint32_t i = 0; i < frames; ++i, p += bytesPerFrame)
+                        WriteLE32(p, (uint32_t)(int32_t)lrint(Clip(src[i]) * 2147483647.));
+                    break;
+                }
+                case WaveFormat::kFloat32: {
+                    uint8_t *p = dest + channel * 4;
+                    for (uint32_t i = 0; i < frames; ++i, p += bytesPerFrame)
+                        memcpy(p, &src[i], sizeof(float));
+                    break;
+                }
+                case WaveFormat::kFloat64: {
+                    uint8_t *p = dest + channel * 8;
+                    for (uint32_t i = 0; i < frames; ++i, p += bytesPerFrame) {
+                        double value = src[i];
+                        memcpy(p, &value, sizeof(value));
+                    }
+                    break;
+                }
+            }
+        }
+
+        mFill += (size_t)frames * bytesPerFrame;
+        done += frames;
+        if (mFill == buffer.size())
+            Submit();
+    }
+    return true;
+}
+
+void WaveWriter::StopWriterThread ()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mQuit = true;
+    }
+    mCondition.notify_all();
+    mThread.join();
+}
+
+bool WaveWriter::Close (std::string &outError)
+{
+    if (mFile < 0)
+        return false;
+
+    if (mFill > 0)
+        Submit();
+    StopWriterThread();
+
+    bool ok = mError == 0;
+    if (!ok)
+        outError = strerror(mError);
+
+    // Patch the RIFF and data chunk sizes (and add the pad byte for an odd data length).
+    if (ok && mHeaderSize + mDataBytes + (mDataBytes & 1) > UINT32_MAX) {
+        outError = "output exceeds the 4 GB WAV limit";
+        ok = false;
+    }
+    if (ok) {
+        uint8_t size[4];
+        uint8_t pad = 0;
+        if ((mDataBytes & 1) && write(mFile, &pad, 1) != 1)
+            ok = false;
+        WriteLE32(size, (uint32_t)(mHeaderSize - 8 + mDataBytes + (mDataBytes & 1)));
+        if (ok && pwrite(mFile, size, 4, 4) != 4)
+            ok = false;
+        WriteLE32(size, (uint32_t)mDataBytes);
+        if (ok && pwrite(mFile, size, 4, mHeaderSize - 4) != 4)
+            ok = false;
+        if (!ok)
+            outError = strerror(errno);
+    }
+    if (close(mFile) != 0 && ok) {
+        outError = strerror(errno);
+        ok = false;
+    }
+    if (ok && rename(mTempPath.c_str(), mPath.c_str()) != 0) {
+        outError = strerror(errno);
+        ok = false;
+    }
+    if (!ok)
+        unlink(mTempPath.c_str());
+    mFile = -1;
+    return ok;
+}
+
+void WaveWriter::Discard ()
+{
+    if (mFile < 0)
+        return;
+
+    StopWriterThread();
+    close(mFile);
+    unlink(mTempPath.c_str());
+    mFile = -1;
+}
@@ -0,0 +1,131 @@
+//
+//  WaveFile.h
+//  TremeloAUv2
+//
+//  Streaming WAV I/O for the offline renderer. WaveReader maps the input
+//  file and walks it with a sliding read-ahead window, so a render worker
+//  never blocks on read(2); WaveWriter converts into one buffer while a
+//  background thread writes the other. Both exchange audio as
+//  non-interleaved float, one pointer per channel, to match TremeloUnit_Render.
+//
+//  Supported: RIFF/WAVE with 16/24/32-bit integer or 32/64-bit float PCM
+//  (plain or WAVE_FORMAT_EXTENSIBLE), little-endian hosts, files < 4 GB.
+//
+
+#ifndef WaveFile_h
+#define WaveFile_h
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#pragma mark ____WaveFormat
+
+struct WaveFormat {
+    enum SampleType {
+        kInt16,
+        kInt24,
+        kInt32,
+        kFloat32,
+        kFloat64
+    };
+
+    double      mSampleRate;
+    uint32_t    mChannels;
+    SampleType  mSampleType;
+
+    uint32_t    BytesPerSample () const;
+    uint32_t    BytesPerFrame () const { return BytesPerSample() * mChannels; }
+};
+
+#pragma mark ____WaveReader
+
+class WaveReader {
+public:
+    WaveReader ();
+    ~WaveReader ();
+
+    /// Maps the file and parses its header. On failure returns false and fills outError.
+    bool                Open (const char *inPath, std::string &outError);
+    void                Close ();
+
+    const WaveFormat &  Format () const     { return mFormat; }
+    uint64_t            FrameCount () const { return mFrameCount; }
+
+    /// Converts up to inFrames frames into outChannels and advances the read position.
+    /// Returns the number of frames produced, 0 at the end of the file.
+    uint32_t            Read (float *const *outChannels, uint32_t inFrames);
+
+private:
+    void                AdviseWindow (size_t inOffset);
+
+    enum { kReadAheadBytes = 4 * 1024 * 1024 };    // prefetched ahead of the read position
+
+    int                 mFile;
+    uint8_t *           mMap;
+    size_t              mMapLength;
+    size_t              mDataOffset;        // byte offset of the first frame in the map
+    WaveFormat          mFormat;
+    uint64_t            mFrameCount;
+    uint64_t            mPosition;          // in frames
+    size_t              mAdvisedEnd;        // map offset up to which MADV_WILLNEED has been issued
+    size_t              mReleasedEnd;       // map offset below which pages have been dropped
+};
+
+#pragma mark ____WaveWriter
+
+class WaveWriter {
+public:
+    WaveWriter ();
+    ~WaveWriter ();
+
+    /// Creates a temporary file next to inPath and writes a header with placeholder sizes.
+    /// inPath itself is only replaced by a successful Close, so a file that is still being read
+    /// (even through another name for it) is never truncated.
+    bool                Open (const char *inPath, const WaveFormat &inFormat, std::string &outError);
+
+    /// Converts inFrames frames from inChannels into the fill buffer, handing it to the
+    /// writer thread whenever it is full. Returns false once a write has failed.
+    bool                Write (const float *const *inChannels, uint32_t inFrames);
+
+    /// Flushes the remaining audio, patches the header sizes, closes the file and renames it
+    /// to the path given to Open. On failure the temporary file is removed.
+    bool                Close (std::string &outError);
+
+    /// Stops writing and removes the temporary file, leaving the path given to Open as it was.
+    /// The destructor does this for a writer that was not closed.
+    void                Discard ();
+
+private:
+    void                Submit ();
+    void                WriterThread ();
+    void                StopWriterThread ();
+
+    enum { kBufferBytes = 1024 * 1024 };
+
+    int                     mFile;
+    std::string             mPath;
+    std::string             mTempPath;      // where the file is written until Close renames it
+    WaveFormat              mFormat;
+    uint32_t                mHeaderSize;
+    uint64_t                mDataBytes;
+
+    std::vector<uint8_t>    mBuffers[2];
+    size_t                  mFill;          // bytes used in mBuffers[mActive]
+    int                     mActive;        // buffer being filled by the render thread
+
+    std::thread             mThread;
+    std::mutex              mMutex;
+    std::condition_variable mCondition;
+    const uint8_t *         mPendingData;   // buffer owned by the writer thread, NULL when idle
+    size_t                  mPendingSize;
+    bool                    mQuit;
+    int                     mError;         // errno of the first failed write
+};
+
+#endif /* WaveFile_h */
@@ -0,0 +1,271 @@
+//
+//  AudioComponent.cpp
+//  TremeloAUv2
+//
+//  In-process AudioComponent registry and AudioUnit host entry points for the
+//  portable build. Each AudioUnit* call looks the selector up in the plug-in's
+//  dispatch table and forwards to it, the same path AudioToolbox takes for an
+//  AudioComponentPlugInInterface on macOS.
+//
+
+#include "AudioUnit.h"
+
+#include <mutex>
+#include <new>
+#include <vector>
+
+struct OpaqueAudioComponent {
+    AudioComponentDescription       mDescription;
+    CFStringRef                     mName;
+    UInt32                          mVersion;
+    AudioComponentFactoryFunction   mFactory;
+};
+
+struct ComponentInstanceRecord {
+    AudioComponent                  mComponent;
+    AudioComponentPlugInInterface * mPlugIn;
+};
+
+#pragma mark ____Registry
+
+static std::mutex &RegistryLock()
+{
+    static std::mutex *sLock = new std::mutex;
+    return *sLock;
+}
+
+static std::vector<AudioComponent> &Registry()
+{
+    static std::vector<AudioComponent> *sRegistry = new std::vector<AudioComponent>;
+    return *sRegistry;
+}
+
+/// Zero fields in inDesc are wildcards, as with AudioComponentFindNext on macOS.
+static bool MatchesDescription(const AudioComponentDescription &inDesc, const AudioComponentDescription &inCandidate)
+{
+    return (inDesc.componentType == 0 || inDesc.componentType == inCandidate.componentType)
+        && (inDesc.componentSubType == 0 || inDesc.componentSubType == inCandidate.componentSubType)
+        && (inDesc.componentManufacturer == 0 || inDesc.componentManufacturer == inCandidate.componentManufacturer);
+}
+
+AudioComponent AudioComponentRegister(const AudioComponentDescription *inDesc, CFStringRef inName, UInt32 inVersion, AudioComponentFactoryFunction inFactory)
+{
+    if (inDesc == NULL || inFactory == NULL)
+        return NULL;
+
+    std::lock_guard<std::mutex> lock(RegistryLock());
+    for (AudioComponent comp : Registry()) {
+        const AudioComponentDescription &desc = comp->mDescription;
+        if (desc.componentType == inDesc->componentType && desc.componentSubType == inDesc->componentSubType
+            && desc.componentManufacturer == inDesc->componentManufacturer)
+            return comp;    // registering the same component twice is harmless
+    }
+
+    AudioComponent comp = new OpaqueAudioComponent;
+    comp->mDescription = *inDesc;
+    comp->mName = inName ? (CFStringRef)CFRetain(inName) : NULL;
+    comp->mVersion = inVersion;
+    comp->mFactory = inFactory;
+    Registry().push_back(comp);
+    return comp;
+}
+
+AudioComponent AudioComponentFindNext(AudioComponent inComponent, const AudioComponentDescription *inDesc)
+{
+    if (inDesc == NULL)
+        return NULL;
+
+    std::lock_guard<std::mutex> lock(RegistryLock());
+    std::vector<AudioComponent> &registry = Registry();
+    bool searching = (inComponent == NULL);
+    for (AudioComponent comp : registry) {
+        if (!searching) {
+            searching = (comp == inComponent);
+            continue;
+        }
+        if (MatchesDescription(*inDesc, comp->mDescription))
+            return comp;
+    }
+    return NULL;
+}
+
+UInt32 AudioComponentCount(const AudioComponentDescription *inDesc)
+{
+    if (inDesc == NULL)
+        return 0;
+
+    std::lock_guard<std::mutex> lock(RegistryLock());
+    UInt32 count = 0;
+    for (AudioComponent comp : Registry())
+        if (MatchesDescription(*inDesc, comp->mDescription))
+            ++count;
+    return count;
+}
+
+OSStatus AudioComponentCopyName(AudioComponent inComponent, CFStringRef *outName)
+{
+    if (inComponent == NULL || outName == NULL)
+        return kAudio_ParamError;
+    *outName = inComponent->mName ? (CFStringRef)CFRetain(inComponent->mName) : NULL;
+    return noErr;
+}
+
+OSStatus AudioComponentGetDescription(AudioComponent inComponent, AudioComponentDescription *outDesc)
+{
+    if (inComponent == NULL || outDesc == NULL)
+        return kAudio_ParamError;
+    *outDesc = inComponent->mDescription;
+    return noErr;
+}
+
+OSStatus AudioComponentGetVersion(AudioComponent inComponent, UInt32 *outVersion)
+{
+    if (inComponent == NULL || outVersion == NULL)
+        return kAudio_ParamError;
+    *outVersion = inComponent->mVersion;
+    return noErr;
+}
+
+#pragma mark ____Instances
+
+OSStatus AudioComponentInstanceNew(AudioComponent inComponent, AudioComponentInstance *outInstance)
+{
+    if (inComponent == NULL || outInstance == NULL)
+        return kAudio_ParamError;
+    *outInstance = NULL;
+
+    AudioComponentPlugInInterface *plugIn = (*inComponent->mFactory)(&inComponent->mDescription);
+    if (plugIn == NULL)
+        return kAudio_MemFullError;
+
+    ComponentInstanceRecord *instance = new (std::nothrow) ComponentInstanceRecord;
+    if (instance == NULL)
+        return kAudio_MemFullError;
+    instance->mComponent = inComponent;
+    instance->mPlugIn = plugIn;
+
+    // Open constructs the implementation object and releases the plug-in storage itself on failure.
+    OSStatus result = (*plugIn->Open)(plugIn, instance);
+    if (result) {
+        delete instance;
+        return result;
+    }
+    *outInstance = instance;
+    return noErr;
+}
+
+OSStatus AudioComponentInstanceDispose(AudioComponentInstance inInstance)
+{
+    if (inInstance == NULL)
+        return kAudio_ParamError;
+    OSStatus result = (*inInstance->mPlugIn->Close)(inInstance->mPlugIn);
+    delete inInstance;
+    return result;
+}
+
+AudioComponent AudioComponentInstanceGetComponent(AudioComponentInstance inInstance)
+{
+    return inInstance ? inInstance->mComponent : NULL;
+}
+
+Boolean AudioComponentInstanceCanDo(AudioComponentInstance inInstance, SInt16 inSelectorID)
+{
+    return inInstance && (*inInstance->mPlugIn->Lookup)(inSelectorID) != NULL;
+}
+
+#pragma mark ____AudioUnit Dispatch
+
+template <class Proc>
+static inline Proc LookupMethod(AudioUnit inUnit, SInt16 inSelector)
+{
+    return inUnit ? reinterpret_cast<Proc>((*inUnit->mPlugIn->Lookup)(inSelector)) : NULL;
+}
+
+#define AU_DISPATCH(ProcType, selector, ...)                            \
+    ProcType method = LookupMethod<ProcType>(inUnit, selector);         \
+    if (method == NULL)                                                 \
+        return inUnit ? kAudio_UnimplementedError : kAudio_ParamError;  \
+    return (*method)(inUnit->mPlugIn, ## __VA_ARGS__);
+
+OSStatus AudioUnitInitialize(AudioUnit inUnit)
+{
+    AU_DISPATCH(AudioUnitInitializeProc, kAudioUnitInitializeSelect)
+}
+
+OSStatus AudioUnitUninitialize(AudioUnit inUnit)
+{
+    AU_DISPATCH(AudioUnitUninitializeProc, kAudioUnitUninitializeSelect)
+}
+
+OSStatus AudioUnitGetPropertyInfo(AudioUnit inUnit, AudioUnitPropertyID inID, AudioUnitScope inScope, AudioUnitElement inElement,
+                                  UInt32 *outDataSize, Boolean *outWritable)
+{
+    AU_DISPATCH(AudioUnitGetPropertyInfoProc, kAudioUnitGetPropertyInfoSelect, inID, inScope, inElement, outDataSize, outWritable)
+}
+
+OSStatus AudioUnitGetProperty(AudioUnit inUnit, AudioUnitPropertyID inID, AudioUnitScope inScope, AudioUnitElement inElement,
+                              void *outData, UInt32 *ioDataSize)
+{
+    AU_DISPATCH(AudioUnitGetPropertyProc, kAudioUnitGetPropertySelect, inID, inScope, inElement, outData, ioDataSize)
+}
+
+OSStatus AudioUnitSetProperty(AudioUnit inUnit, AudioUnitPropertyID inID, AudioUnitScope inScope, AudioUnitElement inElement,
+                              const void *inData, UInt32 inDataSize)
+{
+    AU_DISPATCH(AudioUnitSetPropertyProc, kAudioUnitSetPropertySelect, inID, inScope, inElement, inData, inDataSize)
+}
+
+OSStatus AudioUnitAddPropertyListener(AudioUnit inUnit, AudioUnitPropertyID inID, AudioUnitPropertyListenerProc inProc, void *inProcUserData)
+{
+    AU_DISPATCH(AudioUnitAddPropertyListenerProc, kAudioUnitAddPropertyListenerSelect, inID, inProc, inProcUserData)
+}
+
+OSStatus AudioUnitRemovePropertyListenerWithUserData(AudioUnit inUnit, AudioUnitPropertyID inID, AudioUnitPropertyListenerProc inProc,
+                                                     void *inProcUserData)
+{
+    AU_DISPATCH(AudioUnitRemovePropertyListenerWithUserDataProc, kAudioUnitRemovePropertyListenerWithUserDataSelect, inID, inProc, inProcUserData)
+}
+
+OSStatus AudioUnitAddRenderNotify(AudioUnit inUnit, AURenderCallback inProc, void *inProcUserData)
+{
+    AU_DISPATCH(AudioUnitAddRenderNotifyProc, kAudioUnitAddRenderNotifySelect, inProc, inProcUserData)
+}
+
+OSStatus AudioUnitRemoveRenderNotify(AudioUnit inUnit, AURenderCallback inProc, void *inProcUserData)
+{
+    AU_DISPATCH(AudioUnitRemoveRenderNotifyProc, kAudioUnitRemoveRenderNotifySelect, inProc, inProcUserData)
+}
+
+OSStatus AudioUnitGetParameter(AudioUnit inUnit, AudioUnitParameterID inID, AudioUnitScope inScope, AudioUnitElement inElement,
+                               AudioUnitParameterValue *outValue)
+{
+    AU_DISPATCH(AudioUnitGetParameterProc, kAudioUnitGetParameterSelect, inID, inScope, inElement, outValue)
+}
+
+OSStatus AudioUnitSetParameter(AudioUnit inUnit, AudioUnitParameterID inID, AudioUnitScope inScope, AudioUnitElement inElement,
+                               AudioUnitParameterValue inValue, UInt32 inBufferOffsetInFrames)
+{
+    AU_DISPATCH(AudioUnitSetParameterProc, kAudioUnitSetParameterSelect, inID, inScope, inElement, inValue, inBufferOffsetInFrames)
+}
+
+OSStatus AudioUnitScheduleParameters(AudioUnit inUnit, const AudioUnitParameterEvent *inParameterEvent, UInt32 inNumParamEvents)
+{
+    AU_DISPATCH(AudioUnitScheduleParametersProc, kAudioUnitScheduleParametersSelect, inParameterEvent, inNumParamEvents)
+}
+
+OSStatus AudioUnitRender(AudioUnit inUnit, AudioUnitRenderActionFlags *ioActionFlags, const AudioTimeStamp *inTimeStamp,
+                         UInt32 inOutputBusNumber, UInt32 inNumberFrames, AudioBufferList *ioData)
+{
+    AU_DISPATCH(AudioUnitRenderProc, kAudioUnitRenderSelect, ioActionFlags, inTimeStamp, inOutputBusNumber, inNumberFrames, ioData)
+}
+
+OSStatus AudioUnitProcess(AudioUnit inUnit, AudioUnitRenderActionFlags *ioActionFlags, const AudioTimeStamp *inTimeStamp,
+                          UInt32 inNumberFrames, AudioBufferList *ioData)
+{
+    AU_DISPATCH(AudioUnitProcessProc, kAudioUnitProcessSelect, ioActionFlags, inTimeStamp, inNumberFrames, ioData)
+}
+
+OSStatus AudioUnitReset(AudioUnit inUnit, AudioUnitScope inScope, AudioUnitElement inElement)
+{
+    AU_DISPATCH(AudioUnitResetProc, kAudioUnitResetSelect, inScope, inElement)
+}
@@ -0,0 +1,66 @@
+//
+//  AudioComponent.h
+//  TremeloAUv2
+//
+//  Portable subset of <AudioToolbox/AudioComponent.h>. Components are
+//  registered in-process with AudioComponentRegister (there is no bundle
+//  scanning off macOS) and then found and instantiated exactly as on the Mac.
+//
+
+#ifndef AudioComponent_h
+#define AudioComponent_h
+
+#include "CoreAudioTypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Component Manager result type, still used by AU subclasses for their overrides. */
+typedef SInt32 ComponentResult;
+
+typedef UInt32 AudioComponentFlags;
+enum {
+    kAudioComponentFlag_Unsearchable    = 1,
+    kAudioComponentFlag_SandboxSafe     = 2
+};
+
+typedef struct AudioComponentDescription {
+    OSType  componentType;
+    OSType  componentSubType;
+    OSType  componentManufacturer;
+    UInt32  componentFlags;
+    UInt32  componentFlagsMask;
+} AudioComponentDescription;
+
+typedef struct OpaqueAudioComponent *           AudioComponent;
+typedef struct ComponentInstanceRecord *        AudioComponentInstance;
+
+typedef OSStatus (*AudioComponentMethod)(void *self, ...);
+
+typedef struct AudioComponentPlugInInterface {
+    OSStatus                (*Open)(void *self, AudioComponentInstance mInstance);
+    OSStatus                (*Close)(void *self);
+    AudioComponentMethod    (*Lookup)(SInt16 selector);
+    void *                  reserved;
+} AudioComponentPlugInInterface;
+
+typedef AudioComponentPlugInInterface * (*AudioComponentFactoryFunction)(const AudioComponentDescription *inDesc);
+
+AudioComponent  AudioComponentRegister(const AudioComponentDescription *inDesc, CFStringRef inName, UInt32 inVersion, AudioComponentFactoryFunction inFactory);
+AudioComponent  AudioComponentFindNext(AudioComponent inComponent, const AudioComponentDescription *inDesc);
+UInt32          AudioComponentCount(const AudioComponentDescription *inDesc);
+OSStatus        AudioComponentCopyName(AudioComponent inComponent, CFStringRef *outName);
+OSStatus        AudioComponentGetDescription(AudioComponent inComponent, AudioComponentDescription *outDesc);
+OSStatus        AudioComponentGetVersion(AudioComponent inComponent, UInt32 *outVersion);
+
+OSStatus        AudioComponentInstanceNew(AudioComponent inComponent, AudioComponentInstance *outInstance);
+OSStatus        AudioComponentInstanceDispose(AudioComponentInstance inInstance);
+AudioComponent  AudioComponentInstanceGetComponent(AudioComponentInstance inInstance);
+Boolean         AudioComponentInstanceCanDo(AudioComponentInstance inInstance, SInt16 inSelectorID);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* AudioComponent_h */
@@ -0,0 +1,16 @@
+//
+//  AudioUnit.h
+//  TremeloAUv2
+//
+//  Umbrella header standing in for <AudioUnit/AudioUnit.h> in the portable
+//  build.
+//
+
+#ifndef AudioUnit_h
+#define AudioUnit_h
+
+#include "AudioComponent.h"
+#include "AUComponent.h"
+#include "AudioUnitProperties.h"
+
+#endif /* AudioUnit_h */
@@ -0,0 +1,36 @@
+//
+//  BSDCompat.h
+//  TremeloAUv2
+//
+//  BSD libc extensions the Core Audio Utility Classes rely on that glibc only
+//  gained recently (strlcpy/strlcat arrived in glibc 2.38).
+//
+
+#ifndef BSDCompat_h
+#define BSDCompat_h
+
+#include <stdio.h>
+#include <string.h>
+
+#if defined(__GLIBC__) && !(__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 38))
+static inline size_t strlcpy(char *dst, const char *src, size_t size)
+{
+    size_t srcLen = strlen(src);
+    if (size != 0) {
+        size_t n = (srcLen >= size) ? size - 1 : srcLen;
+        memcpy(dst, src, n);
+        dst[n] = 0;
+    }
+    return srcLen;
+}
+
+static inline size_t strlcat(char *dst, const char *src, size_t size)
+{
+    size_t dstLen = strnlen(dst, size);
+    if (dstLen == size)
+        return size + strlen(src);
+    return dstLen + strlcpy(dst + dstLen, src, size - dstLen);
+}
+#endif
+
+#endif /* BSDCompat_h */
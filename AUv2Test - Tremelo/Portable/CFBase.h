@@ -0,0 +1,60 @@
+//
+//  CFBase.h
+//  TremeloAUv2
+//
+//  Portable subset of CoreFoundation's base types. Objects are reference
+//  counted exactly as in CF: anything returned by a Create or Copy function
+//  must be balanced with CFRelease.
+//
+
+#ifndef CFBase_h
+#define CFBase_h
+
+#include "MacTypes.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef long                            CFIndex;
+typedef unsigned long                   CFTypeID;
+typedef unsigned long                   CFOptionFlags;
+typedef unsigned long                   CFHashCode;
+
+typedef const void *                    CFTypeRef;
+typedef CFTypeRef                       CFPropertyListRef;
+
+typedef const struct __CFAllocator *    CFAllocatorRef;
+typedef const struct __CFString *       CFStringRef;
+typedef struct __CFString *             CFMutableStringRef;
+typedef const struct __CFArray *        CFArrayRef;
+typedef struct __CFArray *              CFMutableArrayRef;
+typedef const struct __CFDictionary *   CFDictionaryRef;
+typedef struct __CFDictionary *         CFMutableDictionaryRef;
+typedef const struct __CFData *         CFDataRef;
+typedef struct __CFData *               CFMutableDataRef;
+typedef const struct __CFNumber *       CFNumberRef;
+typedef const struct __CFURL *          CFURLRef;
+
+typedef struct {
+    CFIndex location;
+    CFIndex length;
+} CFRange;
+
+static inline CFRange CFRangeMake(CFIndex loc, CFIndex len) { CFRange r = { loc, len }; return r; }
+
+/* Allocators are accepted for source compatibility and otherwise ignored. */
+#define kCFAllocatorDefault     ((CFAllocatorRef)NULL)
+
+CFTypeRef   CFRetain(CFTypeRef cf);
+void        CFRelease(CFTypeRef cf);
+CFIndex     CFGetRetainCount(CFTypeRef cf);
+CFTypeID    CFGetTypeID(CFTypeRef cf);
+Boolean     CFEqual(CFTypeRef cf1, CFTypeRef cf2);
+CFHashCode  CFHash(CFTypeRef cf);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CFBase_h */
@@ -0,0 +1,72 @@
+//
+//  CFByteOrder.h
+//  TremeloAUv2
+//
+//  Portable subset of CoreFoundation's byte swapping helpers.
+//
+
+#ifndef CFByteOrder_h
+#define CFByteOrder_h
+
+#include "CFBase.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum __CFByteOrder {
+    CFByteOrderUnknown,
+    CFByteOrderLittleEndian,
+    CFByteOrderBigEndian
+};
+typedef CFIndex CFByteOrder;
+
+typedef struct { uint32_t v; } CFSwappedFloat32;
+typedef struct { uint64_t v; } CFSwappedFloat64;
+
+static inline CFByteOrder CFByteOrderGetCurrent(void)
+{
+#if TARGET_RT_BIG_ENDIAN
+    return CFByteOrderBigEndian;
+#else
+    return CFByteOrderLittleEndian;
+#endif
+}
+
+static inline uint16_t CFSwapInt16(uint16_t arg) { return __builtin_bswap16(arg); }
+static inline uint32_t CFSwapInt32(uint32_t arg) { return __builtin_bswap32(arg); }
+static inline uint64_t CFSwapInt64(uint64_t arg) { return __builtin_bswap64(arg); }
+
+#if TARGET_RT_BIG_ENDIAN
+static inline uint16_t CFSwapInt16BigToHost(uint16_t arg)    { return arg; }
+static inline uint32_t CFSwapInt32BigToHost(uint32_t arg)    { return arg; }
+static inline uint64_t CFSwapInt64BigToHost(uint64_t arg)    { return arg; }
+static inline uint16_t CFSwapInt16HostToBig(uint16_t arg)    { return arg; }
+static inline uint32_t CFSwapInt32HostToBig(uint32_t arg)    { return arg; }
+static inline uint64_t CFSwapInt64HostToBig(uint64_t arg)    { return arg; }
+static inline uint16_t CFSwapInt16LittleToHost(uint16_t arg) { return CFSwapInt16(arg); }
+static inline uint32_t CFSwapInt32LittleToHost(uint32_t arg) { return CFSwapInt32(arg); }
+static inline uint64_t CFSwapInt64LittleToHost(uint64_t arg) { return CFSwapInt64(arg); }
+static inline uint16_t CFSwapInt16HostToLittle(uint16_t arg) { return CFSwapInt16(arg); }
+static inline uint32_t CFSwapInt32HostToLittle(uint32_t arg) { return CFSwapInt32(arg); }
+static inline uint64_t CFSwapInt64HostToLittle(uint64_t arg) { return CFSwapInt64(arg); }
+#else
+static inline uint16_t CFSwapInt16BigToHost(uint16_t arg)    { return CFSwapInt16(arg); }
+static inline uint32_t CFSwapInt32BigToHost(uint32_t arg)    { return CFSwapInt32(arg); }
+static inline uint64_t CFSwapInt64BigToHost(uint64_t arg)    { return CFSwapInt64(arg); }
+static inline uint16_t CFSwapInt16HostToBig(uint16_t arg)    { return CFSwapInt16(arg); }
+static inline uint32_t CFSwapInt32HostToBig(uint32_t arg)    { return CFSwapInt32(arg); }
+static inline uint64_t CFSwapInt64HostToBig(uint64_t arg)    { return CFSwapInt64(arg); }
+static inline uint16_t CFSwapInt16LittleToHost(uint16_t arg) { return arg; }
+static inline uint32_t CFSwapInt32LittleToHost(uint32_t arg) { return arg; }
+static inline uint64_t CFSwapInt64LittleToHost(uint64_t arg) { return arg; }
+static inline uint16_t CFSwapInt16HostToLittle(uint16_t arg) { return arg; }
+static inline uint32_t CFSwapInt32HostToLittle(uint32_t arg) { return arg; }
+static inline uint64_t CFSwapInt64HostToLittle(uint64_t arg) { return arg; }
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CFByteOrder_h */
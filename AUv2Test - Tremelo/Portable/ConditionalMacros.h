@@ -0,0 +1,14 @@
+//
+//  ConditionalMacros.h
+//  TremeloAUv2
+//
+//  Stand-in for the Carbon header of the same name; the portable build only
+//  needs the target conditionals it pulls in.
+//
+
+#ifndef ConditionalMacros_h
+#define ConditionalMacros_h
+
+#include <TargetConditionals.h>
+
+#endif /* ConditionalMacros_h */
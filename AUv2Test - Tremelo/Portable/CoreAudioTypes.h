@@ -0,0 +1,222 @@
+//
+//  CoreAudioTypes.h
+//  TremeloAUv2
+//
+//  Portable subset of <CoreAudio/CoreAudioTypes.h>. Layouts and constant
+//  values match the Apple SDK so that buffers, stream formats and time stamps
+//  can be handed across the C API unchanged.
+//
+
+#ifndef CoreAudioTypes_h
+#define CoreAudioTypes_h
+
+#include "CoreFoundation.h"
+
+#define COREAUDIOTYPES_VERSION 1051
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma mark ____General Errors
+
+enum {
+    kAudio_UnimplementedError   = -4,
+    kAudio_FileNotFoundError    = -43,
+    kAudio_FilePermissionError  = -54,
+    kAudio_TooManyFilesOpenError = -42,
+    kAudio_BadFilePathError     = '!pth',
+    kAudio_ParamError           = -50,
+    kAudio_MemFullError         = -108
+};
+
+#pragma mark ____AudioValueRange
+
+typedef struct AudioValueRange {
+    Float64 mMinimum;
+    Float64 mMaximum;
+} AudioValueRange;
+
+#pragma mark ____AudioBuffer
+
+typedef struct AudioBuffer {
+    UInt32  mNumberChannels;
+    UInt32  mDataByteSize;
+    void *  mData;
+} AudioBuffer;
+
+typedef struct AudioBufferList {
+    UInt32      mNumberBuffers;
+    AudioBuffer mBuffers[1]; // this is a variable length array of mNumberBuffers elements
+} AudioBufferList;
+
+#pragma mark ____Sample Types
+
+typedef Float32     AudioSampleType;
+typedef Float32     AudioUnitSampleType;
+#define kAudioUnitSampleFractionBits 24
+
+#pragma mark ____AudioStreamBasicDescription
+
+typedef UInt32  AudioFormatID;
+typedef UInt32  AudioFormatFlags;
+
+typedef struct AudioStreamBasicDescription {
+    Float64             mSampleRate;
+    AudioFormatID       mFormatID;
+    AudioFormatFlags    mFormatFlags;
+    UInt32              mBytesPerPacket;
+    UInt32              mFramesPerPacket;
+    UInt32              mBytesPerFrame;
+    UInt32              mChannelsPerFrame;
+    UInt32              mBitsPerChannel;
+    UInt32              mReserved;
+} AudioStreamBasicDescription;
+
+#define kAudioStreamAnyRate 0.0
+
+enum {
+    kAudioFormatLinearPCM               = 'lpcm',
+    kAudioFormatAC3                     = 'ac-3',
+    kAudioFormat60958AC3                = 'cac3',
+    kAudioFormatAppleIMA4               = 'ima4',
+    kAudioFormatMPEG4AAC                = 'aac ',
+    kAudioFormatAppleLossless           = 'alac',
+    kAudioFormatULaw                    = 'ulaw',
+    kAudioFormatALaw                    = 'alaw'
+};
+
+enum {
+    kAudioFormatFlagIsFloat                     = (1U << 0),
+    kAudioFormatFlagIsBigEndian                 = (1U << 1),
+    kAudioFormatFlagIsSignedInteger             = (1U << 2),
+    kAudioFormatFlagIsPacked                    = (1U << 3),
+    kAudioFormatFlagIsAlignedHigh               = (1U << 4),
+    kAudioFormatFlagIsNonInterleaved            = (1U << 5),
+    kAudioFormatFlagIsNonMixable                = (1U << 6),
+    kAudioFormatFlagsAreAllClear                = 0x80000000,
+
+    kLinearPCMFormatFlagIsFloat                 = kAudioFormatFlagIsFloat,
+    kLinearPCMFormatFlagIsBigEndian             = kAudioFormatFlagIsBigEndian,
+    kLinearPCMFormatFlagIsSignedInteger         = kAudioFormatFlagIsSignedInteger,
+    kLinearPCMFormatFlagIsPacked                = kAudioFormatFlagIsPacked,
+    kLinearPCMFormatFlagIsAlignedHigh           = kAudioFormatFlagIsAlignedHigh,
+    kLinearPCMFormatFlagIsNonInterleaved        = kAudioFormatFlagIsNonInterleaved,
+    kLinearPCMFormatFlagIsNonMixable            = kAudioFormatFlagIsNonMixable,
+    kLinearPCMFormatFlagsSampleFractionShift    = 7,
+    kLinearPCMFormatFlagsSampleFractionMask     = (0x3F << kLinearPCMFormatFlagsSampleFractionShift),
+    kLinearPCMFormatFlagsAreAllClear            = kAudioFormatFlagsAreAllClear,
+
+    kAppleLosslessFormatFlag_16BitSourceData    = 1,
+    kAppleLosslessFormatFlag_20BitSourceData    = 2,
+    kAppleLosslessFormatFlag_24BitSourceData    = 3,
+    kAppleLosslessFormatFlag_32BitSourceData    = 4
+};
+
+enum {
+#if TARGET_RT_BIG_ENDIAN
+    kAudioFormatFlagsNativeEndian       = kAudioFormatFlagIsBigEndian,
+#else
+    kAudioFormatFlagsNativeEndian       = 0,
+#endif
+    kAudioFormatFlagsCanonical          = kAudioFormatFlagIsFloat | kAudioFormatFlagsNativeEndian | kAudioFormatFlagIsPacked,
+    kAudioFormatFlagsAudioUnitCanonical = kAudioFormatFlagIsFloat | kAudioFormatFlagsNativeEndian | kAudioFormatFlagIsPacked | kAudioFormatFlagIsNonInterleaved,
+    kAudioFormatFlagsNativeFloatPacked  = kAudioFormatFlagIsFloat | kAudioFormatFlagsNativeEndian | kAudioFormatFlagIsPacked
+};
+
+typedef struct AudioStreamPacketDescription {
+    SInt64  mStartOffset;
+    UInt32  mVariableFramesInPacket;
+    UInt32  mDataByteSize;
+} AudioStreamPacketDescription;
+
+#pragma mark ____AudioTimeStamp
+
+typedef UInt32 SMPTETimeType;
+typedef UInt32 SMPTETimeFlags;
+
+typedef struct SMPTETime {
+    SInt16          mSubframes;
+    SInt16          mSubframeDivisor;
+    UInt32          mCounter;
+    SMPTETimeType   mType;
+    SMPTETimeFlags  mFlags;
+    SInt16          mHours;
+    SInt16          mMinutes;
+    SInt16          mSeconds;
+    SInt16          mFrames;
+} SMPTETime;
+
+typedef UInt32 AudioTimeStampFlags;
+enum {
+    kAudioTimeStampNothingValid         = 0,
+    kAudioTimeStampSampleTimeValid      = (1U << 0),
+    kAudioTimeStampHostTimeValid        = (1U << 1),
+    kAudioTimeStampRateScalarValid      = (1U << 2),
+    kAudioTimeStampWordClockTimeValid   = (1U << 3),
+    kAudioTimeStampSMPTETimeValid       = (1U << 4),
+    kAudioTimeStampSampleHostTimeValid  = (kAudioTimeStampSampleTimeValid | kAudioTimeStampHostTimeValid)
+};
+
+typedef struct AudioTimeStamp {
+    Float64             mSampleTime;
+    UInt64              mHostTime;
+    Float64             mRateScalar;
+    UInt64              mWordClockTime;
+    SMPTETime           mSMPTETime;
+    AudioTimeStampFlags mFlags;
+    UInt32              mReserved;
+} AudioTimeStamp;
+
+#pragma mark ____AudioClassDescription
+
+typedef struct AudioClassDescription {
+    OSType  mType;
+    OSType  mSubType;
+    OSType  mManufacturer;
+} AudioClassDescription;
+
+#pragma mark ____AudioChannelLayout
+
+typedef UInt32 AudioChannelLabel;
+typedef UInt32 AudioChannelLayoutTag;
+typedef UInt32 AudioChannelBitmap;
+typedef UInt32 AudioChannelFlags;
+
+enum {
+    kAudioChannelLabel_Unknown      = 0xFFFFFFFF,
+    kAudioChannelLabel_Unused       = 0,
+    kAudioChannelLabel_Left         = 1,
+    kAudioChannelLabel_Right        = 2,
+    kAudioChannelLabel_Center       = 3,
+    kAudioChannelLabel_Mono         = 42
+};
+
+typedef struct AudioChannelDescription {
+    AudioChannelLabel   mChannelLabel;
+    AudioChannelFlags   mChannelFlags;
+    Float32             mCoordinates[3];
+} AudioChannelDescription;
+
+typedef struct AudioChannelLayout {
+    AudioChannelLayoutTag       mChannelLayoutTag;
+    AudioChannelBitmap          mChannelBitmap;
+    UInt32                      mNumberChannelDescriptions;
+    AudioChannelDescription     mChannelDescriptions[1]; // this is a variable length array of mNumberChannelDescriptions elements
+} AudioChannelLayout;
+
+#define AudioChannelLayoutTag_GetNumberOfChannels(layoutTag) ((UInt32)((layoutTag) & 0x0000FFFF))
+
+enum {
+    kAudioChannelLayoutTag_UseChannelDescriptions   = (0U<<16) | 0,
+    kAudioChannelLayoutTag_UseChannelBitmap         = (1U<<16) | 0,
+    kAudioChannelLayoutTag_Mono                     = (100U<<16) | 1,
+    kAudioChannelLayoutTag_Stereo                   = (101U<<16) | 2,
+    kAudioChannelLayoutTag_Unknown                  = 0xFFFF0000
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CoreAudioTypes_h */
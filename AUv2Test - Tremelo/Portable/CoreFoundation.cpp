@@ -0,0 +1,443 @@
+//
+//  CoreFoundation.cpp
+//  TremeloAUv2
+//
+//  Minimal reference counted implementation of the CoreFoundation subset
+//  declared in CoreFoundation.h. Collections are small in practice (a preset
+//  dictionary holds a dozen keys at most) so lookups are linear.
+//
+
+#include "CoreFoundation.h"
+
+#include <atomic>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#pragma mark ____Runtime
+
+enum {
+    kCFTypeID_String = 1,
+    kCFTypeID_Number,
+    kCFTypeID_Data,
+    kCFTypeID_Array,
+    kCFTypeID_Dictionary
+};
+
+struct __CFRuntimeBase {
+    explicit __CFRuntimeBase(CFTypeID inTypeID) : mRetainCount(1), mTypeID(inTypeID) { }
+    virtual ~__CFRuntimeBase() { }
+
+    virtual bool        Equal(const __CFRuntimeBase *other) const { return this == other; }
+    virtual CFHashCode  Hash() const { return CFHashCode(this); }
+    /// Constant strings (CFSTR) are never destroyed.
+    virtual bool        IsImmortal() const { return false; }
+
+    std::atomic<CFIndex>    mRetainCount;
+    CFTypeID                mTypeID;
+};
+
+static inline const __CFRuntimeBase *CFRuntimeBase(CFTypeRef cf)
+{
+    return static_cast<const __CFRuntimeBase *>(cf);
+}
+
+struct __CFString : __CFRuntimeBase {
+    __CFString(const char *cStr, bool immortal) : __CFRuntimeBase(kCFTypeID_String), mString(cStr), mImmortal(immortal) { }
+
+    bool Equal(const __CFRuntimeBase *other) const override
+    {
+        return other->mTypeID == kCFTypeID_String && static_cast<const __CFString *>(other)->mString == mString;
+    }
+    CFHashCode  Hash() const override { return std::hash<std::string>()(mString); }
+    bool        IsImmortal() const override { return mImmortal; }
+
+    std::string mString;
+    bool        mImmortal;
+};
+
+struct __CFNumber : __CFRuntimeBase {
+    __CFNumber() : __CFRuntimeBase(kCFTypeID_Number), mIsFloat(false), mInteger(0), mFloat(0.) { }
+
+    bool Equal(const __CFRuntimeBase *other) const override
+    {
+        if (other->mTypeID != kCFTypeID_Number) return false;
+        const __CFNumber *num = static_cast<const __CFNumber *>(other);
+        return mIsFloat ? (mFloat == num->AsFloat()) : (num->mIsFloat ? Float64(mInteger) == num->mFloat : mInteger == num->mInteger);
+    }
+    CFHashCode Hash() const override { return mIsFloat ? std::hash<Float64>()(mFloat) : CFHashCode(mInteger); }
+
+    Float64 AsFloat() const { return mIsFloat ? mFloat : Float64(mInteger); }
+    SInt64  AsInteger() const { return mIsFloat ? SInt64(mFloat) : mInteger; }
+
+    bool    mIsFloat;
+    SInt64  mInteger;
+    Float64 mFloat;
+};
+
+struct __CFData : __CFRuntimeBase {
+    __CFData() : __CFRuntimeBase(kCFTypeID_Data) { }
+
+    bool Equal(const __CFRuntimeBase *other) const override
+    {
+        return other->mTypeID == kCFTypeID_Data && static_cast<const __CFData *>(other)->mBytes == mBytes;
+    }
+
+    std::vector<UInt8> mBytes;
+};
+
+struct __CFArray : __CFRuntimeBase {
+    explicit __CFArray(bool retainsValues) : __CFRuntimeBase(kCFTypeID_Array), mRetainsValues(retainsValues) { }
+    ~__CFArray() override
+    {
+        if (mRetainsValues)
+            for (const void *value : mValues)
+                CFRelease(value);
+    }
+
+    bool                        mRetainsValues;
+    std::vector<const void *>   mValues;
+};
+
+struct __CFDictionary : __CFRuntimeBase {
+    __CFDictionary(bool retainsKeys, bool retainsValues)
+        : __CFRuntimeBase(kCFTypeID_Dictionary), mRetainsKeys(retainsKeys), mRetainsValues(retainsValues) { }
+    ~__CFDictionary() override
+    {
+        for (auto &entry : mEntries) {
+            if (mRetainsKeys) CFRelease(entry.first);
+            if (mRetainsValues) CFRelease(entry.second);
+        }
+    }
+
+    /// Keys are compared with CFEqual when the dictionary retains them (CF object keys), by pointer otherwise.
+    std::vector<std::pair<const void *, const void *>>::iterator Find(const void *key)
+    {
+        for (auto it = mEntries.begin(); it != mEntries.end(); ++it)
+            if (it->first == key || (mRetainsKeys && CFEqual(it->first, key)))
+                return it;
+        return mEntries.end();
+    }
+
+    bool                                                mRetainsKeys;
+    bool                                                mRetainsValues;
+    std::vector<std::pair<const void *, const void *>>  mEntries;
+};
+
+CFTypeRef CFRetain(CFTypeRef cf)
+{
+    if (cf && !CFRuntimeBase(cf)->IsImmortal())
+        const_cast<__CFRuntimeBase *>(CFRuntimeBase(cf))->mRetainCount.fetch_add(1, std::memory_order_relaxed);
+    return cf;
+}
+
+void CFRelease(CFTypeRef cf)
+{
+    if (cf == NULL || CFRuntimeBase(cf)->IsImmortal())
+        return;
+    __CFRuntimeBase *base = const_cast<__CFRuntimeBase *>(CFRuntimeBase(cf));
+    if (base->mRetainCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        delete base;
+}
+
+CFIndex CFGetRetainCount(CFTypeRef cf)
+{
+    return cf ? CFRuntimeBase(cf)->mRetainCount.load(std::memory_order_relaxed) : 0;
+}
+
+CFTypeID CFGetTypeID(CFTypeRef cf)
+{
+    return cf ? CFRuntimeBase(cf)->mTypeID : 0;
+}
+
+Boolean CFEqual(CFTypeRef cf1, CFTypeRef cf2)
+{
+    if (cf1 == cf2) return true;
+    if (cf1 == NULL || cf2 == NULL) return false;
+    return CFRuntimeBase(cf1)->Equal(CFRuntimeBase(cf2));
+}
+
+CFHashCode CFHash(CFTypeRef cf)
+{
+    return cf ? CFRuntimeBase(cf)->Hash() : 0;
+}
+
+static const void *CFTypeRetainCallBack(CFAllocatorRef, const void *value) { return CFRetain(value); }
+static void CFTypeReleaseCallBack(CFAllocatorRef, const void *value) { CFRelease(value); }
+
+const CFArrayCallBacks kCFTypeArrayCallBacks = { 0, CFTypeRetainCallBack, CFTypeReleaseCallBack };
+const CFDictionaryKeyCallBacks kCFTypeDictionaryKeyCallBacks = { 0, CFTypeRetainCallBack, CFTypeReleaseCallBack };
+const CFDictionaryKeyCallBacks kCFCopyStringDictionaryKeyCallBacks = { 0, CFTypeRetainCallBack, CFTypeReleaseCallBack };
+const CFDictionaryValueCallBacks kCFTypeDictionaryValueCallBacks = { 0, CFTypeRetainCallBack, CFTypeReleaseCallBack };
+
+#pragma mark ____CFString
+
+CFStringRef __CFStringMakeConstantString(const char *cStr)
+{
+    // CFSTR literals are interned so that repeated evaluation yields the same immortal object.
+    static std::mutex sLock;
+    static std::unordered_map<std::string, __CFString *> *sTable = new std::unordered_map<std::string, __CFString *>;
+
+    std::lock_guard<std::mutex> lock(sLock);
+    __CFString *&str = (*sTable)[cStr];
+    if (str == NULL)
+        str = new __CFString(cStr, true);
+    return str;
+}
+
+CFTypeID CFStringGetTypeID(void) { return kCFTypeID_String; }
+
+CFStringRef CFStringCreateWithCString(CFAllocatorRef, const char *cStr, CFStringEncoding)
+{
+    return cStr ? new __CFString(cStr, false) : NULL;
+}
+
+CFStringRef CFStringCreateCopy(CFAllocatorRef, CFStringRef theString)
+{
+    return theString ? new __CFString(theString->mString.c_str(), false) : NULL;
+}
+
+CFIndex CFStringGetLength(CFStringRef theString)
+{
+    return theString ? CFIndex(theString->mString.size()) : 0;
+}
+
+Boolean CFStringGetCString(CFStringRef theString, char *buffer, CFIndex bufferSize, CFStringEncoding)
+{
+    if (theString == NULL || buffer == NULL || bufferSize <= 0)
+        return false;
+    const std::string &str = theString->mString;
+    if (CFIndex(str.size()) >= bufferSize) {
+        // CF fails rather than truncating; leave a terminated prefix for callers that ignore the result.
+        memcpy(buffer, str.data(), size_t(bufferSize - 1));
+        buffer[bufferSize - 1] = 0;
+        return false;
+    }
+    memcpy(buffer, str.c_str(), str.size() + 1);
+    return true;
+}
+
+const char *CFStringGetCStringPtr(CFStringRef theString, CFStringEncoding)
+{
+    return theString ? theString->mString.c_str() : NULL;
+}
+
+#pragma mark ____CFNumber
+
+CFTypeID CFNumberGetTypeID(void) { return kCFTypeID_Number; }
+
+CFNumberRef CFNumberCreate(CFAllocatorRef, CFNumberType theType, const void *valuePtr)
+{
+    if (valuePtr == NULL)
+        return NULL;
+    __CFNumber *num = new __CFNumber;
+    switch (theType) {
+        case kCFNumberSInt8Type:
+        case kCFNumberCharType:     num->mInteger = *(const SInt8 *)valuePtr; break;
+        case kCFNumberSInt16Type:
+        case kCFNumberShortType:    num->mInteger = *(const SInt16 *)valuePtr; break;
+        case kCFNumberSInt32Type:
+        case kCFNumberIntType:      num->mInteger = *(const SInt32 *)valuePtr; break;
+        case kCFNumberSInt64Type:
+        case kCFNumberLongLongType: num->mInteger = *(const SInt64 *)valuePtr; break;
+        case kCFNumberLongType:     num->mInteger = *(const long *)valuePtr; break;
+        case kCFNumberCFIndexType:  num->mInteger = *(const CFIndex *)valuePtr; break;
+        case kCFNumberFloat32Type:
+        case kCFNumberFloatType:    num->mIsFloat = true; num->mFloat = *(const Float32 *)valuePtr; break;
+        case kCFNumberFloat64Type:
+        case kCFNumberDoubleType:   num->mIsFloat = true; num->mFloat = *(const Float64 *)valuePtr; break;
+        default:
+            delete num;
+            return NULL;
+    }
+    return num;
+}
+
+Boolean CFNumberGetValue(CFNumberRef number, CFNumberType theType, void *valuePtr)
+{
+    if (number == NULL || valuePtr == NULL)
+        return false;
+    switch (theType) {
+        case kCFNumberSInt8Type:
+        case kCFNumberCharType:     *(SInt8 *)valuePtr = SInt8(number->AsInteger()); break;
+        case kCFNumberSInt16Type:
+        case kCFNumberShortType:    *(SInt16 *)valuePtr = SInt16(number->AsInteger()); break;
+        case kCFNumberSInt32Type:
+        case kCFNumberIntType:      *(SInt32 *)valuePtr = SInt32(number->AsInteger()); break;
+        case kCFNumberSInt64Type:
+        case kCFNumberLongLongType: *(SInt64 *)valuePtr = number->AsInteger(); break;
+        case kCFNumberLongType:     *(long *)valuePtr = long(number->AsInteger()); break;
+        case kCFNumberCFIndexType:  *(CFIndex *)valuePtr = CFIndex(number->AsInteger()); break;
+        case kCFNumberFloat32Type:
+        case kCFNumberFloatType:    *(Float32 *)valuePtr = Float32(number->AsFloat()); break;
+        case kCFNumberFloat64Type:
+        case kCFNumberDoubleType:   *(Float64 *)valuePtr = number->AsFloat(); break;
+        default:
+            return false;
+    }
+    return true;
+}
+
+#pragma mark ____CFData
+
+CFTypeID CFDataGetTypeID(void) { return kCFTypeID_Data; }
+
+CFDataRef CFDataCreate(CFAllocatorRef, const UInt8 *bytes, CFIndex length)
+{
+    __CFData *data = new __CFData;
+    if (bytes && length > 0)
+        data->mBytes.assign(bytes, bytes + length);
+    return data;
+}
+
+CFMutableDataRef CFDataCreateMutable(CFAllocatorRef, CFIndex capacity)
+{
+    __CFData *data = new __CFData;
+    if (capacity > 0)
+        data->mBytes.reserve(size_t(capacity));
+    return data;
+}
+
+void CFDataAppendBytes(CFMutableDataRef theData, const UInt8 *bytes, CFIndex length)
+{
+    if (theData && bytes && length > 0)
+        theData->mBytes.insert(theData->mBytes.end(), bytes, bytes + length);
+}
+
+CFIndex CFDataGetLength(CFDataRef theData)
+{
+    return theData ? CFIndex(theData->mBytes.size()) : 0;
+}
+
+const UInt8 *CFDataGetBytePtr(CFDataRef theData)
+{
+    return (theData && !theData->mBytes.empty()) ? theData->mBytes.data() : NULL;
+}
+
+#pragma mark ____CFArray
+
+CFTypeID CFArrayGetTypeID(void) { return kCFTypeID_Array; }
+
+CFArrayRef CFArrayCreate(CFAllocatorRef allocator, const void **values, CFIndex numValues, const CFArrayCallBacks *callBacks)
+{
+    CFMutableArrayRef array = CFArrayCreateMutable(allocator, numValues, callBacks);
+    for (CFIndex i = 0; i < numValues; ++i)
+        CFArrayAppendValue(array, values[i]);
+    return array;
+}
+
+CFMutableArrayRef CFArrayCreateMutable(CFAllocatorRef, CFIndex capacity, const CFArrayCallBacks *callBacks)
+{
+    __CFArray *array = new __CFArray(callBacks != NULL);
+    if (capacity > 0)
+        array->mValues.reserve(size_t(capacity));
+    return array;
+}
+
+void CFArrayAppendValue(CFMutableArrayRef theArray, const void *value)
+{
+    if (theArray == NULL)
+        return;
+    if (theArray->mRetainsValues)
+        CFRetain(value);
+    theArray->mValues.push_back(value);
+}
+
+CFIndex CFArrayGetCount(CFArrayRef theArray)
+{
+    return theArray ? CFIndex(theArray->mValues.size()) : 0;
+}
+
+const void *CFArrayGetValueAtIndex(CFArrayRef theArray, CFIndex idx)
+{
+    if (theArray == NULL || idx < 0 || idx >= CFIndex(theArray->mValues.size()))
+        return NULL;
+    return theArray->mValues[size_t(idx)];
+}
+
+#pragma mark ____CFDictionary
+
+CFTypeID CFDictionaryGetTypeID(void) { return kCFTypeID_Dictionary; }
+
+CFMutableDictionaryRef CFDictionaryCreateMutable(CFAllocatorRef, CFIndex capacity, const CFDictionaryKeyCallBacks *keyCallBacks, const CFDictionaryValueCallBacks *valueCallBacks)
+{
+    __CFDictionary *dict = new __CFDictionary(keyCallBacks != NULL, valueCallBacks != NULL);
+    if (capacity > 0)
+        dict->mEntries.reserve(size_t(capacity));
+    return dict;
+}
+
+void CFDictionarySetValue(CFMutableDictionaryRef theDict, const void *key, const void *value)
+{
+    if (theDict == NULL)
+        return;
+    if (theDict->mRetainsValues)
+        CFRetain(value);
+    auto it = theDict->Find(key);
+    if (it != theDict->mEntries.end()) {
+        if (theDict->mRetainsValues)
+            CFRelease(it->second);
+        it->second = value;
+    } else {
+        if (theDict->mRetainsKeys)
+            CFRetain(key);
+        theDict->mEntries.emplace_back(key, value);
+    }
+}
+
+void CFDictionaryRemoveValue(CFMutableDictionaryRef theDict, const void *key)
+{
+    if (theDict == NULL)
+        return;
+    auto it = theDict->Find(key);
+    if (it == theDict->mEntries.end())
+        return;
+    if (theDict->mRetainsKeys) CFRelease(it->first);
+    if (theDict->mRetainsValues) CFRelease(it->second);
+    theDict->mEntries.erase(it);
+}
+
+const void *CFDictionaryGetValue(CFDictionaryRef theDict, const void *key)
+{
+    const void *value = NULL;
+    CFDictionaryGetValueIfPresent(theDict, key, &value);
+    return value;
+}
+
+Boolean CFDictionaryGetValueIfPresent(CFDictionaryRef theDict, const void *key, const void **value)
+{
+    if (theDict == NULL)
+        return false;
+    __CFDictionary *dict = const_cast<__CFDictionary *>(theDict);
+    auto it = dict->Find(key);
+    if (it == dict->mEntries.end())
+        return false;
+    if (value)
+        *value = it->second;
+    return true;
+}
+
+Boolean CFDictionaryContainsKey(CFDictionaryRef theDict, const void *key)
+{
+    return CFDictionaryGetValueIfPresent(theDict, key, NULL);
+}
+
+CFIndex CFDictionaryGetCount(CFDictionaryRef theDict)
+{
+    return theDict ? CFIndex(theDict->mEntries.size()) : 0;
+}
+
+void CFDictionaryGetKeysAndValues(CFDictionaryRef theDict, const void **keys, const void **values)
+{
+    if (theDict == NULL)
+        return;
+    CFIndex i = 0;
+    for (const auto &entry : theDict->mEntries) {
+        if (keys) keys[i] = entry.first;
+        if (values) values[i] = entry.second;
+        ++i;
+    }
+}
@@ -0,0 +1,144 @@
+//
+//  CoreFoundation.h
+//  TremeloAUv2
+//
+//  Portable subset of CoreFoundation: the property list types (strings,
+//  numbers, data, arrays and dictionaries) that AUBase uses for parameter
+//  names, factory presets and ClassInfo state. Semantics follow CF: Create
+//  functions return a +1 reference, Get functions do not retain, and
+//  collections created with the kCFType callbacks retain their contents.
+//
+
+#ifndef CoreFoundation_h
+#define CoreFoundation_h
+
+// Like the real umbrella header, pull in the C library headers that code
+// written against CoreFoundation takes for granted.
+#include <assert.h>
+#include <ctype.h>
+#include <errno.h>
+#include <float.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "BSDCompat.h"
+
+#include "CFBase.h"
+#include "CFByteOrder.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#pragma mark ____CFString
+
+typedef UInt32 CFStringEncoding;
+enum {
+    kCFStringEncodingMacRoman   = 0,
+    kCFStringEncodingASCII      = 0x0600,
+    kCFStringEncodingUTF8       = 0x08000100
+};
+
+CFStringRef __CFStringMakeConstantString(const char *cStr);
+#define CFSTR(cStr)     __CFStringMakeConstantString("" cStr "")
+
+CFTypeID    CFStringGetTypeID(void);
+CFStringRef CFStringCreateWithCString(CFAllocatorRef alloc, const char *cStr, CFStringEncoding encoding);
+CFStringRef CFStringCreateCopy(CFAllocatorRef alloc, CFStringRef theString);
+CFIndex     CFStringGetLength(CFStringRef theString);
+Boolean     CFStringGetCString(CFStringRef theString, char *buffer, CFIndex bufferSize, CFStringEncoding encoding);
+const char *CFStringGetCStringPtr(CFStringRef theString, CFStringEncoding encoding);
+
+#pragma mark ____CFNumber
+
+typedef CFIndex CFNumberType;
+enum {
+    kCFNumberSInt8Type      = 1,
+    kCFNumberSInt16Type     = 2,
+    kCFNumberSInt32Type     = 3,
+    kCFNumberSInt64Type     = 4,
+    kCFNumberFloat32Type    = 5,
+    kCFNumberFloat64Type    = 6,
+    kCFNumberCharType       = 7,
+    kCFNumberShortType      = 8,
+    kCFNumberIntType        = 9,
+    kCFNumberLongType       = 10,
+    kCFNumberLongLongType   = 11,
+    kCFNumberFloatType      = 12,
+    kCFNumberDoubleType     = 13,
+    kCFNumberCFIndexType    = 14
+};
+
+CFTypeID    CFNumberGetTypeID(void);
+CFNumberRef CFNumberCreate(CFAllocatorRef allocator, CFNumberType theType, const void *valuePtr);
+Boolean     CFNumberGetValue(CFNumberRef number, CFNumberType theType, void *valuePtr);
+
+#pragma mark ____CFData
+
+CFTypeID        CFDataGetTypeID(void);
+CFDataRef       CFDataCreate(CFAllocatorRef allocator, const UInt8 *bytes, CFIndex length);
+CFMutableDataRef CFDataCreateMutable(CFAllocatorRef allocator, CFIndex capacity);
+void            CFDataAppendBytes(CFMutableDataRef theData, const UInt8 *bytes, CFIndex length);
+CFIndex         CFDataGetLength(CFDataRef theData);
+const UInt8 *   CFDataGetBytePtr(CFDataRef theData);
+
+#pragma mark ____CFArray
+
+typedef const void *    (*CFArrayRetainCallBack)(CFAllocatorRef allocator, const void *value);
+typedef void            (*CFArrayReleaseCallBack)(CFAllocatorRef allocator, const void *value);
+
+typedef struct {
+    CFIndex                 version;
+    CFArrayRetainCallBack   retain;
+    CFArrayReleaseCallBack  release;
+} CFArrayCallBacks;
+
+extern const CFArrayCallBacks kCFTypeArrayCallBacks;
+
+CFTypeID            CFArrayGetTypeID(void);
+CFArrayRef          CFArrayCreate(CFAllocatorRef allocator, const void **values, CFIndex numValues, const CFArrayCallBacks *callBacks);
+CFMutableArrayRef   CFArrayCreateMutable(CFAllocatorRef allocator, CFIndex capacity, const CFArrayCallBacks *callBacks);
+void                CFArrayAppendValue(CFMutableArrayRef theArray, const void *value);
+CFIndex             CFArrayGetCount(CFArrayRef theArray);
+const void *        CFArrayGetValueAtIndex(CFArrayRef theArray, CFIndex idx);
+
+#pragma mark ____CFDictionary
+
+typedef const void *    (*CFDictionaryRetainCallBack)(CFAllocatorRef allocator, const void *value);
+typedef void            (*CFDictionaryReleaseCallBack)(CFAllocatorRef allocator, const void *value);
+
+typedef struct {
+    CFIndex                     version;
+    CFDictionaryRetainCallBack  retain;
+    CFDictionaryReleaseCallBack release;
+} CFDictionaryKeyCallBacks;
+
+typedef struct {
+    CFIndex                     version;
+    CFDictionaryRetainCallBack  retain;
+    CFDictionaryReleaseCallBack release;
+} CFDictionaryValueCallBacks;
+
+extern const CFDictionaryKeyCallBacks   kCFTypeDictionaryKeyCallBacks;
+extern const CFDictionaryKeyCallBacks   kCFCopyStringDictionaryKeyCallBacks;
+extern const CFDictionaryValueCallBacks kCFTypeDictionaryValueCallBacks;
+
+CFTypeID                CFDictionaryGetTypeID(void);
+CFMutableDictionaryRef  CFDictionaryCreateMutable(CFAllocatorRef allocator, CFIndex capacity, const CFDictionaryKeyCallBacks *keyCallBacks, const CFDictionaryValueCallBacks *valueCallBacks);
+void                    CFDictionarySetValue(CFMutableDictionaryRef theDict, const void *key, const void *value);
+void                    CFDictionaryRemoveValue(CFMutableDictionaryRef theDict, const void *key);
+const void *            CFDictionaryGetValue(CFDictionaryRef theDict, const void *key);
+Boolean                 CFDictionaryGetValueIfPresent(CFDictionaryRef theDict, const void *key, const void **value);
+Boolean                 CFDictionaryContainsKey(CFDictionaryRef theDict, const void *key);
+CFIndex                 CFDictionaryGetCount(CFDictionaryRef theDict);
+void                    CFDictionaryGetKeysAndValues(CFDictionaryRef theDict, const void **keys, const void **values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* CoreFoundation_h */
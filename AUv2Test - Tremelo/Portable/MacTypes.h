@@ -0,0 +1,52 @@
+//
+//  MacTypes.h
+//  TremeloAUv2
+//
+//  Portable subset of the Carbon scalar types used throughout the Core Audio
+//  Utility Classes.
+//
+
+#ifndef MacTypes_h
+#define MacTypes_h
+
+#include <TargetConditionals.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t         UInt8;
+typedef int8_t          SInt8;
+typedef uint16_t        UInt16;
+typedef int16_t         SInt16;
+typedef uint32_t        UInt32;
+typedef int32_t         SInt32;
+typedef uint64_t        UInt64;
+typedef int64_t         SInt64;
+
+typedef float           Float32;
+typedef double          Float64;
+
+typedef unsigned char   Boolean;
+typedef UInt8           Byte;
+typedef SInt8           SignedByte;
+typedef char *          Ptr;
+typedef UInt16          UniChar;
+
+typedef SInt32          OSStatus;
+typedef SInt16          OSErr;
+typedef UInt32          FourCharCode;
+typedef FourCharCode    OSType;
+
+#ifndef TRUE
+    #define TRUE    1
+#endif
+#ifndef FALSE
+    #define FALSE   0
+#endif
+
+enum {
+    noErr           = 0,
+    paramErr        = -50,
+    memFullErr      = -108
+};
+
+#endif /* MacTypes_h */
@@ -0,0 +1,56 @@
+//
+//  MusicDevice.h
+//  TremeloAUv2
+//
+//  Portable subset of <AudioToolbox/MusicDevice.h>. Only the types and
+//  selectors referenced by AUPlugInDispatch are provided; the portable build
+//  sets CA_BASIC_AU_FEATURES so the MusicDevice dispatch itself is compiled
+//  out.
+//
+
+#ifndef MusicDevice_h
+#define MusicDevice_h
+
+#include "AUComponent.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef UInt32 MusicDeviceInstrumentID;
+typedef UInt32 MusicDeviceGroupID;
+typedef UInt32 NoteInstanceID;
+
+typedef struct MusicDeviceStdNoteParams {
+    UInt32  argCount;
+    Float32 mPitch;
+    Float32 mVelocity;
+} MusicDeviceStdNoteParams;
+
+typedef struct NoteParamsControlValue {
+    AudioUnitParameterID    mID;
+    AudioUnitParameterValue mValue;
+} NoteParamsControlValue;
+
+typedef struct MusicDeviceNoteParams {
+    UInt32                  argCount;
+    Float32                 mPitch;
+    Float32                 mVelocity;
+    NoteParamsControlValue  mControls[1];
+} MusicDeviceNoteParams;
+
+enum {
+    kMusicDeviceRange                   = 0x0100,
+    kMusicDeviceMIDIEventSelect         = 0x0101,
+    kMusicDeviceSysExSelect             = 0x0102,
+    kMusicDevicePrepareInstrumentSelect = 0x0103,
+    kMusicDeviceReleaseInstrumentSelect = 0x0104,
+    kMusicDeviceStartNoteSelect         = 0x0105,
+    kMusicDeviceStopNoteSelect          = 0x0106
+};
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* MusicDevice_h */
@@ -0,0 +1,54 @@
+//
+//  TargetConditionals.h
+//  TremeloAUv2
+//
+//  Stand-in for the Apple SDK header when building the AU base classes with
+//  the portable (non-Xcode) build. Only the conditionals the Core Audio
+//  Utility Classes actually test are defined here.
+//
+
+#ifndef TargetConditionals_h
+#define TargetConditionals_h
+
+#define TARGET_OS_MAC               0
+#define TARGET_OS_WIN32             0
+#define TARGET_OS_IPHONE            0
+#define TARGET_OS_IOS               0
+#define TARGET_OS_LINUX             1
+#define TARGET_API_MAC_CARBON       0
+
+#if defined(__x86_64__)
+    #define TARGET_CPU_X86_64       1
+    #define TARGET_CPU_X86          0
+    #define TARGET_CPU_ARM64        0
+#elif defined(__i386__)
+    #define TARGET_CPU_X86_64       0
+    #define TARGET_CPU_X86          1
+    #define TARGET_CPU_ARM64        0
+#elif defined(__aarch64__)
+    #define TARGET_CPU_X86_64       0
+    #define TARGET_CPU_X86          0
+    #define TARGET_CPU_ARM64        1
+#else
+    #define TARGET_CPU_X86_64       0
+    #define TARGET_CPU_X86          0
+    #define TARGET_CPU_ARM64        0
+#endif
+#define TARGET_CPU_PPC              0
+#define TARGET_CPU_PPC64            0
+
+#if defined(__LP64__) || defined(_LP64)
+    #define TARGET_RT_64_BIT        1
+#else
+    #define TARGET_RT_64_BIT        0
+#endif
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    #define TARGET_RT_BIG_ENDIAN    1
+    #define TARGET_RT_LITTLE_ENDIAN 0
+#else
+    #define TARGET_RT_BIG_ENDIAN    0
+    #define TARGET_RT_LITTLE_ENDIAN 1
+#endif
+
+#endif /* TargetConditionals_h */
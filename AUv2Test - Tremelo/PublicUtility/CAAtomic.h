@@ -24,6 +24,9 @@ full barrier.
 	#include <intrin.h>
 	#pragma intrinsic(_InterlockedOr)
 	#pragma intrinsic(_InterlockedAnd)
+#elif TARGET_OS_LINUX
+	#include "CFBase.h"
+	#include <unistd.h>
 #else
 	#include <CoreFoundation/CFBase.h>
 	#include <libkern/OSAtomic.h>
@@ -33,6 +36,8 @@ inline void CAMemoryBarrier()
 {
 #if TARGET_OS_WIN32
 	MemoryBarrier();
+#elif TARGET_OS_LINUX
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);
 #else
 	OSMemoryBarrier();
 #endif
@@ -46,6 +51,8 @@ inline SInt32 CAAtomicAdd32Barrier(SInt32 theAmt, volatile SInt32* theValue)
 	// At this point the addition would have occured and hence returning the new value
 	// to keep it sync with OSX.
 	return lRetVal + theAmt;
+#elif TARGET_OS_LINUX
+	return __atomic_add_fetch(theValue, theAmt, __ATOMIC_SEQ_CST);
 #else
 	return OSAtomicAdd32Barrier(theAmt, (volatile int32_t *)theValue);
 #endif
@@ -60,6 +67,8 @@ inline SInt32 CAAtomicOr32Barrier(UInt32 theMask, volatile UInt32* theValue)
 	// _InterlockedOr returns the original value which differs from OSX version.
 	// Returning the new value similar to OSX
 	return (SInt32)(j | theMask);
+#elif TARGET_OS_LINUX
+	return (SInt32)__atomic_or_fetch(theValue, theMask, __ATOMIC_SEQ_CST);
 #else
 	return OSAtomicOr32Barrier(theMask, (volatile uint32_t *)theValue);
 #endif
@@ -74,6 +83,8 @@ inline SInt32 CAAtomicAnd32Barrier(UInt32 theMask, volatile UInt32* theValue)
 	// _InterlockedAnd returns the original value which differs from OSX version.
 	// Returning the new value similar to OSX
 	return (SInt32)(j & theMask);
+#elif TARGET_OS_LINUX
+	return (SInt32)__atomic_and_fetch(theValue, theMask, __ATOMIC_SEQ_CST);
 #else
 	return OSAtomicAnd32Barrier(theMask, (volatile uint32_t *)theValue);
 #endif
@@ -87,6 +98,8 @@ inline bool CAAtomicCompareAndSwap32Barrier(SInt32 oldValue, SInt32 newValue, vo
 // Hence we check if the new value is set and if it is we return true else false.
 // If theValue is equal to oldValue then the swap happens. Otherwise swap doesn't happen.
 	return (oldValue == lRetVal);
+#elif TARGET_OS_LINUX
+	return __atomic_compare_exchange_n(theValue, &oldValue, newValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
 #else
 	return OSAtomicCompareAndSwap32Barrier(oldValue, newValue, (volatile int32_t *)theValue);
 #endif
@@ -97,6 +110,8 @@ inline SInt32 CAAtomicIncrement32(volatile SInt32* theValue)
 {
 #if TARGET_OS_WIN32
 	return (SInt32)InterlockedIncrement((volatile long*)theValue);
+#elif TARGET_OS_LINUX
+	return __atomic_add_fetch(theValue, 1, __ATOMIC_RELAXED);
 #else
 	return OSAtomicIncrement32((volatile int32_t *)theValue);
 #endif
@@ -106,6 +121,8 @@ inline SInt32 CAAtomicDecrement32(volatile SInt32* theValue)
 {
 #if TARGET_OS_WIN32
 	return (SInt32)InterlockedDecrement((volatile long*)theValue);
+#elif TARGET_OS_LINUX
+	return __atomic_sub_fetch(theValue, 1, __ATOMIC_RELAXED);
 #else
 	return OSAtomicDecrement32((volatile int32_t *)theValue);
 #endif
@@ -115,6 +132,8 @@ inline SInt32 CAAtomicIncrement32Barrier(volatile SInt32* theValue)
 {
 #if TARGET_OS_WIN32
 	return CAAtomicIncrement32(theValue);
+#elif TARGET_OS_LINUX
+	return __atomic_add_fetch(theValue, 1, __ATOMIC_SEQ_CST);
 #else
 	return OSAtomicIncrement32Barrier((volatile int32_t *)theValue);
 #endif
@@ -124,6 +143,8 @@ inline SInt32 CAAtomicDecrement32Barrier(volatile SInt32* theValue)
 {
 #if TARGET_OS_WIN32
 	return CAAtomicDecrement32(theValue);
+#elif TARGET_OS_LINUX
+	return __atomic_sub_fetch(theValue, 1, __ATOMIC_SEQ_CST);
 #else
 	return OSAtomicDecrement32Barrier((volatile int32_t *)theValue);
 #endif
@@ -134,6 +155,11 @@ inline bool CAAtomicTestAndClearBarrier(int bitToClear, void* theAddress)
 #if TARGET_OS_WIN32
 	BOOL bOldVal = InterlockedBitTestAndReset((long*)theAddress, bitToClear);
 	return (bOldVal ? true : false);
+#elif TARGET_OS_LINUX
+	// same bit numbering as OSAtomicTestAndClear: bit 0 is the high bit of the first byte
+	volatile UInt8* theByte = (volatile UInt8*)theAddress + (bitToClear >> 3);
+	UInt8 theMask = (UInt8)(0x80 >> (bitToClear & 7));
+	return (__atomic_fetch_and(theByte, (UInt8)~theMask, __ATOMIC_SEQ_CST) & theMask) != 0;
 #else
 	return OSAtomicTestAndClearBarrier(bitToClear, (volatile void *)theAddress);
 #endif
@@ -144,6 +170,8 @@ inline bool CAAtomicTestAndClear(int bitToClear, void* theAddress)
 #if TARGET_OS_WIN32
 	BOOL bOldVal = CAAtomicTestAndClearBarrier(bitToClear, (long*)theAddress);
 	return (bOldVal ? true : false);
+#elif TARGET_OS_LINUX
+	return CAAtomicTestAndClearBarrier(bitToClear, theAddress);
 #else
 	return OSAtomicTestAndClear(bitToClear, (volatile void *)theAddress);
 #endif
@@ -154,6 +182,10 @@ inline bool CAAtomicTestAndSetBarrier(int bitToSet, void* theAddress)
 #if TARGET_OS_WIN32
 	BOOL bOldVal = InterlockedBitTestAndSet((long*)theAddress, bitToSet);
 	return (bOldVal ? true : false);
+#elif TARGET_OS_LINUX
+	volatile UInt8* theByte = (volatile UInt8*)theAddress + (bitToSet >> 3);
+	UInt8 theMask = (UInt8)(0x80 >> (bitToSet & 7));
+	return (__atomic_fetch_or(theByte, theMask, __ATOMIC_SEQ_CST) & theMask) != 0;
 #else
 	return OSAtomicTestAndSetBarrier(bitToSet, (volatile void *)theAddress);
 #endif
@@ -209,7 +241,11 @@ inline int32_t CAAtomicDecrement32Barrier(volatile int32_t* theValue)
 #if __LP64__
 inline bool CAAtomicCompareAndSwap64Barrier( int64_t __oldValue, int64_t __newValue, volatile int64_t *__theValue )
 {
+#if TARGET_OS_LINUX
+	return __atomic_compare_exchange_n(__theValue, &__oldValue, __newValue, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#else
 	return OSAtomicCompareAndSwap64Barrier(__oldValue, __newValue, __theValue);
+#endif
 }
 #endif
 
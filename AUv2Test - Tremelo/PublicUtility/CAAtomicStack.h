@@ -12,6 +12,7 @@ Part of Core Audio Public Utility Classes
 #if !defined(__COREAUDIO_USE_FLAT_INCLUDES__)
 	#include <libkern/OSAtomic.h>
 #else
+	#include "CoreAudioTypes.h"
 	#include <CAAtomic.h>
 #endif
 
@@ -19,8 +20,17 @@ Part of Core Audio Public Utility Classes
 	#include <CoreServices/CoreServices.h>
 #endif
 
+#include <atomic>
+#include <stdint.h>
+
 //  linked list LIFO or FIFO (pop_all_reversed) stack, elements are pushed and popped atomically
 //  class T must implement T *& next().
+//
+//	The head is a std::atomic<T *>, so it is the width of a pointer on every platform. Pushes and
+//	pop_all are safe from any number of threads. A pop that reads the head's next() and swaps it in
+//	can be fooled by the head being popped and pushed back in between (the ABA problem), so
+//	pop_atomic_single_reader is only safe with one popping thread; use TAtomicStack2 when several
+//	threads pop.
 template <class T>
 class TAtomicStack {
 public:
@@ -29,30 +39,29 @@ public:
 	// non-atomic routines, for use when initializing/deinitializing, operate NON-atomically
 	void	push_NA(T *item)
 	{
-		item->next() = mHead;
-		mHead = item;
+		item->next() = mHead.load(std::memory_order_relaxed);
+		mHead.store(item, std::memory_order_relaxed);
 	}
 	
 	T *		pop_NA()
 	{
-		T *result = mHead;
+		T *result = mHead.load(std::memory_order_relaxed);
 		if (result)
-			mHead = result->next();
+			mHead.store(result->next(), std::memory_order_relaxed);
 		return result;
 	}
 	
-	bool	empty() const { return mHead == NULL; }
+	bool	empty() const { return mHead.load(std::memory_order_relaxed) == NULL; }
 	
-	T *		head() { return mHead; }
+	T *		head() { return mHead.load(std::memory_order_acquire); }
 	
 	// atomic routines
 	void	push_atomic(T *item)
 	{
-		T *head_;
+		T *head_ = mHead.load(std::memory_order_relaxed);
 		do {
-			head_ = mHead;
 			item->next() = head_;
-		} while (!compare_and_swap(head_, item, &mHead));
+		} while (!mHead.compare_exchange_weak(head_, item, std::memory_order_release, std::memory_order_relaxed));
 	}
 	
 	void	push_multiple_atomic(T *item)
@@ -64,10 +73,10 @@ public:
 			tail = p;
 			p = p->next();
 		} while (p);
+		head_ = mHead.load(std::memory_order_relaxed);
 		do {
-			head_ = mHead;
 			tail->next() = head_;
-		} while (!compare_and_swap(head_, item, &mHead));
+		} while (!mHead.compare_exchange_weak(head_, item, std::memory_order_release, std::memory_order_relaxed));
 	}
 	
 	T *		pop_atomic_single_reader()
@@ -75,11 +84,9 @@ public:
 		// if multiple threads may pop, this suffers from the ABA problem.
 		// <rdar://problem/4606346> TAtomicStack suffers from the ABA problem
 	{
-		T *result;
-		do {
-			if ((result = mHead) == NULL)
-				break;
-		} while (!compare_and_swap(result, result->next(), &mHead));
+		T *result = mHead.load(std::memory_order_acquire);
+		while (result != NULL && !mHead.compare_exchange_weak(result, result->next(), std::memory_order_acquire, std::memory_order_acquire))
+			;
 		return result;
 	}
 	
@@ -100,12 +107,7 @@ public:
 	
 	T *		pop_all()
 	{
-		T *result;
-		do {
-			if ((result = mHead) == NULL)
-				break;
-		} while (!compare_and_swap(result, NULL, &mHead));
-		return result;
+		return mHead.exchange(NULL, std::memory_order_acquire);
 	}
 	
 	T*		pop_all_reversed()
@@ -117,30 +119,14 @@ public:
 			reversed.push_NA(p);
 			p = next;
 		}
-		return reversed.mHead;
-	}
-	
-	static bool	compare_and_swap(T *oldvalue, T *newvalue, T **pvalue)
-	{
-#if TARGET_OS_MAC
-	#if __LP64__
-			return ::OSAtomicCompareAndSwap64Barrier(int64_t(oldvalue), int64_t(newvalue), (int64_t *)pvalue);
-	#elif MAC_OS_X_VERSION_MAX_ALLOWED >= MAC_OS_X_VERSION_10_4
-			return ::OSAtomicCompareAndSwap32Barrier(int32_t(oldvalue), int32_t(newvalue), (int32_t *)pvalue);
-	#else
-			return ::CompareAndSwap(UInt32(oldvalue), UInt32(newvalue), (UInt32 *)pvalue);
-	#endif
-#else
-			//return ::CompareAndSwap(UInt32(oldvalue), UInt32(newvalue), (UInt32 *)pvalue);
-			return CAAtomicCompareAndSwap32Barrier(SInt32(oldvalue), SInt32(newvalue), (SInt32*)pvalue);
-#endif
+		return reversed.pop_all();
 	}
 	
 protected:
-	T *		mHead;
+	std::atomic<T *>	mHead;
 };
 
-#if ((MAC_OS_X_VERSION_MAX_ALLOWED >= MAC_OS_X_VERSION_10_5) && !TARGET_OS_WIN32)
+#if ((MAC_OS_X_VERSION_MAX_ALLOWED >= MAC_OS_X_VERSION_10_5) && !TARGET_OS_WIN32 && !TARGET_OS_LINUX)
 #include <libkern/OSAtomic.h>
 
 class CAAtomicStack {
@@ -194,7 +180,68 @@ private:
 
 #else
 
-#define TAtomicStack2 TAtomicStack
+// The same subset as the OSQueue version, for any number of pushing and popping threads. The head
+// is a pointer plus a count of pops, swapped together with a double-width compare-and-swap, so a
+// pop fails if the head was popped and pushed back since it was read. A popped item may still have
+// its next() read by a pop that is about to fail, so items must stay allocated for as long as the
+// stack is in use (as they do in a freelist).
+template <class T>
+class TAtomicStack2 {
+public:
+	TAtomicStack2() : mHead(Head()) { }
+
+	void	push_atomic(T *item) {
+		Head head_ = mHead.load(std::memory_order_relaxed), newHead;
+		do {
+			store_next(item, head_.mItem);
+			newHead.mItem = item;
+			newHead.mPops = head_.mPops;
+		} while (!mHead.compare_exchange_weak(head_, newHead, std::memory_order_release, std::memory_order_relaxed));
+	}
+	void	push_NA(T *item) { push_atomic(item); }
+
+	T *		pop_atomic() {
+		Head head_ = mHead.load(std::memory_order_acquire), newHead;
+		do {
+			if (head_.mItem == NULL)
+				return NULL;
+			newHead.mItem = load_next(head_.mItem);
+			newHead.mPops = head_.mPops + 1;
+		} while (!mHead.compare_exchange_weak(head_, newHead, std::memory_order_acquire, std::memory_order_acquire));
+		return head_.mItem;
+	}
+	T *		pop_atomic_single_reader() { return pop_atomic(); }
+	T *		pop_NA() { return pop_atomic(); }
+	
+	// caution: do not try to implement pop_all_reversed here. the writer could add new elements
+	// while the reader is trying to pop old ones!
+	
+private:
+	struct alignas(2 * sizeof(void *)) Head {
+		Head() : mItem(NULL), mPops(0) { }
+		T *			mItem;
+		uintptr_t	mPops;
+	};
+
+	// A pop that loses the race reads next() while the winner may be writing it; the value is
+	// discarded, but the accesses must be atomic for that to be well defined.
+	static T *	load_next(T *item) {
+#if defined(__GNUC__)
+		return __atomic_load_n(&item->next(), __ATOMIC_RELAXED);
+#else
+		return item->next();
+#endif
+	}
+	static void	store_next(T *item, T *next) {
+#if defined(__GNUC__)
+		__atomic_store_n(&item->next(), next, __ATOMIC_RELAXED);
+#else
+		item->next() = next;
+#endif
+	}
+
+	std::atomic<Head>	mHead;
+};
 
 #endif // MAC_OS_X_VERSION_MAX_ALLOWED && !TARGET_OS_WIN32
 
@@ -24,6 +24,9 @@ inline void* CA_realloc(void* old, size_t size)
 {
 #if TARGET_OS_WIN32
 	void* p = realloc(old, size);
+#elif TARGET_OS_LINUX
+	void* p = realloc(old, size);
+	if (!p && size) free(old); // match reallocf, which frees the old pointer if memory is full.
 #else
 	void* p = reallocf(old, size); // reallocf ensures the old pointer is freed if memory is full (p is NULL).
 #endif
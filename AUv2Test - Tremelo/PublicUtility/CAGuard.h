@@ -51,7 +51,7 @@ public:
 
 //	Implementation
 protected:
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 	pthread_cond_t	mCondVar;
 #else
 	HANDLE			mEvent;
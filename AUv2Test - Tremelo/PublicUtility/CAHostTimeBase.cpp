@@ -12,16 +12,136 @@ Part of Core Audio Public Utility Classes
 
 #include "CAHostTimeBase.h"
 
+#if TARGET_OS_LINUX
+	#include <stdio.h>
+	#include <string.h>
+	#if TARGET_CPU_X86_64 || TARGET_CPU_X86
+		#include <cpuid.h>
+	#endif
+#endif
+
+#if TARGET_OS_LINUX
+//	CLOCK_MONOTONIC nanoseconds until Initialize has run
+Float64			CAHostTimeBase::sFrequency = 1000000000.0;
+Float64			CAHostTimeBase::sInverseFrequency = 1.0 / 1000000000.0;
+UInt32			CAHostTimeBase::sMinDelta = 1;
+UInt32			CAHostTimeBase::sToNanosNumerator = 1;
+UInt32			CAHostTimeBase::sToNanosDenominator = 1;
+bool			CAHostTimeBase::sUseCycleCounter = false;
+#else
 Float64			CAHostTimeBase::sFrequency = 0;
 Float64			CAHostTimeBase::sInverseFrequency = 0;
 UInt32			CAHostTimeBase::sMinDelta = 0;
 UInt32			CAHostTimeBase::sToNanosNumerator = 0;
 UInt32			CAHostTimeBase::sToNanosDenominator = 0;
+#endif
+#if CAHostTimeBase_Use_Fixed_Point
+UInt64			CAHostTimeBase::sToNanosMultiplier = 1ULL << kFixedPointShift;
+UInt64			CAHostTimeBase::sFromNanosMultiplier = 1ULL << kFixedPointShift;
+#endif
 pthread_once_t	CAHostTimeBase::sIsInited = PTHREAD_ONCE_INIT;
 #if Track_Host_TimeBase
 UInt64			CAHostTimeBase::sLastTime = 0;
 #endif
 
+//=============================================================================
+//	Linux cycle counter
+//=============================================================================
+
+#if TARGET_OS_LINUX
+
+//	how long the TSC is timed against CLOCK_MONOTONIC_RAW when its frequency isn't reported
+static const UInt64	kCalibrationNanos = 2000000ULL;
+
+#if TARGET_CPU_X86_64 || TARGET_CPU_X86
+//	a CLOCK_MONOTONIC_RAW reading and the TSC at the same moment, as well as that can be told
+static void	SampleTSCAndClock(UInt64& outTicks, UInt64& outNanos)
+{
+	UInt64 theNarrowest = ~0ULL;
+	for(int theTry = 0; theTry < 5; ++theTry)
+	{
+		struct timespec theValue;
+		UInt64 theBefore = CAHostTimeBase::ReadCycleCounter();
+		clock_gettime(CLOCK_MONOTONIC_RAW, &theValue);
+		UInt64 theAfter = CAHostTimeBase::ReadCycleCounter();
+		if(theAfter - theBefore < theNarrowest)
+		{
+			theNarrowest = theAfter - theBefore;
+			outTicks = theBefore + theNarrowest / 2;
+			outNanos = static_cast<UInt64>(theValue.tv_sec) * 1000000000ULL + static_cast<UInt64>(theValue.tv_nsec);
+		}
+	}
+}
+#endif
+
+//	The rate of the counter ReadCycleCounter reads, or 0 if the host time shouldn't use it.
+static UInt64	GetCycleCounterFrequency()
+{
+#if TARGET_CPU_X86_64 || TARGET_CPU_X86
+	//	the TSC must tick at a constant rate through frequency and power state changes
+	UInt32 theEAX, theEBX, theECX, theEDX;
+	if(!__get_cpuid(0x80000007, &theEAX, &theEBX, &theECX, &theEDX) || !(theEDX & (1U << 8)))
+	{
+		return 0;
+	}
+	
+	//	and be in step on every CPU; the kernel only makes it the clocksource when it is
+	char theClockSource[32] = { 0 };
+	FILE* theFile = fopen("/sys/devices/system/clocksource/clocksource0/current_clocksource", "r");
+	if(theFile == NULL)
+	{
+		return 0;
+	}
+	bool theClockSourceIsTSC = (fgets(theClockSource, sizeof(theClockSource), theFile) != NULL) && (strncmp(theClockSource, "tsc", 3) == 0);
+	fclose(theFile);
+	if(!theClockSourceIsTSC)
+	{
+		return 0;
+	}
+	
+	//	recent Intel CPUs report the TSC's rate as a ratio of the crystal clock
+	if(__get_cpuid_max(0, NULL) >= 0x15)
+	{
+		__cpuid(0x15, theEAX, theEBX, theECX, theEDX);
+		if((theEAX != 0) && (theEBX != 0) && (theECX != 0))
+		{
+			return static_cast<UInt64>(theECX) * theEBX / theEAX;
+		}
+	}
+	
+	//	otherwise time it
+	UInt64 theStartTicks = 0, theStartNanos = 0, theEndTicks = 0, theEndNanos = 0;
+	SampleTSCAndClock(theStartTicks, theStartNanos);
+	struct timespec theSleep = { 0, static_cast<long>(kCalibrationNanos) };
+	while(nanosleep(&theSleep, &theSleep) != 0)
+	{
+	}
+	SampleTSCAndClock(theEndTicks, theEndNanos);
+	if((theEndNanos <= theStartNanos) || (theEndTicks <= theStartTicks))
+	{
+		return 0;
+	}
+	Float64 theFrequency = static_cast<Float64>(theEndTicks - theStartTicks) * 1.0e9 / static_cast<Float64>(theEndNanos - theStartNanos);
+	//	round to the nearest kHz, the precision of the measurement
+	return static_cast<UInt64>(theFrequency / 1000.0 + 0.5) * 1000;
+#elif TARGET_CPU_ARM64
+	//	the generic timer's virtual count is always constant rate and readable from user space
+	UInt64 theFrequency;
+	__asm__ __volatile__("mrs %0, cntfrq_el0" : "=r" (theFrequency));
+	return theFrequency;
+#else
+	return 0;
+#endif
+}
+
+//	Chooses the host time source before any other static initializer can ask for the time.
+static struct CAHostTimeBaseInitializer
+{
+	CAHostTimeBaseInitializer() { CAHostTimeBase::Initialize(); }
+}	sHostTimeBaseInitializer __attribute__((init_priority(101)));
+
+#endif
+
 //=============================================================================
 //	CAHostTimeBase
 //
@@ -41,6 +161,28 @@ void	CAHostTimeBase::Initialize()
 		//	the frequency of that clock is: (sToNanosDenominator / sToNanosNumerator) * 10^9
 		sFrequency = static_cast<Float64>(sToNanosDenominator) / static_cast<Float64>(sToNanosNumerator);
 		sFrequency *= 1000000000.0;
+	#elif TARGET_OS_LINUX
+		UInt64 theCycleCounterFrequency = GetCycleCounterFrequency();
+		sMinDelta = 1;
+		if((theCycleCounterFrequency >= 1000000ULL) && CAHostTimeBase_Use_Fixed_Point)
+		{
+			//	nanos per tick is 10^6 / the frequency in kHz
+			sToNanosNumerator = 1000000;
+			sToNanosDenominator = static_cast<UInt32>(theCycleCounterFrequency / 1000);
+			sFrequency = static_cast<Float64>(theCycleCounterFrequency);
+			#if CAHostTimeBase_Use_Fixed_Point
+				sToNanosMultiplier = static_cast<UInt64>((static_cast<__uint128_t>(1000000000ULL) << kFixedPointShift) / theCycleCounterFrequency);
+				sFromNanosMultiplier = static_cast<UInt64>((static_cast<__uint128_t>(theCycleCounterFrequency) << kFixedPointShift) / 1000000000ULL);
+			#endif
+			sUseCycleCounter = true;
+		}
+		else
+		{
+			//	CLOCK_MONOTONIC is already in nanoseconds
+			sToNanosNumerator = 1;
+			sToNanosDenominator = 1;
+			sFrequency = 1000000000.0;
+		}
 	#elif TARGET_OS_WIN32
 		LARGE_INTEGER theFrequency;
 		QueryPerformanceFrequency(&theFrequency);
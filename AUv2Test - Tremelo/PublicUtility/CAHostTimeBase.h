@@ -22,6 +22,9 @@ Part of Core Audio Public Utility Classes
 #if TARGET_OS_MAC
 	#include <mach/mach_time.h>
 	#include <pthread.h>
+#elif TARGET_OS_LINUX
+	#include <time.h>
+	#include <pthread.h>
 #elif TARGET_OS_WIN32
 	#include <windows.h>
 	#include "WinPThreadDefs.h"
@@ -35,6 +38,15 @@ Part of Core Audio Public Utility Classes
 //	CAHostTimeBase
 //
 //	This class provides platform independent access to the host's time base.
+//
+//	On Linux the host time is the CPU's cycle counter where it runs at a
+//	constant rate and the kernel trusts it (an invariant TSC that is the
+//	kernel's clocksource on x86, the generic timer's virtual count on ARM64),
+//	and CLOCK_MONOTONIC nanoseconds (through the vDSO) otherwise. The counter
+//	and the conversion constants are chosen and calibrated once, by a static
+//	initializer, so reading the time and converting it never checks for
+//	initialization, and ConvertToNanos is a multiply and a shift. Until that
+//	initializer has run, the time is CLOCK_MONOTONIC nanoseconds.
 //=============================================================================
 
 #if CoreAudio_Debug
@@ -42,6 +54,12 @@ Part of Core Audio Public Utility Classes
 //	#define Track_Host_TimeBase				1
 #endif
 
+#if TARGET_OS_LINUX && TARGET_RT_64_BIT
+	#define	CAHostTimeBase_Use_Fixed_Point	1
+#else
+	#define	CAHostTimeBase_Use_Fixed_Point	0
+#endif
+
 class	CAHostTimeBase
 {
 
@@ -50,22 +68,30 @@ public:
 	static UInt64			ConvertFromNanos(UInt64 inNanos);
 
 	static UInt64			GetTheCurrentTime();
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 	static UInt64			GetCurrentTime() { return GetTheCurrentTime(); }
 #endif
 	static UInt64			GetCurrentTimeInNanos();
 
-	static Float64			GetFrequency() { pthread_once(&sIsInited, Initialize); return sFrequency; }
-	static Float64			GetInverseFrequency() { pthread_once(&sIsInited, Initialize); return sInverseFrequency; }
-	static UInt32			GetMinimumDelta() { pthread_once(&sIsInited, Initialize); return sMinDelta; }
+	static Float64			GetFrequency() { EnsureInitialized(); return sFrequency; }
+	static Float64			GetInverseFrequency() { EnsureInitialized(); return sInverseFrequency; }
+	static UInt32			GetMinimumDelta() { EnsureInitialized(); return sMinDelta; }
 
 	static UInt64			AbsoluteHostDeltaToNanos(UInt64 inStartTime, UInt64 inEndTime);
 	static SInt64			HostDeltaToNanos(UInt64 inStartTime, UInt64 inEndTime);
 
 	static UInt64			MultiplyByRatio(UInt64 inMuliplicand, UInt32 inNumerator, UInt32 inDenominator);
+
+#if TARGET_OS_LINUX
+	//	the CPU's cycle counter, whether or not the host time is using it
+	static UInt64			ReadCycleCounter();
+#endif
 	
 private:
+	friend struct			CAHostTimeBaseInitializer;
+
 	static void				Initialize();
+	static void				EnsureInitialized();
 	
 	static pthread_once_t	sIsInited;
 	
@@ -74,17 +100,60 @@ private:
 	static UInt32			sMinDelta;
 	static UInt32			sToNanosNumerator;
 	static UInt32			sToNanosDenominator;
+#if TARGET_OS_LINUX
+	static bool				sUseCycleCounter;
+#endif
+#if CAHostTimeBase_Use_Fixed_Point
+	enum					{ kFixedPointShift = 32 };
+	static UInt64			sToNanosMultiplier;		//	nanos per host tick, 32.32 fixed point
+	static UInt64			sFromNanosMultiplier;	//	host ticks per nano, 32.32 fixed point
+#endif
 #if Track_Host_TimeBase
 	static UInt64			sLastTime;
 #endif
 };
 
+inline void	CAHostTimeBase::EnsureInitialized()
+{
+	#if !TARGET_OS_LINUX
+		pthread_once(&sIsInited, Initialize);
+	#endif
+}
+
+#if TARGET_OS_LINUX
+inline UInt64	CAHostTimeBase::ReadCycleCounter()
+{
+	#if TARGET_CPU_X86_64 || TARGET_CPU_X86
+		UInt32 theLow, theHigh;
+		__asm__ __volatile__("rdtsc" : "=a" (theLow), "=d" (theHigh));
+		return (static_cast<UInt64>(theHigh) << 32) | theLow;
+	#elif TARGET_CPU_ARM64
+		UInt64 theCount;
+		__asm__ __volatile__("mrs %0, cntvct_el0" : "=r" (theCount));
+		return theCount;
+	#else
+		return 0;
+	#endif
+}
+#endif
+
 inline UInt64	CAHostTimeBase::GetTheCurrentTime()
 {
 	UInt64 theTime = 0;
 
 	#if TARGET_OS_MAC
 		theTime = mach_absolute_time();
+	#elif TARGET_OS_LINUX
+		if(sUseCycleCounter)
+		{
+			theTime = ReadCycleCounter();
+		}
+		else
+		{
+			struct timespec theValue;
+			clock_gettime(CLOCK_MONOTONIC, &theValue);
+			theTime = static_cast<UInt64>(theValue.tv_sec) * 1000000000ULL + static_cast<UInt64>(theValue.tv_nsec);
+		}
 	#elif TARGET_OS_WIN32
 		LARGE_INTEGER theValue;
 		QueryPerformanceCounter(&theValue);
@@ -111,7 +180,10 @@ inline UInt64	CAHostTimeBase::GetTheCurrentTime()
 
 inline UInt64	CAHostTimeBase::ConvertToNanos(UInt64 inHostTime)
 {
-	pthread_once(&sIsInited, Initialize);
+#if CAHostTimeBase_Use_Fixed_Point
+	return static_cast<UInt64>((static_cast<__uint128_t>(inHostTime) * sToNanosMultiplier) >> kFixedPointShift);
+#else
+	EnsureInitialized();
 	
 	UInt64 theAnswer = MultiplyByRatio(inHostTime, sToNanosNumerator, sToNanosDenominator);
 	#if CoreAudio_Debug
@@ -122,11 +194,15 @@ inline UInt64	CAHostTimeBase::ConvertToNanos(UInt64 inHostTime)
 	#endif
 	
 	return theAnswer;
+#endif
 }
 
 inline UInt64	CAHostTimeBase::ConvertFromNanos(UInt64 inNanos)
 {
-	pthread_once(&sIsInited, Initialize);
+#if CAHostTimeBase_Use_Fixed_Point
+	return static_cast<UInt64>((static_cast<__uint128_t>(inNanos) * sFromNanosMultiplier) >> kFixedPointShift);
+#else
+	EnsureInitialized();
 
 	UInt64 theAnswer = MultiplyByRatio(inNanos, sToNanosDenominator, sToNanosNumerator);
 	#if CoreAudio_Debug
@@ -137,6 +213,7 @@ inline UInt64	CAHostTimeBase::ConvertFromNanos(UInt64 inNanos)
 	#endif
 
 	return theAnswer;
+#endif
 }
 
 inline UInt64	CAHostTimeBase::GetCurrentTimeInNanos()
@@ -180,7 +257,7 @@ inline SInt64	CAHostTimeBase::HostDeltaToNanos(UInt64 inStartTime, UInt64 inEndT
 
 inline UInt64	CAHostTimeBase::MultiplyByRatio(UInt64 inMuliplicand, UInt32 inNumerator, UInt32 inDenominator)
 {
-#if TARGET_OS_MAC && TARGET_RT_64_BIT
+#if (TARGET_OS_MAC || TARGET_OS_LINUX) && TARGET_RT_64_BIT
 	__uint128_t theAnswer = inMuliplicand;
 #else
 	long double theAnswer = inMuliplicand;
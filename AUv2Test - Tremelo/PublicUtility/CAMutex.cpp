@@ -13,10 +13,15 @@ Part of Core Audio Public Utility Classes
 //	Self Include
 #include "CAMutex.h"
 
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 	#include <errno.h>
+	#include <unistd.h>
 #endif
 
+//	Standard Library Includes
+#include <mutex>
+#include <string.h>
+
 //	PublicUtility Includes
 #include "CADebugMacros.h"
 #include "CAException.h"
@@ -33,42 +38,205 @@ Part of Core Audio Public Utility Classes
 //	#define LongLatencyThreshholdNS	1000000ULL	// nanoseconds
 #endif
 
+//==================================================================================================
+//	Contention profiling
+//==================================================================================================
+
+struct	CAMutex::ProfileRecord
+{
+	char*					mName;
+	std::atomic<UInt64>		mLocks;
+	std::atomic<UInt64>		mContendedLocks;
+	std::atomic<UInt64>		mFailedTries;
+	std::atomic<UInt64>		mWaitNanos;
+	std::atomic<UInt64>		mMaxWaitNanos;
+	std::atomic<UInt64>		mHoldNanos;
+	std::atomic<UInt64>		mMaxHoldNanos;
+	std::atomic<UInt32>		mWaiters;
+	std::atomic<UInt32>		mMaxWaiters;
+	ProfileRecord*			mNext;
+};
+
+//	The records are never freed, so a mutex can keep a pointer to its record.
+static std::mutex					sProfileRecordsMutex;
+static CAMutex::ProfileRecord*		sProfileRecords = NULL;
+
+std::atomic<bool>	CAMutex::sProfiling(false);
+
+template <typename T>
+static void	StoreMax(std::atomic<T>& ioMax, T inValue)
+{
+	T theMax = ioMax.load(std::memory_order_relaxed);
+	while(inValue > theMax && !ioMax.compare_exchange_weak(theMax, inValue, std::memory_order_relaxed))
+	{
+	}
+}
+
+void	CAMutex::SetProfiling(bool inProfiling)
+{
+	sProfiling.store(inProfiling, std::memory_order_relaxed);
+}
+
+UInt32	CAMutex::GetProfiles(Profile* outProfiles, UInt32 inMaxProfiles)
+{
+	std::lock_guard<std::mutex> theLock(sProfileRecordsMutex);
+	UInt32 theCount = 0;
+	for(ProfileRecord* theRecord = sProfileRecords; theRecord != NULL; theRecord = theRecord->mNext, ++theCount)
+	{
+		if((outProfiles != NULL) && (theCount < inMaxProfiles))
+		{
+			Profile& theProfile = outProfiles[theCount];
+			theProfile.mName = theRecord->mName;
+			theProfile.mLocks = theRecord->mLocks.load(std::memory_order_relaxed);
+			theProfile.mContendedLocks = theRecord->mContendedLocks.load(std::memory_order_relaxed);
+			theProfile.mFailedTries = theRecord->mFailedTries.load(std::memory_order_relaxed);
+			theProfile.mWaitNanos = theRecord->mWaitNanos.load(std::memory_order_relaxed);
+			theProfile.mMaxWaitNanos = theRecord->mMaxWaitNanos.load(std::memory_order_relaxed);
+			theProfile.mHoldNanos = theRecord->mHoldNanos.load(std::memory_order_relaxed);
+			theProfile.mMaxHoldNanos = theRecord->mMaxHoldNanos.load(std::memory_order_relaxed);
+			theProfile.mMaxWaiters = theRecord->mMaxWaiters.load(std::memory_order_relaxed);
+		}
+	}
+	return theCount;
+}
+
+void	CAMutex::ResetProfiles()
+{
+	std::lock_guard<std::mutex> theLock(sProfileRecordsMutex);
+	for(ProfileRecord* theRecord = sProfileRecords; theRecord != NULL; theRecord = theRecord->mNext)
+	{
+		theRecord->mLocks.store(0, std::memory_order_relaxed);
+		theRecord->mContendedLocks.store(0, std::memory_order_relaxed);
+		theRecord->mFailedTries.store(0, std::memory_order_relaxed);
+		theRecord->mWaitNanos.store(0, std::memory_order_relaxed);
+		theRecord->mMaxWaitNanos.store(0, std::memory_order_relaxed);
+		theRecord->mHoldNanos.store(0, std::memory_order_relaxed);
+		theRecord->mMaxHoldNanos.store(0, std::memory_order_relaxed);
+		theRecord->mMaxWaiters.store(theRecord->mWaiters.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+}
+
+//	Called by the constructor, so that the lock and try paths, which may run on the render thread,
+//	never take sProfileRecordsMutex or allocate.
+CAMutex::ProfileRecord*	CAMutex::FindProfileRecord(const char* inName)
+{
+	const char* theName = (inName != NULL) ? inName : "(unnamed)";
+	std::lock_guard<std::mutex> theLock(sProfileRecordsMutex);
+	ProfileRecord* theRecord;
+	for(theRecord = sProfileRecords; theRecord != NULL; theRecord = theRecord->mNext)
+	{
+		if(strcmp(theRecord->mName, theName) == 0)
+		{
+			return theRecord;
+		}
+	}
+	theRecord = new ProfileRecord();
+	theRecord->mName = strdup(theName);
+	theRecord->mNext = sProfileRecords;
+	sProfileRecords = theRecord;
+	return theRecord;
+}
+
+void	CAMutex::RecordLock(bool inContended, UInt64 inWaitNanos)
+{
+	ProfileRecord* theRecord = mProfileRecord;
+	theRecord->mLocks.fetch_add(1, std::memory_order_relaxed);
+	if(inContended)
+	{
+		theRecord->mContendedLocks.fetch_add(1, std::memory_order_relaxed);
+		theRecord->mWaitNanos.fetch_add(inWaitNanos, std::memory_order_relaxed);
+		StoreMax(theRecord->mMaxWaitNanos, inWaitNanos);
+	}
+	mLockedAtNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+}
+
+void	CAMutex::RecordUnlock()
+{
+	//	still recorded if profiling was turned off while the lock was held
+	UInt64 theHoldNanos = CAHostTimeBase::GetCurrentTimeInNanos() - mLockedAtNanos;
+	mLockedAtNanos = 0;
+	ProfileRecord* theRecord = mProfileRecord;
+	theRecord->mHoldNanos.fetch_add(theHoldNanos, std::memory_order_relaxed);
+	StoreMax(theRecord->mMaxHoldNanos, theHoldNanos);
+}
+
+void	CAMutex::RecordFailedTry()
+{
+	mProfileRecord->mFailedTries.fetch_add(1, std::memory_order_relaxed);
+}
+
 //==================================================================================================
 //	CAMutex
 //==================================================================================================
 
-CAMutex::CAMutex(const char* inName)
+#if TARGET_OS_MAC || TARGET_OS_LINUX
+//	how many times a busy lock is retried before blocking, with kSpinBeforeBlocking
+static const UInt32	kSpinCount = 256;
+
+static inline void	CAMutexSpinPause()
+{
+	#if defined(__i386__) || defined(__x86_64__)
+		__builtin_ia32_pause();
+	#elif defined(__arm__) || defined(__aarch64__)
+		__asm__ __volatile__("yield");
+	#endif
+}
+#endif
+
+CAMutex::CAMutex(const char* inName, UInt32 inOptions)
 :
 	mName(inName),
-	mOwner(0)
+	mOptions(inOptions),
+	mOwner(0),
+	mLockedAtNanos(0),
+	mProfileRecord(FindProfileRecord(inName))
 {
-#if TARGET_OS_MAC
-	OSStatus theError = pthread_mutex_init(&mMutex, NULL);
+#if TARGET_OS_MAC || TARGET_OS_LINUX
+	//	spinning only helps if the owner can run meanwhile
+	static const bool sMultiprocessor = sysconf(_SC_NPROCESSORS_ONLN) > 1;
+	if(!sMultiprocessor)
+	{
+		mOptions &= ~kSpinBeforeBlocking;
+	}
+	
+	pthread_mutexattr_t theAttributes;
+	pthread_mutexattr_init(&theAttributes);
+	#if defined(_POSIX_THREAD_PRIO_INHERIT) && (_POSIX_THREAD_PRIO_INHERIT > 0)
+		if((mOptions & kPriorityInheritance) && (pthread_mutexattr_setprotocol(&theAttributes, PTHREAD_PRIO_INHERIT) != 0))
+		{
+			//	not supported here; fall back to a plain mutex
+			mOptions &= ~kPriorityInheritance;
+		}
+	#else
+		mOptions &= ~kPriorityInheritance;
+	#endif
+	OSStatus theError = pthread_mutex_init(&mMutex, &theAttributes);
+	pthread_mutexattr_destroy(&theAttributes);
 	ThrowIf(theError != 0, CAException(theError), "CAMutex::CAMutex: Could not init the mutex");
 	
 	#if	Log_Ownership
-		DebugPrintf("%p %.4f: CAMutex::CAMutex: creating %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), mName, mOwner);
+		DebugPrintf("%p %.4f: CAMutex::CAMutex: creating %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), mName, mOwner.load());
 	#endif
 #elif TARGET_OS_WIN32
 	mMutex = CreateMutex(NULL, false, NULL);
 	ThrowIfNULL(mMutex, CAException(GetLastError()), "CAMutex::CAMutex: could not create the mutex.");
 	
 	#if	Log_Ownership
-		DebugPrintf("%lu %.4f: CAMutex::CAMutex: creating %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), mName, mOwner);
+		DebugPrintf("%lu %.4f: CAMutex::CAMutex: creating %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), mName, mOwner.load());
 	#endif
 #endif
 }
 
 CAMutex::~CAMutex()
 {
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 	#if	Log_Ownership
-		DebugPrintf("%p %.4f: CAMutex::~CAMutex: destroying %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), mName, mOwner);
+		DebugPrintf("%p %.4f: CAMutex::~CAMutex: destroying %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), mName, mOwner.load());
 	#endif
 	pthread_mutex_destroy(&mMutex);
 #elif TARGET_OS_WIN32
 	#if	Log_Ownership
-		DebugPrintf("%lu %.4f: CAMutex::~CAMutex: destroying %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), mName, mOwner);
+		DebugPrintf("%lu %.4f: CAMutex::~CAMutex: destroying %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), mName, mOwner.load());
 	#endif
 	if(mMutex != NULL)
 	{
@@ -81,22 +249,62 @@ bool	CAMutex::Lock()
 {
 	bool theAnswer = false;
 	
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 	pthread_t theCurrentThread = pthread_self();
-	if(!pthread_equal(theCurrentThread, mOwner))
+	if(!pthread_equal(theCurrentThread, mOwner.load(std::memory_order_relaxed)))
 	{
 		#if	Log_Ownership
-			DebugPrintf("%p %.4f: CAMutex::Lock: thread %p is locking %s, owner: %p\n", theCurrentThread, ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), theCurrentThread, mName, mOwner);
+			DebugPrintf("%p %.4f: CAMutex::Lock: thread %p is locking %s, owner: %p\n", theCurrentThread, ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), theCurrentThread, mName, mOwner.load());
 		#endif
 		
 		#if Log_LongLatencies
 			UInt64 lockTryTime = CAHostTimeBase::GetCurrentTimeInNanos();
 		#endif
 		
-		OSStatus theError = pthread_mutex_lock(&mMutex);
+		//	take it if it's free; if not, spin for a while if asked to, then block
+		OSStatus theError = pthread_mutex_trylock(&mMutex);
+		bool theLockWasBusy = (theError == EBUSY);
+		UInt64 theWaitNanos = 0;
+		if(theLockWasBusy)
+		{
+			bool isProfiling = sProfiling.load(std::memory_order_relaxed);
+			UInt64 theWaitStartNanos = isProfiling ? CAHostTimeBase::GetCurrentTimeInNanos() : 0;
+			if(mOptions & kSpinBeforeBlocking)
+			{
+				for(UInt32 theSpin = 0; (theSpin < kSpinCount) && (theError == EBUSY); ++theSpin)
+				{
+					CAMutexSpinPause();
+					if(mOwner.load(std::memory_order_relaxed) == 0)
+					{
+						theError = pthread_mutex_trylock(&mMutex);
+					}
+				}
+			}
+			if(theError == EBUSY)
+			{
+				ProfileRecord* theRecord = isProfiling ? mProfileRecord : NULL;
+				if(theRecord != NULL)
+				{
+					StoreMax(theRecord->mMaxWaiters, theRecord->mWaiters.fetch_add(1, std::memory_order_relaxed) + 1);
+				}
+				theError = pthread_mutex_lock(&mMutex);
+				if(theRecord != NULL)
+				{
+					theRecord->mWaiters.fetch_sub(1, std::memory_order_relaxed);
+				}
+			}
+			if(isProfiling)
+			{
+				theWaitNanos = CAHostTimeBase::GetCurrentTimeInNanos() - theWaitStartNanos;
+			}
+		}
 		ThrowIf(theError != 0, CAException(theError), "CAMutex::Lock: Could not lock the mutex");
-		mOwner = theCurrentThread;
+		mOwner.store(theCurrentThread, std::memory_order_relaxed);
 		theAnswer = true;
+		if(sProfiling.load(std::memory_order_relaxed))
+		{
+			RecordLock(theLockWasBusy, theWaitNanos);
+		}
 	
 		#if Log_LongLatencies
 			UInt64 lockAcquireTime = CAHostTimeBase::GetCurrentTimeInNanos();
@@ -105,23 +313,35 @@ bool	CAMutex::Lock()
 		#endif
 		
 		#if	Log_Ownership
-			DebugPrintf("%p %.4f: CAMutex::Lock: thread %p has locked %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
+			DebugPrintf("%p %.4f: CAMutex::Lock: thread %p has locked %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner.load());
 		#endif
 	}
 #elif TARGET_OS_WIN32
 	if(mOwner != GetCurrentThreadId())
 	{
 		#if	Log_Ownership
-			DebugPrintf("%lu %.4f: CAMutex::Lock: thread %lu is locking %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner);
+			DebugPrintf("%lu %.4f: CAMutex::Lock: thread %lu is locking %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner.load());
 		#endif
 
-		OSStatus theError = WaitForSingleObject(mMutex, INFINITE);
+		OSStatus theError = WaitForSingleObject(mMutex, 0);
+		bool theLockWasBusy = (theError == WAIT_TIMEOUT);
+		UInt64 theWaitNanos = 0;
+		if(theLockWasBusy)
+		{
+			UInt64 theWaitStartNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+			theError = WaitForSingleObject(mMutex, INFINITE);
+			theWaitNanos = CAHostTimeBase::GetCurrentTimeInNanos() - theWaitStartNanos;
+		}
 		ThrowIfError(theError, CAException(theError), "CAMutex::Lock: could not lock the mutex");
 		mOwner = GetCurrentThreadId();
 		theAnswer = true;
+		if(sProfiling.load(std::memory_order_relaxed))
+		{
+			RecordLock(theLockWasBusy, theWaitNanos);
+		}
 	
 		#if	Log_Ownership
-			DebugPrintf("%lu %.4f: CAMutex::Lock: thread %lu has locked %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner);
+			DebugPrintf("%lu %.4f: CAMutex::Lock: thread %lu has locked %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner.load());
 		#endif
 	}
 #endif
@@ -131,19 +351,23 @@ bool	CAMutex::Lock()
 
 void	CAMutex::Unlock()
 {
-#if TARGET_OS_MAC
-	if(pthread_equal(pthread_self(), mOwner))
+#if TARGET_OS_MAC || TARGET_OS_LINUX
+	if(pthread_equal(pthread_self(), mOwner.load(std::memory_order_relaxed)))
 	{
 		#if	Log_Ownership
-			DebugPrintf("%p %.4f: CAMutex::Unlock: thread %p is unlocking %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
+			DebugPrintf("%p %.4f: CAMutex::Unlock: thread %p is unlocking %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner.load());
 		#endif
 
-		mOwner = 0;
+		if(mLockedAtNanos != 0)
+		{
+			RecordUnlock();
+		}
+		mOwner.store(0, std::memory_order_relaxed);
 		OSStatus theError = pthread_mutex_unlock(&mMutex);
 		ThrowIf(theError != 0, CAException(theError), "CAMutex::Unlock: Could not unlock the mutex");
 	
 		#if	Log_Ownership
-			DebugPrintf("%p %.4f: CAMutex::Unlock: thread %p has unlocked %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner);
+			DebugPrintf("%p %.4f: CAMutex::Unlock: thread %p has unlocked %s, owner: %p\n", pthread_self(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), pthread_self(), mName, mOwner.load());
 		#endif
 	}
 	else
@@ -154,15 +378,19 @@ void	CAMutex::Unlock()
 	if(mOwner == GetCurrentThreadId())
 	{
 		#if	Log_Ownership
-			DebugPrintf("%lu %.4f: CAMutex::Unlock: thread %lu is unlocking %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner);
+			DebugPrintf("%lu %.4f: CAMutex::Unlock: thread %lu is unlocking %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner.load());
 		#endif
 
+		if(mLockedAtNanos != 0)
+		{
+			RecordUnlock();
+		}
 		mOwner = 0;
 		bool wasReleased = ReleaseMutex(mMutex);
 		ThrowIf(!wasReleased, CAException(GetLastError()), "CAMutex::Unlock: Could not unlock the mutex");
 	
 		#if	Log_Ownership
-			DebugPrintf("%lu %.4f: CAMutex::Unlock: thread %lu has unlocked %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner);
+			DebugPrintf("%lu %.4f: CAMutex::Unlock: thread %lu has unlocked %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner.load());
 		#endif
 	}
 	else
@@ -177,13 +405,13 @@ bool	CAMutex::Try(bool& outWasLocked)
 	bool theAnswer = false;
 	outWasLocked = false;
 
-#if TARGET_OS_MAC
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 	pthread_t theCurrentThread = pthread_self();
-	if(!pthread_equal(theCurrentThread, mOwner))
+	if(!pthread_equal(theCurrentThread, mOwner.load(std::memory_order_relaxed)))
 	{
 		//	this means the current thread doesn't already own the lock
 		#if	Log_Ownership
-			DebugPrintf("%p %.4f: CAMutex::Try: thread %p is try-locking %s, owner: %p\n", theCurrentThread, ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), theCurrentThread, mName, mOwner);
+			DebugPrintf("%p %.4f: CAMutex::Try: thread %p is try-locking %s, owner: %p\n", theCurrentThread, ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), theCurrentThread, mName, mOwner.load());
 		#endif
 
 		//	go ahead and call trylock to see if we can lock it.
@@ -191,12 +419,16 @@ bool	CAMutex::Try(bool& outWasLocked)
 		if(theError == 0)
 		{
 			//	return value of 0 means we successfully locked the lock
-			mOwner = theCurrentThread;
+			mOwner.store(theCurrentThread, std::memory_order_relaxed);
 			theAnswer = true;
 			outWasLocked = true;
+			if(sProfiling.load(std::memory_order_relaxed))
+			{
+				RecordLock(false, 0);
+			}
 	
 			#if	Log_Ownership
-				DebugPrintf("%p %.4f: CAMutex::Try: thread %p has locked %s, owner: %p\n", theCurrentThread, ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), theCurrentThread, mName, mOwner);
+				DebugPrintf("%p %.4f: CAMutex::Try: thread %p has locked %s, owner: %p\n", theCurrentThread, ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), theCurrentThread, mName, mOwner.load());
 			#endif
 		}
 		else if(theError == EBUSY)
@@ -204,9 +436,13 @@ bool	CAMutex::Try(bool& outWasLocked)
 			//	return value of EBUSY means that the lock was already locked by another thread
 			theAnswer = false;
 			outWasLocked = false;
+			if(sProfiling.load(std::memory_order_relaxed))
+			{
+				RecordFailedTry();
+			}
 	
 			#if	Log_Ownership
-				DebugPrintf("%p %.4f: CAMutex::Try: thread %p failed to lock %s, owner: %p\n", theCurrentThread, ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), theCurrentThread, mName, mOwner);
+				DebugPrintf("%p %.4f: CAMutex::Try: thread %p failed to lock %s, owner: %p\n", theCurrentThread, ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), theCurrentThread, mName, mOwner.load());
 			#endif
 		}
 		else
@@ -226,7 +462,7 @@ bool	CAMutex::Try(bool& outWasLocked)
 	{
 		//	this means the current thread doesn't own the lock
 		#if	Log_Ownership
-			DebugPrintf("%lu %.4f: CAMutex::Try: thread %lu is try-locking %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner);
+			DebugPrintf("%lu %.4f: CAMutex::Try: thread %lu is try-locking %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner.load());
 		#endif
 		
 		//	try to acquire the mutex
@@ -237,9 +473,13 @@ bool	CAMutex::Try(bool& outWasLocked)
 			mOwner = GetCurrentThreadId();
 			theAnswer = true;
 			outWasLocked = true;
+			if(sProfiling.load(std::memory_order_relaxed))
+			{
+				RecordLock(false, 0);
+			}
 	
 			#if	Log_Ownership
-				DebugPrintf("%lu %.4f: CAMutex::Try: thread %lu has locked %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner);
+				DebugPrintf("%lu %.4f: CAMutex::Try: thread %lu has locked %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner.load());
 			#endif
 		}
 		else if(theError == WAIT_TIMEOUT)
@@ -247,9 +487,13 @@ bool	CAMutex::Try(bool& outWasLocked)
 			//	this means that the lock was already locked by another thread
 			theAnswer = false;
 			outWasLocked = false;
+			if(sProfiling.load(std::memory_order_relaxed))
+			{
+				RecordFailedTry();
+			}
 	
 			#if	Log_Ownership
-				DebugPrintf("%lu %.4f: CAMutex::Try: thread %lu failed to lock %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner);
+				DebugPrintf("%lu %.4f: CAMutex::Try: thread %lu failed to lock %s, owner: %lu\n", GetCurrentThreadId(), ((Float64)(CAHostTimeBase::GetCurrentTimeInNanos()) / 1000000.0), GetCurrentThreadId(), mName, mOwner.load());
 			#endif
 		}
 		else
@@ -271,15 +515,15 @@ bool	CAMutex::Try(bool& outWasLocked)
 
 bool	CAMutex::IsFree() const
 {
-	return mOwner == 0;
+	return mOwner.load(std::memory_order_relaxed) == 0;
 }
 
 bool	CAMutex::IsOwnedByCurrentThread() const
 {
 	bool theAnswer = true;
 	
-#if TARGET_OS_MAC
-	theAnswer = pthread_equal(pthread_self(), mOwner);
+#if TARGET_OS_MAC || TARGET_OS_LINUX
+	theAnswer = pthread_equal(pthread_self(), mOwner.load(std::memory_order_relaxed));
 #elif TARGET_OS_WIN32
 	theAnswer = (mOwner == GetCurrentThreadId());
 #endif
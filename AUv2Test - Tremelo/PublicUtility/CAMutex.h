@@ -20,7 +20,9 @@ Part of Core Audio Public Utility Classes
 	#include <CoreAudioTypes.h>
 #endif
 
-#if TARGET_OS_MAC
+#include <atomic>
+
+#if TARGET_OS_MAC || TARGET_OS_LINUX
 	#include <pthread.h>
 #elif TARGET_OS_WIN32
 	#include <windows.h>
@@ -30,13 +32,32 @@ Part of Core Audio Public Utility Classes
 
 //==================================================================================================
 //	A recursive mutex.
+//
+//	Options passed to the constructor:
+//	kPriorityInheritance	the thread holding the lock runs at the priority of the highest priority
+//							thread waiting for it (PTHREAD_PRIO_INHERIT), so a UI thread holding it
+//							can't be starved by medium priority work while a real-time thread waits.
+//	kSpinBeforeBlocking		a busy lock is retried for a short while before the thread sleeps on it,
+//							for locks held only briefly. Ignored on single processor machines.
+//
+//	When profiling is on (SetProfiling), every lock records how long it was waited for and held,
+//	and how many threads waited at once, in a record shared by all mutexes with the same name. The
+//	constructor finds or makes that record, so locking and trying only update its atomic counters.
 //==================================================================================================
 
 class	CAMutex
 {
+//	Constants
+public:
+	enum
+	{
+					kPriorityInheritance	= 1,
+					kSpinBeforeBlocking		= 2
+	};
+
 //	Construction/Destruction
 public:
-					CAMutex(const char* inName);
+					CAMutex(const char* inName, UInt32 inOptions = 0);
 	virtual			~CAMutex();
 
 //	Actions
@@ -45,19 +66,54 @@ public:
 	virtual void	Unlock();
 	virtual bool	Try(bool& outWasLocked);	// returns true if lock is free, false if not
 	
+	//	Try without the virtual call, the logging or the exceptions; never blocks, so it can be used on
+	//	the render thread. Same results as Try.
+	bool			TryFast(bool& outWasLocked);
+	
 	virtual bool	IsFree() const;
 	virtual bool	IsOwnedByCurrentThread() const;
+
+//	Contention profiling
+public:
+	struct			Profile
+	{
+		const char*	mName;
+		UInt64		mLocks;				//	times the lock was taken (not counting recursive locks)
+		UInt64		mContendedLocks;	//	of those, the times it was busy
+		UInt64		mFailedTries;		//	Try and TryFast calls that found it busy
+		UInt64		mWaitNanos;			//	total and longest time spent waiting for it
+		UInt64		mMaxWaitNanos;
+		UInt64		mHoldNanos;			//	total and longest time it was held
+		UInt64		mMaxHoldNanos;
+		UInt32		mMaxWaiters;		//	most threads waiting for it at once
+	};
+	
+	static void		SetProfiling(bool inProfiling);
+	static UInt32	GetProfiles(Profile* outProfiles, UInt32 inMaxProfiles);	// returns the number of names profiled
+	static void		ResetProfiles();
+	
+	struct			ProfileRecord;	//	the counters behind a Profile, private to CAMutex.cpp
 		
 //	Implementation
 protected:
+	void			RecordLock(bool inContended, UInt64 inWaitNanos);
+	void			RecordUnlock();
+	void			RecordFailedTry();
+	static ProfileRecord*	FindProfileRecord(const char* inName);
+	
+	static std::atomic<bool>	sProfiling;
+	
 	const char*		mName;
-#if TARGET_OS_MAC
-	pthread_t		mOwner;
+	UInt32			mOptions;
+#if TARGET_OS_MAC || TARGET_OS_LINUX
+	std::atomic<pthread_t>	mOwner;
 	pthread_mutex_t	mMutex;
 #elif TARGET_OS_WIN32
-	UInt32			mOwner;
+	std::atomic<UInt32>	mOwner;
 	HANDLE			mMutex;
 #endif
+	UInt64			mLockedAtNanos;		//	only touched by the owner; 0 unless profiling
+	ProfileRecord* const	mProfileRecord;
 
 //	Helper class to manage taking and releasing recursively
 public:
@@ -66,10 +122,23 @@ public:
 	
 	//	Construction/Destruction
 	public:
-					Locker(CAMutex& inMutex) : mMutex(&inMutex), mNeedsRelease(false) { mNeedsRelease = mMutex->Lock(); }
-					Locker(CAMutex* inMutex) : mMutex(inMutex), mNeedsRelease(false) { mNeedsRelease = (mMutex != NULL && mMutex->Lock()); }
+					Locker(CAMutex& inMutex) : mMutex(&inMutex), mNeedsRelease(false), mHasLock(true) { mNeedsRelease = mMutex->Lock(); }
+					Locker(CAMutex* inMutex) : mMutex(inMutex), mNeedsRelease(false), mHasLock(true) { mNeedsRelease = (mMutex != NULL && mMutex->Lock()); }
 						// in this case the mutex can be null
+					Locker(CAMutex* inMutex, bool inMustNotBlock) : mMutex(inMutex), mNeedsRelease(false), mHasLock(true)
+					{
+						if(mMutex != NULL)
+						{
+							if(inMustNotBlock)
+								mHasLock = mMutex->TryFast(mNeedsRelease);
+							else
+								mNeedsRelease = mMutex->Lock();
+						}
+					}
+						// when inMustNotBlock is true the lock is only tried; check HasLock
 					~Locker() { if(mNeedsRelease) { mMutex->Unlock(); } }
+		
+		bool		HasLock() const { return mHasLock; }
 	
 	
 	private:
@@ -80,6 +149,7 @@ public:
 	private:
 		CAMutex*	mMutex;
 		bool		mNeedsRelease;
+		bool		mHasLock;
 	
 	};
 
@@ -121,5 +191,41 @@ public:
 	};
 };
 
+inline bool	CAMutex::TryFast(bool& outWasLocked)
+{
+	outWasLocked = false;
+#if TARGET_OS_MAC || TARGET_OS_LINUX
+	pthread_t theCurrentThread = pthread_self();
+	if(pthread_equal(theCurrentThread, mOwner.load(std::memory_order_relaxed)))
+	{
+		return true;
+	}
+	if(pthread_mutex_trylock(&mMutex) != 0)
+	{
+		if(sProfiling.load(std::memory_order_relaxed))
+			RecordFailedTry();
+		return false;
+	}
+	mOwner.store(theCurrentThread, std::memory_order_relaxed);
+#elif TARGET_OS_WIN32
+	UInt32 theCurrentThread = GetCurrentThreadId();
+	if(mOwner.load(std::memory_order_relaxed) == theCurrentThread)
+	{
+		return true;
+	}
+	if(WaitForSingleObject(mMutex, 0) != WAIT_OBJECT_0)
+	{
+		if(sProfiling.load(std::memory_order_relaxed))
+			RecordFailedTry();
+		return false;
+	}
+	mOwner.store(theCurrentThread, std::memory_order_relaxed);
+#endif
+	if(sProfiling.load(std::memory_order_relaxed))
+		RecordLock(false, 0);
+	outWasLocked = true;
+	return true;
+}
+
 
 #endif // __CAMutex_h__
@@ -435,7 +435,7 @@ private:
 // operator== is deprecated because it uses the deprecated IsEqual(other, true).
 bool		operator<(const AudioStreamBasicDescription& x, const AudioStreamBasicDescription& y);
 ASBD_EQUALITY_DEPRECATED bool		operator==(const AudioStreamBasicDescription& x, const AudioStreamBasicDescription& y);
-#if TARGET_OS_MAC || (TARGET_OS_WIN32 && (_MSC_VER > 600))
+#if TARGET_OS_MAC || TARGET_OS_LINUX || (TARGET_OS_WIN32 && (_MSC_VER > 600))
 ASBD_EQUALITY_DEPRECATED inline bool	operator!=(const AudioStreamBasicDescription& x, const AudioStreamBasicDescription& y) { return !(x == y); }
 ASBD_EQUALITY_DEPRECATED inline bool	operator<=(const AudioStreamBasicDescription& x, const AudioStreamBasicDescription& y) { return (x < y) || (x == y); }
 ASBD_EQUALITY_DEPRECATED inline bool	operator>=(const AudioStreamBasicDescription& x, const AudioStreamBasicDescription& y) { return !(x < y); }
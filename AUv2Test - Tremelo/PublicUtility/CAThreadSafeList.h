@@ -10,9 +10,14 @@ Part of Core Audio Public Utility Classes
 #define __CAThreadSafeList_h__
 
 #include "CAAtomicStack.h"
+#include "CAAutoDisposer.h"
 
 //  linked list of T's
 //	T must define operator ==
+//
+//	Nodes for the deferred requests come from a block allocated up front (kDefaultNodeCount, or
+//	the count passed to the constructor) and are recycled through a freelist, so the deferred_
+//	routines don't call malloc unless more requests are outstanding than the block holds.
 template <class T>
 class TThreadSafeList {
 private:
@@ -44,12 +49,26 @@ public:
 		Node *		mNode;
 	};
 	
-	TThreadSafeList() { }
+	enum { kDefaultNodeCount = 64 };
+
+	TThreadSafeList(UInt32 inNodeCount = kDefaultNodeCount)
+		: mActiveList(NULL), mNodes((Node *)CA_malloc(inNodeCount * sizeof(Node))), mNodeCount(inNodeCount)
+	{
+		for (UInt32 i = 0; i < inNodeCount; ++i)
+			mFreeList.push_NA(&mNodes[i]);
+	}
 	~TThreadSafeList()
 	{
-		mActiveList.free_all();
-		mPendingList.free_all();
-		mFreeList.free_all();
+		Node *node;
+		while ((node = mActiveList) != NULL) {
+			mActiveList = node->mNext;
+			DeleteNode(node);
+		}
+		while ((node = mPendingList.pop_NA()) != NULL)
+			DeleteNode(node);
+		while ((node = mFreeList.pop_NA()) != NULL)
+			DeleteNode(node);
+		free(mNodes);
 	}
 	
 	// These may be called on any thread
@@ -106,7 +125,7 @@ public:
 					{
 						Node **pnode;
 						bool needToInsert = true;
-						for (pnode = mActiveList.phead(); *pnode != NULL; pnode = &node->mNext) {
+						for (pnode = &mActiveList; *pnode != NULL; pnode = &node->mNext) {
 							node = *pnode;
 							if (node->mObject == event->mObject) {
 								//printf("already active!!!\n");
@@ -124,7 +143,7 @@ public:
 					break;
 				case kRemove:
 					// find matching node in the active list, remove it
-					for (Node **pnode = mActiveList.phead(); *pnode != NULL; ) {
+					for (Node **pnode = &mActiveList; *pnode != NULL; ) {
 						node = *pnode;
 						if (node->mObject == event->mObject) {
 							*pnode = node->mNext;	// remove from linked list
@@ -137,11 +156,12 @@ public:
 					FreeNode(event);
 					break;
 				case kClear:
-					for (node = mActiveList.head(); node != NULL; ) {
+					for (node = mActiveList; node != NULL; ) {
 						next = node->mNext;
 						FreeNode(node);
 						node = next;
 					}
+					mActiveList = NULL;
 					FreeNode(event);
 					break;
 				default:
@@ -155,12 +175,15 @@ public:
 	
 	iterator begin() const {
 		//mActiveList.dump("active at begin");
-		return iterator(mActiveList.head());
+		return iterator(mActiveList);
 	}
 	iterator end() const { return iterator(NULL); }
 
 	
 private:
+	TThreadSafeList(const TThreadSafeList &); // private, unimplemented.
+	TThreadSafeList &operator=(const TThreadSafeList &);
+
 	Node *	AllocNode()
 	{
 		Node *node = mFreeList.pop_atomic();
@@ -174,22 +197,21 @@ private:
 		mFreeList.push_atomic(node);
 	}
 
+	void	DeleteNode(Node *node)
+	{
+		// only the overflow nodes were allocated one at a time
+		if (node < mNodes || node >= mNodes + mNodeCount)
+			free(node);
+	}
+
 private:
-	class NodeStack : public TAtomicStack<Node> {
-	public:
-		void free_all() {
-			Node *node;
-			while ((node = this->pop_NA()) != NULL)
-				free(node);
-		}
-		
-		Node **	phead() { return &this->mHead; }
-		Node *	head() const { return this->mHead; }
-	};
+	typedef TAtomicStack<Node> NodeStack;
 
-	NodeStack	mActiveList;	// what's actually in the container - only accessed on one thread
-	NodeStack	mPendingList;	// add or remove requests - threadsafe
-	NodeStack	mFreeList;		// free nodes for reuse - threadsafe
+	Node *				mActiveList;	// what's actually in the container - only accessed on one thread
+	NodeStack			mPendingList;	// add or remove requests - threadsafe
+	TAtomicStack2<Node>	mFreeList;		// free nodes for reuse - threadsafe, popped by any thread
+	Node *				mNodes;			// the preallocated nodes
+	UInt32				mNodeCount;
 };
 
 #endif // __CAThreadSafeList_h__
@@ -8,8 +8,10 @@ Part of Core Audio Public Utility Classes
 
 #include "CAVectorUnit.h"
 
-#if !TARGET_OS_WIN32
+#if TARGET_OS_MAC
 	#include <sys/sysctl.h>
+#elif TARGET_OS_LINUX && TARGET_CPU_ARM64
+	#include <sys/auxv.h>
 #elif HAS_IPP
 	#include "ippdefs.h"
 	#include "ippcore.h"
@@ -130,16 +132,30 @@ SInt32	CAVectorUnit_Examine()
 		if (!error && vType > 0)
 			result = kVecAltivec;
 	#elif (TARGET_CPU_X86 || TARGET_CPU_X86_64)
-		static const struct { const char* kName; const int kVectype; } kStringVectypes[] = {
-			{ "hw.optional.avx1_0", kVecAVX1 }, { "hw.optional.sse3", kVecSSE3 }, { "hw.optional.sse2", kVecSSE2 }
+		// kVecAVX2 and up promise FMA3 as well (see CAVectorUnitTypes.h), which hw.optional.avx2_0
+		// doesn't imply, so those types also need hw.optional.fma, and kVecAVX512 needs AVX2.
+		static const struct { const char* kName; const char* kAlsoNames[2]; const int kVectype; } kStringVectypes[] = {
+			{ "hw.optional.avx512f", { "hw.optional.avx2_0", "hw.optional.fma" }, kVecAVX512 },
+			{ "hw.optional.avx2_0", { "hw.optional.fma", NULL }, kVecAVX2 },
+			{ "hw.optional.avx1_0", { NULL, NULL }, kVecAVX1 }, { "hw.optional.sse3", { NULL, NULL }, kVecSSE3 },
+			{ "hw.optional.sse2", { NULL, NULL }, kVecSSE2 }
 		};
 		static const size_t kNumStringVectypes = sizeof(kStringVectypes)/sizeof(kStringVectypes[0]);
-		int i = 0, answer = 0;
+		int i = 0;
 		while(i != kNumStringVectypes)
 		{
-			size_t length = sizeof(answer);
-			int error = sysctlbyname(kStringVectypes[i].kName, &answer, &length, NULL, 0);
-			if (!error && answer)
+			bool supported = true;
+			for (int name = -1; supported && name < 2; ++name)
+			{
+				const char* kName = (name < 0) ? kStringVectypes[i].kName : kStringVectypes[i].kAlsoNames[name];
+				if (kName == NULL)
+					break;
+				int answer = 0;
+				size_t length = sizeof(answer);
+				int error = sysctlbyname(kName, &answer, &length, NULL, 0);
+				supported = !error && answer;
+			}
+			if (supported)
 			{
 				result = kStringVectypes[i].kVectype;
 				break;
@@ -150,6 +166,35 @@ SInt32	CAVectorUnit_Examine()
 		result = kVecNeon;
 	#endif
 	}
+#elif TARGET_OS_LINUX
+	if (getenv("CA_NoVector")) {
+		// Cache the answer too, so the message is printed once rather than on every GetType().
+		fprintf(stderr, "CA_NoVector set; Vector unit optimized routines will be bypassed\n");
+		gCAVectorUnitType = result;
+		return result;
+	}
+	#if (TARGET_CPU_X86 || TARGET_CPU_X86_64)
+		// __builtin_cpu_supports reads cpuid and, for AVX and up, checks that the OS saves the registers.
+		__builtin_cpu_init();
+		if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			result = kVecAVX512;
+		else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			result = kVecAVX2;
+		else if (__builtin_cpu_supports("avx"))
+			result = kVecAVX1;
+		else if (__builtin_cpu_supports("sse3"))
+			result = kVecSSE3;
+		else if (__builtin_cpu_supports("sse2"))
+			result = kVecSSE2;
+	#elif TARGET_CPU_ARM64
+		result = kVecNeon;
+		#ifdef HWCAP_SVE
+		if (getauxval(AT_HWCAP) & HWCAP_SVE)
+			result = kVecSVE;
+		#endif
+	#elif CA_ARM_NEON
+		result = kVecNeon;
+	#endif
 #endif
 	gCAVectorUnitType = result;
 	return result;
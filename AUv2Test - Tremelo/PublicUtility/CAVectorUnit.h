@@ -53,10 +53,13 @@ public:
 	static SInt32		GetVectorUnitType() { return CAVectorUnit_GetType(); }
 	static bool			HasVectorUnit() { return GetVectorUnitType() > kVecNone; }
 	static bool			HasAltivec() { return GetVectorUnitType() == kVecAltivec; }
-	static bool			HasSSE2() { return GetVectorUnitType() >= kVecSSE2; }
-	static bool			HasSSE3() { return GetVectorUnitType() >= kVecSSE3; }
-	static bool			HasAVX1() { return GetVectorUnitType() >= kVecAVX1; }
-	static bool			HasNeon() { return GetVectorUnitType() == kVecNeon; }
+	static bool			HasSSE2() { return GetVectorUnitType() >= kVecSSE2 && GetVectorUnitType() < kVecNeon; }
+	static bool			HasSSE3() { return GetVectorUnitType() >= kVecSSE3 && GetVectorUnitType() < kVecNeon; }
+	static bool			HasAVX1() { return GetVectorUnitType() >= kVecAVX1 && GetVectorUnitType() < kVecNeon; }
+	static bool			HasAVX2() { return GetVectorUnitType() >= kVecAVX2 && GetVectorUnitType() < kVecNeon; }
+	static bool			HasAVX512() { return GetVectorUnitType() >= kVecAVX512 && GetVectorUnitType() < kVecNeon; }
+	static bool			HasNeon() { return GetVectorUnitType() >= kVecNeon; }
+	static bool			HasSVE() { return GetVectorUnitType() >= kVecSVE; }
 };
 #endif
 
@@ -16,7 +16,10 @@ enum {
 	kVecSSE2 = 100,
 	kVecSSE3 = 101,
 	kVecAVX1 = 110,
-	kVecNeon = 200
+	kVecAVX2 = 111,		// AVX2 and FMA3
+	kVecAVX512 = 120,	// AVX-512F, AVX2 and FMA3
+	kVecNeon = 200,
+	kVecSVE = 201
 };
 
 #endif
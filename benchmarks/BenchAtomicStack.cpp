@@ -0,0 +1,78 @@
+//
+//  BenchAtomicStack.cpp
+//  TremeloAUv2
+//
+//  Push/pop throughput of the atomic stacks: TAtomicStack2 (the double-width compare-and-swap
+//  freelist) with 1, 2 and 4 threads each popping a few nodes and pushing them back, and
+//  TAtomicStack with one thread pushing and popping through pop_atomic_single_reader and
+//  through pop_atomic, which takes the whole list and pushes the rest back.
+//
+
+#include "TremeloBench.h"
+#include "CAAtomicStack.h"
+
+#include <thread>
+#include <vector>
+
+enum { kNodesPerThread = 64, kOperations = 1 << 22, kHeld = 4 };
+
+struct Node {
+    Node *  mNext;
+    Node *& next() { return mNext; }
+};
+
+// Nanoseconds per push or pop, over all threads.
+static double Stack2Nanoseconds(int inThreads)
+{
+    std::vector<Node> nodes(inThreads * kNodesPerThread);
+    TAtomicStack2<Node> stack;
+    for (Node &node : nodes)
+        stack.push_atomic(&node);
+    const int rounds = kOperations / (2 * kHeld * inThreads);
+    double start = TremeloBench_Now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < inThreads; ++t)
+        threads.emplace_back([&] {
+            Node *held[kHeld];
+            for (int round = 0; round < rounds; ++round) {
+                for (int i = 0; i < kHeld; ++i)
+                    held[i] = stack.pop_atomic();
+                for (int i = kHeld; i--; )
+                    if (held[i])
+                        stack.push_atomic(held[i]);
+            }
+        });
+    for (std::thread &thread : threads)
+        thread.join();
+    return 1e9 * (TremeloBench_Now() - start) / (double(rounds) * 2 * kHeld * inThreads);
+}
+
+template <Node *(TAtomicStack<Node>::*kPop)()>
+static double StackNanoseconds()
+{
+    std::vector<Node> nodes(kNodesPerThread);
+    TAtomicStack<Node> stack;
+    for (Node &node : nodes)
+        stack.push_atomic(&node);
+    const int rounds = kOperations / (2 * kHeld);
+    double start = TremeloBench_Now();
+    Node *held[kHeld];
+    for (int round = 0; round < rounds; ++round) {
+        for (int i = 0; i < kHeld; ++i)
+            held[i] = (stack.*kPop)();
+        for (int i = kHeld; i--; )
+            stack.push_atomic(held[i]);
+    }
+    return 1e9 * (TremeloBench_Now() - start) / (double(rounds) * 2 * kHeld);
+}
+
+int main()
+{
+    for (int threads = 1; threads <= 4; threads *= 2)
+        printf("TAtomicStack2, %d thread%s: %6.2f ns per push or pop\n", threads, threads > 1 ? "s" : " ",
+               Stack2Nanoseconds(threads));
+    printf("TAtomicStack, pop_atomic_single_reader: %6.2f ns per push or pop\n",
+           StackNanoseconds<&TAtomicStack<Node>::pop_atomic_single_reader>());
+    printf("TAtomicStack, pop_atomic: %6.2f ns per push or pop\n", StackNanoseconds<&TAtomicStack<Node>::pop_atomic>());
+    return 0;
+}
@@ -0,0 +1,103 @@
+//
+//  BenchBinaryState.cpp
+//  TremeloAUv2
+//
+//  Per-call cost of saving and restoring a unit's state as a host snapshotting many instances
+//  does: AUBase's binary state (kTremeloUnitProperty_BinaryState, into and from one reused
+//  buffer) next to the ClassInfo property list (SaveState's CFDictionary, released after each
+//  restore). The best of several runs, on an uninitialized unit and on an initialized one,
+//  where a restored binary state goes through the parameter exchange.
+//
+
+#include "TremeloBench.h"
+#include "TremeloUnit.hpp"
+#include "AudioComponent.h"
+#include "CAStreamBasicDescription.h"
+
+#include <vector>
+
+enum { kCalls = 20000, kRepeats = 5 };
+
+static AudioUnit NewAudioUnit(bool inInitialize)
+{
+    AudioComponentDescription desc = { kAudioUnitType_Effect, TremeloUnit_COMP_SUBTYPE, TrmeloUnit_COMP_MANF, 0, 0 };
+    AudioComponent component = AudioComponentFindNext(NULL, &desc);
+    TREMELO_CHECK(component != NULL);
+    AudioUnit unit = NULL;
+    TREMELO_CHECK_NOERR(AudioComponentInstanceNew(component, &unit));
+    TREMELO_CHECK_NOERR(AudioUnitSetParameter(unit, kParameter_Frequency, kAudioUnitScope_Global, 0, 7.f, 0));
+    TREMELO_CHECK_NOERR(AudioUnitSetParameter(unit, kParameter_Depth, kAudioUnitScope_Global, 0, 65.f, 0));
+    if (inInitialize)
+        TREMELO_CHECK_NOERR(AudioUnitInitialize(unit));
+    return unit;
+}
+
+// Seconds per call, the best of kRepeats runs of kCalls.
+template <class FUNCTION>
+static double Time(FUNCTION inFunction)
+{
+    double best = 1e9;
+    for (int repeat = 0; repeat < kRepeats; ++repeat) {
+        double start = TremeloBench_Now();
+        for (int i = 0; i < kCalls; ++i)
+            inFunction();
+        double elapsed = (TremeloBench_Now() - start) / kCalls;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+static void Measure(bool inInitialized)
+{
+    AudioUnit unit = NewAudioUnit(inInitialized);
+
+    UInt32 size = 0;
+    Boolean writable = false;
+    TREMELO_CHECK_NOERR(AudioUnitGetPropertyInfo(unit, kTremeloUnitProperty_BinaryState, kAudioUnitScope_Global, 0,
+                                                 &size, &writable));
+    std::vector<UInt32> state(size / 4);
+    const double binarySave = Time([&] {
+        UInt32 bytes = size;
+        TREMELO_CHECK_NOERR(AudioUnitGetProperty(unit, kTremeloUnitProperty_BinaryState, kAudioUnitScope_Global, 0,
+                                                 state.data(), &bytes));
+    });
+    const double binaryRestore = Time([&] {
+        TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kTremeloUnitProperty_BinaryState, kAudioUnitScope_Global, 0,
+                                                 state.data(), size));
+    });
+
+    CFPropertyListRef classInfo = NULL;
+    const double listSave = Time([&] {
+        UInt32 bytes = sizeof(classInfo);
+        TREMELO_CHECK_NOERR(AudioUnitGetProperty(unit, kAudioUnitProperty_ClassInfo, kAudioUnitScope_Global, 0,
+                                                 &classInfo, &bytes));
+        CFRelease(classInfo);
+    });
+    UInt32 bytes = sizeof(classInfo);
+    TREMELO_CHECK_NOERR(AudioUnitGetProperty(unit, kAudioUnitProperty_ClassInfo, kAudioUnitScope_Global, 0,
+                                             &classInfo, &bytes));
+    const double listRestore = Time([&] {
+        TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_ClassInfo, kAudioUnitScope_Global, 0,
+                                                 &classInfo, sizeof(classInfo)));
+    });
+    CFRelease(classInfo);
+
+    const char *label = inInitialized ? "initialized:" : "uninitialized:";
+    printf("%-15s save    binary %7.1f ns (%u bytes), ClassInfo %8.1f ns (%.1fx)\n", label, 1e9 * binarySave,
+           (unsigned)size, 1e9 * listSave, listSave / binarySave);
+    printf("%-15s restore binary %7.1f ns,              ClassInfo %8.1f ns (%.1fx)\n", label, 1e9 * binaryRestore,
+           1e9 * listRestore, listRestore / binaryRestore);
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+}
+
+int main()
+{
+    // TremeloUnit_New registers the component.
+    TremeloUnitRef registered = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&registered));
+    Measure(false);
+    Measure(true);
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(registered));
+    return 0;
+}
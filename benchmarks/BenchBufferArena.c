@@ -0,0 +1,81 @@
+//
+//  BenchBufferArena.c
+//  TremeloAUv2
+//
+//  Resident memory of many stereo instances with buffers of their own and with the shared
+//  arena: how much RSS grows while they are initialized and after they have all rendered
+//  round-robin, and what rendering costs per frame. Each configuration runs in a child process
+//  of its own so that neither inherits the other's heap.
+//
+
+#include "TremeloBench.h"
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+enum { kChannels = 2, kCycles = 20 };
+
+static long ResidentKilobytes(void)
+{
+    FILE *status = fopen("/proc/self/status", "r");
+    char line[256];
+    long kilobytes = 0;
+    while (status != NULL && fgets(line, sizeof(line), status) != NULL)
+        if (strncmp(line, "VmRSS:", 6) == 0)
+            kilobytes = atol(line + 6);
+    if (status != NULL)
+        fclose(status);
+    return kilobytes;
+}
+
+static void Measure(uint32_t inOptions, int inInstances, uint32_t inFrames)
+{
+    TREMELO_CHECK_NOERR(TremeloUnit_SetBufferOptions(inOptions));
+    float *input[kChannels], *output[kChannels];
+    for (uint32_t c = 0; c < kChannels; ++c) {
+        input[c] = (float *)malloc(inFrames * sizeof(float));
+        output[c] = (float *)calloc(inFrames, sizeof(float));
+        TremeloTest_FillSignal(input[c], inFrames, c);
+    }
+    TremeloUnitRef *units = (TremeloUnitRef *)malloc(inInstances * sizeof(TremeloUnitRef));
+
+    long before = ResidentKilobytes();
+    for (int i = 0; i < inInstances; ++i) {
+        TREMELO_CHECK_NOERR(TremeloUnit_New(&units[i]));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(units[i], 48000., kChannels));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(units[i], inFrames));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(units[i], kTremeloUnitParam_Frequency, 1.f + i % 19));
+        TREMELO_CHECK_NOERR(TremeloUnit_Initialize(units[i]));
+    }
+    long initialized = ResidentKilobytes();
+
+    double start = TremeloBench_Now();
+    for (int cycle = 0; cycle < kCycles; ++cycle)
+        for (int i = 0; i < inInstances; ++i)
+            TREMELO_CHECK_NOERR(TremeloUnit_Render(units[i], (const float *const *)input, output, inFrames));
+    double elapsed = TremeloBench_Now() - start;
+    long rendered = ResidentKilobytes();
+
+    printf("%4d instances, %5u frames, %-13s RSS +%7ld KB after Initialize, +%7ld KB after rendering; %6.2f ns/frame\n",
+           inInstances, inFrames, inOptions ? "shared arena:" : "own buffers:", initialized - before, rendered - before,
+           1e9 * elapsed / ((double)kCycles * inInstances * inFrames));
+    fflush(stdout);
+}
+
+int main(void)
+{
+    static const int kInstances[] = { 100, 500 };
+    static const uint32_t kFrames[] = { 512, 4096 };
+    for (size_t n = 0; n < sizeof(kInstances) / sizeof(kInstances[0]); ++n)
+        for (size_t f = 0; f < sizeof(kFrames) / sizeof(kFrames[0]); ++f)
+            for (uint32_t options = 0; options <= kTremeloUnitBufferOption_SharedArena; options += kTremeloUnitBufferOption_SharedArena) {
+                pid_t child = fork();
+                if (child == 0) {
+                    Measure(options, kInstances[n], kFrames[f]);
+                    _exit(0);
+                }
+                int status = 0;
+                TREMELO_CHECK(child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+            }
+    return 0;
+}
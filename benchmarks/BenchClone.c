@@ -0,0 +1,82 @@
+//
+//  BenchClone.c
+//  TremeloAUv2
+//
+//  Stamping out instances of one configured unit: TremeloUnit_Clone of an initialized prototype
+//  against building each the way a host otherwise would, with New, the format, the slice size,
+//  every parameter and setting, and Initialize. Per instance, the best of several runs, with
+//  1,000 instances kept alive and with each disposed of before the next is made, for the legacy
+//  LFO and for the sample-time LFO, whose Initialize allocates the gain cache either way.
+//
+
+#include "TremeloBench.h"
+
+enum { kChannels = 2, kFrames = 512, kInstances = 1000, kRepeats = 5 };
+
+static TremeloUnitRef Build(int inSampleTimeLFO)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 48000., kChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kFrames));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 5.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 80.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Waveform, kTremeloUnitParam_Waveform_Square));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetPresetCrossfade(unit, 256));
+    if (inSampleTimeLFO) {
+        TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, 1));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetControlInterval(unit, 16));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetOscillator(unit, kTremeloUnitOscillator_Polynomial));
+    }
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    return unit;
+}
+
+static TremeloUnitRef Clone(TremeloUnitRef inPrototype)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_Clone(inPrototype, &unit));
+    return unit;
+}
+
+// Seconds per instance made, the best of kRepeats runs.
+static double Time(TremeloUnitRef inPrototype, int inSampleTimeLFO, int inClone, int inKeepAlive)
+{
+    static TremeloUnitRef units[kInstances];
+    double best = 1e9;
+    for (int repeat = 0; repeat < kRepeats; ++repeat) {
+        double start = TremeloBench_Now(), elapsed = 0;
+        for (int i = 0; i < kInstances; ++i) {
+            units[i] = inClone ? Clone(inPrototype) : Build(inSampleTimeLFO);
+            if (!inKeepAlive) {
+                elapsed += TremeloBench_Now() - start;
+                TREMELO_CHECK_NOERR(TremeloUnit_Dispose(units[i]));
+                start = TremeloBench_Now();
+            }
+        }
+        if (inKeepAlive) {
+            elapsed = TremeloBench_Now() - start;
+            for (int i = 0; i < kInstances; ++i)
+                TREMELO_CHECK_NOERR(TremeloUnit_Dispose(units[i]));
+        }
+        if (elapsed / kInstances < best)
+            best = elapsed / kInstances;
+    }
+    return best;
+}
+
+int main(void)
+{
+    for (int sampleTimeLFO = 0; sampleTimeLFO <= 1; ++sampleTimeLFO) {
+        TremeloUnitRef prototype = Build(sampleTimeLFO);
+        for (int keepAlive = 1; keepAlive >= 0; --keepAlive) {
+            double built = Time(prototype, sampleTimeLFO, 0, keepAlive);
+            double cloned = Time(prototype, sampleTimeLFO, 1, keepAlive);
+            printf("%-17s %-23s built %7.2f us, cloned %7.2f us (%.2fx)\n",
+                   sampleTimeLFO ? "sample-time LFO," : "legacy LFO,",
+                   keepAlive ? "1,000 instances alive:" : "one at a time:", 1e6 * built, 1e6 * cloned, built / cloned);
+        }
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(prototype));
+    }
+    return 0;
+}
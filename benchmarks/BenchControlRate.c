@@ -0,0 +1,57 @@
+//
+//  BenchControlRate.c
+//  TremeloAUv2
+//
+//  What the control-rate LFO saves per instance: a stereo unit at 48 kHz rendering 512-frame
+//  slices, at each control interval and with both oscillators. 7.3 Hz has no whole-number
+//  period, so every slice's gains are computed. Reports nanoseconds per frame and the CPU time
+//  one instance takes per second of audio.
+//
+
+#include "TremeloBench.h"
+
+enum { kSampleRate = 48000, kSeconds = 10, kBlock = 512, kChannels = 2 };
+
+static float sInput[kChannels][kBlock];
+static float sOutput[kChannels][kBlock];
+
+static double NanosecondsPerFrame(int inOscillator, uint32_t inInterval)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, kSampleRate, kChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kBlock));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetOscillator(unit, inOscillator));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetControlInterval(unit, inInterval));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 7.3f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 80.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+
+    const float *input[kChannels] = { sInput[0], sInput[1] };
+    float *output[kChannels] = { sOutput[0], sOutput[1] };
+    const uint32_t slices = kSeconds * kSampleRate / kBlock;
+    TREMELO_CHECK_NOERR(TremeloUnit_Render(unit, input, output, kBlock));      // warm up
+    double start = TremeloBench_Now();
+    for (uint32_t slice = 0; slice < slices; ++slice)
+        TREMELO_CHECK_NOERR(TremeloUnit_Render(unit, input, output, kBlock));
+    double elapsed = TremeloBench_Now() - start;
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+    return 1e9 * elapsed / ((double)slices * kBlock);
+}
+
+int main(void)
+{
+    for (uint32_t c = 0; c < kChannels; ++c)
+        TremeloTest_FillSignal(sInput[c], kBlock, c);
+
+    static const uint32_t kIntervals[] = { 0, 16, 32, 64 };
+    printf("%-11s %8s %10s %16s\n", "oscillator", "interval", "ns/frame", "us per second");
+    for (int oscillator = 0; oscillator < 2; ++oscillator)
+        for (size_t k = 0; k < sizeof(kIntervals) / sizeof(kIntervals[0]); ++k) {
+            double ns = NanosecondsPerFrame(oscillator, kIntervals[k]);
+            printf("%-11s %8u %10.2f %16.1f\n", oscillator ? "polynomial" : "wave table", kIntervals[k], ns,
+                   ns * kSampleRate / 1000.);
+        }
+    return 0;
+}
@@ -0,0 +1,70 @@
+//
+//  BenchFirstRender.c
+//  TremeloAUv2
+//
+//  The first render after Initialize, which used to take the page faults for the unit's
+//  buffers, and steady-state throughput, for two slice sizes and each combination of the
+//  huge-page and mlock buffer options. Each line is the median and worst first render over
+//  fresh instances, then ns per frame rendering round-robin through them.
+//
+
+#include "TremeloBench.h"
+
+enum { kChannels = 2, kInstances = 64, kSteadyRenders = 2000 };
+
+static int CompareDoubles(const void *inA, const void *inB)
+{
+    double a = *(const double *)inA, b = *(const double *)inB;
+    return a < b ? -1 : a > b;
+}
+
+static void Measure(uint32_t inOptions, uint32_t inFrames)
+{
+    TREMELO_CHECK_NOERR(TremeloUnit_SetBufferOptions(inOptions));
+    float *input[kChannels], *output[kChannels];
+    for (uint32_t c = 0; c < kChannels; ++c) {
+        input[c] = (float *)malloc(inFrames * sizeof(float));
+        output[c] = (float *)calloc(inFrames, sizeof(float));
+        TremeloTest_FillSignal(input[c], inFrames, c);
+    }
+
+    TremeloUnitRef units[kInstances];
+    double first[kInstances];
+    for (int i = 0; i < kInstances; ++i) {
+        TREMELO_CHECK_NOERR(TremeloUnit_New(&units[i]));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(units[i], 48000., kChannels));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(units[i], inFrames));
+        TREMELO_CHECK_NOERR(TremeloUnit_Initialize(units[i]));
+        double start = TremeloBench_Now();
+        TREMELO_CHECK_NOERR(TremeloUnit_Render(units[i], (const float *const *)input, output, inFrames));
+        first[i] = TremeloBench_Now() - start;
+    }
+    qsort(first, kInstances, sizeof(double), CompareDoubles);
+
+    double start = TremeloBench_Now();
+    for (int r = 0; r < kSteadyRenders; ++r)
+        TREMELO_CHECK_NOERR(TremeloUnit_Render(units[r % kInstances], (const float *const *)input, output, inFrames));
+    double steady = (TremeloBench_Now() - start) / ((double)kSteadyRenders * inFrames);
+
+    printf("%5u frames, huge pages %s, mlock %s: first render median %8.1f us, max %8.1f us; steady %6.2f ns/frame\n",
+           inFrames, inOptions & kTremeloUnitBufferOption_HugePages ? "on " : "off",
+           inOptions & kTremeloUnitBufferOption_Lock ? "on " : "off",
+           1e6 * first[kInstances / 2], 1e6 * first[kInstances - 1], 1e9 * steady);
+
+    for (int i = 0; i < kInstances; ++i)
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(units[i]));
+    for (uint32_t c = 0; c < kChannels; ++c) {
+        free(input[c]);
+        free(output[c]);
+    }
+}
+
+int main(void)
+{
+    static const uint32_t kFrames[] = { 4096, 65536 };
+    for (size_t f = 0; f < sizeof(kFrames) / sizeof(kFrames[0]); ++f)
+        for (uint32_t options = 0; options <= (kTremeloUnitBufferOption_HugePages | kTremeloUnitBufferOption_Lock); ++options)
+            Measure(options, kFrames[f]);
+    TREMELO_CHECK_NOERR(TremeloUnit_SetBufferOptions(0));
+    return 0;
+}
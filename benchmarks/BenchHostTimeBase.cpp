@@ -0,0 +1,46 @@
+//
+//  BenchHostTimeBase.cpp
+//  TremeloAUv2
+//
+//  Per-call cost of reading and converting the host time, next to what it replaced on Linux:
+//  clock_gettime(CLOCK_MONOTONIC) for the reads, and MultiplyByRatio's 128-bit divide for the
+//  conversions.
+//
+
+#include "TremeloBench.h"
+#include "CAHostTimeBase.h"
+
+enum { kCalls = 1 << 24 };
+
+static volatile UInt64 sSink;
+
+template <class FUNCTION>
+static void Measure(const char *inName, FUNCTION inFunction)
+{
+    UInt64 sum = 0;
+    double start = TremeloBench_Now();
+    for (UInt64 i = 0; i < kCalls; ++i)
+        sum += inFunction(i);
+    double elapsed = TremeloBench_Now() - start;
+    sSink = sum;
+    printf("%-32s %6.2f ns per call\n", inName, 1e9 * elapsed / kCalls);
+}
+
+int main()
+{
+    printf("host time frequency %.0f Hz\n", CAHostTimeBase::GetFrequency());
+    const UInt32 numerator = 1000000, denominator = UInt32(CAHostTimeBase::GetFrequency() / 1000);
+
+    Measure("GetTheCurrentTime", [](UInt64) { return CAHostTimeBase::GetTheCurrentTime(); });
+    Measure("GetCurrentTimeInNanos", [](UInt64) { return CAHostTimeBase::GetCurrentTimeInNanos(); });
+    Measure("clock_gettime(CLOCK_MONOTONIC)", [](UInt64) {
+        struct timespec now;
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        return UInt64(now.tv_sec) * 1000000000ULL + UInt64(now.tv_nsec);
+    });
+    Measure("ReadCycleCounter", [](UInt64) { return CAHostTimeBase::ReadCycleCounter(); });
+    Measure("ConvertToNanos", [](UInt64 i) { return CAHostTimeBase::ConvertToNanos(i * 977); });
+    Measure("ConvertFromNanos", [](UInt64 i) { return CAHostTimeBase::ConvertFromNanos(i * 977); });
+    Measure("MultiplyByRatio", [=](UInt64 i) { return CAHostTimeBase::MultiplyByRatio(i * 977, numerator, denominator); });
+    return 0;
+}
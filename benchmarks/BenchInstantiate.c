@@ -0,0 +1,80 @@
+//
+//  BenchInstantiate.c
+//  TremeloAUv2
+//
+//  Bringing up 1,000 instances the way a host loading a large session does: New, SetFormat,
+//  Initialize, then a first render of every instance. Per instance, what each step costs, and
+//  the whole from the first New to the last first render, with the legacy LFO, with the
+//  sample-time LFO initialized synchronously, and with it left to the setup queue; for the last,
+//  also how long until every instance is ready. Each configuration runs in a child process of
+//  its own so that none inherits another's heap or the queue's thread.
+//
+
+#include "TremeloBench.h"
+
+#include <sched.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+enum { kInstances = 1000, kFrames = 512 };
+
+enum { kLegacy, kSampleTimeSync, kSampleTimeAsync };
+
+static void Measure(int inConfiguration, uint32_t inChannels)
+{
+    static const char *const kNames[] = { "legacy LFO:", "sample-time sync:", "sample-time async:" };
+    float **input = (float **)malloc(inChannels * sizeof(float *));
+    float **output = (float **)malloc(inChannels * sizeof(float *));
+    for (uint32_t c = 0; c < inChannels; ++c) {
+        input[c] = (float *)malloc(kFrames * sizeof(float));
+        output[c] = (float *)calloc(kFrames, sizeof(float));
+        TremeloTest_FillSignal(input[c], kFrames, c);
+    }
+    TremeloUnitRef *units = (TremeloUnitRef *)malloc(kInstances * sizeof(TremeloUnitRef));
+
+    double start = TremeloBench_Now();
+    for (int i = 0; i < kInstances; ++i) {
+        TREMELO_CHECK_NOERR(TremeloUnit_New(&units[i]));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(units[i], inConfiguration != kLegacy));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetAsyncInitialize(units[i], inConfiguration == kSampleTimeAsync));
+    }
+    double created = TremeloBench_Now();
+    for (int i = 0; i < kInstances; ++i) {
+        TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(units[i], 48000., inChannels));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(units[i], kFrames));
+    }
+    double configured = TremeloBench_Now();
+    for (int i = 0; i < kInstances; ++i)
+        TREMELO_CHECK_NOERR(TremeloUnit_Initialize(units[i]));
+    double initialized = TremeloBench_Now();
+    for (int i = 0; i < kInstances; ++i)
+        TREMELO_CHECK_NOERR(TremeloUnit_Render(units[i], (const float *const *)input, output, kFrames));
+    double rendered = TremeloBench_Now();
+    for (int i = 0; i < kInstances; ++i)
+        for (int ready = 0; !ready; sched_yield())
+            TREMELO_CHECK_NOERR(TremeloUnit_IsReady(units[i], &ready));
+    double ready = TremeloBench_Now();
+
+    printf("%2u ch, %-19s new %5.2f us, configure %5.2f us, initialize %6.2f us, first render %6.2f us; "
+           "%7.2f ms to the last first render, all ready after %7.2f ms\n",
+           inChannels, kNames[inConfiguration], 1e6 * (created - start) / kInstances,
+           1e6 * (configured - created) / kInstances, 1e6 * (initialized - configured) / kInstances,
+           1e6 * (rendered - initialized) / kInstances, 1e3 * (rendered - start), 1e3 * (ready - start));
+    fflush(stdout);
+}
+
+int main(void)
+{
+    static const uint32_t kChannels[] = { 2, 8 };
+    for (size_t n = 0; n < sizeof(kChannels) / sizeof(kChannels[0]); ++n)
+        for (int configuration = kLegacy; configuration <= kSampleTimeAsync; ++configuration) {
+            pid_t child = fork();
+            if (child == 0) {
+                Measure(configuration, kChannels[n]);
+                _exit(0);
+            }
+            int status = 0;
+            TREMELO_CHECK(child > 0 && waitpid(child, &status, 0) == child && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        }
+    return 0;
+}
@@ -0,0 +1,87 @@
+//
+//  BenchKernelChannels.c
+//  TremeloAUv2
+//
+//  Render cost per frame and channel at 2, 8, 32 and 64 channels, for instances initialized
+//  while other allocations come and go as they would in a host, so kernels allocated one by
+//  one would land wherever the heap had room. Then the cost of reinitializing one instance
+//  with the channel count alternating between that and half of it.
+//
+
+#include "TremeloBench.h"
+
+enum { kInstances = 16, kFrames = 256, kJunk = 4096, kRepeats = 5, kReinitializations = 2000 };
+
+static void Measure(uint32_t inChannels)
+{
+    float **input = (float **)malloc(inChannels * sizeof(float *));
+    float **output = (float **)malloc(inChannels * sizeof(float *));
+    for (uint32_t c = 0; c < inChannels; ++c) {
+        input[c] = (float *)malloc(kFrames * sizeof(float));
+        output[c] = (float *)calloc(kFrames, sizeof(float));
+        TremeloTest_FillSignal(input[c], kFrames, c);
+    }
+
+    TremeloUnitRef units[kInstances];
+    static void *junk[kJunk];
+    int junkCount = 0;
+    srand(1);
+    for (int i = 0; i < kInstances; ++i) {
+        TREMELO_CHECK_NOERR(TremeloUnit_New(&units[i]));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(units[i], 48000., inChannels));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(units[i], kFrames));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(units[i], kTremeloUnitParam_Frequency, 2.f + i));
+        for (int j = 0; j < 64 && junkCount < kJunk; ++j)
+            junk[junkCount++] = malloc(16 + rand() % 512);
+        TREMELO_CHECK_NOERR(TremeloUnit_Initialize(units[i]));
+        for (int j = 0; j < junkCount; j += 2) {
+            free(junk[j]);
+            junk[j] = NULL;
+        }
+    }
+
+    // The best of several runs, each rendering about ten million samples.
+    double best = 1e9;
+    int cycles = 40000 / (inChannels * kInstances);
+    if (cycles < 20)
+        cycles = 20;
+    for (int repeat = 0; repeat < kRepeats; ++repeat) {
+        double start = TremeloBench_Now();
+        for (int cycle = 0; cycle < cycles; ++cycle)
+            for (int i = 0; i < kInstances; ++i)
+                TREMELO_CHECK_NOERR(TremeloUnit_Render(units[i], (const float *const *)input, output, kFrames));
+        double perSample = (TremeloBench_Now() - start) / ((double)cycles * kInstances * kFrames * inChannels);
+        if (perSample < best)
+            best = perSample;
+    }
+
+    double start = TremeloBench_Now();
+    for (int r = 0; r < kReinitializations; ++r) {
+        TREMELO_CHECK_NOERR(TremeloUnit_Uninitialize(units[0]));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(units[0], 48000., (r & 1) ? inChannels : inChannels / 2));
+        TREMELO_CHECK_NOERR(TremeloUnit_Initialize(units[0]));
+    }
+    double reinitialize = (TremeloBench_Now() - start) / kReinitializations;
+
+    printf("%2u channels: %6.3f ns per frame and channel; reinitialize %6.2f us\n", inChannels, 1e9 * best,
+           1e6 * reinitialize);
+
+    for (int i = 0; i < kInstances; ++i)
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(units[i]));
+    for (int j = 1; j < junkCount; j += 2)
+        free(junk[j]);
+    for (uint32_t c = 0; c < inChannels; ++c) {
+        free(input[c]);
+        free(output[c]);
+    }
+    free(input);
+    free(output);
+}
+
+int main(void)
+{
+    static const uint32_t kChannels[] = { 2, 8, 32, 64 };
+    for (size_t i = 0; i < sizeof(kChannels) / sizeof(kChannels[0]); ++i)
+        Measure(kChannels[i]);
+    return 0;
+}
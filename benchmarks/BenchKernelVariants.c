@@ -0,0 +1,79 @@
+//
+//  BenchKernelVariants.c
+//  TremeloAUv2
+//
+//  Each instruction set variant of the sample-time LFO's loops, forced with
+//  TremeloUnit_SetKernelVariant, on the settings that lean on them: the polynomial oscillator,
+//  the control-rate ramps and, for every setting, applying the gains. Variants this build or
+//  CPU can't run are skipped; with CA_NoVector set only the generic one runs. Mono, 48 kHz,
+//  512-frame slices, 7.3 Hz so the gain cache never serves.
+//
+
+#include "TremeloBench.h"
+
+enum { kSampleRate = 48000, kSeconds = 10, kBlock = 512 };
+
+static float sInput[kBlock];
+static float sOutput[kBlock];
+
+typedef struct { const char *mName; int mOscillator; uint32_t mInterval; float mWaveform; } Setting;
+
+static const Setting kSettings[] = {
+    { "table sine",         kTremeloUnitOscillator_WaveTable,  0,  kTremeloUnitParam_Waveform_Sine },
+    { "poly sine",          kTremeloUnitOscillator_Polynomial, 0,  kTremeloUnitParam_Waveform_Sine },
+    { "poly square",        kTremeloUnitOscillator_Polynomial, 0,  kTremeloUnitParam_Waveform_Square },
+    { "table sine / 16",    kTremeloUnitOscillator_WaveTable,  16, kTremeloUnitParam_Waveform_Sine },
+};
+
+// Returns a negative number if the variant isn't available.
+static double NanosecondsPerFrame(int inVariant, const Setting *inSetting)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    if (TremeloUnit_SetKernelVariant(unit, inVariant) != 0) {
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+        return -1.;
+    }
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, kSampleRate, 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kBlock));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetOscillator(unit, inSetting->mOscillator));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetControlInterval(unit, inSetting->mInterval));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 7.3f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 80.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Waveform, inSetting->mWaveform));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+
+    const float *input[1] = { sInput };
+    float *output[1] = { sOutput };
+    const uint32_t slices = kSeconds * kSampleRate / kBlock;
+    TREMELO_CHECK_NOERR(TremeloUnit_Render(unit, input, output, kBlock));      // warm up
+    double start = TremeloBench_Now();
+    for (uint32_t slice = 0; slice < slices; ++slice)
+        TREMELO_CHECK_NOERR(TremeloUnit_Render(unit, input, output, kBlock));
+    double elapsed = TremeloBench_Now() - start;
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+    return 1e9 * elapsed / ((double)slices * kBlock);
+}
+
+int main(void)
+{
+    static const char *const kVariantNames[] = { "generic", "avx2", "avx512" };
+    TremeloTest_FillSignal(sInput, kBlock, 0);
+    printf("%-16s", "ns/frame");
+    for (int variant = 0; variant < 3; ++variant)
+        printf(" %10s", kVariantNames[variant]);
+    printf("\n");
+    for (size_t s = 0; s < sizeof(kSettings) / sizeof(kSettings[0]); ++s) {
+        printf("%-16s", kSettings[s].mName);
+        for (int variant = 0; variant < 3; ++variant) {
+            double ns = NanosecondsPerFrame(variant, &kSettings[s]);
+            if (ns < 0.)
+                printf(" %10s", "-");
+            else
+                printf(" %10.2f", ns);
+        }
+        printf("\n");
+    }
+    return 0;
+}
@@ -0,0 +1,116 @@
+//
+//  BenchLockFreeFIFO.cpp
+//  TremeloAUv2
+//
+//  LockFreeFIFO between two threads at several payload sizes: throughput with one item per
+//  write and read, and with spans of up to 32, then the round-trip latency of one item sent
+//  through a second FIFO and back. The latency includes waking the other thread, so on a
+//  machine with fewer cores than threads it measures the scheduler.
+//
+
+#include "TremeloBench.h"
+#include "LockFreeFIFO.h"
+
+#include <algorithm>
+#include <thread>
+
+enum { kFIFOSize = 256, kItems = 1 << 22, kRoundTrips = 1 << 16, kBatch = 32 };
+
+// Writers fill the whole payload; readers read its last word.
+template <size_t kBytes>
+struct Payload {
+    enum { kWords = kBytes / sizeof(UInt32) };
+    UInt32  mWords[kWords];
+};
+
+template <size_t kBytes>
+static double ItemsPerSecond(UInt32 inBatch)
+{
+    typedef Payload<kBytes> Item;
+    LockFreeFIFO<Item> fifo(kFIFOSize);
+    double start = TremeloBench_Now();
+    std::thread writer([&] {
+        for (UInt32 sequence = 0; sequence < kItems; ) {
+            LockFreeFIFOSpan<Item> span = fifo.WriteItems(std::min<UInt32>(inBatch, kItems - sequence));
+            if (span.Count() == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            for (UInt32 i = 0; i < span.Count(); ++i)
+                for (UInt32 word = 0; word < Item::kWords; ++word)
+                    span[i].mWords[word] = sequence + i;
+            sequence += span.Count();
+            fifo.AdvanceWritePtr(span.Count());
+        }
+    });
+    UInt64 sum = 0;
+    for (UInt32 received = 0; received < kItems; ) {
+        LockFreeFIFOSpan<Item> span = fifo.ReadItems(inBatch);
+        if (span.Count() == 0) {
+            std::this_thread::yield();
+            continue;
+        }
+        for (UInt32 i = 0; i < span.Count(); ++i)
+            sum += span[i].mWords[Item::kWords - 1];
+        received += span.Count();
+        fifo.AdvanceReadPtr(span.Count());
+    }
+    writer.join();
+    double elapsed = TremeloBench_Now() - start;
+    TREMELO_CHECK(sum == UInt64(kItems) * (kItems - 1) / 2);
+    return kItems / elapsed;
+}
+
+template <size_t kBytes>
+static double RoundTripNanoseconds()
+{
+    typedef Payload<kBytes> Item;
+    LockFreeFIFO<Item> there(kFIFOSize), back(kFIFOSize);
+    std::thread echo([&] {
+        for (UInt32 trip = 0; trip < kRoundTrips; ) {
+            Item *item = there.ReadItem();
+            if (item == NULL) {
+                std::this_thread::yield();
+                continue;
+            }
+            Item *reply;
+            while ((reply = back.WriteItem()) == NULL)
+                std::this_thread::yield();
+            *reply = *item;
+            there.AdvanceReadPtr();
+            back.AdvanceWritePtr();
+            ++trip;
+        }
+    });
+    double start = TremeloBench_Now();
+    for (UInt32 trip = 0; trip < kRoundTrips; ++trip) {
+        Item *item = there.WriteItem();
+        for (UInt32 word = 0; word < Item::kWords; ++word)
+            item->mWords[word] = trip;
+        there.AdvanceWritePtr();
+        while ((item = back.ReadItem()) == NULL)
+            std::this_thread::yield();
+        TREMELO_CHECK(item->mWords[Item::kWords - 1] == trip);
+        back.AdvanceReadPtr();
+    }
+    double elapsed = TremeloBench_Now() - start;
+    echo.join();
+    return 1e9 * elapsed / kRoundTrips;
+}
+
+template <size_t kBytes>
+static void Measure()
+{
+    printf("%5zu bytes: %8.2f M items/s single, %8.2f M items/s spans of %d, round trip %9.0f ns\n",
+           kBytes, 1e-6 * ItemsPerSecond<kBytes>(1), 1e-6 * ItemsPerSecond<kBytes>(kBatch), kBatch,
+           RoundTripNanoseconds<kBytes>());
+}
+
+int main()
+{
+    Measure<8>();
+    Measure<64>();
+    Measure<256>();
+    Measure<1024>();
+    return 0;
+}
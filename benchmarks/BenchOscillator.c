@@ -0,0 +1,56 @@
+//
+//  BenchOscillator.c
+//  TremeloAUv2
+//
+//  The sample-time LFO's oscillators, wave table against polynomial, at several block sizes.
+//  7.3 Hz has no whole-number period at 48 kHz, so the gain cache never stands in for the
+//  oscillator and every frame's gain is computed. Reports nanoseconds per frame for a mono
+//  unit, which includes applying the gains.
+//
+
+#include "TremeloBench.h"
+
+enum { kSeconds = 10, kSampleRate = 48000, kFrames = kSeconds * kSampleRate, kMaxBlock = 4096 };
+
+static float sInput[kMaxBlock];
+static float sOutput[kMaxBlock];
+
+static double NanosecondsPerFrame(int inOscillator, float inWaveform, uint32_t inBlock)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, kSampleRate, 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, inBlock));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetOscillator(unit, inOscillator));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 7.3f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 80.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Waveform, inWaveform));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+
+    const float *input[1] = { sInput };
+    float *output[1] = { sOutput };
+    TREMELO_CHECK_NOERR(TremeloUnit_Render(unit, input, output, inBlock));      // warm up
+    double start = TremeloBench_Now();
+    for (uint32_t done = 0; done < kFrames; done += inBlock)
+        TREMELO_CHECK_NOERR(TremeloUnit_Render(unit, input, output, inBlock));
+    double elapsed = TremeloBench_Now() - start;
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+    return 1e9 * elapsed / (double)((kFrames + inBlock - 1) / inBlock * inBlock);
+}
+
+int main(void)
+{
+    TremeloTest_FillSignal(sInput, kMaxBlock, 0);
+    static const uint32_t kBlocks[] = { 16, 64, 256, 1024, 4096 };
+    printf("%-8s %6s %12s %12s\n", "waveform", "block", "table ns/fr", "poly ns/fr");
+    for (int square = 0; square < 2; ++square) {
+        float waveform = square ? kTremeloUnitParam_Waveform_Square : kTremeloUnitParam_Waveform_Sine;
+        for (size_t b = 0; b < sizeof(kBlocks) / sizeof(kBlocks[0]); ++b) {
+            double table = NanosecondsPerFrame(kTremeloUnitOscillator_WaveTable, waveform, kBlocks[b]);
+            double polynomial = NanosecondsPerFrame(kTremeloUnitOscillator_Polynomial, waveform, kBlocks[b]);
+            printf("%-8s %6u %12.2f %12.2f\n", square ? "square" : "sine", kBlocks[b], table, polynomial);
+        }
+    }
+    return 0;
+}
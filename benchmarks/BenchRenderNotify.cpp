@@ -0,0 +1,145 @@
+//
+//  BenchRenderNotify.cpp
+//  TremeloAUv2
+//
+//  What render notifications (AUBase's AURenderNotifyList) add to a render cycle: a 64-frame
+//  AudioUnitRender with none, one and eight notifications that do nothing, with the host leaving
+//  the list alone and with a host thread adding and removing a ninth one all the while, and what
+//  adding and removing one costs the host. The best of several runs. On a single core the time
+//  per render while the host changes the list includes the host thread's share of that core.
+//
+
+#include "TremeloBench.h"
+#include "TremeloUnit.hpp"
+#include "AudioComponent.h"
+#include "CAStreamBasicDescription.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+enum { kChannels = 2, kSlice = 64, kCycles = 100000, kChanges = 100000, kRepeats = 5 };
+
+static float sInput[kChannels][kSlice];
+
+static OSStatus Notify(void *, AudioUnitRenderActionFlags *, const AudioTimeStamp *, UInt32, UInt32, AudioBufferList *)
+{
+    return noErr;
+}
+
+static OSStatus InputCallback(void *, AudioUnitRenderActionFlags *, const AudioTimeStamp *, UInt32, UInt32 inNumberFrames,
+                              AudioBufferList *ioData)
+{
+    for (UInt32 c = 0; c < ioData->mNumberBuffers; ++c) {
+        ioData->mBuffers[c].mData = sInput[c];
+        ioData->mBuffers[c].mDataByteSize = inNumberFrames * sizeof(float);
+    }
+    return noErr;
+}
+
+static AudioUnit NewRenderingUnit()
+{
+    AudioComponentDescription desc = { kAudioUnitType_Effect, TremeloUnit_COMP_SUBTYPE, TrmeloUnit_COMP_MANF, 0, 0 };
+    AudioComponent component = AudioComponentFindNext(NULL, &desc);
+    TREMELO_CHECK(component != NULL);
+    AudioUnit unit = NULL;
+    TREMELO_CHECK_NOERR(AudioComponentInstanceNew(component, &unit));
+    CAStreamBasicDescription format(48000, kChannels, CAStreamBasicDescription::kPCMFormatFloat32, false);
+    for (AudioUnitScope scope : { kAudioUnitScope_Input, kAudioUnitScope_Output })
+        TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_StreamFormat, scope, 0, &format,
+                                                 sizeof(AudioStreamBasicDescription)));
+    UInt32 frames = kSlice;
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0,
+                                             &frames, sizeof(frames)));
+    AURenderCallbackStruct callback = { InputCallback, NULL };
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0,
+                                             &callback, sizeof(callback)));
+    TREMELO_CHECK_NOERR(AudioUnitInitialize(unit));
+    return unit;
+}
+
+// Seconds per render cycle, the best of kRepeats runs of kCycles.
+static double TimeRender(AudioUnit inUnit)
+{
+    float output[kChannels][kSlice];
+    std::vector<Byte> listStorage(offsetof(AudioBufferList, mBuffers) + kChannels * sizeof(AudioBuffer));
+    AudioBufferList *list = (AudioBufferList *)listStorage.data();
+    AudioTimeStamp timeStamp = {};
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+    double best = 1e9;
+    for (int repeat = 0; repeat < kRepeats; ++repeat) {
+        double start = TremeloBench_Now();
+        for (int i = 0; i < kCycles; ++i) {
+            list->mNumberBuffers = kChannels;
+            for (UInt32 c = 0; c < kChannels; ++c)
+                list->mBuffers[c] = { 1, kSlice * sizeof(float), output[c] };
+            AudioUnitRenderActionFlags flags = 0;
+            TREMELO_CHECK_NOERR(AudioUnitRender(inUnit, &flags, &timeStamp, 0, kSlice, list));
+            timeStamp.mSampleTime += kSlice;
+        }
+        double elapsed = (TremeloBench_Now() - start) / kCycles;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+static void Measure(int inNotifications)
+{
+    AudioUnit unit = NewRenderingUnit();
+    static int refCons[8];
+    for (int i = 0; i < inNotifications; ++i)
+        TREMELO_CHECK_NOERR(AudioUnitAddRenderNotify(unit, Notify, &refCons[i]));
+    const double quiet = TimeRender(unit);
+
+    std::atomic<bool> done(false);
+    std::thread host([&] {
+        static int ninth;
+        while (!done) {
+            TREMELO_CHECK_NOERR(AudioUnitAddRenderNotify(unit, Notify, &ninth));
+            TREMELO_CHECK_NOERR(AudioUnitRemoveRenderNotify(unit, Notify, &ninth));
+        }
+    });
+    const double changing = TimeRender(unit);
+    done = true;
+    host.join();
+    printf("%d notifications: %7.1f ns per render, %7.1f ns while the host changes the list\n", inNotifications,
+           1e9 * quiet, 1e9 * changing);
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+}
+
+static void MeasureChanges(int inNotifications)
+{
+    AudioUnit unit = NewRenderingUnit();
+    static int refCons[8], extra;
+    for (int i = 0; i < inNotifications; ++i)
+        TREMELO_CHECK_NOERR(AudioUnitAddRenderNotify(unit, Notify, &refCons[i]));
+    double best = 1e9;
+    for (int repeat = 0; repeat < kRepeats; ++repeat) {
+        double start = TremeloBench_Now();
+        for (int i = 0; i < kChanges; ++i) {
+            TREMELO_CHECK_NOERR(AudioUnitAddRenderNotify(unit, Notify, &extra));
+            TREMELO_CHECK_NOERR(AudioUnitRemoveRenderNotify(unit, Notify, &extra));
+        }
+        double elapsed = (TremeloBench_Now() - start) / kChanges;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    printf("%d notifications: %7.1f ns to add and remove one more\n", inNotifications, 1e9 * best);
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+}
+
+int main()
+{
+    // TremeloUnit_New registers the component.
+    TremeloUnitRef registered = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&registered));
+    for (UInt32 c = 0; c < kChannels; ++c)
+        TremeloTest_FillSignal(sInput[c], kSlice, c);
+    for (int notifications : { 0, 1, 8 })
+        Measure(notifications);
+    for (int notifications : { 0, 8 })
+        MeasureChanges(notifications);
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(registered));
+    return 0;
+}
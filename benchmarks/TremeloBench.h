@@ -0,0 +1,26 @@
+//
+//  TremeloBench.h
+//  TremeloAUv2
+//
+//  Shared by the benchmark programs in this directory, which are not part of the default
+//  build: 'cmake --build <dir> --target benchmarks', then run them from <dir>/benchmarks.
+//  Each prints one line per measurement. Timings are wall-clock, so run them on an idle
+//  machine and compare numbers from the same machine only.
+//
+
+#ifndef TremeloBench_h
+#define TremeloBench_h
+
+#include "TremeloTest.h"
+
+#include <time.h>
+
+/// Seconds on the monotonic clock.
+static inline double TremeloBench_Now(void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (double)now.tv_sec + 1e-9 * (double)now.tv_nsec;
+}
+
+#endif /* TremeloBench_h */
@@ -0,0 +1,250 @@
+//
+//  TestAsyncInitialize.c
+//  TremeloAUv2
+//
+//  The gain buffers are only allocated for the sample-time LFO: by Initialize, or by enabling
+//  it on an initialized unit. With TremeloUnit_SetAsyncInitialize, Initialize leaves the gain
+//  cache to the setup queue: the unit isn't ready, and renders what a synchronously initialized
+//  unit renders without the cache, until the queue has allocated it; then it is ready, its
+//  listeners hear so once, and the next render takes the cache over. A unit uninitialized or
+//  disposed with its job still queued takes the job back. The queue runs one job at a time, so
+//  a unit whose Ready listener doesn't return until the test lets it holds every other job.
+//
+
+#include "TremeloTest.h"
+
+#include <sched.h>
+#include <stdatomic.h>
+
+enum { kProperty_Ready = 64013 };      // kTremeloUnitProperty_Ready
+
+enum { kChannels = 2, kFrames = 512, kSampleRate = 48000, kSlices = 200 };
+
+static float sInput[kChannels][kFrames];
+
+static TremeloUnitRef NewUnit(int inSampleTimeLFO, int inAsync)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, kSampleRate, kChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kFrames));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 3.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, inSampleTimeLFO));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetAsyncInitialize(unit, inAsync));
+    return unit;
+}
+
+static int IsReady(TremeloUnitRef inUnit)
+{
+    int ready = -1;
+    TREMELO_CHECK_NOERR(TremeloUnit_IsReady(inUnit, &ready));
+    TREMELO_CHECK(ready == 0 || ready == 1);
+    return ready;
+}
+
+static void WaitUntilReady(TremeloUnitRef inUnit)
+{
+    for (long spins = 0; !IsReady(inUnit); ++spins) {
+        TREMELO_CHECK(spins < 100000000);
+        sched_yield();
+    }
+}
+
+// The job notifies after the unit turns ready.
+static void WaitForCalls(atomic_int *inCalls, int inCount)
+{
+    for (long spins = 0; atomic_load(inCalls) < inCount; ++spins) {
+        TREMELO_CHECK(spins < 100000000);
+        sched_yield();
+    }
+    TREMELO_CHECK(atomic_load(inCalls) == inCount);
+}
+
+static TremeloUnitGainCacheStats GetStats(TremeloUnitRef inUnit)
+{
+    TremeloUnitGainCacheStats stats;
+    TREMELO_CHECK_NOERR(TremeloUnit_GetGainCacheStats(inUnit, &stats));
+    return stats;
+}
+
+static uint64_t OtherBytes(TremeloUnitRef inUnit)
+{
+    TremeloUnitMemoryUsage usage;
+    TREMELO_CHECK_NOERR(TremeloUnit_GetMemoryUsage(inUnit, &usage));
+    return usage.other;
+}
+
+// Renders one slice of sInput through both units; their outputs must be bit-identical.
+static void RenderBoth(TremeloUnitRef inExpected, TremeloUnitRef inUnit)
+{
+    static float expected[kChannels][kFrames], output[kChannels][kFrames];
+    const float *input[kChannels] = { sInput[0], sInput[1] };
+    float *expectedOutput[kChannels] = { expected[0], expected[1] }, *unitOutput[kChannels] = { output[0], output[1] };
+    TREMELO_CHECK_NOERR(TremeloUnit_Render(inExpected, input, expectedOutput, kFrames));
+    TREMELO_CHECK_NOERR(TremeloUnit_Render(inUnit, input, unitOutput, kFrames));
+    TREMELO_CHECK(memcmp(expected, output, sizeof(output)) == 0);
+}
+
+// Holds the setup queue: its job's Ready listener waits until the test releases it.
+static atomic_int sBlocking, sReleased;
+
+static void BlockingListener(void *inRefCon, TremeloUnitRef inUnit, uint32_t inPropertyID, uint32_t inScope,
+                             uint32_t inElement)
+{
+    (void)inRefCon, (void)inUnit, (void)inPropertyID, (void)inScope, (void)inElement;
+    atomic_store(&sBlocking, 1);
+    while (!atomic_load(&sReleased))
+        sched_yield();
+}
+
+static TremeloUnitRef HoldQueue(void)
+{
+    atomic_store(&sBlocking, 0);
+    atomic_store(&sReleased, 0);
+    TremeloUnitRef blocker = NewUnit(1, 1);
+    TREMELO_CHECK_NOERR(TremeloUnit_AddPropertyListener(blocker, kProperty_Ready, BlockingListener, NULL));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(blocker));
+    for (long spins = 0; !atomic_load(&sBlocking); ++spins) {
+        TREMELO_CHECK(spins < 100000000);
+        sched_yield();
+    }
+    return blocker;
+}
+
+static void ReleaseQueue(TremeloUnitRef inBlocker)
+{
+    atomic_store(&sReleased, 1);
+    WaitUntilReady(inBlocker);
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(inBlocker));
+}
+
+static void CountingListener(void *inRefCon, TremeloUnitRef inUnit, uint32_t inPropertyID, uint32_t inScope,
+                             uint32_t inElement)
+{
+    (void)inUnit, (void)inScope, (void)inElement;
+    TREMELO_CHECK(inPropertyID == kProperty_Ready);
+    atomic_fetch_add((atomic_int *)inRefCon, 1);
+}
+
+static void TestLazyGainBuffers(void)
+{
+    const uint64_t gainBuffers = 2 * kFrames * sizeof(float);
+
+    // The legacy LFO allocates nothing for gains, and is ready as soon as it is initialized.
+    TremeloUnitRef legacy = NewUnit(0, 0);
+    TREMELO_CHECK(!IsReady(legacy));
+    const uint64_t created = OtherBytes(legacy);
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(legacy));
+    TREMELO_CHECK(IsReady(legacy));
+    const uint64_t initialized = OtherBytes(legacy);
+    TREMELO_CHECK(initialized - created < gainBuffers);     // AUBase's parameter event list
+    TREMELO_CHECK(GetStats(legacy).bytesAllocated == 0);
+
+    // The sample-time LFO: the slice and crossfade gain buffers, and the cache.
+    TremeloUnitRef sync = NewUnit(1, 0);
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(sync));
+    TREMELO_CHECK(IsReady(sync));
+    const uint32_t cacheBytes = GetStats(sync).bytesAllocated;
+    TREMELO_CHECK(cacheBytes >= 2 * kSampleRate * sizeof(float));
+    TREMELO_CHECK(OtherBytes(sync) == initialized + gainBuffers + cacheBytes);
+
+    // Enabled on an initialized unit: the gain buffers before the first render, but no cache
+    // until the next Initialize, and the same output.
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(legacy, 1));
+    TREMELO_CHECK(OtherBytes(legacy) == initialized + gainBuffers);
+    for (int slice = 0; slice < kSlices; ++slice)
+        RenderBoth(sync, legacy);
+    TREMELO_CHECK(GetStats(legacy).bytesAllocated == 0 && GetStats(legacy).framesFromCache == 0);
+    TREMELO_CHECK(GetStats(sync).framesFromCache > 0);
+
+    // Uninitialize frees them all.
+    TREMELO_CHECK_NOERR(TremeloUnit_Uninitialize(sync));
+    TREMELO_CHECK(!IsReady(sync));
+    TREMELO_CHECK(OtherBytes(sync) == initialized);
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(sync));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(legacy));
+}
+
+static void TestReadiness(void)
+{
+    TremeloUnitRef sync = NewUnit(1, 0), async = NewUnit(1, 1);
+    atomic_int readyCalls = 0;
+    TREMELO_CHECK_NOERR(TremeloUnit_AddPropertyListener(async, kProperty_Ready, CountingListener, &readyCalls));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(sync));
+
+    // Queued behind the blocker: not ready, no cache, the same output.
+    TremeloUnitRef blocker = HoldQueue();
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(async));
+    TREMELO_CHECK(!IsReady(async));
+    for (int slice = 0; slice < kSlices / 2; ++slice)
+        RenderBoth(sync, async);
+    TREMELO_CHECK(!IsReady(async) && atomic_load(&readyCalls) == 0);
+    TREMELO_CHECK(GetStats(async).bytesAllocated == 0 && GetStats(async).framesFromCache == 0);
+
+    // Ready once the queue gets to it, and rendering from the cache after the next render.
+    ReleaseQueue(blocker);
+    WaitForCalls(&readyCalls, 1);
+    TREMELO_CHECK(IsReady(async));
+    for (int slice = kSlices / 2; slice < kSlices; ++slice)
+        RenderBoth(sync, async);
+    TREMELO_CHECK(GetStats(async).bytesAllocated == GetStats(sync).bytesAllocated);
+    TREMELO_CHECK(GetStats(async).framesFromCache > 0);
+    TREMELO_CHECK(IsReady(async) && atomic_load(&readyCalls) == 1);
+
+    // Reinitialized with the queue free: ready without rendering.
+    TREMELO_CHECK_NOERR(TremeloUnit_Uninitialize(async));
+    TREMELO_CHECK(!IsReady(async));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(async));
+    WaitForCalls(&readyCalls, 2);
+    TREMELO_CHECK(IsReady(async));
+
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(async));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(sync));
+}
+
+// Units whose jobs are still queued are uninitialized, reinitialized synchronously, or disposed.
+static void TestCancel(void)
+{
+    enum { kUnits = 32 };
+    TremeloUnitRef units[kUnits];
+    atomic_int readyCalls = 0;
+    TremeloUnitRef blocker = HoldQueue();
+    for (int i = 0; i < kUnits; ++i) {
+        units[i] = NewUnit(1, 1);
+        TREMELO_CHECK_NOERR(TremeloUnit_AddPropertyListener(units[i], kProperty_Ready, CountingListener, &readyCalls));
+        TREMELO_CHECK_NOERR(TremeloUnit_Initialize(units[i]));
+    }
+    for (int i = 0; i < kUnits; i += 2) {
+        TREMELO_CHECK_NOERR(TremeloUnit_Uninitialize(units[i]));
+        TREMELO_CHECK(!IsReady(units[i]));
+        TREMELO_CHECK(OtherBytes(units[i]) == OtherBytes(units[i + 1]) - 2 * kFrames * sizeof(float));
+        if (i % 4 == 0) {
+            TREMELO_CHECK_NOERR(TremeloUnit_SetAsyncInitialize(units[i], 0));
+            TREMELO_CHECK_NOERR(TremeloUnit_Initialize(units[i]));
+            TREMELO_CHECK(IsReady(units[i]));
+        }
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(units[i + 1]));
+    }
+    ReleaseQueue(blocker);
+
+    // Only the synchronous ones, which didn't notify, are ready; no cancelled job ever ran.
+    TremeloUnitRef flush = NewUnit(1, 1);
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(flush));
+    WaitUntilReady(flush);
+    TREMELO_CHECK(atomic_load(&readyCalls) == 0);
+    for (int i = 0; i < kUnits; i += 2) {
+        TREMELO_CHECK(IsReady(units[i]) == (i % 4 == 0));
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(units[i]));
+    }
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(flush));
+}
+
+int main(void)
+{
+    for (uint32_t c = 0; c < kChannels; ++c)
+        TremeloTest_FillSignal(sInput[c], kFrames, c);
+    TestLazyGainBuffers();
+    TestReadiness();
+    TestCancel();
+    return 0;
+}
@@ -0,0 +1,150 @@
+//
+//  TestAtomicStack.cpp
+//  TremeloAUv2
+//
+//  TAtomicStack2's double-width compare-and-swap against the ABA problem. The node's next()
+//  accessor runs between a pop's load of the head and its compare-and-swap, so the test uses it
+//  to stage the classic interleaving: the popping thread has read head X and X's next Y when X
+//  and Y are popped and X is pushed back. A pointer-only swap would then install Y, which is no
+//  longer on the stack. Then several threads pop and push at once, and every node must be owned
+//  by one thread at a time and come back in the end. TAtomicStack is checked with many pushers
+//  and its single reader.
+//
+
+#include "TremeloTest.h"
+#include "CAAtomicStack.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+struct Node {
+    Node *                  mNext;
+    std::atomic<int>        mOwner;
+    Node() : mNext(NULL), mOwner(-1) { }
+
+    Node *& next();
+};
+
+// The ABA interleaving, armed for one call of next() on one thread.
+static TAtomicStack2<Node> *sInterleaveStack;
+static thread_local bool sInterleaveArmed;
+static thread_local Node *sStaleNext;
+static Node *sInterleavePopped[2];
+
+Node *& Node::next()
+{
+    if (!sInterleaveArmed)
+        return mNext;
+    sInterleaveArmed = false;
+    // What the interrupted pop would have read before the other thread ran.
+    sStaleNext = mNext;
+    sInterleavePopped[0] = sInterleaveStack->pop_atomic();      // this node
+    sInterleavePopped[1] = sInterleaveStack->pop_atomic();      // its next
+    sInterleaveStack->push_atomic(sInterleavePopped[0]);
+    return sStaleNext;
+}
+
+static void TestABA()
+{
+    Node x, y, z;
+    TAtomicStack2<Node> stack;
+    stack.push_atomic(&z);
+    stack.push_atomic(&y);
+    stack.push_atomic(&x);
+
+    sInterleaveStack = &stack;
+    sInterleaveArmed = true;
+    Node *popped = stack.pop_atomic();
+    TREMELO_CHECK(!sInterleaveArmed);
+    TREMELO_CHECK(sInterleavePopped[0] == &x && sInterleavePopped[1] == &y);
+
+    // The stale swap must have failed and the retry popped X again, leaving Z: Y belongs to
+    // whoever popped it and must not be back on the stack.
+    TREMELO_CHECK(popped == &x);
+    TREMELO_CHECK(stack.pop_atomic() == &z);
+    TREMELO_CHECK(stack.pop_atomic() == NULL);
+}
+
+static void TestConcurrentPops()
+{
+    enum { kThreads = 4, kNodesPerThread = 16, kRounds = 20000, kHeld = 8 };
+    std::vector<Node> nodes(kThreads * kNodesPerThread);
+    TAtomicStack2<Node> stack;
+    for (Node &node : nodes)
+        stack.push_atomic(&node);
+
+    std::atomic<int> doubleOwned(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t)
+        threads.emplace_back([&, t] {
+            Node *held[kHeld];
+            for (int round = 0; round < kRounds; ++round) {
+                int count = 0;
+                for (; count < kHeld; ++count) {
+                    held[count] = stack.pop_atomic();
+                    if (held[count] == NULL)
+                        break;
+                    if (held[count]->mOwner.exchange(t, std::memory_order_relaxed) != -1)
+                        doubleOwned.fetch_add(1, std::memory_order_relaxed);
+                }
+                while (count--) {
+                    held[count]->mOwner.store(-1, std::memory_order_relaxed);
+                    stack.push_atomic(held[count]);
+                }
+                if (round % 256 == 0)
+                    std::this_thread::yield();
+            }
+        });
+    for (std::thread &thread : threads)
+        thread.join();
+
+    TREMELO_CHECK(doubleOwned.load() == 0);
+    size_t recovered = 0;
+    while (Node *node = stack.pop_atomic()) {
+        TREMELO_CHECK(node->mOwner.load() == -1);
+        node->mOwner.store(-2);
+        ++recovered;
+    }
+    TREMELO_CHECK(recovered == nodes.size());
+}
+
+static void TestSingleReader()
+{
+    enum { kPushers = 3, kNodesPerPusher = 20000 };
+    std::vector<Node> nodes(kPushers * kNodesPerPusher);
+    TAtomicStack<Node> stack;
+    std::vector<std::thread> pushers;
+    for (int t = 0; t < kPushers; ++t)
+        pushers.emplace_back([&, t] {
+            for (int i = 0; i < kNodesPerPusher; ++i)
+                stack.push_atomic(&nodes[t * kNodesPerPusher + i]);
+        });
+
+    // Alternate single pops with taking everything at once.
+    size_t popped = 0;
+    while (popped < nodes.size()) {
+        if (popped % 2) {
+            for (Node *node = stack.pop_all(); node != NULL; node = node->next()) {
+                TREMELO_CHECK(node->mOwner.exchange(0) == -1);
+                ++popped;
+            }
+        } else if (Node *node = stack.pop_atomic_single_reader()) {
+            TREMELO_CHECK(node->mOwner.exchange(0) == -1);
+            ++popped;
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    for (std::thread &pusher : pushers)
+        pusher.join();
+    TREMELO_CHECK(stack.empty());
+}
+
+int main()
+{
+    TestABA();
+    TestConcurrentPops();
+    TestSingleReader();
+    return 0;
+}
@@ -0,0 +1,362 @@
+//
+//  TestBinaryState.cpp
+//  TremeloAUv2
+//
+//  AUBase's binary state (kTremeloUnitProperty_BinaryState): a state saved from one unit
+//  restores on another the indexed global parameters, the ID/value pairs of an element that
+//  isn't indexed and the preset, and leaves out parameters flagged OmitFromPresets, as the
+//  property list does. Truncated, misaligned, wrong-magic, wrong-component and oversized-count
+//  blobs are refused without changing anything. Restored on an initialized unit, the global
+//  parameters reach the kernels through TremeloUnit::RestoreParameterValues's exchange: the
+//  next render cycle takes them all at once, and renders what a unit whose parameters were set
+//  before it renders.
+//
+
+#include "TremeloTest.h"
+#include "TremeloUnit.hpp"
+#include "AudioComponent.h"
+#include "CAStreamBasicDescription.h"
+
+#include <vector>
+
+enum { kSampleRate = 48000, kChannels = 2, kSlice = 512, kSlices = 4 };
+
+// Parameters of the output element, which isn't indexed; kOmittedID is flagged OmitFromPresets.
+enum { kOutputIDs = 3, kOmittedID = 205 };
+static const AudioUnitParameterID kOutputParameterIDs[kOutputIDs] = { 7, 100, kOmittedID };
+
+static float sInput[kChannels][kSlice * kSlices];
+
+// TremeloUnit with a non-indexed element and parameters left out of presets.
+class TestStateUnit : public TremeloUnit {
+public:
+    static bool             sOmitDepth;     // flag the global Depth parameter OmitFromPresets too
+    static TestStateUnit *  sNewest;        // the instance created last
+
+    TestStateUnit(AudioComponentInstance inInstance) : TremeloUnit(inInstance) {
+        sNewest = this;
+        for (AudioUnitParameterID paramID : kOutputParameterIDs)
+            GetScope(kAudioUnitScope_Output).GetElement(0)->SetParameter(paramID, 0.f);
+    }
+
+    ComponentResult GetParameterInfo(AudioUnitScope inScope, AudioUnitParameterID inParameterID,
+                                     AudioUnitParameterInfo &outParameterInfo) override {
+        if (inScope == kAudioUnitScope_Output) {
+            memset(&outParameterInfo, 0, sizeof(outParameterInfo));
+            outParameterInfo.flags = kAudioUnitParameterFlag_IsReadable | kAudioUnitParameterFlag_IsWritable;
+            if (inParameterID == kOmittedID)
+                outParameterInfo.flags |= kAudioUnitParameterFlag_OmitFromPresets;
+            outParameterInfo.maxValue = 1000.f;
+            return noErr;
+        }
+        ComponentResult result = TremeloUnit::GetParameterInfo(inScope, inParameterID, outParameterInfo);
+        if (result == noErr && sOmitDepth && inParameterID == kParameter_Depth)
+            outParameterInfo.flags |= kAudioUnitParameterFlag_OmitFromPresets;
+        return result;
+    }
+
+    // What the parameter element holds, not a recalled state that Render hasn't taken yet.
+    AudioUnitParameterValue GetElementValue(AudioUnitParameterID inID) {
+        return Globals()->GetParameter(inID);
+    }
+};
+
+bool TestStateUnit::sOmitDepth = false;
+TestStateUnit *TestStateUnit::sNewest = NULL;
+
+AUDIOCOMPONENT_ENTRY(AUBaseFactory, TestStateUnit)
+
+static AudioUnit NewStateUnit()
+{
+    AudioComponentDescription desc = { kAudioUnitType_Effect, 'tbst', 'Test', 0, 0 };
+    static AudioComponent sComponent = AudioComponentRegister(&desc, CFSTR("TestStateUnit"), 1,
+                                                              (AudioComponentFactoryFunction)TestStateUnitFactory);
+    TREMELO_CHECK(sComponent != NULL);
+    AudioUnit unit = NULL;
+    TREMELO_CHECK_NOERR(AudioComponentInstanceNew(sComponent, &unit));
+    return unit;
+}
+
+static float GetValue(AudioUnit inUnit, AudioUnitScope inScope, AudioUnitParameterID inID)
+{
+    AudioUnitParameterValue value = -1.f;
+    TREMELO_CHECK_NOERR(AudioUnitGetParameter(inUnit, inID, inScope, 0, &value));
+    return value;
+}
+
+static void SetValue(AudioUnit inUnit, AudioUnitScope inScope, AudioUnitParameterID inID, float inValue)
+{
+    TREMELO_CHECK_NOERR(AudioUnitSetParameter(inUnit, inID, inScope, 0, inValue, 0));
+}
+
+static void SetGlobals(AudioUnit inUnit, float inFrequency, float inDepth, float inWaveform)
+{
+    SetValue(inUnit, kAudioUnitScope_Global, kParameter_Frequency, inFrequency);
+    SetValue(inUnit, kAudioUnitScope_Global, kParameter_Depth, inDepth);
+    SetValue(inUnit, kAudioUnitScope_Global, kParameter_Waveform, inWaveform);
+}
+
+// The binary state, in a buffer of UInt32 so that it is aligned.
+static std::vector<UInt32> SaveState(AudioUnit inUnit)
+{
+    UInt32 size = 0;
+    Boolean writable = false;
+    TREMELO_CHECK_NOERR(AudioUnitGetPropertyInfo(inUnit, kTremeloUnitProperty_BinaryState, kAudioUnitScope_Global, 0,
+                                                 &size, &writable));
+    TREMELO_CHECK(writable && size % 4 == 0 && size >= sizeof(AUBinaryStateHeader));
+    std::vector<UInt32> state(size / 4);
+    TREMELO_CHECK_NOERR(AudioUnitGetProperty(inUnit, kTremeloUnitProperty_BinaryState, kAudioUnitScope_Global, 0,
+                                             state.data(), &size));
+    TREMELO_CHECK(size == state.size() * 4 && reinterpret_cast<const AUBinaryStateHeader *>(state.data())->mSize == size);
+    return state;
+}
+
+static OSStatus RestoreState(AudioUnit inUnit, const void *inData, UInt32 inSize)
+{
+    return AudioUnitSetProperty(inUnit, kTremeloUnitProperty_BinaryState, kAudioUnitScope_Global, 0, inData, inSize);
+}
+
+static AUPreset GetPreset(AudioUnit inUnit)
+{
+    AUPreset preset = { -2, NULL };
+    UInt32 size = sizeof(preset);
+    TREMELO_CHECK_NOERR(AudioUnitGetProperty(inUnit, kAudioUnitProperty_PresentPreset, kAudioUnitScope_Global, 0,
+                                             &preset, &size));
+    TREMELO_CHECK(preset.presetName != NULL);
+    return preset;
+}
+
+#pragma mark ____Round Trip
+
+static void TestRoundTrip(bool inOmitDepth)
+{
+    TestStateUnit::sOmitDepth = inOmitDepth;
+    AudioUnit source = NewStateUnit(), destination = NewStateUnit();
+    AUPreset fast = kPresets[kPreset_Fast];
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(source, kAudioUnitProperty_PresentPreset, kAudioUnitScope_Global, 0,
+                                             &fast, sizeof(fast)));
+    SetGlobals(source, 13.5f, 10.f, kSquareWave_Tremelo_Waveform);
+    for (UInt32 i = 0; i < kOutputIDs; ++i)
+        SetValue(source, kAudioUnitScope_Output, kOutputParameterIDs[i], 11.f * (i + 1));
+
+    std::vector<UInt32> state = SaveState(source);
+    const AUBinaryStateHeader &header = *reinterpret_cast<const AUBinaryStateHeader *>(state.data());
+    const AUBinaryStateBlock &globals = *reinterpret_cast<const AUBinaryStateBlock *>(&header + 1);
+    TREMELO_CHECK(header.mNumberOfBlocks == 2);
+    TREMELO_CHECK(globals.mScope == kAudioUnitScope_Global && globals.mIndexed == !inOmitDepth);
+    TREMELO_CHECK(globals.mCount == (inOmitDepth ? kNumberOfParameters - 1 : kNumberOfParameters));
+    TREMELO_CHECK_NOERR(RestoreState(destination, state.data(), UInt32(state.size() * 4)));
+
+    TREMELO_CHECK(GetValue(destination, kAudioUnitScope_Global, kParameter_Frequency) == 13.5f);
+    TREMELO_CHECK(GetValue(destination, kAudioUnitScope_Global, kParameter_Depth) == (inOmitDepth ? 50.f : 10.f));
+    TREMELO_CHECK(GetValue(destination, kAudioUnitScope_Global, kParameter_Waveform) == kSquareWave_Tremelo_Waveform);
+    TREMELO_CHECK(GetValue(destination, kAudioUnitScope_Output, kOutputParameterIDs[0]) == 11.f);
+    TREMELO_CHECK(GetValue(destination, kAudioUnitScope_Output, kOutputParameterIDs[1]) == 22.f);
+    TREMELO_CHECK(GetValue(destination, kAudioUnitScope_Output, kOmittedID) == 0.f);
+    AUPreset preset = GetPreset(destination);
+    TREMELO_CHECK(preset.presetNumber == kPreset_Fast && CFEqual(preset.presetName, fast.presetName));
+    CFRelease(preset.presetName);
+
+    // The property list leaves out the same parameters. It restores the preset's name only, as
+    // a user preset's.
+    AudioUnit viaClassInfo = NewStateUnit();
+    CFPropertyListRef classInfo = NULL;
+    UInt32 size = sizeof(classInfo);
+    TREMELO_CHECK_NOERR(AudioUnitGetProperty(source, kAudioUnitProperty_ClassInfo, kAudioUnitScope_Global, 0,
+                                             &classInfo, &size));
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(viaClassInfo, kAudioUnitProperty_ClassInfo, kAudioUnitScope_Global, 0,
+                                             &classInfo, sizeof(classInfo)));
+    CFRelease(classInfo);
+    std::vector<UInt32> restored = SaveState(viaClassInfo);
+    AUBinaryStateHeader &restoredHeader = *reinterpret_cast<AUBinaryStateHeader *>(restored.data());
+    TREMELO_CHECK(restoredHeader.mPresetNumber == -1);
+    restoredHeader.mPresetNumber = kPreset_Fast;
+    TREMELO_CHECK(restored == SaveState(destination));
+
+    TestStateUnit::sOmitDepth = false;
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(viaClassInfo));
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(destination));
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(source));
+}
+
+#pragma mark ____Malformed States
+
+// Every one is refused, and the unit is left as it was.
+static void TestMalformed()
+{
+    AudioUnit source = NewStateUnit(), unit = NewStateUnit();
+    SetGlobals(source, 3.f, 70.f, kSquareWave_Tremelo_Waveform);
+    SetValue(source, kAudioUnitScope_Output, kOutputParameterIDs[0], 5.f);
+    const std::vector<UInt32> state = SaveState(source);
+    const UInt32 size = UInt32(state.size() * 4);
+    const std::vector<UInt32> before = SaveState(unit);
+
+    auto refused = [&](const void *inData, UInt32 inSize) {
+        TREMELO_CHECK(RestoreState(unit, inData, inSize) == kAudioUnitErr_InvalidPropertyValue);
+        TREMELO_CHECK(SaveState(unit) == before);
+    };
+    auto header = [](std::vector<UInt32> &ioState) { return reinterpret_cast<AUBinaryStateHeader *>(ioState.data()); };
+    auto firstBlock = [&](std::vector<UInt32> &ioState) {
+        return reinterpret_cast<AUBinaryStateBlock *>(header(ioState) + 1);
+    };
+
+    // Truncated: shorter than the header, shorter than its size, and a size that cuts into the
+    // blocks or the name.
+    refused(state.data(), sizeof(AUBinaryStateHeader) - 4);
+    refused(state.data(), size - 4);
+    for (UInt32 cut : { UInt32(sizeof(AUBinaryStateHeader) + 8), size - 4 }) {
+        std::vector<UInt32> truncated = state;
+        header(truncated)->mSize = cut;
+        refused(truncated.data(), size);
+    }
+    // Misaligned.
+    std::vector<UInt8> bytes(size + 1);
+    memcpy(bytes.data() + 1, state.data(), size);
+    refused(bytes.data() + 1, size);
+    // Wrong magic, version and component.
+    std::vector<UInt32> wrong = state;
+    header(wrong)->mMagic = 'AUbS';
+    refused(wrong.data(), size);
+    wrong = state;
+    header(wrong)->mVersion += 1;
+    refused(wrong.data(), size);
+    wrong = state;
+    header(wrong)->mComponentSubType = 'tbsu';
+    refused(wrong.data(), size);
+    TremeloUnitRef tremelo = NULL;
+    UInt32 tremeloSize = 0;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&tremelo));
+    TREMELO_CHECK_NOERR(TremeloUnit_SaveState(tremelo, NULL, &tremeloSize));
+    std::vector<UInt32> tremeloState(tremeloSize / 4);
+    TREMELO_CHECK_NOERR(TremeloUnit_SaveState(tremelo, tremeloState.data(), &tremeloSize));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(tremelo));
+    refused(tremeloState.data(), tremeloSize);
+    // Oversized counts: of blocks, of values in a block (also where count * 4 wraps around 32
+    // bits), and of the name's bytes; and a name without its terminating zero.
+    wrong = state;
+    header(wrong)->mNumberOfBlocks = 0x10000000;
+    refused(wrong.data(), size);
+    for (UInt32 count : { 4U, 0x40000001U, 0xFFFFFFFFU }) {
+        wrong = state;
+        firstBlock(wrong)->mCount = count;
+        refused(wrong.data(), size);
+    }
+    wrong = state;
+    header(wrong)->mNameLength = kAUBinaryStateMaxNameLength + 1;
+    refused(wrong.data(), size);
+    wrong = state;
+    memset(reinterpret_cast<UInt8 *>(wrong.data()) + size - 4, 'x', 4);
+    header(wrong)->mNameLength = 3;
+    refused(wrong.data(), size);
+
+    // The state itself still restores.
+    TREMELO_CHECK_NOERR(RestoreState(unit, state.data(), size));
+    TREMELO_CHECK(SaveState(unit) == state);
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(source));
+}
+
+#pragma mark ____Restore While Initialized
+
+static UInt32 sSliceOffset;
+
+// A copy of the slice of sInput, which the unit may process in place.
+static OSStatus InputCallback(void *, AudioUnitRenderActionFlags *, const AudioTimeStamp *, UInt32, UInt32 inNumberFrames,
+                              AudioBufferList *ioData)
+{
+    static float input[kChannels][kSlice];
+    for (UInt32 c = 0; c < ioData->mNumberBuffers; ++c) {
+        memcpy(input[c], sInput[c] + sSliceOffset, inNumberFrames * sizeof(float));
+        ioData->mBuffers[c].mData = input[c];
+        ioData->mBuffers[c].mDataByteSize = inNumberFrames * sizeof(float);
+    }
+    return noErr;
+}
+
+static AudioUnit NewRenderingUnit()
+{
+    AudioUnit unit = NewStateUnit();
+    CAStreamBasicDescription format(kSampleRate, kChannels, CAStreamBasicDescription::kPCMFormatFloat32, false);
+    for (AudioUnitScope scope : { kAudioUnitScope_Input, kAudioUnitScope_Output })
+        TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_StreamFormat, scope, 0, &format,
+                                                 sizeof(AudioStreamBasicDescription)));
+    UInt32 frames = kSlice;
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0,
+                                             &frames, sizeof(frames)));
+    AURenderCallbackStruct callback = { InputCallback, NULL };
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0,
+                                             &callback, sizeof(callback)));
+    SetGlobals(unit, 2.f, 40.f, kSineWave_Tremelo_Waveform);
+    TREMELO_CHECK_NOERR(AudioUnitInitialize(unit));
+    return unit;
+}
+
+static std::vector<float> RenderSlice(AudioUnit inUnit, UInt32 inSlice)
+{
+    std::vector<float> output(kChannels * kSlice);
+    std::vector<Byte> listStorage(offsetof(AudioBufferList, mBuffers) + kChannels * sizeof(AudioBuffer));
+    AudioBufferList *list = (AudioBufferList *)listStorage.data();
+    list->mNumberBuffers = kChannels;
+    for (UInt32 c = 0; c < kChannels; ++c)
+        list->mBuffers[c] = { 1, kSlice * sizeof(float), &output[c * kSlice] };
+    AudioTimeStamp timeStamp = {};
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+    timeStamp.mSampleTime = inSlice * kSlice;
+    AudioUnitRenderActionFlags flags = 0;
+    sSliceOffset = inSlice * kSlice;
+    TREMELO_CHECK_NOERR(AudioUnitRender(inUnit, &flags, &timeStamp, 0, kSlice, list));
+    // The buffers may have been replaced by the unit's own.
+    for (UInt32 c = 0; c < kChannels; ++c)
+        if (list->mBuffers[c].mData != &output[c * kSlice])
+            memcpy(&output[c * kSlice], list->mBuffers[c].mData, kSlice * sizeof(float));
+    return output;
+}
+
+static void TestRestoreWhileInitialized()
+{
+    AudioUnit source = NewStateUnit();
+    SetGlobals(source, 9.f, 90.f, kSquareWave_Tremelo_Waveform);
+    const std::vector<UInt32> state = SaveState(source);
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(source));
+
+    AudioUnit unit = NewRenderingUnit();
+    TestStateUnit *implementation = TestStateUnit::sNewest;
+    AudioUnit reference = NewRenderingUnit();
+    const std::vector<float> first = RenderSlice(unit, 0);
+    TREMELO_CHECK(first == RenderSlice(reference, 0) && first != std::vector<float>(first.size()));
+
+    TREMELO_CHECK_NOERR(RestoreState(unit, state.data(), UInt32(state.size() * 4)));
+    // Reported at once, but the parameter element is only written by the next render cycle.
+    TREMELO_CHECK(GetValue(unit, kAudioUnitScope_Global, kParameter_Frequency) == 9.f);
+    TREMELO_CHECK(GetValue(unit, kAudioUnitScope_Global, kParameter_Depth) == 90.f);
+    TREMELO_CHECK(implementation->GetElementValue(kParameter_Frequency) == 2.f);
+    TREMELO_CHECK(implementation->GetElementValue(kParameter_Depth) == 40.f);
+    TREMELO_CHECK(implementation->GetElementValue(kParameter_Waveform) == kSineWave_Tremelo_Waveform);
+
+    SetGlobals(reference, 9.f, 90.f, kSquareWave_Tremelo_Waveform);
+    for (UInt32 slice = 1; slice < kSlices; ++slice)
+        TREMELO_CHECK(RenderSlice(unit, slice) == RenderSlice(reference, slice));
+    TREMELO_CHECK(implementation->GetElementValue(kParameter_Frequency) == 9.f);
+    TREMELO_CHECK(implementation->GetElementValue(kParameter_Depth) == 90.f);
+    TREMELO_CHECK(implementation->GetElementValue(kParameter_Waveform) == kSquareWave_Tremelo_Waveform);
+
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(reference));
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+}
+
+int main()
+{
+    for (UInt32 c = 0; c < kChannels; ++c)
+        TremeloTest_FillSignal(sInput[c], kSlice * kSlices, c);
+
+    // TremeloUnit_New registers TremeloUnit's own component, which the test's subclass needs.
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+
+    TestRoundTrip(false);
+    TestRoundTrip(true);
+    TestMalformed();
+    TestRestoreWhileInitialized();
+    return 0;
+}
@@ -0,0 +1,276 @@
+//
+//  TestBufferArena.cpp
+//  TremeloAUv2
+//
+//  AUBufferArena: a thread gets back the block it returned last, blocks released from another
+//  thread come out of the shared reserve without allocating, and Reserve only tops up what is
+//  missing. With the shared-arena buffer option, units rendered one after another share the
+//  same few blocks however many there are, and render exactly what units with buffers of their
+//  own render, on one thread or several. Buffers a NULL-buffer render handed to its caller, and
+//  those of a unit pulled through a connection, stay intact while other units render.
+//
+
+#include "TremeloTest.h"
+#include "TremeloUnit.hpp"
+#include "AudioComponent.h"
+#include "AUBuffer.h"
+#include "CAStreamBasicDescription.h"
+
+#include <thread>
+#include <vector>
+
+enum { kChannels = 2, kFrames = 4096, kUnits = 200, kThreads = 4, kUnitsPerThread = 8 };
+
+static float sInput[kChannels][kFrames];
+
+static void TestBlocks()
+{
+    const UInt64 allocated = AUBufferArena::GetAllocatedBytes();
+    AUBufferArena::Block *block = AUBufferArena::Borrow(5000);
+    TREMELO_CHECK(AUBufferArena::GetSize(block) == 8192);
+    TREMELO_CHECK(((uintptr_t)AUBufferArena::GetData(block) & (AUBufferMemory::kDefaultAlignment - 1)) == 0);
+    TREMELO_CHECK(AUBufferArena::GetAllocatedBytes() == allocated + 8192);
+    memset(AUBufferArena::GetData(block), 0x5A, 8192);
+
+    // The same size class comes back from this thread's free list.
+    AUBufferArena::Return(block);
+    TREMELO_CHECK(AUBufferArena::Borrow(8192) == block);
+    AUBufferArena::Block *small = AUBufferArena::Borrow(1);
+    TREMELO_CHECK(AUBufferArena::GetSize(small) == 4096);
+    TREMELO_CHECK(AUBufferArena::GetAllocatedBytes() == allocated + 8192 + 4096);
+
+    // Released blocks go to the shared reserve, where another thread borrows them.
+    AUBufferArena::Release(block);
+    AUBufferArena::Release(small);
+    std::thread([&] {
+        AUBufferArena::Block *borrowed = AUBufferArena::Borrow(6000);
+        TREMELO_CHECK(borrowed == block);
+        AUBufferArena::Return(borrowed);
+    }).join();
+    TREMELO_CHECK(AUBufferArena::GetAllocatedBytes() == allocated + 8192 + 4096);
+
+    // The thread gave its free list back as it exited; Reserve tops up what is missing once.
+    const UInt32 wanted[] = { 8000, 8000, 3000 };
+    AUBufferArena::Reserve(wanted, 3);
+    TREMELO_CHECK(AUBufferArena::GetAllocatedBytes() == allocated + 2 * 8192 + 4096);
+    AUBufferArena::Reserve(wanted, 3);
+    TREMELO_CHECK(AUBufferArena::GetAllocatedBytes() == allocated + 2 * 8192 + 4096);
+}
+
+static TremeloUnitRef NewUnit(int inIndex)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 48000., kChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kFrames));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 1.f + inIndex % 19));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    return unit;
+}
+
+static void RenderUnit(TremeloUnitRef inUnit, float (*outOutput)[kFrames])
+{
+    const float *input[kChannels] = { sInput[0], sInput[1] };
+    float *output[kChannels] = { outOutput[0], outOutput[1] };
+    TREMELO_CHECK_NOERR(TremeloUnit_Render(inUnit, input, output, kFrames));
+}
+
+// Units with their own buffers against units sharing the arena, rendered one after another.
+static void TestSharing()
+{
+    static float own[kChannels][kFrames], shared[kChannels][kFrames];
+    std::vector<TremeloUnitRef> ownUnits(kUnits), sharedUnits(kUnits);
+    TREMELO_CHECK_NOERR(TremeloUnit_SetBufferOptions(0));
+    for (int i = 0; i < kUnits; ++i)
+        ownUnits[i] = NewUnit(i);
+
+    TREMELO_CHECK_NOERR(TremeloUnit_SetBufferOptions(kTremeloUnitBufferOption_SharedArena));
+    TREMELO_CHECK(AUBufferArena::IsEnabled());
+    const UInt64 allocated = AUBufferArena::GetAllocatedBytes();
+    sharedUnits[0] = NewUnit(0);
+    const UInt64 perUnit = AUBufferArena::GetAllocatedBytes() - allocated;
+    TREMELO_CHECK(perUnit >= kChannels * kFrames * sizeof(float));
+    for (int i = 1; i < kUnits; ++i)
+        sharedUnits[i] = NewUnit(i);
+
+    TremeloUnitMemoryUsage ownUsage, sharedUsage;
+    TREMELO_CHECK_NOERR(TremeloUnit_GetMemoryUsage(ownUnits[0], &ownUsage));
+    TREMELO_CHECK_NOERR(TremeloUnit_GetMemoryUsage(sharedUnits[0], &sharedUsage));
+    TREMELO_CHECK(sharedUsage.ioBuffers < ownUsage.ioBuffers);
+
+    for (int cycle = 0; cycle < 3; ++cycle)
+        for (int i = 0; i < kUnits; ++i) {
+            RenderUnit(ownUnits[i], own);
+            RenderUnit(sharedUnits[i], shared);
+            TREMELO_CHECK(memcmp(own, shared, sizeof(own)) == 0);
+        }
+    // However many units there are, they reuse one unit's worth.
+    TREMELO_CHECK(AUBufferArena::GetAllocatedBytes() - allocated <= perUnit);
+
+    for (int i = 0; i < kUnits; ++i) {
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(ownUnits[i]));
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(sharedUnits[i]));
+    }
+    TREMELO_CHECK_NOERR(TremeloUnit_SetBufferOptions(0));
+}
+
+// Each thread renders its own units against the same units rendered with buffers of their own.
+static void TestThreads()
+{
+    static float expected[kUnitsPerThread][kChannels][kFrames];
+    TREMELO_CHECK_NOERR(TremeloUnit_SetBufferOptions(0));
+    for (int i = 0; i < kUnitsPerThread; ++i) {
+        TremeloUnitRef unit = NewUnit(i);
+        RenderUnit(unit, expected[i]);
+        RenderUnit(unit, expected[i]);
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+    }
+
+    TREMELO_CHECK_NOERR(TremeloUnit_SetBufferOptions(kTremeloUnitBufferOption_SharedArena));
+    for (int round = 0; round < 3; ++round) {
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t)
+            threads.emplace_back([] {
+                static thread_local float output[kChannels][kFrames];
+                TremeloUnitRef units[kUnitsPerThread];
+                for (int i = 0; i < kUnitsPerThread; ++i)
+                    units[i] = NewUnit(i);
+                for (int pass = 0; pass < 2; ++pass)
+                    for (int i = 0; i < kUnitsPerThread; ++i)
+                        RenderUnit(units[i], output);
+                for (int i = 0; i < kUnitsPerThread; ++i) {
+                    TREMELO_CHECK_NOERR(TremeloUnit_Reset(units[i]));
+                    RenderUnit(units[i], output);
+                    RenderUnit(units[i], output);
+                    TREMELO_CHECK(memcmp(output, expected[i], sizeof(output)) == 0);
+                    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(units[i]));
+                }
+            });
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+    TREMELO_CHECK_NOERR(TremeloUnit_SetBufferOptions(0));
+}
+
+#pragma mark ____Buffers handed out
+
+static OSStatus InputCallback(void *, AudioUnitRenderActionFlags *, const AudioTimeStamp *, UInt32, UInt32 inNumberFrames,
+                              AudioBufferList *ioData)
+{
+    for (UInt32 c = 0; c < ioData->mNumberBuffers; ++c) {
+        if (ioData->mBuffers[c].mData == NULL)
+            ioData->mBuffers[c].mData = sInput[c];
+        else
+            memcpy(ioData->mBuffers[c].mData, sInput[c], inNumberFrames * sizeof(float));
+        ioData->mBuffers[c].mDataByteSize = inNumberFrames * sizeof(float);
+    }
+    return noErr;
+}
+
+static AudioUnit NewAudioUnit(AudioUnit inSource)
+{
+    AudioComponentDescription desc = { kAudioUnitType_Effect, TremeloUnit_COMP_SUBTYPE, TrmeloUnit_COMP_MANF, 0, 0 };
+    AudioComponent component = AudioComponentFindNext(NULL, &desc);
+    TREMELO_CHECK(component != NULL);
+    AudioUnit unit = NULL;
+    TREMELO_CHECK_NOERR(AudioComponentInstanceNew(component, &unit));
+    CAStreamBasicDescription format(48000., kChannels, CAStreamBasicDescription::kPCMFormatFloat32, false);
+    for (AudioUnitScope scope : { kAudioUnitScope_Input, kAudioUnitScope_Output })
+        TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_StreamFormat, scope, 0, &format,
+                                                 sizeof(AudioStreamBasicDescription)));
+    UInt32 maximumFrames = kFrames;
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0,
+                                             &maximumFrames, sizeof(maximumFrames)));
+    if (inSource != NULL) {
+        AudioUnitConnection connection = { inSource, 0, 0 };
+        TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_MakeConnection, kAudioUnitScope_Input, 0,
+                                                 &connection, sizeof(connection)));
+    } else {
+        AURenderCallbackStruct callback = { InputCallback, NULL };
+        TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0,
+                                                 &callback, sizeof(callback)));
+    }
+    TREMELO_CHECK_NOERR(AudioUnitInitialize(unit));
+    return unit;
+}
+
+struct NullBufferList {
+    UInt32          mNumberBuffers;
+    AudioBuffer     mBuffers[kChannels];
+};
+
+// Renders with NULL buffers, so the unit hands out its own, and returns a copy of the output.
+static std::vector<float> RenderNull(AudioUnit inUnit, Float64 inSampleTime, NullBufferList &outList)
+{
+    outList.mNumberBuffers = kChannels;
+    for (UInt32 c = 0; c < kChannels; ++c)
+        outList.mBuffers[c] = { 1, kFrames * sizeof(float), NULL };
+    AudioTimeStamp timeStamp = {};
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+    timeStamp.mSampleTime = inSampleTime;
+    AudioUnitRenderActionFlags flags = 0;
+    TREMELO_CHECK_NOERR(AudioUnitRender(inUnit, &flags, &timeStamp, 0, kFrames, (AudioBufferList *)&outList));
+    std::vector<float> copy;
+    for (UInt32 c = 0; c < kChannels; ++c) {
+        TREMELO_CHECK(outList.mBuffers[c].mData != NULL);
+        const float *samples = (const float *)outList.mBuffers[c].mData;
+        copy.insert(copy.end(), samples, samples + kFrames);
+    }
+    return copy;
+}
+
+static bool StillHolds(const NullBufferList &inList, const std::vector<float> &inCopy)
+{
+    for (UInt32 c = 0; c < kChannels; ++c)
+        if (memcmp(inList.mBuffers[c].mData, &inCopy[c * kFrames], kFrames * sizeof(float)) != 0)
+            return false;
+    return true;
+}
+
+static void TestHandedOut()
+{
+    // TremeloUnit_New registers the component with the shim.
+    TremeloUnitRef registration = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&registration));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(registration));
+
+    TREMELO_CHECK_NOERR(TremeloUnit_SetBufferOptions(kTremeloUnitBufferOption_SharedArena));
+    AudioUnit source = NewAudioUnit(NULL);
+    AudioUnit pulling = NewAudioUnit(source);
+    AudioUnit other = NewAudioUnit(NULL);
+    TREMELO_CHECK_NOERR(AudioUnitSetParameter(other, kTremeloUnitParam_Frequency, kAudioUnitScope_Global, 0, 11.f, 0));
+
+    for (int cycle = 0; cycle < 4; ++cycle) {
+        const Float64 sampleTime = cycle * kFrames;
+        NullBufferList pulled, unrelated;
+        std::vector<float> pulledCopy = RenderNull(pulling, sampleTime, pulled);
+        // The source's output for this cycle, which the pulling unit read through the connection.
+        NullBufferList sourced;
+        std::vector<float> sourcedCopy = RenderNull(source, sampleTime, sourced);
+
+        std::vector<float> unrelatedCopy = RenderNull(other, sampleTime, unrelated);
+        TREMELO_CHECK(pulledCopy != unrelatedCopy);
+        for (UInt32 c = 0; c < kChannels; ++c)
+            for (UInt32 d = 0; d < kChannels; ++d) {
+                TREMELO_CHECK(unrelated.mBuffers[c].mData != pulled.mBuffers[d].mData);
+                TREMELO_CHECK(unrelated.mBuffers[c].mData != sourced.mBuffers[d].mData);
+            }
+        TREMELO_CHECK(StillHolds(pulled, pulledCopy));
+        TREMELO_CHECK(StillHolds(sourced, sourcedCopy));
+    }
+
+    for (AudioUnit unit : { pulling, source, other })
+        TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetBufferOptions(0));
+}
+
+int main()
+{
+    for (UInt32 c = 0; c < kChannels; ++c)
+        TremeloTest_FillSignal(sInput[c], kFrames, c);
+    TestBlocks();
+    TestSharing();
+    TestThreads();
+    TestHandedOut();
+    return 0;
+}
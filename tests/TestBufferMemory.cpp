@@ -0,0 +1,184 @@
+//
+//  TestBufferMemory.cpp
+//  TremeloAUv2
+//
+//  AUBufferMemory and the buffers built on it. Blocks come back aligned to the process-wide
+//  alignment, zeroed and already faulted in, with or without the huge-page and mlock options,
+//  and free correctly after the settings change. AUBufferList starts every stream on an
+//  alignment boundary and TAUBuffer its samples; a host's external buffer yields the frame
+//  count the padded layout fits. The first render after Initialize takes no page faults for
+//  the unit's buffers.
+//
+
+#include "TremeloTest.h"
+#include "AUBuffer.h"
+
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+static const size_t kPageSize = (size_t)sysconf(_SC_PAGESIZE);
+
+static long MinorFaults()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_minflt;
+}
+
+static bool IsAligned(const void *inPointer, size_t inAlignment)
+{
+    return ((uintptr_t)inPointer & (inAlignment - 1)) == 0;
+}
+
+static bool IsZero(const Byte *inBlock, size_t inBytes)
+{
+    for (size_t i = 0; i < inBytes; ++i)
+        if (inBlock[i] != 0)
+            return false;
+    return true;
+}
+
+// Every page of the block is resident, and writing all of it faults nothing in.
+static void CheckPrefaulted(Byte *inBlock, size_t inBytes)
+{
+    Byte *firstPage = (Byte *)((uintptr_t)inBlock & ~(uintptr_t)(kPageSize - 1));
+    size_t pages = (inBlock + inBytes - firstPage + kPageSize - 1) / kPageSize;
+    std::vector<unsigned char> resident(pages);
+    TREMELO_CHECK(mincore(firstPage, pages * kPageSize, resident.data()) == 0);
+    for (size_t i = 0; i < pages; ++i)
+        TREMELO_CHECK(resident[i] & 1);
+
+    long faults = MinorFaults();
+    memset(inBlock, 0xA5, inBytes);
+    TREMELO_CHECK(MinorFaults() - faults <= 2);
+}
+
+static void TestAllocate(UInt32 inOptions)
+{
+    static const size_t kSizes[] = { 1, 100, 4096, 65536, 1 << 20, 5 << 20 };
+    AUBufferMemory::SetOptions(inOptions);
+    for (UInt32 alignment = 16; alignment <= 4096; alignment *= 2) {
+        AUBufferMemory::SetAlignment(alignment);
+        TREMELO_CHECK(AUBufferMemory::GetAlignment() == alignment);
+        for (size_t bytes : kSizes) {
+            Byte *block = (Byte *)AUBufferMemory::Allocate(bytes);
+            TREMELO_CHECK(IsAligned(block, alignment));
+            TREMELO_CHECK(IsZero(block, bytes));
+            CheckPrefaulted(block, bytes);
+            AUBufferMemory::Free(block);
+        }
+    }
+    AUBufferMemory::SetAlignment(AUBufferMemory::kDefaultAlignment);
+
+    // A block remembers how it was allocated, whatever the settings are when it is freed.
+    Byte *mapped = (Byte *)AUBufferMemory::Allocate(AUBufferMemory::kLargeBlockSize * 4);
+    AUBufferMemory::SetOptions(inOptions ^ (AUBufferMemory::kOption_HugePages | AUBufferMemory::kOption_Lock));
+    AUBufferMemory::SetAlignment(4096);
+    AUBufferMemory::Free(mapped);
+    AUBufferMemory::SetAlignment(AUBufferMemory::kDefaultAlignment);
+    AUBufferMemory::SetOptions(0);
+    AUBufferMemory::Free(NULL);
+}
+
+static void TestSetAlignment()
+{
+    static const UInt32 kInvalid[] = { 0, 8, 48, 100, 8192 };
+    for (UInt32 alignment : kInvalid) {
+        OSStatus error = noErr;
+        try {
+            AUBufferMemory::SetAlignment(alignment);
+        } catch (OSStatus inError) {
+            error = inError;
+        }
+        TREMELO_CHECK(error == kAudio_ParamError);
+        TREMELO_CHECK(AUBufferMemory::GetAlignment() == AUBufferMemory::kDefaultAlignment);
+    }
+    AUBufferMemory::SetOptions(~0u);
+    TREMELO_CHECK(AUBufferMemory::GetOptions() == (AUBufferMemory::kOption_HugePages | AUBufferMemory::kOption_Lock));
+    AUBufferMemory::SetOptions(0);
+}
+
+static void TestBufferList()
+{
+    enum { kChannels = 5, kFrames = 1001 };
+    CAStreamBasicDescription format(48000., kChannels, CAStreamBasicDescription::kPCMFormatFloat32, false);
+    for (UInt32 alignment = 16; alignment <= 4096; alignment *= 4) {
+        AUBufferMemory::SetAlignment(alignment);
+        AUBufferList list;
+        list.Allocate(format, kFrames);
+        AudioBufferList &abl = list.PrepareBuffer(format, kFrames);
+        TREMELO_CHECK(abl.mNumberBuffers == kChannels);
+        for (UInt32 i = 0; i < kChannels; ++i) {
+            TREMELO_CHECK(IsAligned(abl.mBuffers[i].mData, alignment));
+            TREMELO_CHECK(abl.mBuffers[i].mDataByteSize == kFrames * sizeof(Float32));
+            TREMELO_CHECK(IsZero((const Byte *)abl.mBuffers[i].mData, abl.mBuffers[i].mDataByteSize));
+            if (i > 0)
+                TREMELO_CHECK((Byte *)abl.mBuffers[i].mData >= (Byte *)abl.mBuffers[i - 1].mData + kFrames * sizeof(Float32));
+        }
+        CheckPrefaulted((Byte *)abl.mBuffers[0].mData, list.GetBufferBytes());
+
+        // A host buffer for 2.5 padded streams per channel fits the frames 2 padded streams hold.
+        const UInt32 stream = (kFrames * sizeof(Float32) + alignment - 1) & ~(alignment - 1);
+        std::vector<Byte> hostMemory(kChannels * stream * 5 / 2 + alignment);
+        AudioUnitExternalBuffer external = { (Byte *)(((uintptr_t)hostMemory.data() + alignment - 1) & ~(uintptr_t)(alignment - 1)),
+                                             UInt32(kChannels * stream * 5 / 2) };
+        list.UseExternalBuffer(format, external);
+        UInt32 padded = (external.size / kChannels) & ~(alignment - 1);
+        TREMELO_CHECK(list.GetAllocatedFrames() == padded / sizeof(Float32));
+        TREMELO_CHECK(list.GetAllocatedFrames() >= 2 * kFrames);
+        AudioBufferList &hosted = list.PrepareBuffer(format, kFrames);
+        for (UInt32 i = 0; i < kChannels; ++i) {
+            TREMELO_CHECK(IsAligned(hosted.mBuffers[i].mData, alignment));
+            TREMELO_CHECK((Byte *)hosted.mBuffers[i].mData + kFrames * sizeof(Float32) <= external.buffer + external.size);
+        }
+        list.Deallocate();
+    }
+    AUBufferMemory::SetAlignment(AUBufferMemory::kDefaultAlignment);
+
+    TAUBuffer<Float32> samples;
+    samples.Allocate(999);
+    TREMELO_CHECK(IsAligned((Float32 *)samples, AUBufferMemory::kDefaultAlignment));
+    TREMELO_CHECK(IsZero((const Byte *)(Float32 *)samples, 999 * sizeof(Float32)));
+}
+
+// The first render after Initialize writes into buffers Initialize already faulted in.
+static void TestFirstRender()
+{
+    enum { kChannels = 2, kFrames = 65536 };
+    static float input[kChannels][kFrames], output[kChannels][kFrames];
+    const float *inputs[kChannels] = { input[0], input[1] };
+    float *outputs[kChannels] = { output[0], output[1] };
+    for (UInt32 c = 0; c < kChannels; ++c)
+        TremeloTest_FillSignal(input[c], kFrames, c);
+    memset(output, 0, sizeof(output));
+
+    // A warm-up instance faults in the code and the allocator's own pages.
+    for (int pass = 0; pass < 2; ++pass) {
+        TremeloUnitRef unit = NULL;
+        TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 48000., kChannels));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kFrames));
+        TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+        long faults = MinorFaults();
+        TREMELO_CHECK_NOERR(TremeloUnit_Render(unit, inputs, outputs, kFrames));
+        faults = MinorFaults() - faults;
+        // The unit's buffers for one slice are 128 pages.
+        if (pass == 1)
+            TREMELO_CHECK(faults <= 8);
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+    }
+}
+
+int main()
+{
+    TestSetAlignment();
+    TestAllocate(0);
+    TestAllocate(AUBufferMemory::kOption_HugePages);
+    TestAllocate(AUBufferMemory::kOption_Lock);
+    TestAllocate(AUBufferMemory::kOption_HugePages | AUBufferMemory::kOption_Lock);
+    TestBufferList();
+    TestFirstRender();
+    return 0;
+}
@@ -0,0 +1,110 @@
+//
+//  TestChunkedRender.c
+//  TremeloAUv2
+//
+//  With the sample-time LFO the output for a stretch of the timeline must not depend on how it
+//  is split into render calls: render a signal in one call, then in odd-sized chunks, and
+//  compare bit for bit. Also covers a frequency change between render calls, and a stretch
+//  split across two instances with the LFO anchor carried over.
+//
+
+#include "TremeloTest.h"
+
+enum { kChannels = 2, kFrames = 6007, kChange = 2741, kHandOver = 3307 };
+
+static float sInput[kChannels][kFrames];
+static float sWhole[kChannels][kFrames];
+static float sChunked[kChannels][kFrames];
+
+static TremeloUnitRef NewUnit(float inWaveform)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 44100., kChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kFrames));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 7.3f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 80.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Waveform, inWaveform));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    return unit;
+}
+
+// Renders [inStart, inEnd) of sInput into ioOutput in calls of inChunk frames.
+static void RenderRange(TremeloUnitRef inUnit, float (*ioOutput)[kFrames], uint32_t inStart, uint32_t inEnd,
+                        uint32_t inChunk)
+{
+    const float *input[kChannels];
+    float *output[kChannels];
+    for (uint32_t c = 0; c < kChannels; ++c) {
+        input[c] = sInput[c] + inStart;
+        output[c] = ioOutput[c] + inStart;
+    }
+    TREMELO_CHECK_NOERR(TremeloTest_RenderChunked(inUnit, input, output, kChannels, inEnd - inStart, inChunk));
+}
+
+static void Restart(TremeloUnitRef inUnit)
+{
+    memset(sChunked, 0, sizeof(sChunked));
+    TREMELO_CHECK_NOERR(TremeloUnit_Reset(inUnit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTime(inUnit, 0.));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(inUnit, kTremeloUnitParam_Frequency, 7.3f));
+}
+
+int main(void)
+{
+    for (uint32_t c = 0; c < kChannels; ++c)
+        TremeloTest_FillSignal(sInput[c], kFrames, c);
+
+    static const uint32_t kChunks[] = { 1, 3, 7, 64, 113, 509, 1021, 4093 };
+    static const float kWaveforms[] = { kTremeloUnitParam_Waveform_Sine, kTremeloUnitParam_Waveform_Square };
+
+    for (int waveform = 0; waveform < 2; ++waveform) {
+        TremeloUnitRef unit = NewUnit(kWaveforms[waveform]);
+        RenderRange(unit, sWhole, 0, kFrames, kFrames);
+        for (size_t k = 0; k < sizeof(kChunks) / sizeof(kChunks[0]); ++k) {
+            Restart(unit);
+            RenderRange(unit, sChunked, 0, kFrames, kChunks[k]);
+            if (memcmp(sWhole, sChunked, sizeof(sWhole)) != 0) {
+                fprintf(stderr, "waveform %d: %u-frame chunks differ from one render call\n", waveform, kChunks[k]);
+                return 1;
+            }
+        }
+
+        // A frequency change at kChange, between two render calls.
+        Restart(unit);
+        RenderRange(unit, sWhole, 0, kChange, kChange);
+        TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 13.1f));
+        RenderRange(unit, sWhole, kChange, kFrames, kFrames - kChange);
+
+        Restart(unit);
+        RenderRange(unit, sChunked, 0, kChange, 211);
+        TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 13.1f));
+        RenderRange(unit, sChunked, kChange, kFrames, 17);
+        TREMELO_CHECK(memcmp(sWhole, sChunked, sizeof(sWhole)) == 0);
+
+        // The same, handing over to a second instance at kHandOver. The anchor moved at kChange,
+        // so the second instance only picks up the phase with the first one's anchor.
+        Restart(unit);
+        RenderRange(unit, sChunked, 0, kChange, 997);
+        TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 13.1f));
+        RenderRange(unit, sChunked, kChange, kHandOver, 997);
+        TremeloUnitLFOAnchor anchor;
+        TREMELO_CHECK_NOERR(TremeloUnit_GetLFOAnchor(unit, &anchor));
+        TREMELO_CHECK(anchor.sampleTime == kChange && anchor.frequency == 13.1f);
+
+        TremeloUnitRef second = NewUnit(kWaveforms[waveform]);
+        TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(second, kTremeloUnitParam_Frequency, 13.1f));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetLFOAnchor(second, &anchor));
+        TremeloUnitLFOAnchor pending;
+        TREMELO_CHECK_NOERR(TremeloUnit_GetLFOAnchor(second, &pending));
+        TREMELO_CHECK(memcmp(&pending, &anchor, sizeof(anchor)) == 0);
+        TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTime(second, kHandOver));
+        RenderRange(second, sChunked, kHandOver, kFrames, 331);
+        TREMELO_CHECK(memcmp(sWhole, sChunked, sizeof(sWhole)) == 0);
+
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(second));
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+    }
+    return 0;
+}
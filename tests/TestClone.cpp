@@ -0,0 +1,301 @@
+//
+//  TestClone.cpp
+//  TremeloAUv2
+//
+//  TremeloUnit_Clone: a clone renders exactly what its prototype renders from the same start,
+//  whether the prototype was initialized (and had rendered) or not, with the legacy LFO, with
+//  the sample-time LFO at a control rate, and after a factory preset was recalled.
+//  kTremeloUnitProperty_Configuration, which Clone sets: a configuration that names an unknown
+//  factory preset, an unknown notification mode, one that changes the notification mode from
+//  inside a render call, or one whose output format ChangeStreamFormat refuses fails with that
+//  error and leaves the unit as it was; a known factory preset number takes the factory
+//  preset's name.
+//
+
+#include "TremeloTest.h"
+#include "TremeloUnit.hpp"
+#include "AudioComponent.h"
+#include "CAStreamBasicDescription.h"
+
+#include <vector>
+
+enum { kSampleRate = 48000, kChannels = 2, kSlice = 512, kSlices = 16 };
+
+static float sInput[kChannels][kSlice * kSlices];
+
+#pragma mark ____Clone
+
+// Configured as a host would, one call at a time.
+static TremeloUnitRef NewPrototype(int inSampleTimeLFO, int inPreset)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, kSampleRate, kChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kSlice));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 5.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 80.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Waveform, kTremeloUnitParam_Waveform_Square));
+    if (inSampleTimeLFO) {
+        TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, 1));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetControlInterval(unit, 16));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetOscillator(unit, kTremeloUnitOscillator_Polynomial));
+    }
+    if (inPreset >= 0)
+        TREMELO_CHECK_NOERR(TremeloUnit_SetFactoryPreset(unit, inPreset));
+    return unit;
+}
+
+// kSlices slices of sInput from the current sample time.
+static std::vector<float> Render(TremeloUnitRef inUnit)
+{
+    std::vector<float> output(kChannels * kSlice * kSlices);
+    for (UInt32 slice = 0; slice < kSlices; ++slice) {
+        const float *input[kChannels];
+        float *out[kChannels];
+        for (UInt32 c = 0; c < kChannels; ++c) {
+            input[c] = sInput[c] + slice * kSlice;
+            out[c] = &output[(c * kSlices + slice) * kSlice];
+        }
+        TREMELO_CHECK_NOERR(TremeloUnit_Render(inUnit, input, out, kSlice));
+    }
+    return output;
+}
+
+static void TestCloneOutput(int inSampleTimeLFO, int inPreset)
+{
+    // Of an initialized prototype that has rendered: initialized, from sample time 0, as the
+    // prototype renders after its next Initialize.
+    TremeloUnitRef prototype = NewPrototype(inSampleTimeLFO, inPreset), clone = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(prototype));
+    Render(prototype);
+    TREMELO_CHECK_NOERR(TremeloUnit_Clone(prototype, &clone));
+    const std::vector<float> cloned = Render(clone);
+    TREMELO_CHECK_NOERR(TremeloUnit_Uninitialize(prototype));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(prototype));
+    TREMELO_CHECK(Render(prototype) == cloned);
+
+    // And not the prototype's state: a new unit configured the same way renders the same.
+    TremeloUnitRef fresh = NewPrototype(inSampleTimeLFO, inPreset);
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(fresh));
+    TREMELO_CHECK(Render(fresh) == cloned);
+    for (uint32_t parameter = kTremeloUnitParam_Frequency; parameter <= kTremeloUnitParam_Waveform; ++parameter) {
+        float prototypeValue = -1.f, cloneValue = -2.f;
+        TREMELO_CHECK_NOERR(TremeloUnit_GetParameter(prototype, parameter, &prototypeValue));
+        TREMELO_CHECK_NOERR(TremeloUnit_GetParameter(clone, parameter, &cloneValue));
+        TREMELO_CHECK(cloneValue == prototypeValue);
+    }
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(fresh));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(clone));
+
+    // Of an uninitialized prototype: uninitialized, and a clone of the clone is the same again.
+    TremeloUnitRef secondClone = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_Uninitialize(prototype));
+    TREMELO_CHECK_NOERR(TremeloUnit_Clone(prototype, &clone));
+    int ready = -1;
+    TREMELO_CHECK_NOERR(TremeloUnit_IsReady(clone, &ready));
+    TREMELO_CHECK(ready == 0);
+    TREMELO_CHECK_NOERR(TremeloUnit_Clone(clone, &secondClone));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(clone));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(secondClone));
+    TREMELO_CHECK(Render(clone) == cloned);
+    TREMELO_CHECK(Render(secondClone) == cloned);
+
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(secondClone));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(clone));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(prototype));
+}
+
+#pragma mark ____Configuration
+
+// Refuses to change the format in one scope, as a subclass with fixed formats would.
+class TestConfigurationUnit : public TremeloUnit {
+public:
+    static const OSStatus       kRefused = 'rfsd';
+    static AudioUnitScope       sRefusedScope;
+
+    TestConfigurationUnit(AudioComponentInstance inInstance) : TremeloUnit(inInstance) { }
+
+    OSStatus ChangeStreamFormat(AudioUnitScope inScope, AudioUnitElement inElement,
+                                const CAStreamBasicDescription &inPrevFormat, const CAStreamBasicDescription &inNewFormat) override {
+        if (inScope == sRefusedScope)
+            return kRefused;
+        return TremeloUnit::ChangeStreamFormat(inScope, inElement, inPrevFormat, inNewFormat);
+    }
+};
+
+AudioUnitScope TestConfigurationUnit::sRefusedScope = kAudioUnitScope_Global;
+
+AUDIOCOMPONENT_ENTRY(AUBaseFactory, TestConfigurationUnit)
+
+static AudioUnit sConfigured;                       // what the render callback configures
+static TremeloUnitConfiguration sRenderConfiguration;
+static OSStatus sRenderResult;
+
+// Sets sRenderConfiguration on sConfigured from inside the render call, and renders silence.
+static OSStatus InputCallback(void *, AudioUnitRenderActionFlags *, const AudioTimeStamp *, UInt32, UInt32 inNumberFrames,
+                              AudioBufferList *ioData)
+{
+    static float silence[kSlice];
+    sRenderResult = AudioUnitSetProperty(sConfigured, kTremeloUnitProperty_Configuration, kAudioUnitScope_Global, 0,
+                                         &sRenderConfiguration, sizeof(sRenderConfiguration));
+    for (UInt32 c = 0; c < ioData->mNumberBuffers; ++c) {
+        ioData->mBuffers[c].mData = silence;
+        ioData->mBuffers[c].mDataByteSize = inNumberFrames * sizeof(float);
+    }
+    return noErr;
+}
+
+static AudioUnit NewConfigurationUnit()
+{
+    AudioComponentDescription desc = { kAudioUnitType_Effect, 'tcfg', 'Test', 0, 0 };
+    static AudioComponent sComponent = AudioComponentRegister(&desc, CFSTR("TestConfigurationUnit"), 1,
+                                                              (AudioComponentFactoryFunction)TestConfigurationUnitFactory);
+    TREMELO_CHECK(sComponent != NULL);
+    AudioUnit unit = NULL;
+    TREMELO_CHECK_NOERR(AudioComponentInstanceNew(sComponent, &unit));
+    return unit;
+}
+
+static TremeloUnitConfiguration GetConfiguration(AudioUnit inUnit)
+{
+    TremeloUnitConfiguration config;
+    UInt32 size = sizeof(config);
+    TREMELO_CHECK_NOERR(AudioUnitGetProperty(inUnit, kTremeloUnitProperty_Configuration, kAudioUnitScope_Global, 0,
+                                             &config, &size));
+    TREMELO_CHECK(size == sizeof(config));
+    if (config.mPreset.presetName)
+        CFRelease(config.mPreset.presetName);
+    return config;
+}
+
+static OSStatus SetConfiguration(AudioUnit inUnit, const TremeloUnitConfiguration &inConfig)
+{
+    return AudioUnitSetProperty(inUnit, kTremeloUnitProperty_Configuration, kAudioUnitScope_Global, 0, &inConfig,
+                                sizeof(inConfig));
+}
+
+static bool SameConfiguration(const TremeloUnitConfiguration &inA, const TremeloUnitConfiguration &inB)
+{
+    return CAStreamBasicDescription(inA.mInputFormat).IsExactlyEqual(inB.mInputFormat) &&
+           CAStreamBasicDescription(inA.mOutputFormat).IsExactlyEqual(inB.mOutputFormat) &&
+           inA.mMaxFramesPerSlice == inB.mMaxFramesPerSlice &&
+           memcmp(&inA.mParameters, &inB.mParameters, sizeof(inA.mParameters)) == 0 &&
+           inA.mPreset.presetNumber == inB.mPreset.presetNumber && inA.mPreset.presetName && inB.mPreset.presetName &&
+           CFEqual(inA.mPreset.presetName, inB.mPreset.presetName) &&
+           inA.mBypass == inB.mBypass && inA.mSampleTimeLFO == inB.mSampleTimeLFO &&
+           inA.mControlInterval == inB.mControlInterval && inA.mPresetCrossfade == inB.mPresetCrossfade &&
+           inA.mPropertyNotification == inB.mPropertyNotification && inA.mHibernateAfter == inB.mHibernateAfter;
+}
+
+// Differs from the default in every field that Set checks or changes.
+static TremeloUnitConfiguration Changed(const TremeloUnitConfiguration &inConfig)
+{
+    TremeloUnitConfiguration config = inConfig;
+    config.mInputFormat = config.mOutputFormat =
+        CAStreamBasicDescription(96000, 4, CAStreamBasicDescription::kPCMFormatFloat32, false);
+    config.mMaxFramesPerSlice = 256;
+    config.mParameters.mValues[kTremeloUnitParam_Frequency] = 11.f;
+    config.mPreset.presetNumber = kPreset_Fast;
+    config.mPreset.presetName = CFSTR("Renamed");
+    config.mBypass = 1;
+    config.mSampleTimeLFO = 1;
+    config.mControlInterval = kTremeloControlInterval_32;
+    config.mPresetCrossfade = 128;
+    config.mPropertyNotification = kAUPropertyNotification_HostPumped;
+    config.mHibernateAfter = 4096;
+    return config;
+}
+
+static void TestConfigurationErrors()
+{
+    AudioUnit unit = NewConfigurationUnit();
+    const TremeloUnitConfiguration original = GetConfiguration(unit);
+    TREMELO_CHECK(original.mPropertyNotification == kAUPropertyNotification_Synchronous);
+
+    // Unknown factory preset and notification mode.
+    TremeloUnitConfiguration config = Changed(original);
+    config.mPreset.presetNumber = kNumberOfPresets + 5;
+    TREMELO_CHECK(SetConfiguration(unit, config) == kAudioUnitErr_InvalidPropertyValue);
+    TREMELO_CHECK(SameConfiguration(GetConfiguration(unit), original));
+    config = Changed(original);
+    config.mPropertyNotification = kAUPropertyNotification_HostPumped + 1;
+    TREMELO_CHECK(SetConfiguration(unit, config) == kAudioUnitErr_InvalidPropertyValue);
+    TREMELO_CHECK(SameConfiguration(GetConfiguration(unit), original));
+
+    // A format ChangeStreamFormat refuses: its error, and the other format as it was.
+    for (AudioUnitScope scope : { kAudioUnitScope_Input, kAudioUnitScope_Output }) {
+        TestConfigurationUnit::sRefusedScope = scope;
+        TREMELO_CHECK(SetConfiguration(unit, Changed(original)) == TestConfigurationUnit::kRefused);
+        TREMELO_CHECK(SameConfiguration(GetConfiguration(unit), original));
+    }
+    TestConfigurationUnit::sRefusedScope = kAudioUnitScope_Global;
+
+    // A known factory preset: the factory preset's name, whatever the configuration says.
+    config = Changed(original);
+    TREMELO_CHECK_NOERR(SetConfiguration(unit, config));
+    TremeloUnitConfiguration applied = GetConfiguration(unit);
+    config.mPreset.presetName = kPresets[kPreset_Fast].presetName;
+    TREMELO_CHECK(SameConfiguration(applied, config));
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+}
+
+// Changing the notification mode from inside a render call, here another unit's, fails before
+// anything changes; keeping it doesn't.
+static void TestConfigurationWhileRendering()
+{
+    AudioUnit renderer = NewConfigurationUnit();
+    sConfigured = NewConfigurationUnit();
+    const TremeloUnitConfiguration original = GetConfiguration(sConfigured);
+
+    CAStreamBasicDescription format(kSampleRate, kChannels, CAStreamBasicDescription::kPCMFormatFloat32, false);
+    for (AudioUnitScope scope : { kAudioUnitScope_Input, kAudioUnitScope_Output })
+        TREMELO_CHECK_NOERR(AudioUnitSetProperty(renderer, kAudioUnitProperty_StreamFormat, scope, 0, &format,
+                                                 sizeof(AudioStreamBasicDescription)));
+    AURenderCallbackStruct callback = { InputCallback, NULL };
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(renderer, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0,
+                                             &callback, sizeof(callback)));
+    TREMELO_CHECK_NOERR(AudioUnitInitialize(renderer));
+
+    float output[kChannels][kSlice];
+    std::vector<Byte> listStorage(offsetof(AudioBufferList, mBuffers) + kChannels * sizeof(AudioBuffer));
+    AudioBufferList *list = (AudioBufferList *)listStorage.data();
+    AudioTimeStamp timeStamp = {};
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+    for (int changesMode = 1; changesMode >= 0; --changesMode) {
+        sRenderConfiguration = Changed(original);
+        if (!changesMode)
+            sRenderConfiguration.mPropertyNotification = original.mPropertyNotification;
+        list->mNumberBuffers = kChannels;
+        for (UInt32 c = 0; c < kChannels; ++c)
+            list->mBuffers[c] = { 1, kSlice * sizeof(float), output[c] };
+        AudioUnitRenderActionFlags flags = 0;
+        sRenderResult = -1;
+        TREMELO_CHECK_NOERR(AudioUnitRender(renderer, &flags, &timeStamp, 0, kSlice, list));
+        timeStamp.mSampleTime += kSlice;
+        if (changesMode) {
+            TREMELO_CHECK(sRenderResult == kAudioUnitErr_CannotDoInCurrentContext);
+            TREMELO_CHECK(SameConfiguration(GetConfiguration(sConfigured), original));
+        } else {
+            TREMELO_CHECK(sRenderResult == noErr);
+            sRenderConfiguration.mPreset.presetName = kPresets[kPreset_Fast].presetName;
+            TREMELO_CHECK(SameConfiguration(GetConfiguration(sConfigured), sRenderConfiguration));
+        }
+    }
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(sConfigured));
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(renderer));
+}
+
+int main()
+{
+    for (UInt32 c = 0; c < kChannels; ++c)
+        TremeloTest_FillSignal(sInput[c], kSlice * kSlices, c);
+
+    // TremeloUnit_New registers TremeloUnit's own component, which the test's subclass needs.
+    TestCloneOutput(0, -1);
+    TestCloneOutput(1, -1);
+    TestCloneOutput(0, kPreset_Slow);
+    TestCloneOutput(1, kPreset_Fast);
+    TestConfigurationErrors();
+    TestConfigurationWhileRendering();
+    return 0;
+}
@@ -0,0 +1,136 @@
+//
+//  TestControlRate.c
+//  TremeloAUv2
+//
+//  The control-rate LFO (kTremeloUnitProperty_ControlInterval): at every control point the gain
+//  is the audio-rate LFO's, in between it is a straight line, the curve never jumps (not at
+//  slice boundaries, not where a whole-number period wraps), it stays within the documented
+//  distance of the audio-rate curve, and it does not depend on how the timeline is split. The
+//  same holds from a fractional sample time, where no sample falls on a control point.
+//
+
+#include "TremeloTest.h"
+
+#include <unistd.h>
+
+// 20 Hz at 44.1 kHz: a whole-number period of 2205 frames, which no control interval divides.
+enum { kSampleRate = 44100, kPeriod = 2205, kFrames = 4 * kPeriod + 1000, kSlice = 512 };
+
+static float sOnes[kFrames];
+static float sAudioRate[kFrames];
+static float sGains[kFrames];
+static float sChunked[kFrames];
+
+static void RenderGains(uint32_t inInterval, float inWaveform, double inSampleTime, float *outGains, uint32_t inChunk)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, kSampleRate, 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kSlice));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetOscillator(unit, kTremeloUnitOscillator_Polynomial));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetControlInterval(unit, inInterval));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 20.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 100.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Waveform, inWaveform));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTime(unit, inSampleTime));
+    const float *input[1] = { sOnes };
+    float *output[1] = { outGains };
+    TREMELO_CHECK_NOERR(TremeloTest_RenderChunked(unit, input, output, 1, kFrames, inChunk));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+}
+
+static float MaximumStep(const float *inGains)
+{
+    float maximum = 0.f;
+    for (uint32_t i = 1; i < kFrames; ++i)
+        if (fabsf(inGains[i] - inGains[i - 1]) > maximum)
+            maximum = fabsf(inGains[i] - inGains[i - 1]);
+    return maximum;
+}
+
+// Every sample lies between two control points, the ramp's phase offset by the fraction; each
+// Render still returns, and the curve keeps its shape and its distance from the audio-rate one.
+static void TestFractionalSampleTime(double inSampleTime)
+{
+    const uint32_t interval = 16;
+    const double bound = 1.05 * 1.3e-4;     // the sine's, at interval 16
+    const float waveform = kTremeloUnitParam_Waveform_Sine;
+    RenderGains(0, waveform, inSampleTime, sAudioRate, kSlice);
+    alarm(10);
+    RenderGains(interval, waveform, inSampleTime, sGains, kSlice);
+    alarm(0);
+
+    double maximumError = 0.;
+    for (uint32_t i = 0; i < kFrames; ++i) {
+        const double position = fmod(inSampleTime + i, kPeriod);
+        const double segmentStart = floor(position / interval) * interval;
+        if (position >= segmentStart + 2 && i >= 2) {
+            float secondDifference = sGains[i] - 2.f * sGains[i - 1] + sGains[i - 2];
+            TREMELO_CHECK(fabsf(secondDifference) <= 2e-6f);
+        }
+        double error = fabs((double)sGains[i] - sAudioRate[i]);
+        if (error > maximumError)
+            maximumError = error;
+    }
+    TREMELO_CHECK(MaximumStep(sGains) <= MaximumStep(sAudioRate) + 1e-6f);
+    TREMELO_CHECK(maximumError <= bound);
+    printf("sine from %g, interval %2u: max deviation %.3g\n", inSampleTime, interval, maximumError);
+
+    RenderGains(interval, waveform, inSampleTime, sChunked, 37);
+    TREMELO_CHECK(memcmp(sGains, sChunked, sizeof(sGains)) == 0);
+}
+
+int main(void)
+{
+    for (uint32_t i = 0; i < kFrames; ++i)
+        sOnes[i] = 1.f;
+
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK(TremeloUnit_SetControlInterval(unit, 20) != 0);
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+
+    static const uint32_t kIntervals[] = { 16, 32, 64 };
+    // From the description of kTremeloUnitProperty_ControlInterval in TremeloUnit.hpp, which
+    // rounds them to two digits.
+    static const double kBounds[2][3] = { { 1.3e-4, 5.2e-4, 2.1e-3 }, { 2.3e-3, 9.2e-3, 3.6e-2 } };
+    for (int square = 0; square < 2; ++square) {
+        const float waveform = square ? kTremeloUnitParam_Waveform_Square : kTremeloUnitParam_Waveform_Sine;
+        RenderGains(0, waveform, 0., sAudioRate, kSlice);
+        const float audioRateStep = MaximumStep(sAudioRate);
+
+        for (size_t k = 0; k < sizeof(kIntervals) / sizeof(kIntervals[0]); ++k) {
+            const uint32_t interval = kIntervals[k];
+            RenderGains(interval, waveform, 0., sGains, kSlice);
+
+            double maximumError = 0.;
+            for (uint32_t i = 0; i < kFrames; ++i) {
+                const uint32_t position = i % kPeriod;
+                const uint32_t segmentStart = position / interval * interval;
+                if (position == segmentStart)
+                    TREMELO_CHECK(fabsf(sGains[i] - sAudioRate[i]) <= 1e-6f);
+                // Inside a segment, a constant slope.
+                if (position > segmentStart + 1 && i >= 2) {
+                    float secondDifference = sGains[i] - 2.f * sGains[i - 1] + sGains[i - 2];
+                    TREMELO_CHECK(fabsf(secondDifference) <= 2e-6f);
+                }
+                double error = fabs((double)sGains[i] - sAudioRate[i]);
+                if (error > maximumError)
+                    maximumError = error;
+            }
+            // A chord is never steeper than the curve it spans.
+            TREMELO_CHECK(MaximumStep(sGains) <= audioRateStep + 1e-6f);
+            TREMELO_CHECK(maximumError <= 1.05 * kBounds[square][k]);
+            printf("%s, interval %2u: max deviation %.3g\n", square ? "square" : "sine", interval, maximumError);
+
+            RenderGains(interval, waveform, 0., sChunked, 37);
+            TREMELO_CHECK(memcmp(sGains, sChunked, sizeof(sGains)) == 0);
+        }
+    }
+
+    TestFractionalSampleTime(0.5);
+    TestFractionalSampleTime(100.25);
+    return 0;
+}
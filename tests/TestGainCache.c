@@ -0,0 +1,79 @@
+//
+//  TestGainCache.c
+//  TremeloAUv2
+//
+//  The sample-time LFO's period cache (TremeloGainCache.h) must replay exactly the gains the
+//  unit would compute: with a whole-number period, the output for a constant input repeats
+//  bit for bit once the cache serves it, and a slice at a fractional sample time, which the
+//  cache can't hold, renders as it would on a unit without a cache.
+//
+
+#include "TremeloTest.h"
+
+enum { kPeriod = 2400, kFrames = 4 * kPeriod, kSlice = 256, kFractionalFrames = 700 };
+
+static float sOnes[kFrames];
+static float sOutput[kFrames];
+static float sReference[kFractionalFrames];
+
+static TremeloUnitRef NewUnit(void)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 48000., 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kSlice));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetOscillator(unit, kTremeloUnitOscillator_Polynomial));
+    // 20 Hz at 48 kHz: one cycle is kPeriod frames.
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 20.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 100.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    return unit;
+}
+
+static void Render(TremeloUnitRef inUnit, float *outOutput, uint32_t inFrames)
+{
+    const float *input[1] = { sOnes };
+    float *output[1] = { outOutput };
+    TREMELO_CHECK_NOERR(TremeloTest_RenderChunked(inUnit, input, output, 1, inFrames, kSlice));
+}
+
+int main(void)
+{
+    for (uint32_t i = 0; i < kFrames; ++i)
+        sOnes[i] = 1.f;
+
+    TremeloUnitRef unit = NewUnit();
+    Render(unit, sOutput, kFrames);
+
+    TremeloUnitGainCacheStats stats;
+    TREMELO_CHECK_NOERR(TremeloUnit_GetGainCacheStats(unit, &stats));
+    TREMELO_CHECK(stats.periodFrames == kPeriod);
+    TREMELO_CHECK(stats.framesProcessed == kFrames);
+    // Everything after the first period (rounded up to a slice) comes from the cache.
+    TREMELO_CHECK(stats.framesFromCache >= kFrames - kPeriod - kSlice);
+    for (uint32_t period = 1; period < kFrames / kPeriod; ++period)
+        TREMELO_CHECK(memcmp(sOutput, sOutput + period * kPeriod, kPeriod * sizeof(float)) == 0);
+
+    // Half a frame off the cache's grid: computed, not served.
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTime(unit, 5000.5));
+    Render(unit, sOutput, kFractionalFrames);
+    TremeloUnitGainCacheStats after;
+    TREMELO_CHECK_NOERR(TremeloUnit_GetGainCacheStats(unit, &after));
+    TREMELO_CHECK(after.framesFromCache == stats.framesFromCache);
+
+    TremeloUnitRef reference = NewUnit();
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTime(reference, 5000.5));
+    Render(reference, sReference, kFractionalFrames);
+    TREMELO_CHECK(memcmp(sOutput, sReference, sizeof(sReference)) == 0);
+
+    // Back on the grid the cache fills and serves again.
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTime(unit, 9600.));
+    Render(unit, sOutput, kFrames);
+    TREMELO_CHECK_NOERR(TremeloUnit_GetGainCacheStats(unit, &stats));
+    TREMELO_CHECK(stats.framesFromCache > after.framesFromCache);
+
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(reference));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+    return 0;
+}
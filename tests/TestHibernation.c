@@ -0,0 +1,169 @@
+//
+//  TestHibernation.c
+//  TremeloAUv2
+//
+//  kTremeloUnitProperty_HibernateAfter: a unit hibernates once it has rendered the configured
+//  number of silent or bypassed frames, not before; the listeners' thread then frees its I/O
+//  buffers (and the sample-time LFO's gain cache), and the bytes it reports released are what
+//  its memory usage fell by. The first audible render call wakes it up, and from then on it
+//  renders bit for bit what a unit that never hibernated renders, while its gain cache comes
+//  back; Initialize allocates the rest again.
+//
+
+#include "TremeloTest.h"
+
+enum { kChannels = 2, kSlice = 256, kHibernateAfter = 1000, kAudibleSlices = 12 };
+
+static float sInput[kChannels][kSlice * kAudibleSlices];
+
+typedef struct {
+    TremeloUnitRef  mUnit;
+    uint32_t        mSlices;        // rendered so far
+} TestUnit;
+
+static TremeloUnitRef NewUnit(int inSampleTimeLFO, uint32_t inHibernateAfter)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 48000, kChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kSlice));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 5.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 80.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, inSampleTimeLFO));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetHibernateAfter(unit, inHibernateAfter));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetPropertyNotification(unit, kTremeloUnitPropertyNotification_HostPumped));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    return unit;
+}
+
+static TremeloUnitHibernationStats GetStats(TremeloUnitRef inUnit)
+{
+    TremeloUnitHibernationStats stats;
+    TREMELO_CHECK_NOERR(TremeloUnit_GetHibernationStats(inUnit, &stats));
+    return stats;
+}
+
+static TremeloUnitMemoryUsage GetUsage(TremeloUnitRef inUnit)
+{
+    TremeloUnitMemoryUsage usage;
+    TREMELO_CHECK_NOERR(TremeloUnit_GetMemoryUsage(inUnit, &usage));
+    return usage;
+}
+
+// One slice, silent (NULL input) or the next slice of sInput, into outOutput.
+static void RenderSlice(TremeloUnitRef inUnit, int inSilent, uint32_t inSlice, float outOutput[kChannels][kSlice])
+{
+    const float *input[kChannels];
+    float *output[kChannels];
+    for (uint32_t c = 0; c < kChannels; ++c) {
+        input[c] = sInput[c] + (inSlice % kAudibleSlices) * kSlice;
+        output[c] = outOutput[c];
+    }
+    TREMELO_CHECK_NOERR(TremeloUnit_Render(inUnit, inSilent ? NULL : input, output, kSlice));
+}
+
+// Renders the same slice through the hibernating unit and the reference, which must agree.
+static void RenderBoth(TremeloUnitRef inUnit, TremeloUnitRef inReference, int inSilent, uint32_t inSlice)
+{
+    float output[kChannels][kSlice], expected[kChannels][kSlice];
+    RenderSlice(inUnit, inSilent, inSlice, output);
+    RenderSlice(inReference, inSilent, inSlice, expected);
+    TREMELO_CHECK(memcmp(output, expected, sizeof(output)) == 0);
+}
+
+// Idle slices up to kHibernateAfter frames: the unit hibernates at the start of the render call
+// after the one that reaches it, and not before.
+static uint32_t RenderUntilHibernating(TremeloUnitRef inUnit, TremeloUnitRef inReference, int inBypassed)
+{
+    uint32_t slice = 0;
+    for (uint32_t frames = 0; frames < kHibernateAfter; frames += kSlice) {
+        TREMELO_CHECK(!GetStats(inUnit).hibernating);
+        RenderBoth(inUnit, inReference, !inBypassed, slice++);
+    }
+    TREMELO_CHECK(!GetStats(inUnit).hibernating);
+    RenderBoth(inUnit, inReference, !inBypassed, slice++);
+    TREMELO_CHECK(GetStats(inUnit).hibernating);
+    return slice;
+}
+
+static void TestHibernation(int inSampleTimeLFO, int inBypassed)
+{
+    TremeloUnitRef unit = NewUnit(inSampleTimeLFO, kHibernateAfter), reference = NewUnit(inSampleTimeLFO, 0);
+    if (inBypassed) {
+        TREMELO_CHECK_NOERR(TremeloUnit_SetBypass(unit, 1));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetBypass(reference, 1));
+    }
+    // Audible slices first, so that the buffers are in use and the gain cache is filled.
+    uint32_t slice = 0;
+    if (!inBypassed)
+        for (; slice < 4; ++slice)
+            RenderBoth(unit, reference, 0, slice);
+    TREMELO_CHECK_NOERR(TremeloUnit_DeliverPropertyChanges(unit, 0));
+    const TremeloUnitMemoryUsage awake = GetUsage(unit);
+    TREMELO_CHECK(awake.ioBuffers != 0);
+    TremeloUnitHibernationStats stats = GetStats(unit);
+    TREMELO_CHECK(stats.hibernations == 0 && stats.bytesReleased == 0 && stats.unitsHibernating == 0);
+
+    slice += RenderUntilHibernating(unit, reference, inBypassed);
+    // Nothing is freed on the render thread; the listeners' thread frees the retired buffers.
+    TREMELO_CHECK(GetUsage(unit).total == awake.total);
+    TREMELO_CHECK_NOERR(TremeloUnit_DeliverPropertyChanges(unit, 0));
+    const TremeloUnitMemoryUsage hibernating = GetUsage(unit);
+    stats = GetStats(unit);
+    TREMELO_CHECK(stats.hibernating && stats.hibernations == 1 && stats.unitsHibernating == 1);
+    TREMELO_CHECK(stats.bytesReleased == awake.total - hibernating.total);
+    TREMELO_CHECK(stats.processBytesReleased == stats.bytesReleased);
+    // The samples the I/O buffers held are gone (what is left is the buffer lists' pointers),
+    // and with the sample-time LFO the gain cache is too.
+    TREMELO_CHECK(hibernating.ioBuffers < awake.ioBuffers / 4);
+    TREMELO_CHECK(inSampleTimeLFO ? hibernating.other < awake.other : hibernating.other == awake.other);
+    printf("%s LFO, %s: %llu of %llu bytes released\n", inSampleTimeLFO ? "sample-time" : "legacy",
+           inBypassed ? "bypassed" : "silent", (unsigned long long)stats.bytesReleased, (unsigned long long)awake.total);
+
+    // Hibernating, the unit goes on rendering what the reference renders.
+    for (int i = 0; i < 3; ++i)
+        RenderBoth(unit, reference, !inBypassed, slice++);
+    TREMELO_CHECK_NOERR(TremeloUnit_DeliverPropertyChanges(unit, 0));
+    TREMELO_CHECK(GetUsage(unit).total == hibernating.total);
+
+    // The first audible render call wakes it, with the same output as the reference, before the
+    // gain cache is back and after.
+    if (inBypassed) {
+        TREMELO_CHECK_NOERR(TremeloUnit_SetBypass(unit, 0));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetBypass(reference, 0));
+    }
+    RenderBoth(unit, reference, 0, slice++);
+    stats = GetStats(unit);
+    TREMELO_CHECK(!stats.hibernating && stats.hibernations == 1 && stats.unitsHibernating == 0);
+    for (int i = 0; i < kAudibleSlices; ++i) {
+        RenderBoth(unit, reference, 0, slice++);
+        if (i == kAudibleSlices / 2)
+            TREMELO_CHECK_NOERR(TremeloUnit_DeliverPropertyChanges(unit, 0));
+    }
+    // Only the I/O buffers stay released; the render thread borrows from the shared pool instead.
+    const TremeloUnitMemoryUsage woken = GetUsage(unit);
+    stats = GetStats(unit);
+    TREMELO_CHECK(woken.other == awake.other);
+    TREMELO_CHECK(stats.bytesReleased == awake.ioBuffers - hibernating.ioBuffers);
+    TREMELO_CHECK(stats.processBytesReleased == stats.bytesReleased);
+
+    // Initialize allocates them again.
+    TREMELO_CHECK_NOERR(TremeloUnit_Uninitialize(unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    stats = GetStats(unit);
+    TREMELO_CHECK(stats.hibernations == 0 && stats.bytesReleased == 0 && stats.processBytesReleased == 0);
+    TREMELO_CHECK(GetUsage(unit).ioBuffers == awake.ioBuffers);
+
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(reference));
+}
+
+int main(void)
+{
+    for (uint32_t c = 0; c < kChannels; ++c)
+        TremeloTest_FillSignal(sInput[c], kSlice * kAudibleSlices, c);
+    for (int sampleTimeLFO = 0; sampleTimeLFO < 2; ++sampleTimeLFO)
+        for (int bypassed = 0; bypassed < 2; ++bypassed)
+            TestHibernation(sampleTimeLFO, bypassed);
+    return 0;
+}
@@ -0,0 +1,132 @@
+//
+//  TestHostTimeBase.cpp
+//  TremeloAUv2
+//
+//  CAHostTimeBase on Linux: the host time never runs backwards, on one thread or when a time
+//  is handed to another thread; over a fifth of a second it agrees with CLOCK_MONOTONIC to
+//  well under a millisecond per second; the conversions invert each other and match the
+//  reported frequency; and a static initializer that runs after the time base's own already
+//  gets the calibrated constants.
+//
+
+#include "TremeloTest.h"
+#include "CAHostTimeBase.h"
+
+#include <atomic>
+#include <math.h>
+#include <thread>
+#include <time.h>
+#include <unistd.h>
+
+enum { kReads = 1000000, kHandoffs = 20000 };
+
+static UInt64 MonotonicNanos()
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return UInt64(now.tv_sec) * 1000000000ULL + UInt64(now.tv_nsec);
+}
+
+// Runs after CAHostTimeBase's own initializer, which has init_priority(101).
+static const Float64 sFrequencyAtStaticInit = CAHostTimeBase::GetFrequency();
+
+static void TestMonotonic()
+{
+    UInt64 last = CAHostTimeBase::GetTheCurrentTime();
+    UInt64 lastNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+    for (int i = 0; i < kReads; ++i) {
+        UInt64 now = CAHostTimeBase::GetTheCurrentTime();
+        TREMELO_CHECK(now >= last);
+        last = now;
+        UInt64 nowNanos = CAHostTimeBase::GetCurrentTimeInNanos();
+        TREMELO_CHECK(nowNanos >= lastNanos);
+        lastNanos = nowNanos;
+    }
+}
+
+// A time read before a release is never later than one read after the matching acquire, on
+// whichever processors the two threads run.
+static void TestHandoff()
+{
+    std::atomic<UInt64> handed(0);
+    std::atomic<int> turn(0);
+    std::thread other([&] {
+        for (int i = 0; i < kHandoffs; ++i) {
+            while (turn.load(std::memory_order_acquire) != 1)
+                std::this_thread::yield();
+            TREMELO_CHECK(CAHostTimeBase::GetTheCurrentTime() >= handed.load(std::memory_order_relaxed));
+            handed.store(CAHostTimeBase::GetTheCurrentTime(), std::memory_order_relaxed);
+            turn.store(0, std::memory_order_release);
+        }
+    });
+    for (int i = 0; i < kHandoffs; ++i) {
+        while (turn.load(std::memory_order_acquire) != 0)
+            std::this_thread::yield();
+        TREMELO_CHECK(CAHostTimeBase::GetTheCurrentTime() >= handed.load(std::memory_order_relaxed));
+        handed.store(CAHostTimeBase::GetTheCurrentTime(), std::memory_order_relaxed);
+        turn.store(1, std::memory_order_release);
+    }
+    other.join();
+}
+
+// Host nanoseconds against CLOCK_MONOTONIC, each host read bracketed by two monotonic reads.
+static void TestCalibration()
+{
+    UInt64 before0 = MonotonicNanos();
+    UInt64 host0 = CAHostTimeBase::GetCurrentTimeInNanos();
+    UInt64 after0 = MonotonicNanos();
+    usleep(200000);
+    UInt64 before1 = MonotonicNanos();
+    UInt64 host1 = CAHostTimeBase::GetCurrentTimeInNanos();
+    UInt64 after1 = MonotonicNanos();
+
+    double hostElapsed = double(host1 - host0);
+    double shortest = double(before1 - after0), longest = double(after1 - before0);
+    TREMELO_CHECK(shortest >= 2e8);
+    // 200 ppm of the interval on top of the brackets: a wrong frequency is off by far more.
+    double slack = 200e-6 * shortest;
+    TREMELO_CHECK(hostElapsed >= shortest - slack && hostElapsed <= longest + slack);
+
+    // The same interval through the delta helpers.
+    UInt64 ticks0 = CAHostTimeBase::ConvertFromNanos(host0), ticks1 = CAHostTimeBase::ConvertFromNanos(host1);
+    TREMELO_CHECK(fabs(double(CAHostTimeBase::AbsoluteHostDeltaToNanos(ticks1, ticks0)) - hostElapsed) <= 2);
+    TREMELO_CHECK(fabs(double(CAHostTimeBase::HostDeltaToNanos(ticks1, ticks0)) + hostElapsed) <= 2);
+}
+
+static void TestConversions()
+{
+    const Float64 frequency = CAHostTimeBase::GetFrequency();
+    TREMELO_CHECK(frequency >= 1e6);
+    TREMELO_CHECK(sFrequencyAtStaticInit == frequency);
+    TREMELO_CHECK(fabs(CAHostTimeBase::GetInverseFrequency() * frequency - 1) < 1e-12);
+
+    // One second of ticks is a second, to the fixed-point constants' rounding.
+    TREMELO_CHECK(fabs(double(CAHostTimeBase::ConvertToNanos(UInt64(frequency))) - 1e9) <= 1);
+    TREMELO_CHECK(fabs(double(CAHostTimeBase::ConvertFromNanos(1000000000ULL)) - frequency) <= 1);
+
+    // Round trips up to a day lose a tick's worth plus the rounding of the two 32.32 constants,
+    // about 2^-32 of the time each.
+    const double tickNanos = 1e9 / frequency;
+    for (UInt64 nanos = 1; nanos < 86400ULL * 1000000000ULL; nanos = nanos * 3 + 7) {
+        UInt64 back = CAHostTimeBase::ConvertToNanos(CAHostTimeBase::ConvertFromNanos(nanos));
+        TREMELO_CHECK(back <= nanos && double(nanos - back) <= tickNanos + 1 + 2e-9 * double(nanos));
+    }
+
+    // When the host time is the cycle counter, both advance together.
+    if (frequency != 1e9) {
+        UInt64 cycles0 = CAHostTimeBase::ReadCycleCounter(), host0 = CAHostTimeBase::GetTheCurrentTime();
+        usleep(10000);
+        UInt64 host1 = CAHostTimeBase::GetTheCurrentTime(), cycles1 = CAHostTimeBase::ReadCycleCounter();
+        TREMELO_CHECK(host0 >= cycles0 && host1 <= cycles1 && host1 - host0 >= (cycles1 - cycles0) / 2);
+    }
+}
+
+int main()
+{
+    printf("host time frequency %.0f Hz\n", CAHostTimeBase::GetFrequency());
+    TestConversions();
+    TestMonotonic();
+    TestHandoff();
+    TestCalibration();
+    return 0;
+}
@@ -0,0 +1,184 @@
+//
+//  TestIntegerFormats.cpp
+//  TremeloAUv2
+//
+//  The C API only speaks Float32, so this test drives the unit through the AudioUnit API of
+//  the portable shim, with interleaved 16-bit and 8.24 fixed-point stream formats. Full-scale
+//  samples through a deep band-limited square (whose gain overshoots 1) must saturate rather
+//  than wrap, in both LFO modes; the same unit rendering half-scale samples must still follow
+//  the Float32 render.
+//
+
+#include "TremeloTest.h"
+#include "TremeloUnit.hpp"
+#include "AudioComponent.h"
+#include "CAStreamBasicDescription.h"
+
+#include <limits>
+#include <vector>
+
+enum { kSampleRate = 48000, kChannels = 2, kSlice = 512, kFrames = 94 * kSlice };
+
+static std::vector<char> sInput;
+static std::vector<char> sPulled;      // what the unit gets; it may process in place
+static UInt32 sBytesPerFrame;
+
+static OSStatus InputCallback(void *, AudioUnitRenderActionFlags *, const AudioTimeStamp *, UInt32, UInt32 inNumberFrames,
+                              AudioBufferList *ioData)
+{
+    if (ioData->mNumberBuffers != 1 || inNumberFrames * sBytesPerFrame > sInput.size())
+        return kAudio_ParamError;
+    sPulled = sInput;
+    ioData->mBuffers[0].mData = &sPulled[0];
+    ioData->mBuffers[0].mDataByteSize = inNumberFrames * sBytesPerFrame;
+    return noErr;
+}
+
+static AudioUnit NewUnit(const CAStreamBasicDescription &inFormat, bool inSampleTimeLFO)
+{
+    // TremeloUnit_New registers the component with the shim.
+    TremeloUnitRef registration = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&registration));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(registration));
+
+    AudioComponentDescription desc = { kAudioUnitType_Effect, TremeloUnit_COMP_SUBTYPE, TrmeloUnit_COMP_MANF, 0, 0 };
+    AudioComponent component = AudioComponentFindNext(NULL, &desc);
+    TREMELO_CHECK(component != NULL);
+    AudioUnit unit = NULL;
+    TREMELO_CHECK_NOERR(AudioComponentInstanceNew(component, &unit));
+
+    AURenderCallbackStruct callback = { InputCallback, NULL };
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0,
+                                             &callback, sizeof(callback)));
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Input, 0,
+                                             &inFormat, sizeof(AudioStreamBasicDescription)));
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 0,
+                                             &inFormat, sizeof(AudioStreamBasicDescription)));
+    UInt32 maximumFrames = kSlice;
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0,
+                                             &maximumFrames, sizeof(maximumFrames)));
+    UInt32 sampleTimeLFO = inSampleTimeLFO;
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kTremeloUnitProperty_SampleTimeLFO, kAudioUnitScope_Global, 0,
+                                             &sampleTimeLFO, sizeof(sampleTimeLFO)));
+    TREMELO_CHECK_NOERR(AudioUnitSetParameter(unit, kTremeloUnitParam_Frequency, kAudioUnitScope_Global, 0, 7.3f, 0));
+    TREMELO_CHECK_NOERR(AudioUnitSetParameter(unit, kTremeloUnitParam_Depth, kAudioUnitScope_Global, 0, 100.f, 0));
+    TREMELO_CHECK_NOERR(AudioUnitSetParameter(unit, kTremeloUnitParam_Waveform, kAudioUnitScope_Global, 0,
+                                              kTremeloUnitParam_Waveform_Square, 0));
+    TREMELO_CHECK_NOERR(AudioUnitInitialize(unit));
+    return unit;
+}
+
+// Renders kFrames frames of the samples in sInput (one slice's worth, repeated) into outOutput.
+static void Render(AudioUnit inUnit, std::vector<char> &outOutput)
+{
+    outOutput.assign(size_t(kFrames) * sBytesPerFrame, 0);
+    AudioTimeStamp timeStamp = {};
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+    for (UInt32 offset = 0; offset < kFrames; offset += kSlice) {
+        AudioBufferList list;
+        list.mNumberBuffers = 1;
+        list.mBuffers[0].mNumberChannels = kChannels;
+        list.mBuffers[0].mDataByteSize = kSlice * sBytesPerFrame;
+        list.mBuffers[0].mData = &outOutput[size_t(offset) * sBytesPerFrame];
+        AudioUnitRenderActionFlags flags = 0;
+        TREMELO_CHECK_NOERR(AudioUnitRender(inUnit, &flags, &timeStamp, 0, kSlice, &list));
+        timeStamp.mSampleTime += kSlice;
+    }
+}
+
+template <typename Sample>
+static void CheckFullScale(CAStreamBasicDescription::CommonPCMFormat inFormat, bool inSampleTimeLFO)
+{
+    CAStreamBasicDescription format(kSampleRate, kChannels, inFormat, true);
+    sBytesPerFrame = format.mBytesPerFrame;
+    TREMELO_CHECK(sBytesPerFrame == kChannels * sizeof(Sample));
+
+    // Alternating full-scale samples: the most positive on the left, the most negative on the right.
+    sInput.assign(size_t(kSlice) * sBytesPerFrame, 0);
+    Sample *input = reinterpret_cast<Sample *>(&sInput[0]);
+    for (UInt32 i = 0; i < kSlice; ++i) {
+        input[i * kChannels] = std::numeric_limits<Sample>::max();
+        input[i * kChannels + 1] = std::numeric_limits<Sample>::min();
+    }
+
+    AudioUnit unit = NewUnit(format, inSampleTimeLFO);
+    std::vector<char> rendered;
+    Render(unit, rendered);
+    const Sample *output = reinterpret_cast<const Sample *>(&rendered[0]);
+    // The band-limited square also dips slightly below a gain of 0, so a small sample of the
+    // opposite sign is the waveform; a wrapped one is near full scale.
+    const Sample kWrapped = std::numeric_limits<Sample>::max() / 32;
+    UInt32 saturated = 0;
+    for (UInt32 i = 0; i < kFrames; ++i) {
+        TREMELO_CHECK(output[i * kChannels] > -kWrapped);
+        TREMELO_CHECK(output[i * kChannels + 1] < kWrapped);
+        saturated += output[i * kChannels] == std::numeric_limits<Sample>::max();
+    }
+    // The square sits at full gain for half of each cycle, so a good part of the output is
+    // pinned; if none is, the overshoot this test relies on is gone.
+    TREMELO_CHECK(saturated > kFrames / 8);
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+}
+
+template <typename Sample>
+static void CheckHalfScale(CAStreamBasicDescription::CommonPCMFormat inFormat, double inFullScale, bool inSampleTimeLFO)
+{
+    CAStreamBasicDescription format(kSampleRate, kChannels, inFormat, true);
+    sBytesPerFrame = format.mBytesPerFrame;
+
+    float reference[kChannels][kSlice];
+    sInput.assign(size_t(kSlice) * sBytesPerFrame, 0);
+    Sample *input = reinterpret_cast<Sample *>(&sInput[0]);
+    for (UInt32 c = 0; c < kChannels; ++c) {
+        TremeloTest_FillSignal(reference[c], kSlice, c);
+        for (UInt32 i = 0; i < kSlice; ++i) {
+            input[i * kChannels + c] = Sample(reference[c][i] * inFullScale);
+            reference[c][i] = float(input[i * kChannels + c] / inFullScale);
+        }
+    }
+
+    AudioUnit unit = NewUnit(format, inSampleTimeLFO);
+    std::vector<char> rendered;
+    Render(unit, rendered);
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+
+    // The same settings through the C API, in Float32.
+    TremeloUnitRef floatUnit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&floatUnit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(floatUnit, kSampleRate, kChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(floatUnit, kSlice));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(floatUnit, inSampleTimeLFO));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(floatUnit, kTremeloUnitParam_Frequency, 7.3f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(floatUnit, kTremeloUnitParam_Depth, 100.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(floatUnit, kTremeloUnitParam_Waveform, kTremeloUnitParam_Waveform_Square));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(floatUnit));
+
+    const Sample *output = reinterpret_cast<const Sample *>(&rendered[0]);
+    double maximumError = 0.;
+    for (UInt32 offset = 0; offset < kFrames; offset += kSlice) {
+        float floatOutput[kChannels][kSlice];
+        const float *in[kChannels] = { reference[0], reference[1] };
+        float *out[kChannels] = { floatOutput[0], floatOutput[1] };
+        TREMELO_CHECK_NOERR(TremeloUnit_Render(floatUnit, in, out, kSlice));
+        for (UInt32 c = 0; c < kChannels; ++c)
+            for (UInt32 i = 0; i < kSlice; ++i) {
+                double error = fabs(output[(offset + i) * kChannels + c] / inFullScale - floatOutput[c][i]);
+                if (error > maximumError)
+                    maximumError = error;
+            }
+    }
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(floatUnit));
+    // Truncation to the integer grid, one step either way.
+    TREMELO_CHECK(maximumError <= 1.01 / inFullScale);
+}
+
+int main()
+{
+    for (int sampleTimeLFO = 0; sampleTimeLFO < 2; ++sampleTimeLFO) {
+        CheckFullScale<SInt16>(CAStreamBasicDescription::kPCMFormatInt16, sampleTimeLFO);
+        CheckFullScale<SInt32>(CAStreamBasicDescription::kPCMFormatFixed824, sampleTimeLFO);
+        CheckHalfScale<SInt16>(CAStreamBasicDescription::kPCMFormatInt16, 32768., sampleTimeLFO);
+        CheckHalfScale<SInt32>(CAStreamBasicDescription::kPCMFormatFixed824, double(1 << 24), sampleTimeLFO);
+    }
+    return 0;
+}
@@ -0,0 +1,195 @@
+//
+//  TestKernelStorage.cpp
+//  TremeloAUv2
+//
+//  TremeloUnit's kernels are constructed in place in one AUEffectBase block: each starts on a
+//  128-byte boundary, one stride after the last, so no two channels share a cache line.
+//  Reinitializing with as many channels or fewer reconstructs them at the same addresses;
+//  more channels move them to a larger block, still aligned. A reconstructed kernel starts
+//  fresh, and at 2, 8, 32 and 64 channels every channel renders exactly what a mono unit
+//  renders from the same input.
+//
+
+#include "TremeloTest.h"
+#include "TremeloUnit.hpp"
+#include "AudioComponent.h"
+#include "CAStreamBasicDescription.h"
+
+#include <vector>
+
+enum { kSampleRate = 48000, kSlice = 512, kSlices = 4, kMaxChannels = 64, kAlignment = 128 };
+
+static float sInput[kMaxChannels][kSlice * kSlices];
+static std::vector<float> sPulled[kMaxChannels];       // what the unit gets; it may process in place
+
+// Exposes the kernels.
+class TestKernelUnit : public TremeloUnit {
+public:
+    static TestKernelUnit *     sLastInstance;
+
+    TestKernelUnit(AudioComponentInstance inInstance) : TremeloUnit(inInstance) { sLastInstance = this; }
+
+    const KernelList &          Kernels() const { return mKernelList; }
+    // KernelStorageSize rounded up to whole pairs of cache lines.
+    size_t                      Stride() const { return (KernelStorageSize() + kAlignment - 1) & ~size_t(kAlignment - 1); }
+};
+
+TestKernelUnit *TestKernelUnit::sLastInstance;
+
+AUDIOCOMPONENT_ENTRY(AUBaseFactory, TestKernelUnit)
+
+// The unit's channel c reads sInput[c + the first input channel, passed as the refCon].
+static OSStatus InputCallback(void *inRefCon, AudioUnitRenderActionFlags *, const AudioTimeStamp *inTimeStamp, UInt32,
+                              UInt32 inNumberFrames, AudioBufferList *ioData)
+{
+    const UInt32 firstInput = UInt32(uintptr_t(inRefCon)), offset = UInt32(inTimeStamp->mSampleTime);
+    for (UInt32 c = 0; c < ioData->mNumberBuffers; ++c) {
+        const float *input = sInput[firstInput + c] + offset;
+        sPulled[c].assign(input, input + inNumberFrames);
+        ioData->mBuffers[c].mData = sPulled[c].data();
+        ioData->mBuffers[c].mDataByteSize = inNumberFrames * sizeof(float);
+    }
+    return noErr;
+}
+
+static void SetChannels(AudioUnit inUnit, UInt32 inChannels)
+{
+    CAStreamBasicDescription format(kSampleRate, inChannels, CAStreamBasicDescription::kPCMFormatFloat32, false);
+    for (AudioUnitScope scope : { kAudioUnitScope_Input, kAudioUnitScope_Output })
+        TREMELO_CHECK_NOERR(AudioUnitSetProperty(inUnit, kAudioUnitProperty_StreamFormat, scope, 0, &format,
+                                                 sizeof(AudioStreamBasicDescription)));
+}
+
+static AudioUnit NewUnit(UInt32 inChannels, TestKernelUnit *&outInstance, UInt32 inFirstInput = 0)
+{
+    AudioComponentDescription desc = { kAudioUnitType_Effect, 'tkst', 'Test', 0, 0 };
+    static AudioComponent sComponent = AudioComponentRegister(&desc, CFSTR("TestKernelUnit"), 1,
+                                                              (AudioComponentFactoryFunction)TestKernelUnitFactory);
+    TREMELO_CHECK(sComponent != NULL);
+    AudioUnit unit = NULL;
+    TREMELO_CHECK_NOERR(AudioComponentInstanceNew(sComponent, &unit));
+    outInstance = TestKernelUnit::sLastInstance;
+    SetChannels(unit, inChannels);
+    UInt32 maximumFrames = kSlice;
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0,
+                                             &maximumFrames, sizeof(maximumFrames)));
+    AURenderCallbackStruct callback = { InputCallback, (void *)uintptr_t(inFirstInput) };
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0,
+                                             &callback, sizeof(callback)));
+    TREMELO_CHECK_NOERR(AudioUnitSetParameter(unit, kTremeloUnitParam_Frequency, kAudioUnitScope_Global, 0, 9.1f, 0));
+    TREMELO_CHECK_NOERR(AudioUnitSetParameter(unit, kTremeloUnitParam_Depth, kAudioUnitScope_Global, 0, 70.f, 0));
+    TREMELO_CHECK_NOERR(AudioUnitInitialize(unit));
+    return unit;
+}
+
+// Renders kSlices slices of sInput; outOutput[c] gets channel c.
+static void Render(AudioUnit inUnit, UInt32 inChannels, std::vector<std::vector<float> > &outOutput)
+{
+    outOutput.assign(inChannels, std::vector<float>(kSlice * kSlices));
+    std::vector<Byte> listStorage(offsetof(AudioBufferList, mBuffers) + inChannels * sizeof(AudioBuffer));
+    AudioBufferList *list = (AudioBufferList *)listStorage.data();
+    for (UInt32 slice = 0; slice < kSlices; ++slice) {
+        list->mNumberBuffers = inChannels;
+        for (UInt32 c = 0; c < inChannels; ++c)
+            list->mBuffers[c] = { 1, kSlice * sizeof(float), &outOutput[c][slice * kSlice] };
+        AudioTimeStamp timeStamp = {};
+        timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+        timeStamp.mSampleTime = slice * kSlice;
+        AudioUnitRenderActionFlags flags = 0;
+        TREMELO_CHECK_NOERR(AudioUnitRender(inUnit, &flags, &timeStamp, 0, kSlice, list));
+    }
+}
+
+// One stride apart from the first, each on its own lines.
+static const Byte *CheckLayout(const TestKernelUnit *inInstance, UInt32 inChannels)
+{
+    const TestKernelUnit::KernelList &kernels = inInstance->Kernels();
+    TREMELO_CHECK(kernels.size() == inChannels);
+    const Byte *first = (const Byte *)kernels[0];
+    TREMELO_CHECK(((uintptr_t)first & (kAlignment - 1)) == 0);
+    for (UInt32 c = 0; c < inChannels; ++c) {
+        TREMELO_CHECK(kernels[c] != NULL && kernels[c]->GetChannelNum() == c);
+        TREMELO_CHECK((const Byte *)kernels[c] == first + c * inInstance->Stride());
+    }
+    return first;
+}
+
+static void TestLayout()
+{
+    TestKernelUnit *instance = NULL;
+    AudioUnit unit = NewUnit(8, instance);
+    TREMELO_CHECK(instance->KernelStorageSize() > 0 && instance->Stride() >= instance->KernelStorageSize());
+    const Byte *block = CheckLayout(instance, 8);
+
+    // As many channels or fewer: the same block.
+    static const UInt32 kFewer[] = { 8, 3, 1, 8 };
+    for (UInt32 channels : kFewer) {
+        TREMELO_CHECK_NOERR(AudioUnitUninitialize(unit));
+        SetChannels(unit, channels);
+        TREMELO_CHECK_NOERR(AudioUnitInitialize(unit));
+        TREMELO_CHECK(CheckLayout(instance, channels) == block);
+    }
+    // More: a larger block, which then stays.
+    TREMELO_CHECK_NOERR(AudioUnitUninitialize(unit));
+    SetChannels(unit, 20);
+    TREMELO_CHECK_NOERR(AudioUnitInitialize(unit));
+    block = CheckLayout(instance, 20);
+    TREMELO_CHECK_NOERR(AudioUnitUninitialize(unit));
+    SetChannels(unit, 2);
+    TREMELO_CHECK_NOERR(AudioUnitInitialize(unit));
+    TREMELO_CHECK(CheckLayout(instance, 2) == block);
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+}
+
+// After rendering, a reinitialized unit renders what a new one does.
+static void TestFreshKernels()
+{
+    TestKernelUnit *instance = NULL;
+    AudioUnit reused = NewUnit(2, instance), fresh = NewUnit(2, instance);
+    std::vector<std::vector<float> > first, again, expected;
+    Render(reused, 2, first);
+    TREMELO_CHECK_NOERR(AudioUnitUninitialize(reused));
+    TREMELO_CHECK_NOERR(AudioUnitInitialize(reused));
+    Render(reused, 2, again);
+    Render(fresh, 2, expected);
+    TREMELO_CHECK(again == expected && first == expected);
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(reused));
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(fresh));
+}
+
+static void TestChannels()
+{
+    std::vector<std::vector<float> > mono[kMaxChannels], output;
+    static const UInt32 kChannels[] = { 2, 8, 32, 64 };
+    for (UInt32 channels : kChannels) {
+        TestKernelUnit *instance = NULL;
+        AudioUnit unit = NewUnit(channels, instance);
+        CheckLayout(instance, channels);
+        Render(unit, channels, output);
+        TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+
+        for (UInt32 c = 0; c < channels; ++c) {
+            if (mono[c].empty()) {
+                AudioUnit monoUnit = NewUnit(1, instance, c);
+                Render(monoUnit, 1, mono[c]);
+                TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(monoUnit));
+            }
+            TREMELO_CHECK(output[c] == mono[c][0]);
+        }
+    }
+}
+
+int main()
+{
+    // TremeloUnit_New registers TremeloUnit's own component and sets up its shared tables.
+    TremeloUnitRef registration = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&registration));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(registration));
+
+    for (UInt32 c = 0; c < kMaxChannels; ++c)
+        TremeloTest_FillSignal(sInput[c], kSlice * kSlices, c);
+    TestLayout();
+    TestFreshKernels();
+    TestChannels();
+    return 0;
+}
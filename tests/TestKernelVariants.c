@@ -0,0 +1,100 @@
+//
+//  TestKernelVariants.c
+//  TremeloAUv2
+//
+//  Each instruction set variant of the sample-time LFO's loops (TremeloKernelDispatch.h), forced
+//  with TremeloUnit_SetKernelVariant, renders what the generic variant renders: bit for bit
+//  where the loops only multiply, and within FMA rounding of it for the polynomial oscillator
+//  and the control-rate ramps. Variants this build or CPU can't run must be refused. ctest
+//  runs it a second time with CA_NoVector set, where only the generic variant is available.
+//
+
+#include "TremeloTest.h"
+
+enum { kFrames = 48000, kSlice = 500, kNumberOfVariants = 3 };
+
+static float sInput[kFrames];
+static float sGeneric[kFrames];
+static float sOutput[kFrames];
+
+typedef struct { int mOscillator; uint32_t mInterval; float mWaveform; float mTolerance; } Setting;
+
+static const Setting kSettings[] = {
+    { kTremeloUnitOscillator_WaveTable,  0,  kTremeloUnitParam_Waveform_Sine,   0.f },
+    { kTremeloUnitOscillator_WaveTable,  0,  kTremeloUnitParam_Waveform_Square, 0.f },
+    { kTremeloUnitOscillator_Polynomial, 0,  kTremeloUnitParam_Waveform_Sine,   2e-7f },
+    { kTremeloUnitOscillator_Polynomial, 0,  kTremeloUnitParam_Waveform_Square, 1e-6f },
+    { kTremeloUnitOscillator_WaveTable,  32, kTremeloUnitParam_Waveform_Sine,   1e-6f },
+    { kTremeloUnitOscillator_Polynomial, 64, kTremeloUnitParam_Waveform_Square, 1e-6f },
+};
+
+// Renders with inVariant bound; returns non-zero if the unit refused it.
+static int32_t Render(int inVariant, const Setting *inSetting, float *outOutput)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 48000., 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kSlice));
+    int32_t result = TremeloUnit_SetKernelVariant(unit, inVariant);
+    if (result == 0) {
+        TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, 1));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetOscillator(unit, inSetting->mOscillator));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetControlInterval(unit, inSetting->mInterval));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 7.3f));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 90.f));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Waveform, inSetting->mWaveform));
+        TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+        int bound = -2;
+        TREMELO_CHECK_NOERR(TremeloUnit_GetKernelVariant(unit, &bound));
+        TREMELO_CHECK(bound == inVariant);
+        const float *input[1] = { sInput };
+        float *output[1] = { outOutput };
+        TREMELO_CHECK_NOERR(TremeloTest_RenderChunked(unit, input, output, 1, kFrames, kSlice));
+    }
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+    return result;
+}
+
+int main(void)
+{
+    const int noVector = getenv("CA_NoVector") != NULL;
+    TremeloTest_FillSignal(sInput, kFrames, 0);
+
+    int supported[kNumberOfVariants] = { 0 };
+    for (int variant = 0; variant < kNumberOfVariants; ++variant)
+        supported[variant] = Render(variant, &kSettings[0], sOutput) == 0;
+    TREMELO_CHECK(supported[kTremeloUnitKernelVariant_Generic]);
+    if (noVector)
+        TREMELO_CHECK(!supported[kTremeloUnitKernelVariant_AVX2] && !supported[kTremeloUnitKernelVariant_AVX512]);
+    // AVX-512 implies AVX2.
+    TREMELO_CHECK(!supported[kTremeloUnitKernelVariant_AVX512] || supported[kTremeloUnitKernelVariant_AVX2]);
+
+    // Auto binds the best one.
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK(TremeloUnit_SetKernelVariant(unit, 7) != 0);
+    TREMELO_CHECK_NOERR(TremeloUnit_SetKernelVariant(unit, kTremeloUnitKernelVariant_Auto));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    int best = -2;
+    TREMELO_CHECK_NOERR(TremeloUnit_GetKernelVariant(unit, &best));
+    TREMELO_CHECK(best >= 0 && best < kNumberOfVariants && supported[best]);
+    for (int variant = best + 1; variant < kNumberOfVariants; ++variant)
+        TREMELO_CHECK(!supported[variant]);
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+
+    for (size_t s = 0; s < sizeof(kSettings) / sizeof(kSettings[0]); ++s) {
+        TREMELO_CHECK_NOERR(Render(kTremeloUnitKernelVariant_Generic, &kSettings[s], sGeneric));
+        for (int variant = 1; variant < kNumberOfVariants; ++variant) {
+            if (!supported[variant])
+                continue;
+            TREMELO_CHECK_NOERR(Render(variant, &kSettings[s], sOutput));
+            float maximum = 0.f;
+            for (uint32_t i = 0; i < kFrames; ++i)
+                if (fabsf(sOutput[i] - sGeneric[i]) > maximum)
+                    maximum = fabsf(sOutput[i] - sGeneric[i]);
+            printf("setting %zu, variant %d: max difference %.3g\n", s, variant, maximum);
+            TREMELO_CHECK(maximum <= kSettings[s].mTolerance);
+        }
+    }
+    return 0;
+}
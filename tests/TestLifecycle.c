@@ -0,0 +1,72 @@
+//
+//  TestLifecycle.c
+//  TremeloAUv2
+//
+//  The portable build end to end: create, configure, initialize, render and dispose an
+//  instance through the C API, and check the parameter and format calls reject what the
+//  unit can't take.
+//
+
+#include "TremeloTest.h"
+
+enum { kChannels = 2, kFrames = 512 };
+
+int main(void)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK(unit != NULL);
+
+    float in[kChannels][kFrames], out[kChannels][kFrames];
+    const float *input[kChannels] = { in[0], in[1] };
+    float *output[kChannels] = { out[0], out[1] };
+    for (uint32_t c = 0; c < kChannels; ++c)
+        TremeloTest_FillSignal(in[c], kFrames, c);
+
+    // Not initialized yet.
+    TREMELO_CHECK(TremeloUnit_Render(unit, input, output, kFrames) != 0);
+
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 48000., kChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kFrames));
+    TREMELO_CHECK(TremeloUnit_SetFormat(unit, 0., kChannels) != 0);
+
+    // Writes are clamped to the parameter's range.
+    float value = 0.f;
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 1000.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_GetParameter(unit, kTremeloUnitParam_Frequency, &value));
+    TREMELO_CHECK(value == 20.f);
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, -5.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_GetParameter(unit, kTremeloUnitParam_Depth, &value));
+    TREMELO_CHECK(value == 0.f);
+
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    TREMELO_CHECK(TremeloUnit_SetFormat(unit, 44100., kChannels) != 0);
+
+    // At depth 0 every gain is exactly 1.
+    TREMELO_CHECK_NOERR(TremeloUnit_Render(unit, input, output, kFrames));
+    TREMELO_CHECK(memcmp(in, out, sizeof(in)) == 0);
+
+    // At full depth the gain stays within [0, 1] and does modulate.
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 100.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 20.f));
+    int modulated = 0;
+    for (int pass = 0; pass < 8; ++pass) {
+        TREMELO_CHECK_NOERR(TremeloUnit_Render(unit, input, output, kFrames));
+        for (uint32_t c = 0; c < kChannels; ++c)
+            for (uint32_t i = 0; i < kFrames; ++i) {
+                TREMELO_CHECK(fabsf(out[c][i]) <= fabsf(in[c][i]));
+                modulated |= fabsf(out[c][i]) < 0.99f * fabsf(in[c][i]);
+            }
+    }
+    TREMELO_CHECK(modulated);
+
+    // More frames than the maximum per slice.
+    TREMELO_CHECK(TremeloUnit_Render(unit, input, output, kFrames + 1) != 0);
+
+    TREMELO_CHECK_NOERR(TremeloUnit_Uninitialize(unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 44100., 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_Render(unit, input, output, kFrames));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+    return 0;
+}
@@ -0,0 +1,188 @@
+//
+//  TestLockFreeFIFO.cpp
+//  TremeloAUv2
+//
+//  Single-producer, single-consumer stress of LockFreeFIFO and LockFreeFIFOWithFree, through
+//  the single-item and the span paths, with small and cache-line-crossing payloads. Every item
+//  must arrive once, in order and intact; LockFreeFIFOWithFree must free each item once, after
+//  it was read, on the writer's thread, and by the next write.
+//
+
+#include "TremeloTest.h"
+#include "LockFreeFIFO.h"
+
+#include <atomic>
+#include <thread>
+
+enum { kItems = 1 << 17 };
+
+static std::thread::id sWriterThread;
+
+template <size_t kPayloadWords>
+struct Item {
+    UInt32                  mSequence;
+    UInt32                  mPayload[kPayloadWords];
+    std::atomic<UInt32>     mState;         // kWritten, kRead, kFreed
+    static std::atomic<UInt32> sFreed;
+
+    enum { kWritten = 1, kRead = 2, kFreed = 3 };
+
+    Item() : mSequence(0), mPayload(), mState(kFreed) { }
+
+    void Fill(UInt32 inSequence) {
+        TREMELO_CHECK(mState.load(std::memory_order_relaxed) == kFreed);
+        mSequence = inSequence;
+        for (size_t i = 0; i < kPayloadWords; ++i)
+            mPayload[i] = inSequence * 2654435761u + UInt32(i);
+        mState.store(kWritten, std::memory_order_relaxed);
+    }
+    void Check(UInt32 inSequence) {
+        TREMELO_CHECK(mSequence == inSequence);
+        for (size_t i = 0; i < kPayloadWords; ++i)
+            TREMELO_CHECK(mPayload[i] == inSequence * 2654435761u + UInt32(i));
+        TREMELO_CHECK(mState.load(std::memory_order_relaxed) == kWritten);
+        mState.store(kRead, std::memory_order_relaxed);
+    }
+    // Only LockFreeFIFOWithFree calls this.
+    void Free() {
+        TREMELO_CHECK(std::this_thread::get_id() == sWriterThread);
+        TREMELO_CHECK(mState.load(std::memory_order_relaxed) == kRead);
+        mState.store(kFreed, std::memory_order_relaxed);
+        sFreed.fetch_add(1, std::memory_order_relaxed);
+    }
+};
+
+template <size_t kPayloadWords>
+std::atomic<UInt32> Item<kPayloadWords>::sFreed;
+
+// LockFreeFIFO's items are never freed; mark them free again once read.
+template <class ITEM> static void Recycle(LockFreeFIFO<ITEM> &, ITEM &ioItem) { ioItem.mState.store(ITEM::kFreed, std::memory_order_relaxed); }
+template <class ITEM> static void Recycle(LockFreeFIFOWithFree<ITEM> &, ITEM &) { }
+
+template <class FIFO, class ITEM>
+static void Stress(UInt32 inFIFOSize, UInt32 inWriteBatch, UInt32 inReadBatch)
+{
+    FIFO fifo(inFIFOSize);
+    ITEM::sFreed.store(0);
+    std::thread writer([&] {
+        for (UInt32 sequence = 0; sequence < kItems; ) {
+            if (inWriteBatch == 1) {
+                ITEM *item = fifo.WriteItem();
+                if (item == NULL) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                item->Fill(sequence++);
+                fifo.AdvanceWritePtr();
+            } else {
+                LockFreeFIFOSpan<ITEM> span = fifo.WriteItems(std::min<UInt32>(inWriteBatch, kItems - sequence));
+                if (span.Count() == 0) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                for (UInt32 i = 0; i < span.Count(); ++i)
+                    span[i].Fill(sequence + i);
+                sequence += span.Count();
+                fifo.AdvanceWritePtr(span.Count());
+            }
+        }
+    });
+    sWriterThread = writer.get_id();
+
+    for (UInt32 sequence = 0; sequence < kItems; ) {
+        if (inReadBatch == 1) {
+            ITEM *item = fifo.ReadItem();
+            if (item == NULL) {
+                std::this_thread::yield();
+                continue;
+            }
+            item->Check(sequence++);
+            Recycle(fifo, *item);
+            fifo.AdvanceReadPtr();
+        } else {
+            LockFreeFIFOSpan<ITEM> span = fifo.ReadItems(inReadBatch);
+            if (span.Count() == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            TREMELO_CHECK(span.Count() <= inReadBatch);
+            for (UInt32 i = 0; i < span.Count(); ++i) {
+                span[i].Check(sequence + i);
+                Recycle(fifo, span[i]);
+            }
+            sequence += span.Count();
+            fifo.AdvanceReadPtr(span.Count());
+        }
+    }
+    writer.join();
+    TREMELO_CHECK(fifo.ReadItem() == NULL);
+    TREMELO_CHECK(fifo.ReadItems(inFIFOSize).Count() == 0);
+}
+
+template <class ITEM>
+static void StressWithFree(UInt32 inFIFOSize, UInt32 inWriteBatch, UInt32 inReadBatch)
+{
+    Stress<LockFreeFIFOWithFree<ITEM>, ITEM>(inFIFOSize, inWriteBatch, inReadBatch);
+    // Everything but what was read after the writer's last write has been freed.
+    TREMELO_CHECK(ITEM::sFreed.load() <= kItems && ITEM::sFreed.load() + inFIFOSize >= kItems);
+}
+
+template <class ITEM>
+static void StressAll()
+{
+    static const UInt32 kBatches[][2] = { { 1, 1 }, { 8, 1 }, { 1, 16 }, { 5, 7 }, { 64, 64 } };
+    for (const UInt32 *batch : kBatches) {
+        Stress<LockFreeFIFO<ITEM>, ITEM>(64, batch[0], batch[1]);
+        StressWithFree<ITEM>(64, batch[0], batch[1]);
+    }
+    // The smallest FIFO keeps both sides at the wrap-around and the full/empty checks.
+    Stress<LockFreeFIFO<ITEM>, ITEM>(2, 1, 1);
+    StressWithFree<ITEM>(2, 1, 1);
+}
+
+// Single-threaded: Free runs at the start of the next write, not only once the FIFO is full.
+static void TestEagerFree()
+{
+    typedef Item<1> SmallItem;
+    sWriterThread = std::this_thread::get_id();
+    SmallItem::sFreed.store(0);
+    LockFreeFIFOWithFree<SmallItem> fifo(16);
+    for (UInt32 i = 0; i < 3; ++i) {
+        fifo.WriteItem()->Fill(i);
+        fifo.AdvanceWritePtr();
+    }
+    for (UInt32 i = 0; i < 2; ++i) {
+        fifo.ReadItem()->Check(i);
+        fifo.AdvanceReadPtr();
+    }
+    TREMELO_CHECK(SmallItem::sFreed.load() == 0);
+    TREMELO_CHECK(fifo.WriteItem() != NULL);
+    TREMELO_CHECK(SmallItem::sFreed.load() == 2);
+    fifo.ReadItem()->Check(2);
+    fifo.AdvanceReadPtr();
+    TREMELO_CHECK(fifo.WriteItems(4).Count() == 4);
+    TREMELO_CHECK(SmallItem::sFreed.load() == 3);
+
+    // A span wraps around the end of the buffer in two pieces.
+    LockFreeFIFOSpan<SmallItem> span = fifo.WriteItems(15);
+    TREMELO_CHECK(span.Count() == 15 && span.mCounts[0] == 13 && span.mCounts[1] == 2);
+    for (UInt32 i = 0; i < 15; ++i)
+        span[i].Fill(100 + i);
+    fifo.AdvanceWritePtr(15);
+    TREMELO_CHECK(fifo.WriteItem() == NULL);
+    span = fifo.ReadItems(100);
+    TREMELO_CHECK(span.Count() == 15);
+    for (UInt32 i = 0; i < 15; ++i)
+        span[i].Check(100 + i);
+    fifo.AdvanceReadPtr(15);
+    fifo.Reset();
+    TREMELO_CHECK(SmallItem::sFreed.load() == 18);
+}
+
+int main()
+{
+    TestEagerFree();
+    StressAll<Item<1> >();      // 12 bytes, several to a cache line
+    StressAll<Item<30> >();     // 128 bytes, straddling lines
+    return 0;
+}
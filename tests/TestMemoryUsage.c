@@ -0,0 +1,149 @@
+//
+//  TestMemoryUsage.c
+//  TremeloAUv2
+//
+//  TremeloUnit_GetMemoryUsage: the parts add up to the total; buffers and kernels appear with
+//  Initialize and scale with the channel count and the slice size; Uninitialize frees the
+//  buffers' samples and keeps the kernels' storage for the next Initialize; the rest doesn't
+//  depend on the format. Then 1,000 stereo instances are created,
+//  initialized and rendered, and the process's resident memory must grow by what they report,
+//  give or take allocator overhead, and stay within the footprint budget.
+//
+
+#include "TremeloTest.h"
+
+enum { kFrames = 1024, kInstances = 1000 };
+
+// The reported footprint of an initialized stereo instance at kFrames frames was 20.6 KB, and
+// 3.4 KB of resident memory before Initialize, when these budgets were set.
+static const uint64_t kInitializedBudget = 24 * 1024;
+static const long kCreatedBudget = 5 * 1024;
+
+static long ResidentBytes(void)
+{
+    FILE *status = fopen("/proc/self/status", "r");
+    char line[256];
+    long kilobytes = 0;
+    while (status != NULL && fgets(line, sizeof(line), status) != NULL)
+        if (strncmp(line, "VmRSS:", 6) == 0)
+            kilobytes = atol(line + 6);
+    if (status != NULL)
+        fclose(status);
+    return kilobytes * 1024;
+}
+
+static TremeloUnitMemoryUsage GetUsage(TremeloUnitRef inUnit)
+{
+    TremeloUnitMemoryUsage usage;
+    memset(&usage, 0xFF, sizeof(usage));
+    TREMELO_CHECK_NOERR(TremeloUnit_GetMemoryUsage(inUnit, &usage));
+    TREMELO_CHECK(usage.total == usage.instance + usage.elements + usage.parameters + usage.elementNames +
+                                 usage.ioBuffers + usage.kernels + usage.other);
+    return usage;
+}
+
+static TremeloUnitRef NewUnit(uint32_t inChannels, uint32_t inFrames)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 48000., inChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, inFrames));
+    return unit;
+}
+
+static void TestBreakdown(void)
+{
+    TremeloUnitMemoryUsage initialized[3];
+    static const uint32_t kChannels[3] = { 1, 2, 8 };
+    for (int i = 0; i < 3; ++i) {
+        TremeloUnitRef unit = NewUnit(kChannels[i], kFrames);
+        TremeloUnitMemoryUsage created = GetUsage(unit);
+        TREMELO_CHECK(created.instance > 0 && created.elements > 0 && created.parameters > 0);
+        TREMELO_CHECK(created.ioBuffers == 0 && created.kernels == 0);
+
+        TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+        initialized[i] = GetUsage(unit);
+        // An input and an output buffer of every channel, and their buffer lists.
+        const uint64_t samples = 2 * kChannels[i] * kFrames * sizeof(float);
+        TREMELO_CHECK(initialized[i].ioBuffers >= samples);
+        TREMELO_CHECK(initialized[i].ioBuffers <= samples + 64 * (kChannels[i] + 1));
+        TREMELO_CHECK(initialized[i].kernels > 0);
+        TREMELO_CHECK(initialized[i].instance == created.instance);
+        TREMELO_CHECK(initialized[i].elements == created.elements);
+        TREMELO_CHECK(initialized[i].parameters == created.parameters);
+
+        TREMELO_CHECK_NOERR(TremeloUnit_Uninitialize(unit));
+        TremeloUnitMemoryUsage uninitialized = GetUsage(unit);
+        TREMELO_CHECK(uninitialized.ioBuffers == initialized[i].ioBuffers - samples);
+        TREMELO_CHECK(uninitialized.kernels == initialized[i].kernels);
+        TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+        TREMELO_CHECK(GetUsage(unit).total == initialized[i].total);
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+    }
+    // One kernel per channel, sharing the wave tables.
+    TREMELO_CHECK(initialized[1].kernels == 2 * initialized[0].kernels);
+    TREMELO_CHECK(initialized[2].kernels == 8 * initialized[0].kernels);
+    TREMELO_CHECK(initialized[0].kernels < 1024);
+    TREMELO_CHECK(initialized[0].parameters == initialized[2].parameters);
+
+    // Twice the slice, twice the buffers.
+    TremeloUnitRef unit = NewUnit(2, 2 * kFrames);
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    TremeloUnitMemoryUsage doubled = GetUsage(unit);
+    TREMELO_CHECK(doubled.ioBuffers - initialized[1].ioBuffers == 2 * 2 * kFrames * sizeof(float));
+    TREMELO_CHECK(doubled.total - doubled.ioBuffers == initialized[1].total - initialized[1].ioBuffers);
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+}
+
+static void TestFootprint(void)
+{
+    enum { kChannels = 2 };
+    float *input[kChannels], *output[kChannels];
+    for (uint32_t c = 0; c < kChannels; ++c) {
+        input[c] = (float *)malloc(kFrames * sizeof(float));
+        output[c] = (float *)calloc(kFrames, sizeof(float));
+        TremeloTest_FillSignal(input[c], kFrames, c);
+    }
+    TremeloUnitRef *units = (TremeloUnitRef *)malloc(kInstances * sizeof(TremeloUnitRef));
+
+    long before = ResidentBytes();
+    for (int i = 0; i < kInstances; ++i)
+        units[i] = NewUnit(kChannels, kFrames);
+    long created = ResidentBytes();
+    for (int i = 0; i < kInstances; ++i) {
+        TREMELO_CHECK_NOERR(TremeloUnit_Initialize(units[i]));
+        TREMELO_CHECK_NOERR(TremeloUnit_Render(units[i], (const float *const *)input, output, kFrames));
+    }
+    long rendered = ResidentBytes();
+
+    uint64_t reported = 0;
+    for (int i = 0; i < kInstances; ++i)
+        reported += GetUsage(units[i]).total;
+    const double perInstance = (double)(rendered - before) / kInstances;
+    const double reportedPerInstance = (double)reported / kInstances;
+    printf("%d instances: %.0f bytes resident and %.0f reported per instance, %.0f resident before Initialize\n",
+           kInstances, perInstance, reportedPerInstance, (double)(created - before) / kInstances);
+
+    TREMELO_CHECK(reportedPerInstance <= kInitializedBudget);
+#if !defined(__SANITIZE_ADDRESS__) && !defined(__SANITIZE_THREAD__)    // their allocators pad every block
+    TREMELO_CHECK((created - before) / kInstances <= kCreatedBudget);
+    // What the instances report is what they cost, but for the allocator's headers and slack.
+    TREMELO_CHECK(perInstance >= 0.9 * reportedPerInstance);
+    TREMELO_CHECK(perInstance <= 1.25 * reportedPerInstance + 1024);
+#endif
+
+    for (int i = 0; i < kInstances; ++i)
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(units[i]));
+    free(units);
+    for (uint32_t c = 0; c < kChannels; ++c) {
+        free(input[c]);
+        free(output[c]);
+    }
+}
+
+int main(void)
+{
+    TestFootprint();
+    TestBreakdown();
+    return 0;
+}
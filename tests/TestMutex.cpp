@@ -0,0 +1,383 @@
+//
+//  TestMutex.cpp
+//  TremeloAUv2
+//
+//  CAMutex's options and its non-blocking paths. Try and TryFast agree, recursive tries by the
+//  owner succeed without taking the lock again, and neither waits while another thread holds
+//  the lock; the must-not-block Locker reports that. With kPriorityInheritance the pthread
+//  mutex uses PTHREAD_PRIO_INHERIT where the system supports it. A unit whose lock a UI thread
+//  holds answers a property call made from its render call with
+//  kAudioUnitErr_CannotDoInCurrentContext instead of blocking, and profiling counts the try
+//  that failed. Profiling allocates nothing in TryFast, not even for the first try it counts, and
+//  under a stress of UI threads locking a spinning mutex while a render thread tries it, its
+//  counters add up: every lock and failed try, the most threads waiting at once, and hold times
+//  no shorter than the threads measured.
+//
+
+#include "TremeloTest.h"
+#include "AUEffectBase.h"
+#include "CAMutex.h"
+#include "CAHostTimeBase.h"
+
+#include <atomic>
+#include <new>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+enum { kProperty_Probe = 64900 };
+
+// Counts operator new calls made on a thread while it sets sCountAllocations.
+static thread_local bool sCountAllocations = false;
+static std::atomic<int> sAllocations(0);
+
+void *operator new(size_t inSize)
+{
+    if (sCountAllocations)
+        sAllocations.fetch_add(1);
+    void *memory = malloc(inSize ? inSize : 1);
+    if (memory == NULL)
+        throw std::bad_alloc();
+    return memory;
+}
+
+void operator delete(void *inMemory) noexcept
+{
+    free(inMemory);
+}
+
+void operator delete(void *inMemory, size_t) noexcept
+{
+    free(inMemory);
+}
+
+// Exposes what the options turned into.
+class TestMutex : public CAMutex {
+public:
+    TestMutex(const char *inName, UInt32 inOptions) : CAMutex(inName, inOptions) { }
+    UInt32 Options() const { return mOptions; }
+    pthread_mutex_t *Mutex() { return &mMutex; }
+};
+
+// Holds a mutex on another thread until released.
+class Holder {
+public:
+    explicit Holder(CAMutex &inMutex) : mHeld(false), mRelease(false), mThread([this, &inMutex] {
+        inMutex.Lock();
+        mHeld.store(true);
+        while (!mRelease.load())
+            std::this_thread::yield();
+        inMutex.Unlock();
+    }) {
+        while (!mHeld.load())
+            std::this_thread::yield();
+    }
+    ~Holder() {
+        mRelease.store(true);
+        mThread.join();
+    }
+private:
+    std::atomic<bool>   mHeld;
+    std::atomic<bool>   mRelease;
+    std::thread         mThread;
+};
+
+static void TestTry(UInt32 inOptions)
+{
+    TestMutex mutex("TestTry", inOptions);
+    bool wasLocked = false;
+    TREMELO_CHECK(mutex.IsFree());
+    TREMELO_CHECK(mutex.TryFast(wasLocked) && wasLocked);
+    TREMELO_CHECK(mutex.IsOwnedByCurrentThread());
+
+    // The owner's tries succeed without taking the lock again.
+    bool again = true;
+    TREMELO_CHECK(mutex.TryFast(again) && !again);
+    TREMELO_CHECK(mutex.Try(again) && !again);
+    {
+        CAMutex::Locker locker(&mutex, true);
+        TREMELO_CHECK(locker.HasLock());
+    }
+    TREMELO_CHECK(mutex.IsOwnedByCurrentThread());
+    mutex.Unlock();
+    TREMELO_CHECK(mutex.IsFree());
+
+    TREMELO_CHECK(mutex.Try(wasLocked) && wasLocked);
+    mutex.Unlock();
+
+    // Busy elsewhere: both tries fail at once, and so does the must-not-block Locker.
+    {
+        Holder holder(mutex);
+        TREMELO_CHECK(!mutex.IsFree() && !mutex.IsOwnedByCurrentThread());
+        for (int i = 0; i < 1000; ++i) {
+            TREMELO_CHECK(!mutex.TryFast(wasLocked) && !wasLocked);
+            TREMELO_CHECK(!mutex.Try(wasLocked) && !wasLocked);
+        }
+        CAMutex::Locker locker(&mutex, true);
+        TREMELO_CHECK(!locker.HasLock());
+    }
+    CAMutex::Locker locker(&mutex, true);
+    TREMELO_CHECK(locker.HasLock() && mutex.IsOwnedByCurrentThread());
+}
+
+static void TestPriorityInheritance()
+{
+    TestMutex plain("TestPlain", 0);
+    TestMutex inheriting("TestInheriting", CAMutex::kPriorityInheritance);
+    TREMELO_CHECK(!(plain.Options() & CAMutex::kPriorityInheritance));
+#if defined(_POSIX_THREAD_PRIO_INHERIT) && (_POSIX_THREAD_PRIO_INHERIT > 0)
+    pthread_mutexattr_t attributes;
+    pthread_mutexattr_init(&attributes);
+    const bool supported = pthread_mutexattr_setprotocol(&attributes, PTHREAD_PRIO_INHERIT) == 0;
+    pthread_mutexattr_destroy(&attributes);
+    TREMELO_CHECK(bool(inheriting.Options() & CAMutex::kPriorityInheritance) == supported);
+  #if defined(__GLIBC__)
+    // glibc keeps the protocol in the mutex's kind (PTHREAD_MUTEX_PRIO_INHERIT_NP in its internal
+    // headers); there is no getter for an initialized mutex.
+    const int kPrioInheritKind = 32;
+    if (supported) {
+        TREMELO_CHECK(inheriting.Mutex()->__data.__kind & kPrioInheritKind);
+        TREMELO_CHECK(!(plain.Mutex()->__data.__kind & kPrioInheritKind));
+    }
+  #endif
+#else
+    TREMELO_CHECK(!(inheriting.Options() & CAMutex::kPriorityInheritance));
+#endif
+    // The inheriting mutex still locks recursively and unlocks.
+    TREMELO_CHECK(inheriting.Lock());
+    TREMELO_CHECK(!inheriting.Lock());
+    inheriting.Unlock();
+    TREMELO_CHECK(inheriting.IsFree());
+}
+
+static CAMutex::Profile GetProfile(const char *inName)
+{
+    CAMutex::Profile profiles[64];
+    UInt32 count = CAMutex::GetProfiles(profiles, 64);
+    for (UInt32 i = 0; i < count && i < 64; ++i)
+        if (strcmp(profiles[i].mName, inName) == 0)
+            return profiles[i];
+    TREMELO_CHECK(!"no profile");
+    return CAMutex::Profile();
+}
+
+#pragma mark ____Profiling
+
+// The first counted try, failed or not, of a mutex that was never profiled before.
+static void TestTryFastAllocatesNothing()
+{
+    CAMutex mutex("TestTryFastFirst", CAMutex::kSpinBeforeBlocking);
+    bool wasLocked = false;
+    CAMutex::ResetProfiles();
+    {
+        Holder holder(mutex);
+        CAMutex::SetProfiling(true);
+        sCountAllocations = true;
+        TREMELO_CHECK(!mutex.TryFast(wasLocked));
+        sCountAllocations = false;
+        CAMutex::SetProfiling(false);
+    }
+    CAMutex other("TestTryFastFirstLock", CAMutex::kSpinBeforeBlocking);
+    CAMutex::SetProfiling(true);
+    sCountAllocations = true;
+    TREMELO_CHECK(other.TryFast(wasLocked) && wasLocked);
+    other.Unlock();
+    sCountAllocations = false;
+    CAMutex::SetProfiling(false);
+    TREMELO_CHECK(sAllocations.load() == 0);
+    TREMELO_CHECK(GetProfile("TestTryFastFirst").mFailedTries == 1);
+    TREMELO_CHECK(GetProfile("TestTryFastFirstLock").mLocks == 1);
+}
+
+enum { kUIThreads = 3, kUILocks = 2000, kUIHoldNanos = 5000, kStartHoldNanos = 2000000 };
+
+static void BusyWait(UInt64 inNanos)
+{
+    const UInt64 start = CAHostTimeBase::GetCurrentTimeInNanos();
+    while (CAHostTimeBase::GetCurrentTimeInNanos() - start < inNanos) {
+    }
+}
+
+// UI threads lock a spinning mutex, held for kUIHoldNanos each time, while a render thread only
+// tries it. The UI threads start while this thread holds it, so all of them end up waiting.
+static void TestStress()
+{
+    CAMutex mutex("TestMutexStress", CAMutex::kPriorityInheritance | CAMutex::kSpinBeforeBlocking);
+    CAMutex::ResetProfiles();
+    CAMutex::SetProfiling(true);
+
+    std::atomic<UInt64> measuredHold(0);
+    std::atomic<int> uiThreadsDone(0);
+    UInt64 renderLocks = 0, renderFailures = 0;
+    TREMELO_CHECK(mutex.Lock());
+    const UInt64 startHeld = CAHostTimeBase::GetCurrentTimeInNanos();
+
+    std::thread render([&] {
+        sCountAllocations = true;
+        while (uiThreadsDone.load() < kUIThreads) {
+            bool wasLocked = false;
+            if (mutex.TryFast(wasLocked)) {
+                TREMELO_CHECK(wasLocked);
+                ++renderLocks;
+                mutex.Unlock();
+            } else {
+                ++renderFailures;
+            }
+        }
+        sCountAllocations = false;
+    });
+    std::vector<std::thread> uiThreads;
+    for (int t = 0; t < kUIThreads; ++t)
+        uiThreads.emplace_back([&] {
+            UInt64 held = 0;
+            for (int i = 0; i < kUILocks; ++i) {
+                TREMELO_CHECK(mutex.Lock());
+                const UInt64 locked = CAHostTimeBase::GetCurrentTimeInNanos();
+                BusyWait(kUIHoldNanos);
+                held += CAHostTimeBase::GetCurrentTimeInNanos() - locked;
+                mutex.Unlock();
+            }
+            measuredHold.fetch_add(held);
+            uiThreadsDone.fetch_add(1);
+        });
+
+    while (GetProfile("TestMutexStress").mMaxWaiters < kUIThreads)
+        std::this_thread::yield();
+    BusyWait(kStartHoldNanos);
+    const UInt64 startHold = CAHostTimeBase::GetCurrentTimeInNanos() - startHeld;
+    mutex.Unlock();
+    for (std::thread &thread : uiThreads)
+        thread.join();
+    render.join();
+    CAMutex::SetProfiling(false);
+
+    const CAMutex::Profile profile = GetProfile("TestMutexStress");
+    TREMELO_CHECK(sAllocations.load() == 0);
+    TREMELO_CHECK(profile.mLocks == 1 + kUIThreads * kUILocks + renderLocks);
+    TREMELO_CHECK(profile.mFailedTries == renderFailures);
+    TREMELO_CHECK(profile.mContendedLocks >= kUIThreads && profile.mContendedLocks <= kUIThreads * kUILocks);
+    TREMELO_CHECK(profile.mMaxWaiters == kUIThreads);
+    TREMELO_CHECK(profile.mWaitNanos >= profile.mMaxWaitNanos && profile.mMaxWaitNanos >= kStartHoldNanos);
+    TREMELO_CHECK(profile.mHoldNanos >= measuredHold.load() + startHold);
+    TREMELO_CHECK(profile.mMaxHoldNanos >= startHold && profile.mHoldNanos >= profile.mMaxHoldNanos);
+    printf("stress: %llu locks, %llu contended, %llu failed tries, %u waiting at most, held %.1f ms\n",
+           (unsigned long long)profile.mLocks, (unsigned long long)profile.mContendedLocks,
+           (unsigned long long)profile.mFailedTries, (unsigned)profile.mMaxWaiters, 1e-6 * profile.mHoldNanos);
+}
+
+#pragma mark ____A unit with a lock
+
+class TestMutexUnit : public AUEffectBase {
+public:
+    static TestMutexUnit *      sInstance;
+    OSStatus                    mProbeResult;
+
+    TestMutexUnit(AudioComponentInstance inInstance) : AUEffectBase(inInstance), mProbeResult(-1) {
+        CreateElements();
+        mAUMutex = new CAMutex("TestMutexUnit", CAMutex::kPriorityInheritance | CAMutex::kSpinBeforeBlocking);
+        sInstance = this;
+    }
+    ~TestMutexUnit() { delete mAUMutex; }
+
+    OSStatus GetPropertyInfo(AudioUnitPropertyID inID, AudioUnitScope inScope, AudioUnitElement inElement,
+                             UInt32 &outDataSize, Boolean &outWritable) {
+        if (inID == kProperty_Probe) {
+            outDataSize = sizeof(UInt32);
+            outWritable = false;
+            return noErr;
+        }
+        return AUEffectBase::GetPropertyInfo(inID, inScope, inElement, outDataSize, outWritable);
+    }
+    OSStatus GetProperty(AudioUnitPropertyID inID, AudioUnitScope inScope, AudioUnitElement inElement, void *outData) {
+        if (inID == kProperty_Probe) {
+            *(UInt32 *)outData = 1;
+            return noErr;
+        }
+        return AUEffectBase::GetProperty(inID, inScope, inElement, outData);
+    }
+    // A render-thread property query, as a misbehaving host callback or view might make.
+    OSStatus Render(AudioUnitRenderActionFlags &, const AudioTimeStamp &, UInt32) {
+        UInt32 value = 0, size = sizeof(value);
+        mProbeResult = AudioUnitGetProperty(GetComponentInstance(), kProperty_Probe, kAudioUnitScope_Global, 0, &value, &size);
+        return noErr;
+    }
+};
+
+TestMutexUnit *TestMutexUnit::sInstance;
+
+AUDIOCOMPONENT_ENTRY(AUBaseFactory, TestMutexUnit)
+
+// A new sample time each call, or the unit hands back the last cycle's output without rendering.
+static void RenderOnce(AudioUnit inUnit)
+{
+    static Float64 sSampleTime = 0;
+    float buffers[2][64];
+    struct { UInt32 mNumberBuffers; AudioBuffer mBuffers[2]; } list =
+        { 2, { { 1, sizeof(buffers[0]), buffers[0] }, { 1, sizeof(buffers[1]), buffers[1] } } };
+    AudioTimeStamp timeStamp = {};
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+    timeStamp.mSampleTime = sSampleTime;
+    sSampleTime += 64;
+    AudioUnitRenderActionFlags flags = 0;
+    TREMELO_CHECK_NOERR(AudioUnitRender(inUnit, &flags, &timeStamp, 0, 64, (AudioBufferList *)&list));
+}
+
+static void TestRenderContext()
+{
+    AudioComponentDescription desc = { kAudioUnitType_Effect, 'tmtx', 'Test', 0, 0 };
+    AudioComponent component = AudioComponentRegister(&desc, CFSTR("TestMutexUnit"), 1,
+                                                      (AudioComponentFactoryFunction)TestMutexUnitFactory);
+    TREMELO_CHECK(component != NULL);
+    AudioUnit unit = NULL;
+    TREMELO_CHECK_NOERR(AudioComponentInstanceNew(component, &unit));
+    TestMutexUnit *instance = TestMutexUnit::sInstance;
+    TREMELO_CHECK(instance != NULL && instance->GetMutex() != NULL);
+    UInt32 maximumFrames = 64;
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0,
+                                             &maximumFrames, sizeof(maximumFrames)));
+    TREMELO_CHECK_NOERR(AudioUnitInitialize(unit));
+
+    // Outside a render call a property query takes the lock as usual.
+    UInt32 value = 0, size = sizeof(value);
+    TREMELO_CHECK_NOERR(AudioUnitGetProperty(unit, kProperty_Probe, kAudioUnitScope_Global, 0, &value, &size));
+    TREMELO_CHECK(value == 1);
+
+    CAMutex::ResetProfiles();
+    CAMutex::SetProfiling(true);
+    RenderOnce(unit);
+    TREMELO_CHECK(instance->mProbeResult == noErr);
+    {
+        Holder uiThread(*instance->GetMutex());
+        RenderOnce(unit);
+        TREMELO_CHECK(instance->mProbeResult == kAudioUnitErr_CannotDoInCurrentContext);
+    }
+    RenderOnce(unit);
+    TREMELO_CHECK(instance->mProbeResult == noErr);
+    CAMutex::SetProfiling(false);
+
+    CAMutex::Profile profiles[16];
+    UInt32 count = CAMutex::GetProfiles(profiles, 16);
+    bool found = false;
+    for (UInt32 i = 0; i < count && i < 16; ++i)
+        if (strcmp(profiles[i].mName, "TestMutexUnit") == 0) {
+            found = true;
+            TREMELO_CHECK(profiles[i].mFailedTries == 1);
+            TREMELO_CHECK(profiles[i].mLocks >= 3);
+        }
+    TREMELO_CHECK(found);
+
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+}
+
+int main()
+{
+    TestTry(0);
+    TestTry(CAMutex::kPriorityInheritance);
+    TestTry(CAMutex::kPriorityInheritance | CAMutex::kSpinBeforeBlocking);
+    TestPriorityInheritance();
+    TestTryFastAllocatesNothing();
+    TestStress();
+    TestRenderContext();
+    return 0;
+}
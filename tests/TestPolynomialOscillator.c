@@ -0,0 +1,90 @@
+//
+//  TestPolynomialOscillator.c
+//  TremeloAUv2
+//
+//  The polynomial oscillator (TremeloOscillator.h) against the waveforms computed in double
+//  precision with libm. With a constant input of 1 the output is the gain curve; at depth 100
+//  the gain is the waveform's shape itself.
+//
+
+#include "TremeloTest.h"
+
+enum { kFrames = 96000, kSlice = 512 };
+
+// Float arithmetic on a phase rounded to float: the sine's polynomial alone is good to 1.3e-8.
+static const double kSineErrorBound     = 3e-7;
+static const double kSquareErrorBound   = 1.5e-6;
+
+static float sOnes[kFrames];
+static float sGains[kFrames];
+
+static double SineShape(double inCycles)
+{
+    return (sin(2. * M_PI * inCycles) + 1.) * 0.5;
+}
+
+// The square wave table's construction in TremeloUnitKernel::WaveTables.
+static double SquareShape(double inCycles)
+{
+    double radians = inCycles * 2. * M_PI + 0.32;
+    return (sin(radians) + 0.3 * sin(3 * radians) + 0.15 * sin(5 * radians) + 0.075 * sin(7 * radians) +
+            0.0375 * sin(9 * radians) + 0.01875 * sin(11 * radians) + 0.009375 * sin(13 * radians) + 0.8) * 0.63;
+}
+
+static double MaximumError(int inOscillator, float inWaveform, float inFrequency, float inDepth)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 48000., 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kSlice));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetOscillator(unit, inOscillator));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, inFrequency));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, inDepth));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Waveform, inWaveform));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    const float *input[1] = { sOnes };
+    float *output[1] = { sGains };
+    TREMELO_CHECK_NOERR(TremeloTest_RenderChunked(unit, input, output, 1, kFrames, kSlice));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+
+    // The LFO anchors at sample time 0 with phase 0.
+    const double increment = (double)inFrequency / 48000.;
+    const double depth = inDepth;
+    double maximum = 0.;
+    for (uint32_t i = 0; i < kFrames; ++i) {
+        double phase = i * increment;
+        double cycles = phase - floor(phase);
+        double shape = inWaveform == kTremeloUnitParam_Waveform_Sine ? SineShape(cycles) : SquareShape(cycles);
+        double error = fabs((shape * depth - depth + 100.) * 0.01 - sGains[i]);
+        if (error > maximum)
+            maximum = error;
+    }
+    return maximum;
+}
+
+int main(void)
+{
+    for (uint32_t i = 0; i < kFrames; ++i)
+        sOnes[i] = 1.f;
+
+    static const float kFrequencies[] = { 0.5f, 7.3f, 20.f };
+    for (size_t k = 0; k < sizeof(kFrequencies) / sizeof(kFrequencies[0]); ++k) {
+        double sine = MaximumError(kTremeloUnitOscillator_Polynomial, kTremeloUnitParam_Waveform_Sine,
+                                   kFrequencies[k], 100.f);
+        double square = MaximumError(kTremeloUnitOscillator_Polynomial, kTremeloUnitParam_Waveform_Square,
+                                     kFrequencies[k], 100.f);
+        printf("%5.1f Hz: sine %.3g, square %.3g\n", kFrequencies[k], sine, square);
+        TREMELO_CHECK(sine <= kSineErrorBound);
+        TREMELO_CHECK(square <= kSquareErrorBound);
+        // Less depth scales the error down.
+        TREMELO_CHECK(MaximumError(kTremeloUnitOscillator_Polynomial, kTremeloUnitParam_Waveform_Square,
+                                   kFrequencies[k], 30.f) <= kSquareErrorBound);
+    }
+
+    // The wave tables hold each entry for a fraction of a cycle: the polynomials' reason to exist.
+    double table = MaximumError(kTremeloUnitOscillator_WaveTable, kTremeloUnitParam_Waveform_Sine, 7.3f, 100.f);
+    printf("wave table sine: %.3g\n", table);
+    TREMELO_CHECK(table > 100. * kSineErrorBound && table < 1.7e-3);
+    return 0;
+}
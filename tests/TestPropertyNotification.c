@@ -0,0 +1,237 @@
+//
+//  TestPropertyNotification.c
+//  TremeloAUv2
+//
+//  Property-change delivery in the three notification modes. With the host pumping, changes
+//  wait for TremeloUnit_DeliverPropertyChanges, repeated changes to one property are delivered
+//  once, and a change made after a pump is delivered by the next one. Synchronous listeners
+//  run before the setter returns. Under load, with a render thread that keeps hibernating and
+//  waking the unit (changes posted from inside the render call) while a host thread recalls
+//  presets, no listener ever runs on the render thread. A synchronous listener can uninitialize
+//  its unit while the notifier thread waits to deliver a change to it.
+//
+
+#include "TremeloTest.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <unistd.h>
+
+enum {
+    kProperty_PresentPreset = 36,       // kAudioUnitProperty_PresentPreset
+    kProperty_Hibernation   = 64016     // kTremeloUnitProperty_Hibernation
+};
+
+enum { kChannels = 2, kFrames = 64, kLoadSlices = 40000 };
+
+typedef struct {
+    atomic_uint     mPresetCalls;
+    atomic_uint     mHibernationCalls;
+    atomic_uint     mRenderThreadCalls;
+} ListenerCounts;
+
+static pthread_t sRenderThread;
+static atomic_int sRendering;
+
+static void Listener(void *inRefCon, TremeloUnitRef inUnit, uint32_t inPropertyID, uint32_t inScope, uint32_t inElement)
+{
+    ListenerCounts *counts = (ListenerCounts *)inRefCon;
+    (void)inUnit;
+    TREMELO_CHECK(inScope == 0 && inElement == 0);
+    if (atomic_load(&sRendering) && pthread_equal(pthread_self(), sRenderThread))
+        atomic_fetch_add(&counts->mRenderThreadCalls, 1);
+    if (inPropertyID == kProperty_PresentPreset)
+        atomic_fetch_add(&counts->mPresetCalls, 1);
+    else if (inPropertyID == kProperty_Hibernation)
+        atomic_fetch_add(&counts->mHibernationCalls, 1);
+}
+
+static TremeloUnitRef NewUnit(ListenerCounts *inCounts, int inMode)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 48000, kChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kFrames));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetHibernateAfter(unit, kFrames));
+    TREMELO_CHECK_NOERR(TremeloUnit_AddPropertyListener(unit, kProperty_PresentPreset, Listener, inCounts));
+    TREMELO_CHECK_NOERR(TremeloUnit_AddPropertyListener(unit, kProperty_Hibernation, Listener, inCounts));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetPropertyNotification(unit, inMode));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    return unit;
+}
+
+// Renders one slice, silent or audible. Two silent slices in a row hibernate the unit (the
+// second one takes the request the first made); an audible one wakes it up.
+static void RenderSlice(TremeloUnitRef inUnit, int inSilent)
+{
+    static float input[kChannels][kFrames];
+    float output[kChannels][kFrames];
+    const float *in[kChannels] = { input[0], input[1] };
+    float *out[kChannels] = { output[0], output[1] };
+    if (input[0][0] == 0.f)
+        for (uint32_t c = 0; c < kChannels; ++c)
+            TremeloTest_FillSignal(input[c], kFrames, c);
+    TREMELO_CHECK_NOERR(TremeloUnit_Render(inUnit, inSilent ? NULL : in, out, kFrames));
+}
+
+static void TestHostPumped(void)
+{
+    ListenerCounts counts = { 0 };
+    TremeloUnitRef unit = NewUnit(&counts, kTremeloUnitPropertyNotification_HostPumped);
+
+    // Repeated changes to one property wait for the pump and are delivered once.
+    for (int32_t i = 0; i < 5; ++i)
+        TREMELO_CHECK_NOERR(TremeloUnit_SetFactoryPreset(unit, i % 2));
+    TREMELO_CHECK(atomic_load(&counts.mPresetCalls) == 0);
+    TREMELO_CHECK_NOERR(TremeloUnit_DeliverPropertyChanges(unit, 0));
+    TREMELO_CHECK(atomic_load(&counts.mPresetCalls) == 1);
+    TREMELO_CHECK_NOERR(TremeloUnit_DeliverPropertyChanges(unit, 0));
+    TREMELO_CHECK(atomic_load(&counts.mPresetCalls) == 1);
+
+    // A change made after a pump isn't lost.
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFactoryPreset(unit, 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_DeliverPropertyChanges(unit, 0));
+    TREMELO_CHECK(atomic_load(&counts.mPresetCalls) == 2);
+
+    // Changes posted from the render call are queued the same way; inMaxChanges bounds a pump.
+    for (int slice = 0; slice < 4; ++slice)
+        RenderSlice(unit, 1);
+    TremeloUnitHibernationStats stats;
+    TREMELO_CHECK_NOERR(TremeloUnit_GetHibernationStats(unit, &stats));
+    TREMELO_CHECK(stats.hibernating);
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFactoryPreset(unit, 0));
+    TREMELO_CHECK(atomic_load(&counts.mHibernationCalls) == 0);
+    TREMELO_CHECK_NOERR(TremeloUnit_DeliverPropertyChanges(unit, 1));
+    TREMELO_CHECK(atomic_load(&counts.mPresetCalls) + atomic_load(&counts.mHibernationCalls) == 3);
+    TREMELO_CHECK_NOERR(TremeloUnit_DeliverPropertyChanges(unit, 1));
+    TREMELO_CHECK(atomic_load(&counts.mPresetCalls) == 3 && atomic_load(&counts.mHibernationCalls) == 1);
+
+    TREMELO_CHECK(atomic_load(&counts.mRenderThreadCalls) == 0);
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+}
+
+static void TestSynchronous(void)
+{
+    ListenerCounts counts = { 0 };
+    TremeloUnitRef unit = NewUnit(&counts, kTremeloUnitPropertyNotification_Synchronous);
+    for (int32_t i = 0; i < 5; ++i) {
+        TREMELO_CHECK_NOERR(TremeloUnit_SetFactoryPreset(unit, i % 2));
+        TREMELO_CHECK(atomic_load(&counts.mPresetCalls) == (unsigned)i + 1);
+    }
+    TREMELO_CHECK(TremeloUnit_SetPropertyNotification(unit, 7) != 0);
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+}
+
+typedef struct {
+    TremeloUnitRef  mUnit;
+} RenderThreadArgs;
+
+static void *HibernateThread(void *inArgs)
+{
+    RenderThreadArgs *args = (RenderThreadArgs *)inArgs;
+    RenderSlice(args->mUnit, 1);
+    RenderSlice(args->mUnit, 1);
+    return NULL;
+}
+
+static atomic_int sUninitializeResult;
+
+// The first preset change: a render thread queues a hibernation change for the notifier thread,
+// which then waits for the listeners' mutex this thread holds; uninitializing unregisters the unit
+// from the notifier.
+static void UninitializingListener(void *inRefCon, TremeloUnitRef inUnit, uint32_t inPropertyID, uint32_t inScope,
+                                   uint32_t inElement)
+{
+    ListenerCounts *counts = (ListenerCounts *)inRefCon;
+    Listener(inRefCon, inUnit, inPropertyID, inScope, inElement);
+    if (inPropertyID != kProperty_PresentPreset || atomic_load(&counts->mPresetCalls) != 1)
+        return;
+    RenderThreadArgs args = { inUnit };
+    pthread_t thread;
+    TREMELO_CHECK(pthread_create(&thread, NULL, HibernateThread, &args) == 0);
+    TREMELO_CHECK(pthread_join(thread, NULL) == 0);
+    usleep(50000);      // several of the notifier's polls
+    atomic_store(&sUninitializeResult, TremeloUnit_Uninitialize(inUnit));
+}
+
+static void TestUninitializeFromListener(void)
+{
+    ListenerCounts counts = { 0 };
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 48000, kChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kFrames));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetHibernateAfter(unit, kFrames));
+    TREMELO_CHECK_NOERR(TremeloUnit_AddPropertyListener(unit, kProperty_PresentPreset, UninitializingListener, &counts));
+    TREMELO_CHECK_NOERR(TremeloUnit_AddPropertyListener(unit, kProperty_Hibernation, Listener, &counts));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetPropertyNotification(unit, kTremeloUnitPropertyNotification_Synchronous));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+
+    // A deadlock ends the test here.
+    alarm(10);
+    atomic_store(&sUninitializeResult, -1);
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFactoryPreset(unit, 1));
+    alarm(0);
+    TREMELO_CHECK(atomic_load(&sUninitializeResult) == 0);
+    // The notifier thread goes on to deliver the change it had drained.
+    for (int wait = 0; wait < 200 && atomic_load(&counts.mHibernationCalls) == 0; ++wait)
+        usleep(5000);
+    TREMELO_CHECK(atomic_load(&counts.mHibernationCalls) == 1);
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+}
+
+static void *RenderThread(void *inArgs)
+{
+    RenderThreadArgs *args = (RenderThreadArgs *)inArgs;
+    for (int slice = 0; slice < kLoadSlices; ++slice)
+        RenderSlice(args->mUnit, (slice / 3) % 2);
+    return NULL;
+}
+
+static void TestUnderLoad(int inMode)
+{
+    ListenerCounts counts = { 0 };
+    TremeloUnitRef unit = NewUnit(&counts, inMode);
+    RenderThreadArgs args = { unit };
+
+    atomic_store(&sRendering, 1);
+    TREMELO_CHECK(pthread_create(&sRenderThread, NULL, RenderThread, &args) == 0);
+    unsigned recalls = 0;
+    while (recalls < 20000) {
+        TREMELO_CHECK_NOERR(TremeloUnit_SetFactoryPreset(unit, recalls % 2));
+        if (inMode == kTremeloUnitPropertyNotification_HostPumped)
+            TREMELO_CHECK_NOERR(TremeloUnit_DeliverPropertyChanges(unit, 0));
+        if (++recalls % 64 == 0)
+            sched_yield();
+    }
+    TREMELO_CHECK(pthread_join(sRenderThread, NULL) == 0);
+
+    // Let queued changes drain: the notifier thread polls for the render thread's.
+    TremeloUnitHibernationStats stats;
+    TREMELO_CHECK_NOERR(TremeloUnit_GetHibernationStats(unit, &stats));
+    TREMELO_CHECK(stats.hibernations > 100);
+    if (inMode == kTremeloUnitPropertyNotification_HostPumped)
+        TREMELO_CHECK_NOERR(TremeloUnit_DeliverPropertyChanges(unit, 0));
+    for (int wait = 0; wait < 200 && atomic_load(&counts.mHibernationCalls) == 0; ++wait)
+        usleep(5000);
+    atomic_store(&sRendering, 0);
+
+    TREMELO_CHECK(atomic_load(&counts.mRenderThreadCalls) == 0);
+    TREMELO_CHECK(atomic_load(&counts.mHibernationCalls) > 0);
+    TREMELO_CHECK(atomic_load(&counts.mPresetCalls) > 0);
+    // Coalescing never delivers more changes than were made.
+    TREMELO_CHECK(atomic_load(&counts.mPresetCalls) <= recalls);
+    TREMELO_CHECK(atomic_load(&counts.mHibernationCalls) <= 2 * stats.hibernations);
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+}
+
+int main(void)
+{
+    TestHostPumped();
+    TestSynchronous();
+    TestUninitializeFromListener();
+    TestUnderLoad(kTremeloUnitPropertyNotification_Synchronous);
+    TestUnderLoad(kTremeloUnitPropertyNotification_NotifierThread);
+    TestUnderLoad(kTremeloUnitPropertyNotification_HostPumped);
+    return 0;
+}
@@ -0,0 +1,251 @@
+//
+//  TestRenderCLI.c
+//  TremeloAUv2
+//
+//  tremelo-render, run as a host would run it (its path comes in TREMELO_RENDER). A 16-bit
+//  stereo and a 24-bit mono file render to exactly what TremeloUnit_Render produces from the
+//  same samples with the same settings, written back at the input's bit depth; an output file
+//  already there is replaced, and nothing else is left in the output directory. An output path
+//  that names the input under another spelling ("-o dir/." for dir/in.wav) or through a hard
+//  link is refused, and the input is left intact.
+//
+
+#include "TremeloTest.h"
+
+#include <dirent.h>
+#include <spawn.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+extern char **environ;
+
+enum { kBlock = 512, kFrames = 20000 };
+
+typedef struct {
+    const char *mName;
+    uint32_t    mSampleRate;
+    uint32_t    mChannels;
+    uint32_t    mBytesPerSample;    // 2 or 3
+} TestFile;
+
+static const TestFile kFiles[] = {
+    { "a16.wav", 44100, 2, 2 },
+    { "a24.wav", 48000, 1, 3 }
+};
+
+static char sDirectory[256];
+
+static void PathOf(char *outPath, const char *inSubdirectory, const char *inName)
+{
+    snprintf(outPath, 512, "%s/%s%s%s", sDirectory, inSubdirectory, *inSubdirectory ? "/" : "", inName);
+}
+
+static void WriteLE(uint8_t *outBytes, uint32_t inValue, int inBytes)
+{
+    for (int i = 0; i < inBytes; ++i)
+        outBytes[i] = (uint8_t)(inValue >> (8 * i));
+}
+
+// A plain PCM WAV file of kFrames frames of the test signal, quantized to the file's depth.
+static void WriteInput(const TestFile *inFile)
+{
+    const uint32_t frameBytes = inFile->mChannels * inFile->mBytesPerSample, dataBytes = kFrames * frameBytes;
+    uint8_t *bytes = (uint8_t *)calloc(44 + dataBytes, 1);
+    memcpy(bytes, "RIFF", 4);
+    WriteLE(bytes + 4, 36 + dataBytes, 4);
+    memcpy(bytes + 8, "WAVEfmt ", 8);
+    WriteLE(bytes + 16, 16, 4);
+    WriteLE(bytes + 20, 1, 2);
+    WriteLE(bytes + 22, inFile->mChannels, 2);
+    WriteLE(bytes + 24, inFile->mSampleRate, 4);
+    WriteLE(bytes + 28, inFile->mSampleRate * frameBytes, 4);
+    WriteLE(bytes + 32, frameBytes, 2);
+    WriteLE(bytes + 34, 8 * inFile->mBytesPerSample, 2);
+    memcpy(bytes + 36, "data", 4);
+    WriteLE(bytes + 40, dataBytes, 4);
+
+    float *signal = (float *)malloc(kFrames * sizeof(float));
+    const float scale = inFile->mBytesPerSample == 2 ? 32767.f : 8388607.f;
+    for (uint32_t c = 0; c < inFile->mChannels; ++c) {
+        TremeloTest_FillSignal(signal, kFrames, c);
+        for (uint32_t i = 0; i < kFrames; ++i)
+            WriteLE(bytes + 44 + i * frameBytes + c * inFile->mBytesPerSample, (uint32_t)(int32_t)lrintf(signal[i] * scale),
+                    (int)inFile->mBytesPerSample);
+    }
+    char path[512];
+    PathOf(path, "", inFile->mName);
+    FILE *file = fopen(path, "wb");
+    TREMELO_CHECK(file != NULL && fwrite(bytes, 1, 44 + dataBytes, file) == 44 + dataBytes && fclose(file) == 0);
+    free(signal);
+    free(bytes);
+}
+
+static uint8_t *ReadWhole(const char *inPath, size_t *outSize)
+{
+    FILE *file = fopen(inPath, "rb");
+    TREMELO_CHECK(file != NULL);
+    fseek(file, 0, SEEK_END);
+    *outSize = (size_t)ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *bytes = (uint8_t *)malloc(*outSize + 1);
+    TREMELO_CHECK(fread(bytes, 1, *outSize, file) == *outSize);
+    fclose(file);
+    return bytes;
+}
+
+static int32_t ReadSample(const uint8_t *inBytes, uint32_t inBytesPerSample)
+{
+    uint32_t value = 0;
+    for (uint32_t i = 0; i < inBytesPerSample; ++i)
+        value |= (uint32_t)inBytes[i] << (8 * (i + 4 - inBytesPerSample));
+    return (int32_t)value >> (8 * (4 - inBytesPerSample));
+}
+
+// The rendered file, sample for sample: the input as tremelo-render reads it, through a unit
+// set up as the command line sets it, in kBlock-frame calls, quantized as it writes.
+static void CheckOutput(const TestFile *inFile)
+{
+    char inputPath[512], outputPath[512];
+    PathOf(inputPath, "", inFile->mName);
+    PathOf(outputPath, "out", inFile->mName);
+    size_t inputSize, outputSize;
+    uint8_t *input = ReadWhole(inputPath, &inputSize), *output = ReadWhole(outputPath, &outputSize);
+    const uint32_t sampleBytes = inFile->mBytesPerSample, frameBytes = inFile->mChannels * sampleBytes;
+    TREMELO_CHECK(outputSize == 44 + kFrames * frameBytes);
+    TREMELO_CHECK(memcmp(output, input, 44) == 0);              // the same header, sizes included
+
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, 7.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 60.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, inFile->mSampleRate, inFile->mChannels));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kBlock));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    const float inScale = sampleBytes == 2 ? 1.f / 32768.f : 1.f / 8388608.f;
+    const float outScale = sampleBytes == 2 ? 32767.f : 8388607.f;
+    float block[2][kBlock];
+    float *channels[2] = { block[0], block[1] };
+    for (uint32_t offset = 0; offset < kFrames; offset += kBlock) {
+        const uint32_t frames = kFrames - offset < kBlock ? kFrames - offset : kBlock;
+        for (uint32_t c = 0; c < inFile->mChannels; ++c)
+            for (uint32_t i = 0; i < frames; ++i)
+                block[c][i] = ReadSample(input + 44 + (offset + i) * frameBytes + c * sampleBytes, sampleBytes) * inScale;
+        TREMELO_CHECK_NOERR(TremeloUnit_Render(unit, (const float *const *)channels, channels, frames));
+        for (uint32_t c = 0; c < inFile->mChannels; ++c)
+            for (uint32_t i = 0; i < frames; ++i) {
+                float value = block[c][i] < -1.f ? -1.f : (block[c][i] > 1.f ? 1.f : block[c][i]);
+                int32_t expected = (int32_t)lrintf(value * outScale);
+                TREMELO_CHECK(ReadSample(output + 44 + (offset + i) * frameBytes + c * sampleBytes, sampleBytes) == expected);
+            }
+    }
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(unit));
+    free(input);
+    free(output);
+}
+
+// Runs tremelo-render with inArguments (NULL-terminated, after the program name) and returns
+// its exit status.
+static int Run(const char *const *inArguments)
+{
+    const char *program = getenv("TREMELO_RENDER");
+    TREMELO_CHECK(program != NULL);
+    char *argv[16];
+    int argc = 0;
+    argv[argc++] = (char *)program;
+    while (*inArguments)
+        argv[argc++] = (char *)*inArguments++;
+    argv[argc] = NULL;
+    pid_t child;
+    TREMELO_CHECK(posix_spawn(&child, program, NULL, NULL, argv, environ) == 0);
+    int status = 0;
+    TREMELO_CHECK(waitpid(child, &status, 0) == child && WIFEXITED(status));
+    return WEXITSTATUS(status);
+}
+
+static int CountEntries(const char *inSubdirectory)
+{
+    char path[512];
+    PathOf(path, inSubdirectory, ".");
+    DIR *directory = opendir(path);
+    TREMELO_CHECK(directory != NULL);
+    int count = 0;
+    struct dirent *entry;
+    while ((entry = readdir(directory)) != NULL)
+        if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+            ++count;
+    closedir(directory);
+    return count;
+}
+
+static void TestRender(void)
+{
+    char outputDirectory[512], inputs[2][512], stale[512];
+    PathOf(outputDirectory, "", "out");
+    TREMELO_CHECK(mkdir(outputDirectory, 0755) == 0);
+    for (int i = 0; i < 2; ++i)
+        PathOf(inputs[i], "", kFiles[i].mName);
+    // Whatever was there before is replaced.
+    PathOf(stale, "out", kFiles[1].mName);
+    FILE *file = fopen(stale, "w");
+    TREMELO_CHECK(file != NULL && fputs("stale", file) >= 0 && fclose(file) == 0);
+
+    const char *arguments[] = { "-q", "-j", "2", "-b", "512", "-f", "7", "-d", "60", "-o", outputDirectory,
+                                inputs[0], inputs[1], NULL };
+    TREMELO_CHECK(Run(arguments) == 0);
+    for (int i = 0; i < 2; ++i)
+        CheckOutput(&kFiles[i]);
+    TREMELO_CHECK(CountEntries("out") == 2);
+}
+
+static void TestSameFile(void)
+{
+    char input[512], sameDirectory[512], linked[512], outputDirectory[512];
+    PathOf(input, "", kFiles[0].mName);
+    PathOf(sameDirectory, "", ".");
+    PathOf(outputDirectory, "", "out");
+    size_t originalSize, size;
+    uint8_t *original = ReadWhole(input, &originalSize);
+
+    // dir/./a16.wav is dir/a16.wav.
+    const char *spelled[] = { "-q", "-o", sameDirectory, input, NULL };
+    TREMELO_CHECK(Run(spelled) == 1);
+    // So is a hard link to it in the output directory.
+    PathOf(linked, "out", kFiles[0].mName);
+    TREMELO_CHECK(unlink(linked) == 0 && link(input, linked) == 0);
+    const char *hardLinked[] = { "-q", "-o", outputDirectory, input, NULL };
+    TREMELO_CHECK(Run(hardLinked) == 1);
+
+    uint8_t *after = ReadWhole(input, &size);
+    TREMELO_CHECK(size == originalSize && memcmp(after, original, size) == 0);
+    TREMELO_CHECK(CountEntries("") == 3 && CountEntries("out") == 2);
+    free(after);
+    free(original);
+}
+
+static void RemoveAll(void)
+{
+    char path[512];
+    for (int i = 0; i < 2; ++i) {
+        PathOf(path, "out", kFiles[i].mName);
+        unlink(path);
+        PathOf(path, "", kFiles[i].mName);
+        unlink(path);
+    }
+    PathOf(path, "", "out");
+    rmdir(path);
+    rmdir(sDirectory);
+}
+
+int main(void)
+{
+    const char *temporary = getenv("TMPDIR");
+    snprintf(sDirectory, sizeof(sDirectory), "%s/TestRenderCLI.XXXXXX", temporary ? temporary : "/tmp");
+    TREMELO_CHECK(mkdtemp(sDirectory) != NULL);
+    for (int i = 0; i < 2; ++i)
+        WriteInput(&kFiles[i]);
+    TestRender();
+    TestSameFile();
+    RemoveAll();
+    return 0;
+}
@@ -0,0 +1,267 @@
+//
+//  TestRenderNotify.cpp
+//  TremeloAUv2
+//
+//  AUBase's render notifications (AURenderNotifyList). While a render cycle is under way, the
+//  host adding and removing notifications frees every array it retires but the one the cycle
+//  is using, which calls the same notifications after rendering as before; the next change
+//  after the cycle frees that one too. Under a host thread adding and removing notifications
+//  while another renders, each render calls a notification with PreRender and PostRender once
+//  each or not at all: always if it stayed installed throughout the render, never if it stayed
+//  out. Afterwards one more change leaves only the current array allocated.
+//
+
+#include "TremeloTest.h"
+#include "TremeloUnit.hpp"
+#include "AudioComponent.h"
+#include "CAStreamBasicDescription.h"
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+enum { kChannels = 2, kSlice = 64, kSlots = 8, kChanges = 20000 };
+
+// A notification's refCon: how often it was called, and how, per render.
+struct Slot {
+    std::atomic<UInt32>     mPre;
+    std::atomic<UInt32>     mPost;
+    std::atomic<UInt32>     mBadCalls;      // with neither or both of PreRender and PostRender, or an error
+    std::atomic<UInt32>     mChanges;       // odd while the host is adding or removing it
+    std::atomic<bool>       mInstalled;
+};
+
+static Slot sSlots[kSlots];
+static std::atomic<int> sPausePhase(0);     // 0: pause; 1: the pausing notification is waiting; 2: go on
+
+static OSStatus Notify(void *inRefCon, AudioUnitRenderActionFlags *ioActionFlags, const AudioTimeStamp *, UInt32 inBusNumber,
+                       UInt32 inNumberFrames, AudioBufferList *)
+{
+    Slot &slot = *static_cast<Slot *>(inRefCon);
+    const AudioUnitRenderActionFlags flags = *ioActionFlags;
+    const bool pre = (flags & kAudioUnitRenderAction_PreRender) != 0, post = (flags & kAudioUnitRenderAction_PostRender) != 0;
+    if (pre == post || (flags & kAudioUnitRenderAction_PostRenderError) || inBusNumber != 0 || inNumberFrames != kSlice)
+        slot.mBadCalls.fetch_add(1);
+    (pre ? slot.mPre : slot.mPost).fetch_add(1);
+    return noErr;
+}
+
+// Notify, and before rendering, if sPausePhase is 0, wait until the test lets the cycle go on.
+static OSStatus NotifyAndPause(void *inRefCon, AudioUnitRenderActionFlags *ioActionFlags, const AudioTimeStamp *inTimeStamp,
+                               UInt32 inBusNumber, UInt32 inNumberFrames, AudioBufferList *ioData)
+{
+    Notify(inRefCon, ioActionFlags, inTimeStamp, inBusNumber, inNumberFrames, ioData);
+    int phase = 0;
+    if ((*ioActionFlags & kAudioUnitRenderAction_PreRender) && sPausePhase.compare_exchange_strong(phase, 1)) {
+        while (sPausePhase.load() != 2)
+            std::this_thread::yield();
+    }
+    return noErr;
+}
+
+static OSStatus InputCallback(void *, AudioUnitRenderActionFlags *, const AudioTimeStamp *, UInt32, UInt32 inNumberFrames,
+                              AudioBufferList *ioData)
+{
+    static float input[kChannels][kSlice];
+    for (UInt32 c = 0; c < ioData->mNumberBuffers; ++c) {
+        TremeloTest_FillSignal(input[c], inNumberFrames, c);
+        ioData->mBuffers[c].mData = input[c];
+        ioData->mBuffers[c].mDataByteSize = inNumberFrames * sizeof(float);
+    }
+    return noErr;
+}
+
+static AudioUnit NewRenderingUnit()
+{
+    AudioComponentDescription desc = { kAudioUnitType_Effect, TremeloUnit_COMP_SUBTYPE, TrmeloUnit_COMP_MANF, 0, 0 };
+    AudioComponent component = AudioComponentFindNext(NULL, &desc);
+    TREMELO_CHECK(component != NULL);
+    AudioUnit unit = NULL;
+    TREMELO_CHECK_NOERR(AudioComponentInstanceNew(component, &unit));
+    CAStreamBasicDescription format(48000, kChannels, CAStreamBasicDescription::kPCMFormatFloat32, false);
+    for (AudioUnitScope scope : { kAudioUnitScope_Input, kAudioUnitScope_Output })
+        TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_StreamFormat, scope, 0, &format,
+                                                 sizeof(AudioStreamBasicDescription)));
+    UInt32 frames = kSlice;
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_MaximumFramesPerSlice, kAudioUnitScope_Global, 0,
+                                             &frames, sizeof(frames)));
+    AURenderCallbackStruct callback = { InputCallback, NULL };
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0,
+                                             &callback, sizeof(callback)));
+    TREMELO_CHECK_NOERR(AudioUnitInitialize(unit));
+    return unit;
+}
+
+static void Render(AudioUnit inUnit, UInt32 inCycle)
+{
+    float output[kChannels][kSlice];
+    std::vector<Byte> listStorage(offsetof(AudioBufferList, mBuffers) + kChannels * sizeof(AudioBuffer));
+    AudioBufferList *list = (AudioBufferList *)listStorage.data();
+    list->mNumberBuffers = kChannels;
+    for (UInt32 c = 0; c < kChannels; ++c)
+        list->mBuffers[c] = { 1, kSlice * sizeof(float), output[c] };
+    AudioTimeStamp timeStamp = {};
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+    timeStamp.mSampleTime = Float64(inCycle) * kSlice;
+    AudioUnitRenderActionFlags flags = 0;
+    TREMELO_CHECK_NOERR(AudioUnitRender(inUnit, &flags, &timeStamp, 0, kSlice, list));
+}
+
+// What the notification arrays hold, with what else the unit counts as other memory.
+static UInt64 OtherBytes(AudioUnit inUnit)
+{
+    AUMemoryUsage usage;
+    UInt32 size = sizeof(usage);
+    TREMELO_CHECK_NOERR(AudioUnitGetProperty(inUnit, kTremeloUnitProperty_MemoryUsage, kAudioUnitScope_Global, 0,
+                                             &usage, &size));
+    return usage.mOther;
+}
+
+static UInt64 ArrayBytes(UInt32 inCount)
+{
+    return offsetof(AURenderNotifyList::Snapshot, mCallbacks) + inCount * sizeof(AURenderNotifyList::Callback);
+}
+
+static void ResetSlots()
+{
+    for (Slot &slot : sSlots) {
+        slot.mPre = slot.mPost = slot.mBadCalls = slot.mChanges = 0;
+        slot.mInstalled = false;
+    }
+}
+
+#pragma mark ____Changes During a Render Cycle
+
+static void TestChangesDuringRender()
+{
+    ResetSlots();
+    AudioUnit unit = NewRenderingUnit();
+    const UInt64 base = OtherBytes(unit);
+    Slot &paused = sSlots[0], &a = sSlots[1], &b = sSlots[2];
+    TREMELO_CHECK_NOERR(AudioUnitAddRenderNotify(unit, NotifyAndPause, &paused));
+    TREMELO_CHECK_NOERR(AudioUnitAddRenderNotify(unit, Notify, &a));
+    // Nothing is rendering: {paused} went as soon as {paused, a} replaced it.
+    TREMELO_CHECK(OtherBytes(unit) - base == ArrayBytes(2));
+
+    sPausePhase = 0;
+    std::thread render([&] { Render(unit, 0); });
+    while (sPausePhase.load() != 1)
+        std::this_thread::yield();
+    // The render cycle is using {paused, a}: removing a and adding and removing b retire it and
+    // two more, and free all but it.
+    TREMELO_CHECK_NOERR(AudioUnitRemoveRenderNotify(unit, Notify, &a));
+    TREMELO_CHECK(OtherBytes(unit) - base == ArrayBytes(1) + ArrayBytes(2));
+    TREMELO_CHECK_NOERR(AudioUnitAddRenderNotify(unit, Notify, &b));
+    TREMELO_CHECK_NOERR(AudioUnitRemoveRenderNotify(unit, Notify, &b));
+    TREMELO_CHECK(OtherBytes(unit) - base == ArrayBytes(1) + ArrayBytes(2));
+    sPausePhase = 2;
+    render.join();
+    // After rendering, the cycle called what it called before: a, though no longer installed,
+    // and not b, which was installed and removed meanwhile.
+    TREMELO_CHECK(paused.mPre == 1 && paused.mPost == 1 && a.mPre == 1 && a.mPost == 1);
+    TREMELO_CHECK(b.mPre == 0 && b.mPost == 0);
+
+    // With the cycle over, the next change frees {paused, a} as well.
+    TREMELO_CHECK_NOERR(AudioUnitAddRenderNotify(unit, Notify, &b));
+    TREMELO_CHECK(OtherBytes(unit) - base == ArrayBytes(2));
+    Render(unit, 1);
+    TREMELO_CHECK(paused.mPre == 2 && a.mPre == 1 && b.mPre == 1 && b.mPost == 1);
+    TREMELO_CHECK_NOERR(AudioUnitRemoveRenderNotify(unit, Notify, &b));
+    TREMELO_CHECK_NOERR(AudioUnitUninitialize(unit));
+    TREMELO_CHECK(OtherBytes(unit) - base == ArrayBytes(1));
+
+    for (const Slot &slot : sSlots)
+        TREMELO_CHECK(slot.mBadCalls == 0);
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+}
+
+#pragma mark ____A Host Thread Against a Render Thread
+
+static void TestConcurrentChanges()
+{
+    ResetSlots();
+    AudioUnit unit = NewRenderingUnit();
+    const UInt64 base = OtherBytes(unit);
+    std::atomic<bool> done(false);
+    std::atomic<UInt32> cycles(0);
+
+    // The host toggles notifications at random, marking each change in its slot's mChanges, and
+    // waits for a render cycle every few changes; the render thread yields after each cycle. So
+    // the two interleave on a single core too.
+    std::thread host([&] {
+        UInt32 random = 1;
+        for (int i = 0; i < kChanges; ++i) {
+            random = random * 1664525 + 1013904223;
+            Slot &slot = sSlots[(random >> 16) % kSlots];
+            slot.mChanges.fetch_add(1);
+            if (slot.mInstalled)
+                TREMELO_CHECK_NOERR(AudioUnitRemoveRenderNotify(unit, Notify, &slot));
+            else
+                TREMELO_CHECK_NOERR(AudioUnitAddRenderNotify(unit, Notify, &slot));
+            slot.mInstalled = !slot.mInstalled;
+            slot.mChanges.fetch_add(1);
+            if (i % 64 == 0)
+                OtherBytes(unit);
+            if (i % 4 == 3)
+                for (UInt32 cycle = cycles; cycles == cycle; )
+                    std::this_thread::yield();
+        }
+        done = true;
+    });
+
+    // A notification that wasn't changed during a render cycle fired in it if it was installed,
+    // and not otherwise. Any other fired before and after rendering, or not at all.
+    UInt32 steady = 0, steadyInstalled = 0;
+    UInt32 changes[kSlots], pre[kSlots], post[kSlots];
+    bool installed[kSlots];
+    while (!done) {
+        for (UInt32 i = 0; i < kSlots; ++i) {
+            changes[i] = sSlots[i].mChanges;
+            installed[i] = sSlots[i].mInstalled;
+            pre[i] = sSlots[i].mPre;
+            post[i] = sSlots[i].mPost;
+        }
+        Render(unit, cycles);
+        for (UInt32 i = 0; i < kSlots; ++i) {
+            const UInt32 fired = sSlots[i].mPre - pre[i];
+            TREMELO_CHECK(fired <= 1 && sSlots[i].mPost - post[i] == fired);
+            if (changes[i] % 2 == 0 && sSlots[i].mChanges == changes[i]) {
+                TREMELO_CHECK(fired == (installed[i] ? 1 : 0));
+                ++steady;
+                steadyInstalled += installed[i];
+            }
+        }
+        ++cycles;
+        std::this_thread::yield();
+    }
+    host.join();
+    for (const Slot &slot : sSlots)
+        TREMELO_CHECK(slot.mBadCalls == 0 && slot.mPre > 0);
+    TREMELO_CHECK(steadyInstalled > 0 && steadyInstalled < steady);
+    printf("%u render cycles against %d changes, %u steady notifications checked\n", cycles.load(), kChanges, steady);
+
+    // The host's last change may have kept the array the last render cycle used; the next one
+    // frees it.
+    Slot &last = sSlots[0];
+    if (last.mInstalled)
+        TREMELO_CHECK_NOERR(AudioUnitRemoveRenderNotify(unit, Notify, &last));
+    else
+        TREMELO_CHECK_NOERR(AudioUnitAddRenderNotify(unit, Notify, &last));
+    last.mInstalled = !last.mInstalled;
+    UInt32 count = 0;
+    for (const Slot &slot : sSlots)
+        count += slot.mInstalled;
+    TREMELO_CHECK(OtherBytes(unit) - base == (count ? ArrayBytes(count) : 0));
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+}
+
+int main()
+{
+    // TremeloUnit_New registers the component.
+    TremeloUnitRef registered = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&registered));
+    TestChangesDuringRender();
+    TestConcurrentChanges();
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(registered));
+    return 0;
+}
@@ -0,0 +1,167 @@
+//
+//  TestScheduledParameters.cpp
+//  TremeloAUv2
+//
+//  Hosts call AudioUnitScheduleParameters on the render thread, and AUBase applies immediate
+//  events through SetParameter. An event scheduled while a recalled preset is still waiting for
+//  the render thread must land after the preset, without the render thread taking the preset
+//  exchange's writer lock. This program interposes pthread_mutex_lock to count the locks taken
+//  inside AudioUnitScheduleParameters; the same count around a host-thread parameter write shows
+//  the interposition sees the exchange's lock at all. A preset number that isn't a factory
+//  preset's is refused with kAudioUnitErr_InvalidPropertyValue, and leaves the current preset
+//  and the parameters as they were.
+//
+
+#include "TremeloTest.h"
+#include "TremeloUnit.hpp"
+#include "AudioComponent.h"
+#include "CAStreamBasicDescription.h"
+
+#include <dlfcn.h>
+#include <pthread.h>
+
+enum { kSampleRate = 48000, kSlice = 256 };
+
+static thread_local bool sCountLocks;
+static thread_local UInt32 sLocks;
+
+extern "C" int pthread_mutex_lock(pthread_mutex_t *inMutex)
+{
+    typedef int (*LockFunction)(pthread_mutex_t *);
+    static LockFunction sLock = (LockFunction)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+    if (sCountLocks)
+        ++sLocks;
+    return sLock(inMutex);
+}
+
+static float sInput[kSlice];
+
+static OSStatus InputCallback(void *, AudioUnitRenderActionFlags *, const AudioTimeStamp *, UInt32, UInt32 inNumberFrames,
+                              AudioBufferList *ioData)
+{
+    if (ioData->mNumberBuffers != 1 || inNumberFrames > kSlice)
+        return kAudio_ParamError;
+    ioData->mBuffers[0].mData = sInput;
+    ioData->mBuffers[0].mDataByteSize = inNumberFrames * sizeof(Float32);
+    return noErr;
+}
+
+static void Render(AudioUnit inUnit, Float64 &ioSampleTime)
+{
+    float output[kSlice];
+    AudioBufferList list;
+    list.mNumberBuffers = 1;
+    list.mBuffers[0].mNumberChannels = 1;
+    list.mBuffers[0].mDataByteSize = sizeof(output);
+    list.mBuffers[0].mData = output;
+    AudioTimeStamp timeStamp = {};
+    timeStamp.mFlags = kAudioTimeStampSampleTimeValid;
+    timeStamp.mSampleTime = ioSampleTime;
+    AudioUnitRenderActionFlags flags = 0;
+    TREMELO_CHECK_NOERR(AudioUnitRender(inUnit, &flags, &timeStamp, 0, kSlice, &list));
+    ioSampleTime += kSlice;
+}
+
+static void RecallPreset(AudioUnit inUnit, SInt32 inPresetNumber)
+{
+    AUPreset preset = { inPresetNumber, NULL };
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(inUnit, kAudioUnitProperty_PresentPreset, kAudioUnitScope_Global, 0,
+                                             &preset, sizeof(preset)));
+}
+
+static float GetParameter(AudioUnit inUnit, AudioUnitParameterID inID)
+{
+    AudioUnitParameterValue value = 0.f;
+    TREMELO_CHECK_NOERR(AudioUnitGetParameter(inUnit, inID, kAudioUnitScope_Global, 0, &value));
+    return value;
+}
+
+int main()
+{
+    // TremeloUnit_New registers the component with the shim.
+    TremeloUnitRef registration = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&registration));
+    TREMELO_CHECK_NOERR(TremeloUnit_Dispose(registration));
+
+    AudioComponentDescription desc = { kAudioUnitType_Effect, TremeloUnit_COMP_SUBTYPE, TrmeloUnit_COMP_MANF, 0, 0 };
+    AudioComponent component = AudioComponentFindNext(NULL, &desc);
+    TREMELO_CHECK(component != NULL);
+    AudioUnit unit = NULL;
+    TREMELO_CHECK_NOERR(AudioComponentInstanceNew(component, &unit));
+
+    CAStreamBasicDescription format(kSampleRate, 1, CAStreamBasicDescription::kPCMFormatFloat32, false);
+    AURenderCallbackStruct callback = { InputCallback, NULL };
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_SetRenderCallback, kAudioUnitScope_Input, 0,
+                                             &callback, sizeof(callback)));
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Input, 0,
+                                             &format, sizeof(AudioStreamBasicDescription)));
+    TREMELO_CHECK_NOERR(AudioUnitSetProperty(unit, kAudioUnitProperty_StreamFormat, kAudioUnitScope_Output, 0,
+                                             &format, sizeof(AudioStreamBasicDescription)));
+    TREMELO_CHECK_NOERR(AudioUnitInitialize(unit));
+    TremeloTest_FillSignal(sInput, kSlice, 0);
+
+    Float64 sampleTime = 0.;
+    Render(unit, sampleTime);
+    TREMELO_CHECK(GetParameter(unit, kTremeloUnitParam_Frequency) == kParameter_Preset_Frequency_Slow);
+
+    // Not a factory preset.
+    for (SInt32 presetNumber : { SInt32(kNumberOfPresets), SInt32(99) }) {
+        AUPreset preset = { presetNumber, NULL };
+        TREMELO_CHECK(AudioUnitSetProperty(unit, kAudioUnitProperty_PresentPreset, kAudioUnitScope_Global, 0, &preset,
+                                           sizeof(preset)) == kAudioUnitErr_InvalidPropertyValue);
+        UInt32 size = sizeof(preset);
+        TREMELO_CHECK_NOERR(AudioUnitGetProperty(unit, kAudioUnitProperty_PresentPreset, kAudioUnitScope_Global, 0,
+                                                 &preset, &size));
+        TREMELO_CHECK(preset.presetNumber == kPreset_Slow);
+        CFRelease(preset.presetName);
+        Render(unit, sampleTime);
+        TREMELO_CHECK(GetParameter(unit, kTremeloUnitParam_Frequency) == kParameter_Preset_Frequency_Slow);
+        TREMELO_CHECK(GetParameter(unit, kTremeloUnitParam_Depth) == kParameter_Preset_Depth_Slow);
+    }
+
+    // A host-thread write behind a pending preset commits it under the exchange's lock.
+    RecallPreset(unit, kPreset_Fast);
+    sLocks = 0;
+    sCountLocks = true;
+    TREMELO_CHECK_NOERR(AudioUnitSetParameter(unit, kTremeloUnitParam_Depth, kAudioUnitScope_Global, 0, 33.f, 0));
+    sCountLocks = false;
+    TREMELO_CHECK(sLocks > 0);
+    TREMELO_CHECK(GetParameter(unit, kTremeloUnitParam_Frequency) == kParameter_Preset_Frequency_Fast);
+    TREMELO_CHECK(GetParameter(unit, kTremeloUnitParam_Depth) == 33.f);
+    Render(unit, sampleTime);
+
+    // Immediate and ramped events scheduled on the render thread behind a pending preset: no lock,
+    // and the events win over the preset's values.
+    for (int round = 0; round < 4; ++round) {
+        const SInt32 presetNumber = round % 2 ? kPreset_Fast : kPreset_Slow;
+        const float depth = 10.f + round;
+        RecallPreset(unit, presetNumber);
+
+        AudioUnitParameterEvent events[2] = {};
+        events[0].scope = kAudioUnitScope_Global;
+        events[0].parameter = kTremeloUnitParam_Depth;
+        events[0].eventType = kParameterEvent_Immediate;
+        events[0].eventValues.immediate.bufferOffset = 0;
+        events[0].eventValues.immediate.value = depth;
+        events[1].scope = kAudioUnitScope_Global;
+        events[1].parameter = kTremeloUnitParam_Frequency;
+        events[1].eventType = kParameterEvent_Immediate;
+        events[1].eventValues.immediate.bufferOffset = kSlice / 2;
+        events[1].eventValues.immediate.value = 7.f;
+
+        sLocks = 0;
+        sCountLocks = true;
+        TREMELO_CHECK_NOERR(AudioUnitScheduleParameters(unit, events, 2));
+        sCountLocks = false;
+        TREMELO_CHECK(sLocks == 0);
+
+        Render(unit, sampleTime);
+        TREMELO_CHECK(GetParameter(unit, kTremeloUnitParam_Depth) == depth);
+        TREMELO_CHECK(GetParameter(unit, kTremeloUnitParam_Frequency) == 7.f);
+        TREMELO_CHECK(GetParameter(unit, kTremeloUnitParam_Waveform) ==
+                      (presetNumber == kPreset_Fast ? kParameter_Preset_Waveform_Fast : kParameter_Preset_Waveform_Slow));
+    }
+
+    TREMELO_CHECK_NOERR(AudioComponentInstanceDispose(unit));
+    return 0;
+}
@@ -0,0 +1,109 @@
+//
+//  TestSharedLFO.c
+//  TremeloAUv2
+//
+//  Instances with kTremeloUnitProperty_SharedLFO on copy gain blocks other instances published
+//  (TremeloSharedLFO.h). Whatever they copy, and however the render threads interleave, each
+//  must render exactly what an instance computing its own gains renders.
+//
+
+#include "TremeloTest.h"
+
+#include <pthread.h>
+
+enum { kUnits = 6, kFrames = 48000 * 2, kSlice = 512, kRounds = 3 };
+
+static float sInput[kFrames];
+static float sReference[2][kFrames];
+static float sOutput[kUnits][kFrames];
+static TremeloUnitRef sUnits[kUnits];
+
+// Two groups of instances with different settings share the table; 7.3 Hz and 3.3 Hz have no
+// whole-number period at 48 kHz, so the gain cache never serves the slices instead.
+static float Frequency(int inUnit) { return inUnit % 2 ? 3.3f : 7.3f; }
+
+static TremeloUnitRef NewUnit(float inFrequency, int inShared)
+{
+    TremeloUnitRef unit = NULL;
+    TREMELO_CHECK_NOERR(TremeloUnit_New(&unit));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetFormat(unit, 48000., 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetMaximumFramesPerSlice(unit, kSlice));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTimeLFO(unit, 1));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetSharedLFO(unit, inShared));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Frequency, inFrequency));
+    TREMELO_CHECK_NOERR(TremeloUnit_SetParameter(unit, kTremeloUnitParam_Depth, 80.f));
+    TREMELO_CHECK_NOERR(TremeloUnit_Initialize(unit));
+    return unit;
+}
+
+static void RenderSlice(int inUnit, uint32_t inOffset)
+{
+    const float *input[1] = { sInput + inOffset };
+    float *output[1] = { sOutput[inUnit] + inOffset };
+    TREMELO_CHECK_NOERR(TremeloUnit_Render(sUnits[inUnit], input, output, kSlice));
+}
+
+static void *RenderThread(void *inUnit)
+{
+    int unit = (int)(intptr_t)inUnit;
+    for (uint32_t offset = 0; offset + kSlice <= kFrames; offset += kSlice)
+        RenderSlice(unit, offset);
+    return NULL;
+}
+
+static void CheckOutputs(void)
+{
+    for (int k = 0; k < kUnits; ++k)
+        TREMELO_CHECK(memcmp(sOutput[k], sReference[k % 2], (kFrames / kSlice) * kSlice * sizeof(float)) == 0);
+}
+
+static void Restart(void)
+{
+    memset(sOutput, 0, sizeof(sOutput));
+    for (int k = 0; k < kUnits; ++k) {
+        TREMELO_CHECK_NOERR(TremeloUnit_Reset(sUnits[k]));
+        TREMELO_CHECK_NOERR(TremeloUnit_SetSampleTime(sUnits[k], 0.));
+    }
+}
+
+int main(void)
+{
+    TremeloTest_FillSignal(sInput, kFrames, 0);
+    for (int group = 0; group < 2; ++group) {
+        TremeloUnitRef reference = NewUnit(Frequency(group), 0);
+        const float *input[1] = { sInput };
+        float *output[1] = { sReference[group] };
+        TREMELO_CHECK_NOERR(TremeloTest_RenderChunked(reference, input, output, 1, kFrames, kSlice));
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(reference));
+    }
+    for (int k = 0; k < kUnits; ++k)
+        sUnits[k] = NewUnit(Frequency(k), 1);
+
+    // In turn on one thread: all but the first of each group copy every block.
+    for (uint32_t offset = 0; offset + kSlice <= kFrames; offset += kSlice)
+        for (int k = 0; k < kUnits; ++k)
+            RenderSlice(k, offset);
+    CheckOutputs();
+    uint64_t shared = 0;
+    for (int k = 0; k < kUnits; ++k) {
+        TremeloUnitGainCacheStats stats;
+        TREMELO_CHECK_NOERR(TremeloUnit_GetGainCacheStats(sUnits[k], &stats));
+        shared += stats.framesFromSharedLFO;
+    }
+    TREMELO_CHECK(shared >= (uint64_t)(kUnits - 2) * (kFrames / kSlice) * kSlice);
+
+    // Concurrently, so readers copy slots while writers fill them.
+    for (int round = 0; round < kRounds; ++round) {
+        Restart();
+        pthread_t threads[kUnits];
+        for (int k = 0; k < kUnits; ++k)
+            TREMELO_CHECK(pthread_create(&threads[k], NULL, RenderThread, (void *)(intptr_t)k) == 0);
+        for (int k = 0; k < kUnits; ++k)
+            pthread_join(threads[k], NULL);
+        CheckOutputs();
+    }
+
+    for (int k = 0; k < kUnits; ++k)
+        TREMELO_CHECK_NOERR(TremeloUnit_Dispose(sUnits[k]));
+    return 0;
+}
@@ -0,0 +1,73 @@
+//
+//  TremeloTest.h
+//  TremeloAUv2
+//
+//  Shared by the ctest programs in this directory. Each test is a plain program that
+//  drives the unit through the C API in TremeloUnitAPI.h (or a PublicUtility class
+//  directly) and exits non-zero at the first failed check, naming the file and line.
+//
+
+#ifndef TremeloTest_h
+#define TremeloTest_h
+
+#include "TremeloUnitAPI.h"
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TREMELO_CHECK(condition)                                                            \
+    do {                                                                                    \
+        if (!(condition)) {                                                                 \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition);   \
+            exit(1);                                                                        \
+        }                                                                                   \
+    } while (0)
+
+/// Checks that a call returned 0 (noErr), printing the OSStatus otherwise.
+#define TREMELO_CHECK_NOERR(call)                                                           \
+    do {                                                                                    \
+        int32_t tremeloStatus_ = (call);                                                    \
+        if (tremeloStatus_ != 0) {                                                          \
+            fprintf(stderr, "%s:%d: %s returned %d\n", __FILE__, __LINE__, #call,           \
+                    (int)tremeloStatus_);                                                   \
+            exit(1);                                                                        \
+        }                                                                                   \
+    } while (0)
+
+/// Fills inFrames samples of a channel with a deterministic test signal: a sine with a little
+/// noise on top, different for every channel, so no two samples are zero by accident.
+static inline void TremeloTest_FillSignal(float *outSamples, uint32_t inFrames, uint32_t inChannel)
+{
+    uint32_t seed = 0x9E3779B9u * (inChannel + 1);
+    for (uint32_t i = 0; i < inFrames; ++i) {
+        seed = seed * 1664525u + 1013904223u;
+        float noise = (float)(seed >> 8) / (float)(1u << 24) - 0.5f;
+        outSamples[i] = 0.5f * (float)sin(0.01 * (i + 1) * (inChannel + 1)) + 0.1f * noise;
+    }
+}
+
+/// Renders inFrames frames of inChannels channels through inUnit in calls of inChunk frames
+/// (the last one shorter), reading from inInput[c] + offset and writing to ioOutput[c] + offset.
+/// At most 16 channels.
+static inline int32_t TremeloTest_RenderChunked(TremeloUnitRef inUnit, const float *const *inInput, float *const *ioOutput,
+                                                uint32_t inChannels, uint32_t inFrames, uint32_t inChunk)
+{
+    for (uint32_t offset = 0; offset < inFrames; offset += inChunk) {
+        const float *input[16];
+        float *output[16];
+        uint32_t frames = inFrames - offset < inChunk ? inFrames - offset : inChunk;
+        for (uint32_t c = 0; c < inChannels; ++c) {
+            input[c] = inInput[c] + offset;
+            output[c] = ioOutput[c] + offset;
+        }
+        int32_t result = TremeloUnit_Render(inUnit, input, output, frames);
+        if (result != 0)
+            return result;
+    }
+    return 0;
+}
+
+#endif /* TremeloTest_h */